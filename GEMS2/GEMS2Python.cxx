@@ -40,7 +40,8 @@ PYBIND11_MODULE(GEMS2Python, m) {
             const py::array_t<double> &,
             const py::array_t<float> &,
             const py::array_t< int > &,
-            const py::array_t<double> &>(),
+            const py::array_t<double> &,
+            int>(),
             py::arg("typeName"),
             py::arg("images"),
             py::arg("boundaryCondition"),
@@ -49,7 +50,8 @@ PYBIND11_MODULE(GEMS2Python, m) {
             py::arg("variances")=py::array_t<double>(),
             py::arg("mixtureWeights")=py::array_t<float>(),
             py::arg("numberOfGaussiansPerClass")=py::array_t<int>(),
-            py::arg("targetPoints")=py::array_t<double>())
+            py::arg("targetPoints")=py::array_t<double>(),
+            py::arg("numberOfResolutionLevels")=1)
             .def("evaluate_mesh_position", &KvlCostAndGradientCalculator::EvaluateMeshPosition)
             // Aliases to help with profiling
             .def("evaluate_mesh_position_a", &KvlCostAndGradientCalculator::EvaluateMeshPosition)
@@ -32,10 +32,10 @@ public:
     //          << " and I'm running! " << std::endl;
               
               
-    // calculator = kvlGetCostAndGradientCalculator( typeName, image(s), boundaryCondition, transform )
+    // calculator = kvlGetCostAndGradientCalculator( typeName, image(s), boundaryCondition, transform, ..., numberOfResolutionLevels )
   
     // Make sure input arguments are correct
-    const  std::string  usageString = "Usage: calculator = kvlGetCostAndGradientCalculator( typeName, image(s), boundaryCondition, [ transform ], [ means ], [ variances ], [ mixtureWeights ], [ numberOfGaussiansPerClass ], [ targetPoints ] )\n where typeName = {'AtlasMeshToIntensityImage','ConditionalGaussianEntropy','MutualInformation','PointSet'}\n and boundaryCondition = {'Sliding', 'Affine', 'Translation', 'None'}";
+    const  std::string  usageString = "Usage: calculator = kvlGetCostAndGradientCalculator( typeName, image(s), boundaryCondition, [ transform ], [ means ], [ variances ], [ mixtureWeights ], [ numberOfGaussiansPerClass ], [ targetPoints ], [ numberOfResolutionLevels ] )\n where typeName = {'AtlasMeshToIntensityImage','ConditionalGaussianEntropy','MutualInformation','PointSet'}\n and boundaryCondition = {'Sliding', 'Affine', 'Translation', 'None'}";
     if ( ( nrhs < 3 ) || 
          !mxIsChar( prhs[ 0 ] ) || 
          !mxIsInt64( prhs[ 1 ] ) || 
@@ -293,6 +293,20 @@ public:
       } // End test if targetPoints are provided 
         
         
+    // Retrieve numberOfResolutionLevels if it is provided (only used for AtlasMeshToIntensityImage)
+    int  numberOfResolutionLevels = 1;
+    if ( nrhs > 9 )
+      {
+      // Sanity check
+      if ( !mxIsDouble( prhs[ 9 ] ) || ( mxGetNumberOfElements( prhs[ 9 ] ) != 1 ) )
+        {
+        mexErrMsgTxt( usageString.c_str() ); 
+        }
+        
+      numberOfResolutionLevels = static_cast< int >( *( mxGetPr( prhs[ 9 ] ) ) );
+      }
+        
+        
     // Construct the correct type of calculator
     AtlasMeshPositionCostAndGradientCalculator::Pointer  calculator = 0; 
     const std::string  typeName = mxArrayToString( prhs[ 0 ] );
@@ -305,6 +319,7 @@ public:
                           = AtlasMeshToIntensityImageCostAndGradientCalculator::New();
         myCalculator->SetImages( images );
         myCalculator->SetParameters( means, variances, mixtureWeights, numberOfGaussiansPerClass );
+        myCalculator->SetNumberOfResolutionLevels( numberOfResolutionLevels );
         calculator = myCalculator;
         break;
         } 
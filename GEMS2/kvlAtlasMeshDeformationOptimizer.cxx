@@ -1,4 +1,5 @@
 #include "kvlAtlasMeshDeformationOptimizer.h"
+#include <algorithm>
 
 
 namespace kvl
@@ -105,9 +106,27 @@ AtlasMeshDeformationOptimizer
   // If this is the first iteration, make sure to initialize some relevant variables 
   if ( m_IterationNumber == 0 )
     {
+    // Start on the coarsest level of the calculator's image pyramid (if any)
+    if ( m_Calculator )
+      {
+      m_Calculator->SetResolutionLevel( m_Calculator->GetNumberOfResolutionLevels() - 1 );
+      }
     this->Initialize();  
     }
     
+  // Coarse levels only get the first half of the iteration budget, so that the
+  // mesh is always refined on the full-resolution image before we stop
+  if ( m_Calculator && ( m_Calculator->GetResolutionLevel() > 0 ) &&
+       ( m_IterationNumber >= m_MaximumNumberOfIterations / 2 ) )
+    {
+    m_Calculator->SetResolutionLevel( 0 );
+    if ( m_Verbose )
+      {
+      std::cout << "Optimizer: coarse level budget used up; moving to resolution level 0" << std::endl;
+      }
+    this->Initialize();
+    }
+
   // Test if we're running out of time
   if ( m_IterationNumber >= m_MaximumNumberOfIterations )
     {
@@ -130,6 +149,21 @@ AtlasMeshDeformationOptimizer
     {
     if ( ( m_IterationNumber > 0 ) || ( maximalDeformation == 0.0 ) )
       {
+      // Converged on a coarse level: move on to the next finer one, restarting the
+      // search direction history since the cost function has changed under our feet
+      if ( m_Calculator && ( m_Calculator->GetResolutionLevel() > 0 ) )
+        {
+        m_Calculator->SetResolutionLevel( m_Calculator->GetResolutionLevel() - 1 );
+        if ( m_Verbose )
+          {
+          std::cout << "Optimizer: moving to resolution level " 
+                    << m_Calculator->GetResolutionLevel() << std::endl;
+          }
+        this->Initialize();
+        m_IterationNumber++;
+        return std::max( maximalDeformation, itk::NumericTraits< double >::min() );
+        }
+
       if ( m_Verbose )
         {
         std::cout << "Optimizer: maximalDeformation is too small; stopping" << std::endl;
@@ -13,6 +13,7 @@ AtlasMeshMultiAlphaDrawer
 ::AtlasMeshMultiAlphaDrawer()
 {
   m_Image = 0; 
+  m_WritesAreOrderIndependent = true;
 }  
 
 
@@ -57,26 +58,16 @@ AtlasMeshMultiAlphaDrawer
                         int threadNumber )
 {
   // Retrieve everything we need to know 
-  AtlasMesh::CellAutoPointer  cell;
-  mesh->GetCell( tetrahedronId, cell );
-
-  AtlasMesh::CellType::PointIdIterator  pit = cell->PointIdsBegin();
-  const AtlasMesh::PointIdentifier  id0 = *pit;
-  ++pit;
-  const AtlasMesh::PointIdentifier  id1 = *pit;
-  ++pit;
-  const AtlasMesh::PointIdentifier  id2 = *pit;
-  ++pit;
-  const AtlasMesh::PointIdentifier  id3 = *pit;
+  const AtlasMesh::PointIdentifier*  vertexIds = this->GetFlatTetrahedronVertexIds( tetrahedronId );
+  const AtlasMesh::PointIdentifier  id0 = vertexIds[ 0 ];
+  const AtlasMesh::PointIdentifier  id1 = vertexIds[ 1 ];
+  const AtlasMesh::PointIdentifier  id2 = vertexIds[ 2 ];
+  const AtlasMesh::PointIdentifier  id3 = vertexIds[ 3 ];
   
-  AtlasMesh::PointType p0;
-  AtlasMesh::PointType p1;
-  AtlasMesh::PointType p2;
-  AtlasMesh::PointType p3;
-  mesh->GetPoint( id0, &p0 );
-  mesh->GetPoint( id1, &p1 );
-  mesh->GetPoint( id2, &p2 );
-  mesh->GetPoint( id3, &p3 );
+  const AtlasMesh::PointType&  p0 = mesh->GetPoints()->ElementAt( id0 );
+  const AtlasMesh::PointType&  p1 = mesh->GetPoints()->ElementAt( id1 );
+  const AtlasMesh::PointType&  p2 = mesh->GetPoints()->ElementAt( id2 );
+  const AtlasMesh::PointType&  p3 = mesh->GetPoints()->ElementAt( id3 );
   
   // Loop over all voxels within the tetrahedron and do The Right Thing  
   TetrahedronInteriorIterator< ImageType::PixelType >  it( m_Image, p0, p1, p2, p3 );
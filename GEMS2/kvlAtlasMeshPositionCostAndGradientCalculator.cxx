@@ -21,6 +21,7 @@ AtlasMeshPositionCostAndGradientCalculator
   m_PositionGradient = 0;
   m_Abort = false;
   m_BoundaryCondition = SLIDING;
+  m_UsesFlatAlphas = true;
 
   this->SetMeshToImageTransform( TransformType::New() );
   
@@ -377,14 +378,12 @@ AtlasMeshPositionCostAndGradientCalculator
   //      CellType* cellptr = 0;
   //      this->GetCells()->GetElementIfIndexExists(cellId, &cellptr);
   //      cellPointer.TakeNoOwnership(cellptr);
-  AtlasMesh::CellType::PointIdIterator  pit = mesh->GetCells()->ElementAt( tetrahedronId )->PointIdsBegin();
-  const AtlasMesh::PointIdentifier  id0 = *pit;
-  ++pit;
-  const AtlasMesh::PointIdentifier  id1 = *pit;
-  ++pit;
-  const AtlasMesh::PointIdentifier  id2 = *pit;
-  ++pit;
-  const AtlasMesh::PointIdentifier  id3 = *pit;
+  // The vertex ids come from the flat tetrahedron table kept by the superclass
+  const AtlasMesh::PointIdentifier*  vertexIds = this->GetFlatTetrahedronVertexIds( tetrahedronId );
+  const AtlasMesh::PointIdentifier  id0 = vertexIds[ 0 ];
+  const AtlasMesh::PointIdentifier  id1 = vertexIds[ 1 ];
+  const AtlasMesh::PointIdentifier  id2 = vertexIds[ 2 ];
+  const AtlasMesh::PointIdentifier  id3 = vertexIds[ 3 ];
   
   //AtlasMesh::PointType p0;
   //AtlasMesh::PointType p1;
@@ -451,10 +450,14 @@ AtlasMeshPositionCostAndGradientCalculator
     m_ThreadSpecificDataTermRasterizationTimers[ threadNumber ].Start();
 #endif
     
-    const AtlasAlphasType&  alphasInVertex0 = mesh->GetPointData()->ElementAt( id0 ).m_Alphas;
-    const AtlasAlphasType&  alphasInVertex1 = mesh->GetPointData()->ElementAt( id1 ).m_Alphas;
-    const AtlasAlphasType&  alphasInVertex2 = mesh->GetPointData()->ElementAt( id2 ).m_Alphas;
-    const AtlasAlphasType&  alphasInVertex3 = mesh->GetPointData()->ElementAt( id3 ).m_Alphas;
+    AtlasAlphasType  alphasInVertex0;
+    AtlasAlphasType  alphasInVertex1;
+    AtlasAlphasType  alphasInVertex2;
+    AtlasAlphasType  alphasInVertex3;
+    this->GetFlatAlphas( id0, alphasInVertex0 );
+    this->GetFlatAlphas( id1, alphasInVertex1 );
+    this->GetFlatAlphas( id2, alphasInVertex2 );
+    this->GetFlatAlphas( id3, alphasInVertex3 );
   
     this->AddDataContributionOfTetrahedron( p0, p1, p2, p3,
                                             alphasInVertex0, 
@@ -86,6 +86,24 @@ public :
     {
     return m_BoundaryCondition;  
     }  
+
+  /** Image pyramid: level 0 is full resolution, and calculators that support it
+   * evaluate the data term on images downsampled by a factor 2^level. The
+   * deformation optimizers start at the coarsest level and move one level finer
+   * every time they converge. */
+  virtual int  GetNumberOfResolutionLevels() const
+    {
+    return 1;
+    }
+
+  /** */
+  virtual void  SetResolutionLevel( int level ) {}
+
+  /** */
+  virtual int  GetResolutionLevel() const
+    {
+    return 0;
+    }
   
   
 protected:
@@ -1,6 +1,7 @@
 #include "kvlAtlasMeshRasterizor.h"
 
-static itk::SimpleFastMutexLock rasterizorMutex;
+#include <algorithm>
+#include <cmath>
 
 
 
@@ -15,6 +16,97 @@ AtlasMeshRasterizor
 ::AtlasMeshRasterizor()
 {
   m_NumberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  m_BrickSize = 16;
+  m_WritesAreOrderIndependent = false;
+  m_UsesFlatAlphas = false;
+  m_FlatCells = 0;
+  m_FlatCellsMTime = 0;
+  m_FlatNumberOfClasses = 0;
+}
+
+
+
+//
+//
+//
+void
+AtlasMeshRasterizor
+::UpdateFlatMesh( const AtlasMesh* mesh )
+{
+
+  // Tetrahedron -> vertex table. The topology rarely changes (only when the mesh
+  // is edited), so only rebuild when we're handed a different or modified cells container
+  const AtlasMesh::CellsContainer*  cells = mesh->GetCells();
+  if ( ( cells != m_FlatCells ) || ( cells->GetMTime() != m_FlatCellsMTime ) )
+    {
+    m_FlatTetrahedronIds.clear();
+    m_FlatTetrahedronVertexIds.clear();
+    AtlasMesh::CellIdentifier  maximumCellId = 0;
+    for ( AtlasMesh::CellsContainer::ConstIterator  cellIt = cells->Begin();
+          cellIt != cells->End(); ++cellIt )
+      {
+      maximumCellId = std::max( maximumCellId, cellIt.Index() );
+      if ( cellIt.Value()->GetType() != AtlasMesh::CellType::TETRAHEDRON_CELL )
+        {
+        continue;
+        }
+
+      m_FlatTetrahedronIds.push_back( cellIt.Index() );
+      AtlasMesh::CellType::PointIdConstIterator  pit = cellIt.Value()->PointIdsBegin();
+      for ( int i = 0; i < 4; i++, ++pit )
+        {
+        m_FlatTetrahedronVertexIds.push_back( *pit );
+        }
+      }
+
+    m_FlatTetrahedronIndices.assign( maximumCellId + 1, -1 );
+    for ( size_t tetrahedronNumber = 0; tetrahedronNumber < m_FlatTetrahedronIds.size(); tetrahedronNumber++ )
+      {
+      m_FlatTetrahedronIndices[ m_FlatTetrahedronIds[ tetrahedronNumber ] ] = tetrahedronNumber;
+      }
+
+    m_FlatCells = cells;
+    m_FlatCellsMTime = cells->GetMTime();
+    }
+
+
+  // Packed alphas, one row of m_FlatNumberOfClasses per point id
+  if ( m_UsesFlatAlphas && mesh->GetPointData()->Size() > 0 )
+    {
+    m_FlatNumberOfClasses = mesh->GetPointData()->Begin().Value().m_Alphas.Size();
+    AtlasMesh::PointIdentifier  maximumPointId = 0;
+    for ( AtlasMesh::PointDataContainer::ConstIterator  it = mesh->GetPointData()->Begin();
+          it != mesh->GetPointData()->End(); ++it )
+      {
+      maximumPointId = std::max( maximumPointId, it.Index() );
+      }
+    m_FlatAlphas.resize( ( maximumPointId + 1 ) * m_FlatNumberOfClasses );
+    for ( AtlasMesh::PointDataContainer::ConstIterator  it = mesh->GetPointData()->Begin();
+          it != mesh->GetPointData()->End(); ++it )
+      {
+      std::copy( it.Value().m_Alphas.begin(), it.Value().m_Alphas.end(),
+                 m_FlatAlphas.begin() + it.Index() * m_FlatNumberOfClasses );
+      }
+    }
+
+}
+
+
+
+//
+// Interleave the bits of three brick coordinates into a Morton (Z-order) key, so
+// that sorting on the key keeps bricks that are close in space close in memory
+//
+static inline unsigned long long  MortonKey( unsigned int x, unsigned int y, unsigned int z )
+{
+  unsigned long long  key = 0;
+  for ( int bit = 0; bit < 21; bit++ )
+    {
+    key |= ( static_cast< unsigned long long >( ( x >> bit ) & 1 ) << ( 3 * bit ) ) |
+           ( static_cast< unsigned long long >( ( y >> bit ) & 1 ) << ( 3 * bit + 1 ) ) |
+           ( static_cast< unsigned long long >( ( z >> bit ) & 1 ) << ( 3 * bit + 2 ) );
+    }
+  return key;
 }
 
 
@@ -31,26 +123,112 @@ AtlasMeshRasterizor
   ThreadStruct  str;
   str.m_Rasterizor = this;
   str.m_Mesh = mesh;
-  for ( AtlasMesh::CellsContainer::ConstIterator  cellIt = mesh->GetCells()->Begin();
-        cellIt != mesh->GetCells()->End(); ++cellIt )
+  str.m_NextBrick = 0;
+  str.m_Abort = false;
+
+  // Bring the flat copies of the mesh up to date
+  this->UpdateFlatMesh( mesh );
+
+  // Collect the tetrahedra together with their centroid and an estimate of how
+  // much work they are (roughly the number of voxels they cover, plus a fixed
+  // cost for setting up each one)
+  const std::vector< AtlasMesh::CellIdentifier >&  ids = m_FlatTetrahedronIds;
+  const int  numberOfTetrahedra = ids.size();
+  if ( numberOfTetrahedra == 0 )
+    {
+    return;
+    }
+  std::vector< AtlasMesh::PointType >  centroids( numberOfTetrahedra );
+  std::vector< double >  costs( numberOfTetrahedra );
+  AtlasMesh::PointType  minCentroid;
+  minCentroid.Fill( itk::NumericTraits< AtlasMesh::PointType::ValueType >::max() );
+  for ( int tetrahedronNumber = 0; tetrahedronNumber < numberOfTetrahedra; tetrahedronNumber++ )
+    {
+    const AtlasMesh::PointIdentifier*  vertexIds = &m_FlatTetrahedronVertexIds[ 4 * tetrahedronNumber ];
+    const AtlasMesh::PointType*  p[ 4 ];
+    for ( int i = 0; i < 4; i++ )
+      {
+      p[ i ] = &( mesh->GetPoints()->ElementAt( vertexIds[ i ] ) );
+      }
+
+    AtlasMesh::PointType  centroid;
+    double  e[ 3 ][ 3 ];
+    for ( int d = 0; d < 3; d++ )
+      {
+      centroid[ d ] = ( ( *p[ 0 ] )[ d ] + ( *p[ 1 ] )[ d ] + ( *p[ 2 ] )[ d ] + ( *p[ 3 ] )[ d ] ) / 4.0;
+      minCentroid[ d ] = std::min( minCentroid[ d ], centroid[ d ] );
+      for ( int i = 0; i < 3; i++ )
+        {
+        e[ i ][ d ] = ( *p[ i+1 ] )[ d ] - ( *p[ 0 ] )[ d ];
+        }
+      }
+    const double  volume = std::abs( e[ 0 ][ 0 ] * ( e[ 1 ][ 1 ] * e[ 2 ][ 2 ] - e[ 1 ][ 2 ] * e[ 2 ][ 1 ] ) -
+                                     e[ 0 ][ 1 ] * ( e[ 1 ][ 0 ] * e[ 2 ][ 2 ] - e[ 1 ][ 2 ] * e[ 2 ][ 0 ] ) +
+                                     e[ 0 ][ 2 ] * ( e[ 1 ][ 0 ] * e[ 2 ][ 1 ] - e[ 1 ][ 1 ] * e[ 2 ][ 0 ] ) ) / 6.0;
+
+    centroids[ tetrahedronNumber ] = centroid;
+    costs[ tetrahedronNumber ] = 10.0 + volume;
+    }
+
+  // Sort the tetrahedra into bricks, visiting the bricks in Morton order. Ties are
+  // broken on the original position so the order only depends on the mesh
+  const double  brickSize = std::max( 1, m_BrickSize );
+  std::vector< unsigned long long >  keys( numberOfTetrahedra );
+  std::vector< int >  order( numberOfTetrahedra );
+  for ( int tetrahedronNumber = 0; tetrahedronNumber < numberOfTetrahedra; tetrahedronNumber++ )
     {
-    if ( cellIt.Value()->GetType() == AtlasMesh::CellType::TETRAHEDRON_CELL )
+    unsigned int  brick[ 3 ];
+    for ( int d = 0; d < 3; d++ )
       {
-      str.m_TetrahedronIds.push_back( cellIt.Index() );
-      //str.m_TetrahedronIds.insert( cellIt.Index() );
+      brick[ d ] = static_cast< unsigned int >( ( centroids[ tetrahedronNumber ][ d ] - minCentroid[ d ] ) / brickSize );
       }
+    keys[ tetrahedronNumber ] = MortonKey( brick[ 0 ], brick[ 1 ], brick[ 2 ] );
+    order[ tetrahedronNumber ] = tetrahedronNumber;
+    }
+  std::sort( order.begin(), order.end(),
+             [ &keys ]( int a, int b ) { return ( keys[ a ] < keys[ b ] ) || ( keys[ a ] == keys[ b ] && a < b ); } );
+
+  str.m_TetrahedronIds.resize( numberOfTetrahedra );
+  double  totalCost = 0.0;
+  for ( int i = 0; i < numberOfTetrahedra; i++ )
+    {
+    str.m_TetrahedronIds[ i ] = ids[ order[ i ] ];
+    totalCost += costs[ order[ i ] ];
+    if ( i == 0 || keys[ order[ i ] ] != keys[ order[ i-1 ] ] )
+      {
+      str.m_BrickStarts.push_back( i );
+      }
+    }
+  str.m_BrickStarts.push_back( numberOfTetrahedra );
+
+  // For the static schedule, cut the sorted list into one contiguous range per
+  // thread with about equal estimated cost
+  const int  numberOfThreads = this->GetNumberOfThreads();
+  str.m_ThreadStarts.push_back( 0 );
+  double  cumulativeCost = 0.0;
+  for ( int i = 0; i < numberOfTetrahedra; i++ )
+    {
+    while ( static_cast< int >( str.m_ThreadStarts.size() ) < numberOfThreads &&
+            cumulativeCost >= totalCost * str.m_ThreadStarts.size() / numberOfThreads )
+      {
+      str.m_ThreadStarts.push_back( i );
+      }
+    cumulativeCost += costs[ order[ i ] ];
+    }
+  while ( static_cast< int >( str.m_ThreadStarts.size() ) <= numberOfThreads )
+    {
+    str.m_ThreadStarts.push_back( numberOfTetrahedra );
     }
 
   // Set up the multithreader
   itk::MultiThreader::Pointer  threader = itk::MultiThreader::New();
-  threader->SetNumberOfThreads( this->GetNumberOfThreads() );
-  //threader->SetNumberOfThreads( 1 );
+  threader->SetNumberOfThreads( numberOfThreads );
   threader->SetSingleMethod( this->ThreaderCallback, &str );
 
   // Let the beast go
   threader->SingleMethodExecute();
 
-  
+
 }
 
 
@@ -66,101 +244,69 @@ AtlasMeshRasterizor
 
   // Retrieve the input arguments
   const int  threadNumber = ((itk::MultiThreader::ThreadInfoStruct *)(arg))->ThreadID;
-  const int  numberOfThreads = ((itk::MultiThreader::ThreadInfoStruct *)(arg))->NumberOfThreads;
   ThreadStruct*  str = (ThreadStruct *)(((itk::MultiThreader::ThreadInfoStruct *)(arg))->UserData);
 
-  
-#if 1  
-  // Compute up-front which tetrahedra this thread should be responsible for. This isn't a 
-  // particularly good way of load-balancing, but it does allow us to get the exact same
-  // round-off errors (by adding many floating-point contributions) every single time we
-  // repeat the same computation on the same computer with the same number of threads.
-  const int  numberOfTetrahedra = str->m_TetrahedronIds.size();
-#if 0  
-  const int  numberOfTetrahedraPerThread = 
-          itk::Math::Ceil< int >( static_cast< double >( numberOfTetrahedra ) / numberOfThreads );
-  const int  thisThreadStartNumber =  threadNumber * numberOfTetrahedraPerThread;
-  int  thisThreadEndNumber =  thisThreadStartNumber + numberOfTetrahedraPerThread - 1;
-  if ( thisThreadEndNumber > (numberOfTetrahedra-1) )
+  if ( str->m_Rasterizor->m_WritesAreOrderIndependent )
     {
-    thisThreadEndNumber = (numberOfTetrahedra-1);
-    }
-    
-  // Rasterize all tetrahedra assigned to this thread  
-  for ( int tetrahedronNumber = thisThreadStartNumber; 
-        tetrahedronNumber <= thisThreadEndNumber; 
-        tetrahedronNumber++ )
-#else
-  // Rasterize all tetrahedra assigned to this thread  
-  for ( int tetrahedronNumber = threadNumber; 
-        tetrahedronNumber < numberOfTetrahedra; 
-        tetrahedronNumber += numberOfThreads )
-#endif
-    {
-    if ( !str->m_Rasterizor->RasterizeTetrahedron( str->m_Mesh, 
-                                                   str->m_TetrahedronIds[ tetrahedronNumber ],
-                                                   threadNumber ) )
-      {
-      // Something wrong with this tetrahedron; abort at least this thread
-      break;
-      }  
-      
-    }
-#else
-
-  while ( true )
-    { 
-    rasterizorMutex.Lock();
-
-    // Check if there is anything left to do
-    if ( str->m_TetrahedronIds.size() == 0 )
+    // Every voxel is written by exactly one tetrahedron, so it doesn't matter who
+    // does what: keep grabbing the next unclaimed brick until there are none left
+    const int  numberOfBricks = str->m_BrickStarts.size() - 1;
+    while ( !str->m_Abort )
       {
-      rasterizorMutex.Unlock();
-      return ITK_THREAD_RETURN_VALUE;
-      }
-
-    // Let's define how many tetrahedra this thread is going to take on 
-    const int  numberOfTetrahedra = 100;
-
-    // Pop the first numberOfTetrahedra tetrahedra on the list
-    std::vector< AtlasMesh::CellIdentifier >  thisThreadTetrahedronIds;
-    for ( int i = 0; i < numberOfTetrahedra; i++ )
-      {
-      const AtlasMesh::CellIdentifier  tetrahedronId = *( str->m_TetrahedronIds.begin() );
-      str->m_TetrahedronIds.erase( tetrahedronId );
-      thisThreadTetrahedronIds.push_back( tetrahedronId );
-      if ( str->m_TetrahedronIds.size() == 0 )
+      const int  brickNumber = str->m_NextBrick++;
+      if ( brickNumber >= numberOfBricks )
         {
         break;
         }
+
+      for ( int tetrahedronNumber = str->m_BrickStarts[ brickNumber ];
+            tetrahedronNumber < str->m_BrickStarts[ brickNumber+1 ];
+            tetrahedronNumber++ )
+        {
+        if ( !str->m_Rasterizor->RasterizeTetrahedron( str->m_Mesh,
+                                                       str->m_TetrahedronIds[ tetrahedronNumber ],
+                                                       threadNumber ) )
+          {
+          // Something wrong with this tetrahedron; make sure all threads stop ASAP
+          str->m_Abort = true;
+          break;
+          }
+        }
       }
 
-    rasterizorMutex.Unlock();
+    return ITK_THREAD_RETURN_VALUE;
+    }
 
 
-    
-    for ( std::vector< AtlasMesh::CellIdentifier >::const_iterator  it = thisThreadTetrahedronIds.begin();
-          it != thisThreadTetrahedronIds.end(); ++it )
+  // Each thread works through its own fixed range(s) of bricks, in order. The ranges
+  // are balanced on estimated cost, and because they only depend on the mesh and
+  // the number of threads we get the exact same round-off errors (by adding many
+  // floating-point contributions into thread-specific buffers) every single time
+  // we repeat the same computation on the same computer with the same number of threads.
+  // (The threader may give us fewer threads than asked for, hence the outer loop.)
+  const int  numberOfThreads = ((itk::MultiThreader::ThreadInfoStruct *)(arg))->NumberOfThreads;
+  const int  numberOfRanges = str->m_ThreadStarts.size() - 1;
+  for ( int rangeNumber = threadNumber; rangeNumber < numberOfRanges; rangeNumber += numberOfThreads )
+    {
+    for ( int tetrahedronNumber = str->m_ThreadStarts[ rangeNumber ];
+          tetrahedronNumber < str->m_ThreadStarts[ rangeNumber+1 ];
+          tetrahedronNumber++ )
       {
-      // 
-      if ( !str->m_Rasterizor->RasterizeTetrahedron( str->m_Mesh, *it ) )
+      if ( str->m_Abort )
         {
-        // Something wrong with this tetrahedron; abort this thread and 
-        // make sure other threads also stop ASAP
-        rasterizorMutex.Lock();
-        str->m_TetrahedronIds.clear();
-        rasterizorMutex.Unlock();
-          
         return ITK_THREAD_RETURN_VALUE;
         }
-        
-      }  
-
-    } // End infinite loop   
-      
-#endif
-    
-  
+      if ( !str->m_Rasterizor->RasterizeTetrahedron( str->m_Mesh,
+                                                     str->m_TetrahedronIds[ tetrahedronNumber ],
+                                                     threadNumber ) )
+        {
+        // Something wrong with this tetrahedron; abort all threads
+        str->m_Abort = true;
+        return ITK_THREAD_RETURN_VALUE;
+        }
+      }
+    }
+
   return ITK_THREAD_RETURN_VALUE;
 }
 
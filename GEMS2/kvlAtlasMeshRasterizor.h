@@ -2,6 +2,7 @@
 #define __kvlAtlasMeshRasterizor_h
 
 #include "kvlAtlasMesh.h"
+#include <atomic>
 
 
 
@@ -39,6 +40,18 @@ public:
     return m_NumberOfThreads;
     }
 
+  /** Edge length (in voxels) of the cubic bricks that tetrahedra are sorted into */
+  void SetBrickSize( int brickSize )
+    {
+    m_BrickSize = brickSize;
+    }
+
+  /** */
+  int GetBrickSize() const
+    {
+    return m_BrickSize;
+    }
+
 protected:
   AtlasMeshRasterizor();
   virtual ~AtlasMeshRasterizor() {};
@@ -54,22 +67,66 @@ protected:
    * control to ThreadedGenerateData(). */
   static ITK_THREAD_RETURN_TYPE ThreaderCallback( void *arg );
   
-  /** Internal structure used for passing information to the threading library */
+  /** Internal structure used for passing information to the threading library.
+   * m_TetrahedronIds is sorted brick by brick; m_ThreadStarts holds, for the
+   * static schedule, where each thread's range starts (one extra entry at the end),
+   * and m_BrickStarts, for the dynamic schedule, where each brick starts. */
   struct ThreadStruct
     {
     Pointer  m_Rasterizor;
     AtlasMesh::ConstPointer  m_Mesh;
     std::vector< AtlasMesh::CellIdentifier >  m_TetrahedronIds;
-    //std::set< AtlasMesh::CellIdentifier >  m_TetrahedronIds;
+    std::vector< int >  m_ThreadStarts;
+    std::vector< int >  m_BrickStarts;
+    std::atomic< int >  m_NextBrick;
+    std::atomic< bool >  m_Abort;
     };
 
-                                     
+  /** Set by subclasses whose RasterizeTetrahedron() only assigns to voxels of
+   * the tetrahedron (the drawers) rather than accumulating into thread-specific
+   * buffers. Their bricks are then handed out dynamically to whichever thread is
+   * free; for everyone else each thread gets a fixed, cost-balanced range so that
+   * floating-point sums are the same every time. */
+  bool  m_WritesAreOrderIndependent;
+
+  /** Flat copies of the mesh, refreshed by Rasterize() before any tetrahedron is
+   * visited. The four vertex ids of every tetrahedron sit in one contiguous table
+   * that is only rebuilt when the mesh's cells change; subclasses that set
+   * m_UsesFlatAlphas also get the alphas of all points packed into one array,
+   * refreshed on every call since alphas are edited in place. Both replace
+   * per-tetrahedron walks through the itk::Mesh cell and point data containers. */
+  void UpdateFlatMesh( const AtlasMesh* mesh );
+
+  /** */
+  const AtlasMesh::PointIdentifier*  GetFlatTetrahedronVertexIds( AtlasMesh::CellIdentifier tetrahedronId ) const
+    {
+    return &m_FlatTetrahedronVertexIds[ 4 * m_FlatTetrahedronIndices[ tetrahedronId ] ];
+    }
+
+  /** Points alphas at the packed alphas of pointId, without copying */
+  void GetFlatAlphas( AtlasMesh::PointIdentifier pointId, AtlasAlphasType& alphas ) const
+    {
+    alphas.SetData( const_cast< float* >( &m_FlatAlphas[ pointId * m_FlatNumberOfClasses ] ),
+                    m_FlatNumberOfClasses, false );
+    }
+
+  bool  m_UsesFlatAlphas;
+
 
 private:
   AtlasMeshRasterizor(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
   
   int  m_NumberOfThreads;
+  int  m_BrickSize;
+
+  const AtlasMesh::CellsContainer*  m_FlatCells;
+  unsigned long  m_FlatCellsMTime;
+  std::vector< AtlasMesh::CellIdentifier >  m_FlatTetrahedronIds;
+  std::vector< int >  m_FlatTetrahedronIndices;
+  std::vector< AtlasMesh::PointIdentifier >  m_FlatTetrahedronVertexIds;
+  std::vector< float >  m_FlatAlphas;
+  int  m_FlatNumberOfClasses;
   
 };
 
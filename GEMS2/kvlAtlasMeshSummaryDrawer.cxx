@@ -14,6 +14,7 @@ AtlasMeshSummaryDrawer
 {
   m_Image = 0; 
   m_CompressionLookupTable = 0;
+  m_WritesAreOrderIndependent = true;
 }  
 
 
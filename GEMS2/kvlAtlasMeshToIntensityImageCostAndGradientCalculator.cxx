@@ -3,6 +3,7 @@
 #include <itkMath.h>
 #include "vnl/vnl_matrix_fixed.h"
 #include "kvlTetrahedronInteriorConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
 
 
 
@@ -17,6 +18,9 @@ AtlasMeshToIntensityImageCostAndGradientCalculator
 {
 
   m_LikelihoodFilter = LikelihoodFilterType::New();  
+  m_NumberOfResolutionLevels = 1;
+  m_ResolutionLevel = 0;
+  m_LikelihoodPyramidMTime = 0;
   
 }
 
@@ -72,6 +76,30 @@ AtlasMeshToIntensityImageCostAndGradientCalculator
   // Make sure the likelihoods are up-to-date
   //m_LikelihoodFilter->SetNumberOfThreads( 1 );
   m_LikelihoodFilter->Update();
+
+  // Make sure the downsampled likelihoods are up-to-date too. They're built one
+  // level from the next, and only when the likelihoods have actually changed
+  // (i.e., once per set of Gaussian mixture parameters, not once per iteration)
+  if ( m_ResolutionLevel > 0 )
+    {
+    if ( m_LikelihoodFilter->GetOutput()->GetMTime() != m_LikelihoodPyramidMTime )
+      {
+      m_LikelihoodPyramid.clear();
+      m_LikelihoodPyramid.push_back( m_LikelihoodFilter->GetOutput() );
+      m_LikelihoodPyramidMTime = m_LikelihoodFilter->GetOutput()->GetMTime();
+      }
+    while ( static_cast< int >( m_LikelihoodPyramid.size() ) <= m_ResolutionLevel )
+      {
+      m_LikelihoodPyramid.push_back( 
+              DownsampleLikelihoods( m_LikelihoodPyramid.back() ).GetPointer() );
+      }
+    }
+  else if ( !m_LikelihoodPyramid.empty() )
+    {
+    // Back on full resolution: the coarse levels won't be used again
+    m_LikelihoodPyramid.clear();
+    m_LikelihoodPyramidMTime = 0;
+    }
   
   // Now rasterize
   Superclass::Rasterize( mesh );
@@ -102,9 +130,36 @@ AtlasMeshToIntensityImageCostAndGradientCalculator
                                     AtlasPositionGradientType&  gradientInVertex3 )
 {
   
+  // On a coarse level of the pyramid, voxel i covers full-resolution voxels 
+  // factor*i ... factor*i+factor-1, so map the vertices accordingly. Each coarse voxel
+  // stands in for factor^3 full-resolution ones, and moving a vertex by one full-resolution
+  // voxel moves it by 1/factor coarse voxels: scale cost and gradient to match
+  const LikelihoodImageType*  likelihoods = m_LikelihoodFilter->GetOutput();
+  AtlasMesh::PointType  q0 = p0;
+  AtlasMesh::PointType  q1 = p1;
+  AtlasMesh::PointType  q2 = p2;
+  AtlasMesh::PointType  q3 = p3;
+  double  costWeight = 1.0;
+  double  gradientWeight = 1.0;
+  if ( m_ResolutionLevel > 0 )
+    {
+    likelihoods = m_LikelihoodPyramid[ m_ResolutionLevel ];
+    const double  factor = 1 << m_ResolutionLevel;
+    const double  offset = ( factor - 1 ) / 2.0;
+    for ( int d = 0; d < 3; d++ )
+      {
+      q0[ d ] = ( p0[ d ] - offset ) / factor;
+      q1[ d ] = ( p1[ d ] - offset ) / factor;
+      q2[ d ] = ( p2[ d ] - offset ) / factor;
+      q3[ d ] = ( p3[ d ] - offset ) / factor;
+      }
+    costWeight = factor * factor * factor;
+    gradientWeight = factor * factor;
+    }
+
   // Loop over all voxels within the tetrahedron and do The Right Thing  
   const int  numberOfClasses = alphasInVertex0.Size();
-  TetrahedronInteriorConstIterator< LikelihoodFilterType::OutputPixelType >  it( m_LikelihoodFilter->GetOutput(), p0, p1, p2, p3 );
+  TetrahedronInteriorConstIterator< LikelihoodFilterType::OutputPixelType >  it( likelihoods, q0, q1, q2, q3 );
   for ( unsigned int classNumber = 0; classNumber < numberOfClasses; classNumber++ )
     {
     it.AddExtraLoading( alphasInVertex0[ classNumber ], 
@@ -144,13 +199,19 @@ AtlasMeshToIntensityImageCostAndGradientCalculator
       
     //  Add contribution to log-likelihood
     likelihood = likelihood + 1e-15; //dont want to divide by zero
-    priorPlusDataCost -= log( likelihood );
+    priorPlusDataCost -= costWeight * log( likelihood );
 
 
     //
     xGradientBasis /= likelihood;
     yGradientBasis /= likelihood;
     zGradientBasis /= likelihood;
+    if ( m_ResolutionLevel > 0 )
+      {
+      xGradientBasis *= gradientWeight;
+      yGradientBasis *= gradientWeight;
+      zGradientBasis *= gradientWeight;
+      }
 
     // Add contribution to gradient in vertex 0
     gradientInVertex0[ 0 ] += xGradientBasis * it.GetPi0();
@@ -180,4 +241,71 @@ AtlasMeshToIntensityImageCostAndGradientCalculator
 
 
 
+//
+//
+//
+AtlasMeshToIntensityImageCostAndGradientCalculator::LikelihoodImageType::Pointer
+AtlasMeshToIntensityImageCostAndGradientCalculator
+::DownsampleLikelihoods( const LikelihoodImageType* likelihoods )
+{
+  // Each coarse voxel gets the average of the (non-empty) likelihood vectors of the
+  // 2x2x2 block of fine voxels it covers, or stays empty if they're all empty
+  const LikelihoodImageType::RegionType  fineRegion = likelihoods->GetBufferedRegion();
+  LikelihoodImageType::SizeType  coarseSize;
+  for ( int d = 0; d < 3; d++ )
+    {
+    coarseSize[ d ] = ( fineRegion.GetSize()[ d ] + 1 ) / 2;
+    }
+  LikelihoodImageType::Pointer  coarse = LikelihoodImageType::New();
+  coarse->SetRegions( coarseSize );
+  coarse->Allocate();
+
+  for ( itk::ImageRegionIteratorWithIndex< LikelihoodImageType >  it( coarse, coarse->GetBufferedRegion() );
+        !it.IsAtEnd(); ++it )
+    {
+    LikelihoodFilterType::OutputPixelType  sum;
+    int  numberOfContributions = 0;
+    for ( int dz = 0; dz < 2; dz++ )
+      {
+      for ( int dy = 0; dy < 2; dy++ )
+        {
+        for ( int dx = 0; dx < 2; dx++ )
+          {
+          LikelihoodImageType::IndexType  fineIndex = fineRegion.GetIndex();
+          fineIndex[ 0 ] += 2 * it.GetIndex()[ 0 ] + dx;
+          fineIndex[ 1 ] += 2 * it.GetIndex()[ 1 ] + dy;
+          fineIndex[ 2 ] += 2 * it.GetIndex()[ 2 ] + dz;
+          if ( !fineRegion.IsInside( fineIndex ) )
+            {
+            continue;
+            }
+          const LikelihoodFilterType::OutputPixelType&  value = likelihoods->GetPixel( fineIndex );
+          if ( value.Size() == 0 )
+            {
+            continue;
+            }
+          if ( numberOfContributions == 0 )
+            {
+            sum = value;
+            }
+          else
+            {
+            sum += value;
+            }
+          numberOfContributions++;
+          }
+        }
+      }
+    if ( numberOfContributions > 1 )
+      {
+      sum /= numberOfContributions;
+      }
+    it.Value() = sum;
+    }
+
+  return coarse;
+}
+
+
+
 } // end namespace kvl
@@ -4,6 +4,8 @@
 #include "kvlAtlasMeshPositionCostAndGradientCalculator.h"
 #include "itkImage.h"
 #include "kvlGMMLikelihoodImageFilter.h"
+#include <vector>
+#include <algorithm>
 
 
 namespace kvl
@@ -43,6 +45,33 @@ public :
     
   /** */  
   void Rasterize( const AtlasMesh* mesh );
+
+  /** Number of pyramid levels to use (1, the default, means full resolution only).
+   * Level n rasterizes against the likelihoods averaged over 2^n x 2^n x 2^n blocks,
+   * with cost and gradient rescaled to full-resolution units */
+  void  SetNumberOfResolutionLevels( int numberOfResolutionLevels )
+    {
+    m_NumberOfResolutionLevels = std::max( numberOfResolutionLevels, 1 );
+    m_ResolutionLevel = std::min( m_ResolutionLevel, m_NumberOfResolutionLevels - 1 );
+    }
+
+  /** */
+  int  GetNumberOfResolutionLevels() const
+    {
+    return m_NumberOfResolutionLevels;
+    }
+
+  /** */
+  void  SetResolutionLevel( int level )
+    {
+    m_ResolutionLevel = std::max( 0, std::min( level, m_NumberOfResolutionLevels - 1 ) );
+    }
+
+  /** */
+  int  GetResolutionLevel() const
+    {
+    return m_ResolutionLevel;
+    }
   
   
 protected:
@@ -70,6 +99,15 @@ private:
   //
   typedef GMMLikelihoodImageFilter< ImageType >  LikelihoodFilterType;
   LikelihoodFilterType::Pointer  m_LikelihoodFilter;
+
+  //
+  typedef LikelihoodFilterType::OutputImageType  LikelihoodImageType;
+  static LikelihoodImageType::Pointer  DownsampleLikelihoods( const LikelihoodImageType* likelihoods );
+
+  int  m_NumberOfResolutionLevels;
+  int  m_ResolutionLevel;
+  std::vector< LikelihoodImageType::ConstPointer >  m_LikelihoodPyramid;
+  unsigned long  m_LikelihoodPyramidMTime;
   
 };
 
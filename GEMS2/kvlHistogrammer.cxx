@@ -19,6 +19,7 @@ Histogrammer
 
   m_MinLogLikelihood = 0;
   m_Image = 0;
+  m_UsesFlatAlphas = true;
   m_BinnedImage = 0;
   m_NumberOfBins = 0;
   
@@ -279,33 +280,27 @@ Histogrammer
                         int threadNumber )
 {
   // Retrieve necessary info about tetrahedron
-  AtlasMesh::CellAutoPointer  cell;
-  mesh->GetCell( tetrahedronId, cell );
-
-  AtlasMesh::CellType::PointIdIterator  pit = cell->PointIdsBegin();
-  const AtlasMesh::PointIdentifier  id0 = *pit;
-  ++pit;
-  const AtlasMesh::PointIdentifier  id1 = *pit;
-  ++pit;
-  const AtlasMesh::PointIdentifier  id2 = *pit;
-  ++pit;
-  const AtlasMesh::PointIdentifier  id3 = *pit;
+  const AtlasMesh::PointIdentifier*  vertexIds = this->GetFlatTetrahedronVertexIds( tetrahedronId );
+  const AtlasMesh::PointIdentifier  id0 = vertexIds[ 0 ];
+  const AtlasMesh::PointIdentifier  id1 = vertexIds[ 1 ];
+  const AtlasMesh::PointIdentifier  id2 = vertexIds[ 2 ];
+  const AtlasMesh::PointIdentifier  id3 = vertexIds[ 3 ];
   
-  AtlasMesh::PointType p0;
-  AtlasMesh::PointType p1;
-  AtlasMesh::PointType p2;
-  AtlasMesh::PointType p3;
-  mesh->GetPoint( id0, &p0 );
-  mesh->GetPoint( id1, &p1 );
-  mesh->GetPoint( id2, &p2 );
-  mesh->GetPoint( id3, &p3 );
+  const AtlasMesh::PointType&  p0 = mesh->GetPoints()->ElementAt( id0 );
+  const AtlasMesh::PointType&  p1 = mesh->GetPoints()->ElementAt( id1 );
+  const AtlasMesh::PointType&  p2 = mesh->GetPoints()->ElementAt( id2 );
+  const AtlasMesh::PointType&  p3 = mesh->GetPoints()->ElementAt( id3 );
   
   // Loop over all voxels within the tetrahedron and do The Right Thing  
   TetrahedronInteriorConstIterator< BinnedImageType::PixelType >  it( m_BinnedImage, p0, p1, p2, p3 );
-  const AtlasAlphasType&  alphasInVertex0 = mesh->GetPointData()->ElementAt( id0 ).m_Alphas;
-  const AtlasAlphasType&  alphasInVertex1 = mesh->GetPointData()->ElementAt( id1 ).m_Alphas;
-  const AtlasAlphasType&  alphasInVertex2 = mesh->GetPointData()->ElementAt( id2 ).m_Alphas;
-  const AtlasAlphasType&  alphasInVertex3 = mesh->GetPointData()->ElementAt( id3 ).m_Alphas;
+  AtlasAlphasType  alphasInVertex0;
+  AtlasAlphasType  alphasInVertex1;
+  AtlasAlphasType  alphasInVertex2;
+  AtlasAlphasType  alphasInVertex3;
+  this->GetFlatAlphas( id0, alphasInVertex0 );
+  this->GetFlatAlphas( id1, alphasInVertex1 );
+  this->GetFlatAlphas( id2, alphasInVertex2 );
+  this->GetFlatAlphas( id3, alphasInVertex3 );
   const int  numberOfClasses = m_ConditionalIntensityDistributions.size();
   for ( int classNumber = 0; classNumber < numberOfClasses; classNumber++ )
     {
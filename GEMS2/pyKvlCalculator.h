@@ -26,7 +26,8 @@ public:
                                  py::array_t<double> variances=py::array_t<double>(),
                                  py::array_t<float> mixtureWeights=py::array_t<float>(),
                                  py::array_t<int> numberOfGaussiansPerClass=py::array_t<int>(),
-                                 py::array_t<double> targetPoints=py::array_t<double>()
+                                 py::array_t<double> targetPoints=py::array_t<double>(),
+                                 int numberOfResolutionLevels=1
 ){
         std::cout << "1" << std::endl;
         switch( typeName[ 0 ] )
@@ -82,6 +83,7 @@ public:
                 }
                 myCalculator->SetImages( images_converted );
                 myCalculator->SetParameters( means_converted, variances_converted, mixtureWeights_converted, numberOfGaussiansPerClass_converted );
+                myCalculator->SetNumberOfResolutionLevels( numberOfResolutionLevels );
                 calculator = myCalculator;
                 break;
             }
@@ -76,7 +76,7 @@ void PoistatsReplica::CoolTemperature( const double coolingFactor ) {
 }
 
 bool
-PoistatsReplica::ShouldUpdateEnergy() {
+PoistatsReplica::ShouldUpdateEnergy( const double randomNumber ) {
 
   const double delta  = ( m_CurrentMeanEnergy - m_PreviousMeanEnergy ) / 
     m_Temperature;
@@ -89,7 +89,6 @@ PoistatsReplica::ShouldUpdateEnergy() {
     updateProbability = maxProbablity;
   }
   
-  const double randomNumber = m_PoistatsModel->GetRandomNumber();
   const bool shouldUpdate = ( randomNumber <= updateProbability );
 
   return shouldUpdate;  
@@ -39,7 +39,11 @@ public:
   
   void CoolTemperature( const double coolingFactor );
   
-  bool ShouldUpdateEnergy();
+  /**
+   * Metropolis-Hastings test of the current against the previous energy,
+   * using randomNumber drawn uniformly from [0, 1].
+   */
+  bool ShouldUpdateEnergy( const double randomNumber );
   
   void ResetCurrentToPreviousEnergy();
   
@@ -22,6 +22,8 @@ PoistatsReplicas::PoistatsReplicas( PoistatsModel *model, const int nReplicas )
 
 PoistatsReplicas::~PoistatsReplicas() {
 
+  this->DeleteReplicaModels();
+
   if( m_Replicas != NULL ) {
     delete []m_Replicas;
   }
@@ -47,6 +49,8 @@ PoistatsReplicas::SetNumberOfReplicas( const int nReplicas ) {
 //    delete[] m_Replicas;
 //  }
   
+  this->DeleteReplicaModels();
+  
   m_Replicas = new PoistatsReplica[ m_NumberOfReplicas ];
 
   for( int cReplica=0; cReplica<m_NumberOfReplicas; cReplica++ ) {
@@ -214,7 +218,10 @@ void PoistatsReplicas::CoolTemperatures( const double coolingFactor ) {
 
 bool PoistatsReplicas::ShouldUpdateEnergy( const int replica ) {
 
-  return m_Replicas[ replica ].ShouldUpdateEnergy();
+  // the acceptance draws come from the main stream, in replica order, so
+  // they don't depend on how the replicas were perturbed
+  return m_Replicas[ replica ].ShouldUpdateEnergy( 
+    m_PoistatsModel->GetRandomNumber() );
 } 
 
 void PoistatsReplicas::ResetCurrentToPreviousEnergy( const int replica ) {
@@ -469,7 +476,8 @@ void PoistatsReplicas::GetPerturbedBasePath( const int replica,
 void PoistatsReplicas::PerturbCurrentTrialPath( const int replica, 
   MatrixPointer lowTrialPath, const int nSteps ) {
     
-  MatrixPointer perturbedTrialPath = m_PoistatsModel->RethreadPath( lowTrialPath, nSteps );
+  MatrixPointer perturbedTrialPath = 
+    this->GetReplicaModel( replica )->RethreadPath( lowTrialPath, nSteps );
   
   m_Replicas[ replica ].SetCurrentTrialPath( perturbedTrialPath );
   
@@ -488,3 +496,47 @@ void PoistatsReplicas::FoundBestPath(
 void PoistatsReplicas::CopyCurrentToPreviousTrialPath( const int replica ) {
   m_Replicas[ replica ].CopyCurrentToPreviousTrialPath();
 }
+
+void PoistatsReplicas::InitializeRandomStreams() {
+
+  this->DeleteReplicaModels();
+  
+  // the seeds are drawn in replica order from the main stream, so a given
+  // main seed always gives the same streams
+  const int maxSeed = 2147483646;
+  for( int cReplica=0; cReplica<m_NumberOfReplicas; cReplica++ ) {
+    const long seed = m_PoistatsModel->GetRandomInt( 1, maxSeed );
+    PoistatsModel *model = new PoistatsModel( seed );
+    model->SetNumberOfControlPoints( 
+      m_PoistatsModel->GetNumberOfControlPoints() );
+    
+    m_ReplicaModels.push_back( model );
+    m_Replicas[ cReplica ].SetModel( model );
+  }
+
+}
+
+/**
+ * Returns the model to be used for perturbing a replica's path.  Each replica
+ * has its own, holding its random stream and spline filter, once 
+ * InitializeRandomStreams has been called.
+ */
+PoistatsModel* PoistatsReplicas::GetReplicaModel( const int replica ) {
+
+  PoistatsModel *model = m_PoistatsModel;
+  
+  if( !m_ReplicaModels.empty() ) {
+    model = m_ReplicaModels[ replica ];
+  }
+  
+  return model;
+}
+
+void PoistatsReplicas::DeleteReplicaModels() {
+
+  for( unsigned int cModel=0; cModel<m_ReplicaModels.size(); cModel++ ) {
+    delete m_ReplicaModels[ cModel ];
+  }
+  m_ReplicaModels.clear();
+  
+}
@@ -111,6 +111,13 @@ public:
   
   void CopyCurrentToPreviousTrialPath( const int replica );
 
+  /**
+   * Gives each replica its own random number stream, seeded from the main
+   * model's stream, so that replicas can be perturbed concurrently and still
+   * give the same results for a given seed.
+   */
+  void InitializeRandomStreams();
+
 private:
 
   PoistatsModel *m_PoistatsModel;
@@ -119,6 +126,11 @@ private:
   PoistatsReplica *m_Replicas;
 
   MatrixPointer m_InitialPoints;
+  
+  std::vector< PoistatsModel* > m_ReplicaModels;
+  
+  PoistatsModel* GetReplicaModel( const int replica );
+  void DeleteReplicaModels();
 
   int m_NumberOfSteps;
     
@@ -599,6 +599,13 @@ PoistatsFilter< TInputImage, TOutputImage >
   
   // creates odfs throughout tensor volume
   this->ConstructOdfList();
+  
+  // each replica gets its own random stream, seeded from the main one
+  this->m_Replicas->InitializeRandomStreams();
+  
+  // the geometry is created on first use, so make sure that happens before
+  // the replicas are evaluated concurrently
+  this->GetTensorGeometry();
 
   // initialize temperatures to be regularily spaced between 0.05 and 0.1
   const double temperatureFloor = 0.05;
@@ -641,11 +648,23 @@ PoistatsFilter< TInputImage, TOutputImage >
     // reset the number of exchanges that occured...if you're keeping track
     this->SetExchanges( 0 );
 
-    // now go through all the replicas and wiggle them around    
-    for( int cReplica=0; cReplica<this->GetNumberOfReplicas(); cReplica++ ) {
+    const bool isFirst = m_CurrentIteration == 1;
+    const int nReplicas = this->GetNumberOfReplicas();
+    const int nSteps = this->GetNumberOfSteps();
+    MatrixPointer startSeeds = this->GetStartSeeds();
+    MatrixPointer endSeeds = this->GetEndSeeds();
+    std::vector< MatrixType > lowTrialPaths( nReplicas );
+    std::vector< double > meanPathEnergies( nReplicas );
+
+    // now go through all the replicas and wiggle them around.  Each replica 
+    // only touches its own paths and random stream here, so they can be 
+    // perturbed and evaluated concurrently
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule( dynamic )
+#endif
+    for( int cReplica=0; cReplica<nReplicas; cReplica++ ) {
     
       //if time > 1, prevpath{i} = trialpath{i}; end;
-      const bool isFirst = m_CurrentIteration == 1;
       if( !isFirst ) {
         this->m_Replicas->CopyCurrentToPreviousTrialPath( cReplica );
       }
@@ -653,14 +672,14 @@ PoistatsFilter< TInputImage, TOutputImage >
       // get the low resolution path for this replica
       MatrixPointer currentBasePath = this->m_Replicas->GetBasePath( cReplica );
             
-      MatrixType lowTrialPath( 
-        currentBasePath->rows(), currentBasePath->cols() );
+      MatrixType &lowTrialPath = lowTrialPaths[ cReplica ];
+      lowTrialPath.SetSize( currentBasePath->rows(), currentBasePath->cols() );
       m_Replicas->GetPerturbedBasePath( cReplica, &lowTrialPath, sigma, 
-        this->GetStartSeeds(), this->GetEndSeeds() );
+        startSeeds, endSeeds );
         
       // MATLAB: trialpath{i} = rethreadpath(lowtrialpath, steps);
       this->m_Replicas->PerturbCurrentTrialPath( cReplica, &lowTrialPath, 
-        this->GetNumberOfSteps() );
+        nSteps );
       MatrixPointer perturbedTrialPath = 
         this->m_Replicas->GetCurrentTrialPath( cReplica );
 
@@ -671,17 +690,28 @@ PoistatsFilter< TInputImage, TOutputImage >
       // we want to obtain an index into our image, so round the path
       this->RoundPath( &roundedPath, perturbedTrialPath );
       
-      ArrayPointer odfs[ this->GetNumberOfSteps() ];
-      this->GetOdfsAtPoints( odfs, &roundedPath );
+      std::vector< ArrayPointer > odfs( nSteps );
+      this->GetOdfsAtPoints( &odfs[ 0 ], &roundedPath );
       
       /* MATLAB: 
         % calculate path energy      
         energy(i) = odfpathenergy(trialpath{i}, odfs, geo);
       */
-      const double meanPathEnergy = 
-        this->CalculateOdfPathEnergy( perturbedTrialPath, odfs, NULL );
+      meanPathEnergies[ cReplica ] = 
+        this->CalculateOdfPathEnergy( perturbedTrialPath, &odfs[ 0 ], NULL );
+      
+    }
+
+    // the Metropolis-Hastings updates and replica exchanges depend on the
+    // other replicas, so they're done in replica order, as before
+    for( int cReplica=0; cReplica<nReplicas; cReplica++ ) {
+
+      MatrixType &lowTrialPath = lowTrialPaths[ cReplica ];
+      MatrixPointer perturbedTrialPath = 
+        this->m_Replicas->GetCurrentTrialPath( cReplica );
 
-      this->m_Replicas->SetCurrentMeanEnergy( cReplica, meanPathEnergy );
+      this->m_Replicas->SetCurrentMeanEnergy( cReplica, 
+        meanPathEnergies[ cReplica ] );
 
       /* MATLAB:                   
         % check for Metropolis-Hastings update
@@ -672,6 +672,9 @@ void FSSurface::SaveVertices( MRIS* mris, int nSet )
     return;
   }
 
+  // cached display arrays of this set are out of date now
+  m_targetPoints[nSet] = NULL;
+
   SaveVertices( mris, m_fVertexSets[nSet] );
 }
 
@@ -748,6 +751,8 @@ void FSSurface::SaveNormals( MRIS* mris, int nSet )
     return;
   }
 
+  m_targetNormals[nSet] = NULL;
+
   int nvertices = mris->nvertices;
   VERTEX *v;
 
@@ -975,48 +980,72 @@ void FSSurface::UpdateSmoothedNormals()
 
 void FSSurface::UpdateVerticesAndNormals()
 {
-  // Allocate all our arrays.
   int cVertices = m_MRIS->nvertices;
 
-  vtkSmartPointer<vtkPoints> newPoints =
-      vtkSmartPointer<vtkPoints>::New();
-  newPoints->Allocate( cVertices );
+  // Points and normals are written straight into packed float arrays that
+  // are kept per vertex set, so switching sets later only swaps arrays.
+  vtkSmartPointer<vtkFloatArray> pointData =
+      vtkSmartPointer<vtkFloatArray>::New();
+  pointData->SetNumberOfComponents( 3 );
+  pointData->SetNumberOfTuples( cVertices );
 
   vtkSmartPointer<vtkFloatArray> newNormals =
       vtkSmartPointer<vtkFloatArray>::New();
-  newNormals->Allocate( cVertices );
   newNormals->SetNumberOfComponents( 3 );
+  newNormals->SetNumberOfTuples( cVertices );
   newNormals->SetName( "Normals" );
 
-  // Go through the surface and copy the vertex and normal for each
-  // vertex. We have to transform them from surface RAS into normal
-  // RAS.
-  float point[3], normal[3], surfaceRAS[3];
-  for ( int vno = 0; vno < cVertices; vno++ )
+  // Surface RAS to target goes through normal RAS. Both transforms are
+  // fixed, so combine them once instead of applying them per vertex.
+  vtkSmartPointer<vtkMatrix4x4> rasToTarget =
+      vtkSmartPointer<vtkMatrix4x4>::New();
+  rasToTarget->DeepCopy( m_targetToRasMatrix );
+  rasToTarget->Invert();
+  vtkSmartPointer<vtkMatrix4x4> surfaceToTarget =
+      vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkMatrix4x4::Multiply4x4( rasToTarget, m_SurfaceToRASTransform->GetMatrix(),
+                             surfaceToTarget );
+  double m[3][4];
+  for ( int i = 0; i < 3; i++ )
   {
-    surfaceRAS[0] = m_MRIS->vertices[vno].x;
-    surfaceRAS[1] = m_MRIS->vertices[vno].y;
-    surfaceRAS[2] = m_MRIS->vertices[vno].z;
-    this->ConvertSurfaceToRAS( surfaceRAS, point );
-    /*
-    if ( m_volumeRef )
+    for ( int j = 0; j < 4; j++ )
     {
-      m_volumeRef->RASToTarget( point, point );
+      m[i][j] = surfaceToTarget->GetElement( i, j );
     }
-    */
-    m_targetToRasTransform->GetInverse()->TransformPoint(point, point);
-    newPoints->InsertNextPoint( point );
+  }
 
-    normal[0] = m_MRIS->vertices[vno].nx;
-    normal[1] = m_MRIS->vertices[vno].ny;
-    normal[2] = m_MRIS->vertices[vno].nz;
-    newNormals->InsertNextTuple( normal );
+  float* point = pointData->GetPointer( 0 );
+  float* normal = newNormals->GetPointer( 0 );
+  for ( int vno = 0; vno < cVertices; vno++ )
+  {
+    VERTEX* v = &m_MRIS->vertices[vno];
+    for ( int i = 0; i < 3; i++ )
+    {
+      point[i] = m[i][0]*v->x + m[i][1]*v->y + m[i][2]*v->z + m[i][3];
+    }
+    normal[0] = v->nx;
+    normal[1] = v->ny;
+    normal[2] = v->nz;
+    point += 3;
+    normal += 3;
   }
 
-  m_polydata->SetPoints( newPoints );
-  m_polydata->GetPointData()->SetNormals( newNormals );
-  m_polydataVertices->SetPoints( newPoints );
-  m_polydataWireframes->SetPoints( newPoints );
+  vtkSmartPointer<vtkPoints> newPoints =
+      vtkSmartPointer<vtkPoints>::New();
+  newPoints->SetData( pointData );
+
+  m_targetPoints[m_nActiveSurface] = newPoints;
+  m_targetNormals[m_nActiveSurface] = newNormals;
+  ApplyVerticesAndNormals( m_nActiveSurface );
+}
+
+void FSSurface::ApplyVerticesAndNormals( int nSet )
+{
+  // all polydata share the same point array
+  m_polydata->SetPoints( m_targetPoints[nSet] );
+  m_polydata->GetPointData()->SetNormals( m_targetNormals[nSet] );
+  m_polydataVertices->SetPoints( m_targetPoints[nSet] );
+  m_polydataWireframes->SetPoints( m_targetPoints[nSet] );
   m_polydata->Update();
 
   // if vector data exist
@@ -1355,7 +1384,15 @@ bool FSSurface::SetActiveSurface( int nIndex )
     RestoreNormals( m_MRIS, nIndex );
   }
 
-  UpdateVerticesAndNormals();
+  // reuse the arrays built the last time this set was shown
+  if ( m_targetPoints[nIndex] != NULL && m_targetNormals[nIndex] != NULL )
+  {
+    ApplyVerticesAndNormals( nIndex );
+  }
+  else
+  {
+    UpdateVerticesAndNormals();
+  }
 
   return true;
 }
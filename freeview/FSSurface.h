@@ -45,6 +45,7 @@ extern "C"
 #define NUM_OF_VSETS 5
 
 class vtkTransform;
+class vtkFloatArray;
 class FSVolume;
 
 class FSSurface : public QObject
@@ -318,6 +319,12 @@ protected:
   VertexItem*  m_fNormalSets[NUM_OF_VSETS];
   VertexItem*  m_fSmoothedNormal;
 
+  // display (target) space points and normals of each vertex set. Built on
+  // first use and dropped when the set's vertices or normals are saved again
+  vtkSmartPointer<vtkPoints>      m_targetPoints[NUM_OF_VSETS];
+  vtkSmartPointer<vtkFloatArray>  m_targetNormals[NUM_OF_VSETS];
+  void ApplyVerticesAndNormals( int nSet );
+
   struct VertexVectorItem
   {
     QString  name;
@@ -1608,15 +1608,11 @@ bool FSVolume::MapMRIToImage( bool do_not_create_image )
   {
     // if there is registration matrix, set target as the reference's target
     MRI* mri = m_volumeRef->m_MRITarget;
-    try {
-      rasMRI = MRIallocSequence( mri->width,
-                                 mri->height,
-                                 mri->depth,
-                                 m_MRI->type,
-                                 m_MRI->nframes );
-    } catch (int ret) {
-      return false;
-    }
+    rasMRI = MRIallocHeader( mri->width,
+                             mri->height,
+                             mri->depth,
+                             m_MRI->type,
+                             m_MRI->nframes );
 
     if ( rasMRI == NULL )
     {
@@ -1634,12 +1630,8 @@ bool FSVolume::MapMRIToImage( bool do_not_create_image )
       dim[i] = (int) ( ( bounds[i*2+1] - bounds[i*2] ) / voxelSize[i] + 0.5 );
     }
 
-    try {
-      rasMRI = MRIallocSequence( dim[0], dim[1], dim[2],
-          m_MRI->type, m_MRI->nframes );
-    } catch (int ret) {
-      return false;
-    }
+    rasMRI = MRIallocHeader( dim[0], dim[1], dim[2],
+                             m_MRI->type, m_MRI->nframes );
 
     if ( rasMRI == NULL )
     {
@@ -1756,12 +1748,8 @@ bool FSVolume::MapMRIToImage( bool do_not_create_image )
 
       *MATRIX_RELT( m, 4, 4 ) = 1;
 
-      try {
-        rasMRI = MRIallocSequence( dim[0], dim[1], dim[2],
-            m_MRI->type, m_MRI->nframes );
-      } catch (int ret) {
-        return false;
-      }
+      rasMRI = MRIallocHeader( dim[0], dim[1], dim[2],
+                               m_MRI->type, m_MRI->nframes );
 
       if ( rasMRI == NULL )
       {
@@ -1785,7 +1773,7 @@ bool FSVolume::MapMRIToImage( bool do_not_create_image )
     }
     else
     {
-      rasMRI = CreateTargetMRI( m_MRI, m_volumeRef->m_MRITarget, true, m_bConform );
+      rasMRI = CreateTargetMRI( m_MRI, m_volumeRef->m_MRITarget, false, m_bConform );
       if ( rasMRI == NULL )
       {
         cerr << "Can not allocate memory for volume transformation\n";
@@ -1801,6 +1789,36 @@ bool FSVolume::MapMRIToImage( bool do_not_create_image )
     cerr << "No target volume available! Cannot use registration matrix.\n";
   }
 
+  // rasMRI only carries the target geometry. The resampled voxels go
+  // straight into the display image when its layout allows it, so a
+  // full-size copy of the volume is not held twice while loading.
+  if ( !do_not_create_image && !CreateImage( rasMRI ) )
+  {
+    ::MRIfree( &rasMRI );
+    return false;
+  }
+
+  MRI* mriImage = CreateMRIFromImage( rasMRI, m_imageData );
+  bool bImageView = ( mriImage != NULL );
+  if ( !bImageView )
+  {
+    try {
+      mriImage = MRIallocSequence( rasMRI->width, rasMRI->height, rasMRI->depth,
+                                   rasMRI->type, rasMRI->nframes );
+    } catch (int ret) {
+      ::MRIfree( &rasMRI );
+      return false;
+    }
+
+    if ( mriImage == NULL )
+    {
+      cerr << "Can not allocate memory for volume transformation\n";
+      ::MRIfree( &rasMRI );
+      return false;
+    }
+    MRIcopyHeader( rasMRI, mriImage );
+  }
+
   if ( m_matReg && m_MRIRef )
   {
     // registration matrix is always converted to tkReg style now
@@ -1817,7 +1835,7 @@ bool FSVolume::MapMRIToImage( bool do_not_create_image )
       MATRIX* t2r = MRIgetVoxelToVoxelXform( rasMRI, m_MRIRef );
       MatrixMultiply( vox2vox, t2r, t2r );
 
-      MRIvol2Vol( m_MRI, rasMRI, t2r, m_nInterpolationMethod, 0 );
+      MRIvol2Vol( m_MRI, mriImage, t2r, m_nInterpolationMethod, 0 );
 
       // copy vox2vox
       MatrixInverse( t2r, vox2vox );
@@ -1836,7 +1854,7 @@ bool FSVolume::MapMRIToImage( bool do_not_create_image )
   }
   else
   {
-    MRIvol2Vol( m_MRI, rasMRI, NULL, m_nInterpolationMethod, 0 );
+    MRIvol2Vol( m_MRI, mriImage, NULL, m_nInterpolationMethod, 0 );
     MATRIX* vox2vox = MRIgetVoxelToVoxelXform( m_MRI, rasMRI );
     for ( int i = 0; i < 16; i++ )
     {
@@ -1849,13 +1867,16 @@ bool FSVolume::MapMRIToImage( bool do_not_create_image )
   SetMRITarget( rasMRI );
   UpdateRASToRASMatrix();
 
-  if ( !do_not_create_image && !CreateImage( rasMRI ) )
+  if ( bImageView )
   {
-    return false;
+    FreeMRIFromImage( &mriImage );
+  }
+  else
+  {
+    // copy mri pixel data to vtkImage we will use for display
+    CopyMRIDataToImage( mriImage, m_imageData );
+    ::MRIfree( &mriImage );
   }
-
-  // copy mri pixel data to vtkImage we will use for display
-  CopyMRIDataToImage( rasMRI, m_imageData );
 
   // Need to recalc our bounds at some point.
   m_bBoundsCacheDirty = true;
@@ -2361,6 +2382,59 @@ MATRIX* FSVolume::GetRotationMatrix( int nPlane, double angle, double* origin )
   return m_r;
 }
 
+// VTK scalar type that holds the voxels of the given MRI type, -1 if none
+static int MRITypeToVTKType( int mri_type )
+{
+  switch ( mri_type )
+  {
+  case MRI_UCHAR:
+    return VTK_UNSIGNED_CHAR;
+  case MRI_INT:
+    return VTK_INT;
+  case MRI_LONG:
+    return VTK_LONG;
+  case MRI_FLOAT:
+    return VTK_FLOAT;
+  case MRI_SHORT:
+    return VTK_SHORT;
+  default:
+    return -1;
+  }
+}
+
+// copy slices [nStartSlice, nEndSlice) of mri into the interleaved image buffer
+template <typename T>
+static void CopyMRISlicesToBuffer( MRI* mri, T* buffer, int nStartSlice, int nEndSlice )
+{
+  int zX = mri->width;
+  int zY = mri->height;
+  int zFrames = mri->nframes;
+
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for
+#endif
+  for ( int nZ = nStartSlice; nZ < nEndSlice; nZ++ )
+  {
+    for ( int nY = 0; nY < zY; nY++ )
+    {
+      T* ptr = buffer + ( (size_t)nZ*zY + nY ) * zX * zFrames;
+      if ( zFrames == 1 )
+      {
+        memcpy( ptr, mri->slices[nZ][nY], sizeof(T)*zX );
+        continue;
+      }
+      for ( int nFrame = 0; nFrame < zFrames; nFrame++ )
+      {
+        T* src = (T*)mri->slices[nZ + nFrame*mri->depth][nY];
+        for ( int nX = 0; nX < zX; nX++ )
+        {
+          ptr[nX*zFrames + nFrame] = src[nX];
+        }
+      }
+    }
+  }
+}
+
 void FSVolume::CopyMRIDataToImage( MRI* mri,
                                    vtkImageData* image )
 {
@@ -2370,10 +2444,46 @@ void FSVolume::CopyMRIDataToImage( MRI* mri,
   int zZ = mri->depth;
   int zFrames = mri->nframes;
 
-  vtkIdType nTuple = 0;
   vtkDataArray *scalars = image->GetPointData()->GetScalars();
   int nProgressStep = 20;
   int nProgress = 0;
+  int nSlicesPerStep = max(1, zZ/5);
+  if ( scalars->GetDataType() == MRITypeToVTKType( mri->type ) &&
+       scalars->GetNumberOfComponents() == zFrames &&
+       scalars->GetNumberOfTuples() == (vtkIdType)zX*zY*zZ )
+  {
+    // same element type, so rows can be copied as they are
+    void* ptr = scalars->GetVoidPointer( 0 );
+    for ( int nZ = 0; nZ < zZ; nZ += nSlicesPerStep )
+    {
+      int nEnd = min( zZ, nZ + nSlicesPerStep );
+      switch ( mri->type )
+      {
+      case MRI_UCHAR:
+        CopyMRISlicesToBuffer( mri, (unsigned char*)ptr, nZ, nEnd );
+        break;
+      case MRI_INT:
+        CopyMRISlicesToBuffer( mri, (int*)ptr, nZ, nEnd );
+        break;
+      case MRI_LONG:
+        CopyMRISlicesToBuffer( mri, (long*)ptr, nZ, nEnd );
+        break;
+      case MRI_FLOAT:
+        CopyMRISlicesToBuffer( mri, (float*)ptr, nZ, nEnd );
+        break;
+      case MRI_SHORT:
+        CopyMRISlicesToBuffer( mri, (short*)ptr, nZ, nEnd );
+        break;
+      default:
+        break;
+      }
+      nProgress += nProgressStep;
+      emit ProgressChanged( nProgress );
+    }
+    return;
+  }
+
+  vtkIdType nTuple = 0;
   for ( int nZ = 0; nZ < zZ; nZ++ )
   {
     for ( int nY = 0; nY < zY; nY++ )
@@ -2412,7 +2522,7 @@ void FSVolume::CopyMRIDataToImage( MRI* mri,
       }
     }
 
-    if ( nZ%(max(1, zZ/5)) == 0 )
+    if ( nZ%nSlicesPerStep == 0 )
     {
       nProgress += nProgressStep;
       emit ProgressChanged( nProgress );
@@ -2420,6 +2530,60 @@ void FSVolume::CopyMRIDataToImage( MRI* mri,
   }
 }
 
+MRI* FSVolume::CreateMRIFromImage( MRI* header, vtkImageData* image )
+{
+  // frames are interleaved in the image, so only single-frame volumes
+  // share the MRI row layout
+  vtkDataArray* scalars = image ? image->GetPointData()->GetScalars() : NULL;
+  if ( !scalars || header->nframes != 1 ||
+       scalars->GetDataType() != MRITypeToVTKType( header->type ) ||
+       scalars->GetNumberOfComponents() != 1 )
+  {
+    return NULL;
+  }
+
+  int* dim = image->GetDimensions();
+  if ( dim[0] != header->width || dim[1] != header->height || dim[2] != header->depth )
+  {
+    return NULL;
+  }
+
+  MRI* mri = MRIallocHeader( header->width, header->height, header->depth,
+                             header->type, 1 );
+  MRIcopyHeader( header, mri );
+
+  // MRIvol2Vol leaves voxels outside of the source untouched
+  char* ptr = (char*)scalars->GetVoidPointer( 0 );
+  size_t nRowBytes = (size_t)mri->width * scalars->GetDataTypeSize();
+  memset( ptr, 0, nRowBytes * mri->height * mri->depth );
+
+  mri->slices = (BUFTYPE ***)calloc( mri->depth, sizeof(BUFTYPE **) );
+  for ( int nZ = 0; nZ < mri->depth; nZ++ )
+  {
+    mri->slices[nZ] = (BUFTYPE **)calloc( mri->height, sizeof(BUFTYPE *) );
+    for ( int nY = 0; nY < mri->height; nY++ )
+    {
+      mri->slices[nZ][nY] = (BUFTYPE *)ptr;
+      ptr += nRowBytes;
+    }
+  }
+
+  return mri;
+}
+
+void FSVolume::FreeMRIFromImage( MRI** pmri )
+{
+  // the rows belong to the image, only the row pointers are ours
+  MRI* mri = *pmri;
+  for ( int nZ = 0; nZ < mri->depth; nZ++ )
+  {
+    free( mri->slices[nZ] );
+  }
+  free( mri->slices );
+  mri->slices = NULL;
+  ::MRIfree( pmri );
+}
+
 vtkImageData* FSVolume::GetImageOutput()
 {
   return m_imageData;
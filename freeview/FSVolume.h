@@ -229,6 +229,10 @@ protected:
   bool LoadRegistrationMatrix( const QString& filename );
   void UpdateHistoCDF(int frame = 0, float threshold = -1, bool bHighThreshold = false);
   void CopyMRIDataToImage( MRI* mri, vtkImageData* image );
+  // wraps the scalars of a single-frame image in an MRI with header's
+  // geometry, so voxels can be written in place. NULL if layouts differ
+  static MRI* CreateMRIFromImage( MRI* header, vtkImageData* image );
+  static void FreeMRIFromImage( MRI** pmri );
   void CopyMatricesFromMRI();
   bool CreateImage( MRI* mri );
   bool ResizeRotatedImage( MRI* mri, MRI* refTarget, vtkImageData* refImageData, double* rasPoint );
@@ -44,6 +44,24 @@ extern "C"
 #include "utils.h"
 }
 
+#define NUM_OF_PERCENTILE_BINS 100
+
+// bins data over range the way PercentileToPosition expects
+static void BuildPercentileHistogram( const float* data, int nSize,
+                                      const double* range, int* histo )
+{
+  double dBinWidth = ( range[1] - range[0] ) / NUM_OF_PERCENTILE_BINS;
+  memset( histo, 0, NUM_OF_PERCENTILE_BINS * sizeof( int ) );
+  for ( long i = 0; i < nSize; i++ )
+  {
+    int n = (int)( ( data[i] - range[0] ) / dBinWidth );
+    if ( n >= 0 && n < NUM_OF_PERCENTILE_BINS )
+    {
+      histo[n] ++;
+    }
+  }
+}
+
 SurfaceOverlay::SurfaceOverlay ( LayerSurface* surf ) :
   QObject(),
   m_fData( NULL ),
@@ -148,6 +166,7 @@ void SurfaceOverlay::InitializeData()
     m_dRawMaxValue = m_dMaxValue;
     m_dRawMinValue = m_dMinValue;
     memcpy(m_fDataRaw, m_fData, sizeof(float)*m_nDataSize);
+    UpdateFrameStats();
   }
 }
 
@@ -186,6 +205,9 @@ void SurfaceOverlay::InitializeData(float *data_buffer_in, int nvertices, int nf
     if (!m_fDataUnsmoothed)
       return;
 
+    // this runs in the io thread, so scrubbing through frames later only
+    // has to look up the ranges and histograms
+    UpdateFrameStats();
     SetActiveFrame(0);
     GetProperty()->Reset();
     m_fCorrelationSourceData = new float[nframes];
@@ -389,16 +411,24 @@ void SurfaceOverlay::SetActiveFrame(int nFrame)
   m_nActiveFrame = nFrame;
   memcpy(m_fData, m_fDataRaw + m_nActiveFrame*m_nDataSize, sizeof(float)*m_nDataSize);
   memcpy(m_fDataUnsmoothed, m_fData, sizeof(float)*m_nDataSize);
-  m_dMaxValue = m_dMinValue = m_fData[0];
-  for ( int i = 0; i < m_nDataSize; i++ )
+  if ( HasFrameStats() )
   {
-    if ( m_dMaxValue < m_fData[i] )
-    {
-      m_dMaxValue = m_fData[i];
-    }
-    else if ( m_dMinValue > m_fData[i] )
+    m_dMinValue = m_fFrameMinValues[m_nActiveFrame];
+    m_dMaxValue = m_fFrameMaxValues[m_nActiveFrame];
+  }
+  else
+  {
+    m_dMaxValue = m_dMinValue = m_fData[0];
+    for ( int i = 0; i < m_nDataSize; i++ )
     {
-      m_dMinValue = m_fData[i];
+      if ( m_dMaxValue < m_fData[i] )
+      {
+        m_dMaxValue = m_fData[i];
+      }
+      else if ( m_dMinValue > m_fData[i] )
+      {
+        m_dMinValue = m_fData[i];
+      }
     }
   }
   if (GetProperty()->GetSmooth())
@@ -511,28 +541,63 @@ bool SurfaceOverlay::GetDataAtVertex(int nVertex, float *output)
   return true;
 }
 
+void SurfaceOverlay::UpdateFrameStats()
+{
+  m_fFrameMinValues.resize( m_nNumOfFrames );
+  m_fFrameMaxValues.resize( m_nNumOfFrames );
+  m_nFrameHistograms.resize( m_nNumOfFrames*NUM_OF_PERCENTILE_BINS );
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for
+#endif
+  for ( int nFrame = 0; nFrame < m_nNumOfFrames; nFrame++ )
+  {
+    const float* data = m_fDataRaw + (size_t)nFrame*m_nDataSize;
+    float fMin = data[0], fMax = data[0];
+    for ( int i = 1; i < m_nDataSize; i++ )
+    {
+      if ( fMax < data[i] )
+      {
+        fMax = data[i];
+      }
+      else if ( fMin > data[i] )
+      {
+        fMin = data[i];
+      }
+    }
+    m_fFrameMinValues[nFrame] = fMin;
+    m_fFrameMaxValues[nFrame] = fMax;
+    double range[2] = { fMin, fMax };
+    BuildPercentileHistogram( data, m_nDataSize, range,
+                              &m_nFrameHistograms[nFrame*NUM_OF_PERCENTILE_BINS] );
+  }
+}
+
+bool SurfaceOverlay::HasFrameStats()
+{
+  // correlation overlays rewrite the raw data whenever the vertex changes
+  return ( !m_bCorrelationData && m_nActiveFrame < (int)m_fFrameMinValues.size() );
+}
+
 double SurfaceOverlay::PercentileToPosition(double percentile)
 {
   double range[2];
   GetRange(range);
-  int m_nNumberOfBins = 100;
+  int m_nNumberOfBins = NUM_OF_PERCENTILE_BINS;
   double m_dBinWidth = ( range[1] - range[0] ) / m_nNumberOfBins;
-  int* m_nOutputData = new int[m_nNumberOfBins];
-  if ( !m_nOutputData )
+
+  // the cached histogram of the frame holds as long as the data shown is
+  // the unsmoothed frame itself
+  std::vector<int> histo;
+  const int* m_nOutputData;
+  if ( HasFrameStats() && !m_bComputeCorrelation && !GetProperty()->GetSmooth() )
   {
-    qCritical() << "Can not allocate memory.";
-    return 0;
+    m_nOutputData = &m_nFrameHistograms[m_nActiveFrame*NUM_OF_PERCENTILE_BINS];
   }
-
-  // calculate histogram data
-  memset( m_nOutputData, 0, m_nNumberOfBins * sizeof( int ) );
-  for ( long i = 0; i < m_nDataSize; i++ )
+  else
   {
-    int n = (int)( ( m_fData[i] - range[0] ) / m_dBinWidth );
-    if ( n >= 0 && n < m_nNumberOfBins )
-    {
-      m_nOutputData[n] ++;
-    }
+    histo.resize( m_nNumberOfBins );
+    BuildPercentileHistogram( m_fData, m_nDataSize, range, &histo[0] );
+    m_nOutputData = &histo[0];
   }
 
   double m_dOutputTotalArea = 0;
@@ -556,6 +621,5 @@ double SurfaceOverlay::PercentileToPosition(double percentile)
     dPos -= (dArea-percentile*m_dOutputTotalArea)*m_dBinWidth/m_nOutputData[n-1];
   }
 
-  delete[] m_nOutputData;
   return dPos;
 }
@@ -31,6 +31,7 @@
 
 #include <QObject>
 #include <QString>
+#include <vector>
 
 extern "C"
 {
@@ -162,6 +163,9 @@ public slots:
   }
 
 private:
+  void UpdateFrameStats();
+  bool HasFrameStats();
+
   float*        m_fData;
   float*        m_fDataRaw;
   float*        m_fDataUnsmoothed;
@@ -189,6 +193,11 @@ private:
   LayerMRI*  m_volumeCorrelationSource;
   float*    m_fCorrelationSourceData;
   float*    m_fCorrelationDataBuffer;
+
+  // value range and percentile histogram of every frame of m_fDataRaw
+  std::vector<float>  m_fFrameMinValues;
+  std::vector<float>  m_fFrameMaxValues;
+  std::vector<int>    m_nFrameHistograms;
 };
 
 #endif
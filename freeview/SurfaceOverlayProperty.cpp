@@ -397,14 +397,17 @@ void SurfaceOverlayProperty::MapOverlayColorSymmetric( float* data, unsigned cha
   double dMidPoint = m_dMidPoint;
   if (m_nColorMethod != CM_Piecewise)
     dMidPoint = (m_dMaxPoint + m_dMinPoint)/2.0;
+  // every vertex is mapped on its own, so the loops below run in parallel
+  bool bUseMask = ( m_mask && nPoints == m_overlay->GetDataSize() );
   if ( m_nColorMethod== CM_LinearOpaque )
   {
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for private(c)
+#endif
     for ( int i = 0; i < nPoints; i++ )
     {
       // map positive values
-      bool bInMask = true;
-      if (nPoints == m_overlay->GetDataSize())
-        bInMask = (!m_mask || ( (!m_bInverseMask && m_maskData[i]) || (m_bInverseMask && !m_maskData[i]) ));
+      bool bInMask = ( !bUseMask || ( m_bInverseMask ? !m_maskData[i] : m_maskData[i] ) );
       if ( data[i] >= m_dMinPoint + m_dOffset && !( m_bColorInverse && m_bColorTruncate ) && bInMask )
       {
         double r = 0;
@@ -474,12 +477,13 @@ void SurfaceOverlayProperty::MapOverlayColorSymmetric( float* data, unsigned cha
   }
   else if ( m_nColorMethod == CM_Piecewise || m_nColorMethod == CM_Linear )
   {
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for private(c)
+#endif
     for ( int i = 0; i < nPoints; i++ )
     {
       // map positive values
-      bool bInMask = true;
-      if (nPoints == m_overlay->GetDataSize())
-        bInMask = (!m_mask || ( (!m_bInverseMask && m_maskData[i]) || (m_bInverseMask && !m_maskData[i]) ));
+      bool bInMask = ( !bUseMask || ( m_bInverseMask ? !m_maskData[i] : m_maskData[i] ) );
       if ( data[i] >= m_dMinPoint + m_dOffset && !( m_bColorInverse && m_bColorTruncate ) && bInMask )
       {
         if ( data[i] < dMidPoint + m_dOffset )
@@ -648,7 +652,6 @@ void SurfaceOverlayProperty::MapOverlayColorFullScale( float* data, unsigned cha
       label = m_mask->GetLabelData();
     return;
   }
-  double c[4];
   double dThLow = m_dMinPoint + m_dOffset;
   double dThHigh = m_overlay->m_dMaxValue+1e10;
   if ( m_nColorScale == CS_Custom)
@@ -666,13 +669,18 @@ void SurfaceOverlayProperty::MapOverlayColorFullScale( float* data, unsigned cha
       dThHigh = m_dMaxStop + m_dOffset;
     }
   }
+  // the lookup only reads the transfer function, so vertices can be
+  // mapped in parallel
+  bool bUseMask = ( m_mask && nPoints == m_overlay->GetDataSize() );
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for
+#endif
   for ( int i = 0; i < nPoints; i++ )
   {
-    bool bInMask = true;
-    if (nPoints == m_overlay->GetDataSize())
-      bInMask = (!m_mask || ( (!m_bInverseMask && m_maskData[i]) || (m_bInverseMask && !m_maskData[i]) ));
+    bool bInMask = ( !bUseMask || ( m_bInverseMask ? !m_maskData[i] : m_maskData[i] ) );
     if (bInMask && data[i] >= dThLow && data[i] <= dThHigh)
     {
+      double c[4];
       m_lut->GetColor( data[i], c );
       colordata[i*4] = ( int )( colordata[i*4] * ( 1 - m_dOpacity ) + c[0]*255 * m_dOpacity );
       colordata[i*4+1] = ( int )( colordata[i*4+1] * ( 1 - m_dOpacity ) + c[1]*255 * m_dOpacity );
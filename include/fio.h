@@ -63,6 +63,13 @@ int   fwrite2(int v, FILE *fp) ;
 int   fwrite3(int v, FILE *fp) ;
 int   fwrite4(int v, FILE *fp) ;
 
+/* bulk big-endian array I/O, return # of complete items transferred */
+int freadIntArray(int *buf, int n, FILE *fp) ;
+int freadFloatArray(float *buf, int n, FILE *fp) ;
+int freadShortArray(short *buf, int n, FILE *fp) ;
+int fwriteIntArray(const int *buf, int n, FILE *fp) ;
+int fwriteFloatArray(const float *buf, int n, FILE *fp) ;
+
 /* znzlib support routines */
 int   znzread1(int *v, znzFile fp) ;
 int   znzread2(int *v, znzFile fp) ;
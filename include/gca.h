@@ -314,6 +314,27 @@ float GCAcomputeNumberOfGoodFittingSamples(GCA *gca, GCA_SAMPLE *gcas,
 float  GCAcomputeLogSampleProbability(GCA *gca, GCA_SAMPLE *gcas,
                                       MRI *mri_inputs,
                                       TRANSFORM *transform,int nsamples, double clamp);
+
+/* a sample set packed into contiguous arrays so that it can be scored
+   under many candidate linear transforms (see GCAsamplePackAlloc) */
+typedef struct
+{
+  int    nsamples ;
+  int    ninputs ;
+  float  *xp, *yp, *zp ;    /* prior coordinates */
+  double *prior_log ;       /* log(prior) */
+  double *log_norm ;        /* -log(sqrt(det(covariance))) */
+  float  *means ;           /* nsamples x ninputs */
+  float  *icovars ;         /* nsamples x ninputs x ninputs inverse covariance */
+  MATRIX *m_prior2voxel ;   /* prior voxel -> template voxel */
+}
+GCA_SAMPLE_PACK ;
+
+GCA_SAMPLE_PACK *GCAsamplePackAlloc(GCA *gca, GCA_SAMPLE *gcas, int nsamples) ;
+void  GCAsamplePackFree(GCA_SAMPLE_PACK **ppack) ;
+float GCAcomputeLogSampleProbabilityPacked(GCA_SAMPLE_PACK *pack,
+                                           MRI *mri_inputs,
+                                           MATRIX *m_L, double clamp) ;
 float  GCAcomputeLabelIntensityVariance(GCA *gca, GCA_SAMPLE *gcas,
 					MRI *mri_inputs,
 					TRANSFORM *transform,int nsamples);
@@ -110,6 +110,13 @@ typedef struct
   GCSA_INPUT       inputs[GCSA_MAX_INPUTS] ;
   char             *ptable_fname ;   /* name of color lookup table */
   COLOR_TABLE      *ct ;
+
+  /* flat copies of the classifiers, built by GCSAflattenClassifiers() */
+  int              *gcs_index ;      /* first classifier of each gc node */
+  float            *gcs_means ;      /* ninputs means per classifier */
+  float            *gcs_icov ;       /* ninputs x ninputs inverse covariance */
+  float            *gcs_det ;        /* covariance determinant */
+  char             *gcs_singular ;   /* inverse needed regularization */
 }
 GAUSSIAN_CLASSIFIER_SURFACE_ARRAY, GCSA ;
 
@@ -136,5 +143,6 @@ int dump_gcsan(GCSA_NODE *gcsan, CP_NODE *cpn, FILE *fp, int verbose) ;
 int GCSAbuildMostLikelyLabels(GCSA *gcsa, MRI_SURFACE *mris) ;
 int GCSArelabelWithAseg(GCSA *gcsa, MRI_SURFACE *mris, MRI *mri_aseg) ;
 int GCSAreclassifyMarked(GCSA *gcsa, MRI_SURFACE *mris,int mark, int *exclude_list, int nexcluded) ;
+int GCSAflattenClassifiers(GCSA *gcsa) ;
 
 #endif
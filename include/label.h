@@ -74,6 +74,11 @@ LABEL ;
 #define LABEL_COORDS_VOXEL        3
 #define LABEL_COORDS_SURFACE_RAS  4
 
+// binary label / multi-label container (see LabelWriteMulti)
+#define LABEL_BINARY_MAGIC        0x424c424c   // "BLBL"
+#define LABEL_BINARY_VERSION      1
+#define LABEL_BINARY_EXT          ".blabel"
+
 #include "mrisurf.h" // MRI_SURFACE, MRIS
 
 LABEL *LabelToScannerRAS(LABEL *lsrc, MRI *mri, LABEL *ldst) ;
@@ -93,6 +98,10 @@ LABEL   *LabelRead(const char *subject_name,const char *label_name) ;
 LABEL   *LabelReadFrom(const char *subject_name, FILE *fp) ;
 int     LabelWriteInto(LABEL *area, FILE *fp) ;
 int     LabelWrite(LABEL *area,const char *fname) ;
+int     LabelIsBinaryFile(const char *fname) ;
+int     LabelWriteMulti(LABEL **labels, int nlabels, const char *fname) ;
+LABEL   **LabelReadMulti(const char *fname, int *pnlabels, const char *subject_name) ;
+LABEL   *LabelReadMultiByName(const char *fname, const char *label_name, const char *subject_name) ;
 int     LabelToCurrent(LABEL *area, MRI_SURFACE *mris) ;
 int     LabelToCanonical(LABEL *area, MRI_SURFACE *mris) ;
 int     LabelThreshold(LABEL *area, float thresh) ;
@@ -1354,6 +1354,10 @@ MRI *MRIreadHeader(const char *fname, int type);
 int GetSPMStartFrame(void);
 int MRIwrite(MRI *mri,const  char *fname);
 int MRIwriteFrame(MRI *mri,const  char *fname, int frame) ;
+typedef struct MRI_FRAME_WRITER MRI_FRAME_WRITER ;
+MRI_FRAME_WRITER *MRIframeWriterOpen(MRI *mri_template, int nframes, const char *fname) ;
+int MRIframeWriterWrite(MRI_FRAME_WRITER *writer, MRI *mri, int frame) ;
+int MRIframeWriterClose(MRI_FRAME_WRITER **pwriter) ;
 int MRIwriteType(MRI *mri,const  char *fname, int type);
 MRI *MRIreadRaw(FILE *fp, int width, int height, int depth, int type);
 int MRIreorderVox2RAS(MRI *mri_src, MRI *mri_dst, int xdim, int ydim, int zdim);
@@ -1497,10 +1501,12 @@ MRI *MRIconformSliceOrder(MRI *mri);
 #define DTRANS_MODE_OUTSIDE  3
 #define DTRANS_MODE_INSIDE   4
 
-/** This is deprecated.
-    Please use MRIextractDistanceMap in fastmarching.h instead */
+/** Exact separable EDT unless mri_mask is given or FS_DTRANS_FASTMARCHING=1,
+    in which case MRIextractDistanceMap in fastmarching.h is used */
 MRI *MRIdistanceTransform(MRI *mri_src, MRI *mri_dist,
                           int label, float max_dist, int mode, MRI *mri_mask);
+MRI *MRIexactDistanceTransform(MRI *mri_src, MRI *mri_dist,
+                               int label, float max_dist, int mode);
 int MRIaddCommandLine(MRI *mri, char *cmdline) ;
 MRI *MRInonMaxSuppress(MRI *mri_src, MRI *mri_sup,
                        float thresh, int thresh_dir) ;
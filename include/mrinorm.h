@@ -129,6 +129,7 @@ MRI *MRI3dGentleNormalize(MRI *mri_src, MRI *mri_bias, float wm_target,
                           float intensity_below, int only_file, float bias_sigma, MRI *mri_not_control);
 MRI *MRIbuildVoronoiDiagram(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst);
 MRI *MRIsoapBubble(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst,int niter, float min_change);
+MRI *MRIsoapBubbleMultigrid(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst,int niter, float min_change);
 MRI *MRIsoapBubbleExpand(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst,int niter);
 int MRI3dUseFileControlPoints(MRI *mri,const char *fname) ;
 int MRI3dUseLabelControlPoints(MRI *mri, LABEL *area) ;
@@ -0,0 +1,72 @@
+/**
+ * @file  mritile.h
+ * @brief out-of-core, tile-by-tile filtering of volumes on disk
+ *
+ * Streams a large uncompressed volume (.mgh or single-file .nii)
+ * through a neighborhood filter one tile at a time, so that only a
+ * tile plus its halo is ever in memory.
+ */
+/*
+ * Copyright © 2011 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#ifndef MRITILE_H
+#define MRITILE_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "mri.h"
+
+/* an uncompressed volume file opened for region-wise access */
+typedef struct
+{
+  char      fname[STRLEN] ;
+  int       fd ;
+  int       filetype ;        // MRI_MGH_FILE or NII_FILE
+  int       width, height, depth, nframes ;
+  int       type ;            // MRI_UCHAR, MRI_SHORT, MRI_INT or MRI_FLOAT
+  int       bytes_per_voxel ;
+  int       swap ;            // file byte order differs from the host
+  long long data_offset ;     // byte offset of voxel (0,0,0,0)
+  long long data_end ;        // byte offset just past the last voxel
+}
+MRI_TILED_FILE ;
+
+/* a filter maps a tile (with halo) to a result of the same dimensions */
+typedef MRI *(*MRI_TILE_FILTER)(MRI *mri_src, void *parms) ;
+
+#define MRI_TILE_DEFAULT_SIZE  128
+
+MRI_TILED_FILE *MRItiledOpen(const char *fname) ;
+MRI_TILED_FILE *MRItiledCreate(const char *fname, MRI_TILED_FILE *tf_template) ;
+int  MRItiledClose(MRI_TILED_FILE **ptf) ;
+MRI  *MRItiledReadRegion(MRI_TILED_FILE *tf, MRI_REGION *region) ;
+int  MRItiledWriteRegion(MRI_TILED_FILE *tf, MRI *mri, int xoff, int yoff, int zoff, MRI_REGION *region) ;
+
+int  MRItiledApplyFilter(const char *in_fname, const char *out_fname,
+                         MRI_TILE_FILTER filter, void *parms, int halo, int tile_size) ;
+int  MRItiledMedian(const char *in_fname, const char *out_fname, int wsize, int tile_size) ;
+int  MRItiledGaussian(const char *in_fname, const char *out_fname, float sigma, int tile_size) ;
+
+#define MRI_TILE_ERODE   1
+#define MRI_TILE_DILATE  2
+#define MRI_TILE_OPEN    3
+#define MRI_TILE_CLOSE   4
+int  MRItiledMorphology(const char *in_fname, const char *out_fname, int operation, int niter, int tile_size) ;
+
+#if defined(__cplusplus)
+};
+#endif
+
+#endif
@@ -113,6 +113,37 @@ MRI *vol2surf_linear(MRI *SrcVol,
                      int InterpMethod, int float2int, MRI *SrcHitVol,
                      int ProjDistFlag, int nskip);
 
+/* Precomputed vol2surf_linear() geometry that can be applied to
+   many volumes on the same grid (see VOL2SURFplanBuild()) */
+#define VOL2SURF_PLAN_MAGIC   0x56325350  /* "V2SP" */
+#define VOL2SURF_PLAN_VERSION 2
+#define VOL2SURF_PLAN_OUTSIDE (-2)    /* index[0] of a sample outside the volume */
+typedef struct
+{
+  int nvertices;      // number of surface vertices
+  int nproj;          // number of projection depths per vertex
+  int nweights;       // voxels per sample: 1 (nearest) or 8 (trilinear)
+  int width, height, depth; // source voxel grid the plan was built for
+  int interp;         // SAMPLE_NEAREST or SAMPLE_TRILINEAR
+  int ProjDistFlag;   // ProjFrac* are mm instead of fraction of thickness
+  float ProjFracMin, ProjFracMax, ProjFracDelta;
+  int *hitindex;      // [nvertices*nproj] voxel hit (-1 if out of vol)
+  int *index;         // [nvertices*nproj*nweights] voxel index (-1 unused)
+  float *weight;      // [nvertices*nproj*nweights] interpolation weight
+} VOL2SURF_PLAN;
+
+VOL2SURF_PLAN *VOL2SURFplanAlloc(int nvertices, int nproj, int nweights);
+int VOL2SURFplanFree(VOL2SURF_PLAN **pplan);
+VOL2SURF_PLAN *VOL2SURFplanBuild(MRI *SrcVol,
+                                 MATRIX *Qsrc, MATRIX *Fsrc, MATRIX *Wsrc, MATRIX *Dsrc,
+                                 MRI_SURFACE *TrgSurf,
+                                 float ProjFracMin, float ProjFracMax, float ProjFracDelta,
+                                 int ProjDistFlag, int InterpMethod, int float2int);
+MRI *VOL2SURFplanApply(VOL2SURF_PLAN *plan, MRI *SrcVol, int GetProjMax,
+                       MRI *SrcHitVol, MRI *TrgVol);
+int VOL2SURFplanWrite(VOL2SURF_PLAN *plan, const char *fname);
+VOL2SURF_PLAN *VOL2SURFplanRead(const char *fname);
+
 MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs,
 		  int ReverseMapFlag, int DoJac, int UseHash);
 MRI *surf2surf_nnfr(MRI *SrcSurfVals, MRI_SURFACE *SrcSurfReg,
@@ -81,6 +81,16 @@ VOLCLUSTER *clustGrow(int col0, int row0, int slc0,
 int clustGrowOneVoxel(VOLCLUSTER *vc, int col0, int row0, int slc0,
                       MRI *HitMap, int AllowDiag);
 
+int *clustLabelVolume(MRI *vol, int frame,
+                      float thmin, float thmax, int thsign,
+                      MRI *binmask, int maskframe, int nbrs,
+                      int *nClusters, int *nhits);
+VOLCLUSTER **clustLabelsToClusterList(MRI *vol, int *ClustNo,
+                                      int nClusters, int nbrs);
+int clustMaxClusterSize(MRI *vol, int frame,
+                        float thmin, float thmax, int thsign,
+                        MRI *binmask, int nbrs, int *nClusters);
+
 int clustMaxMember(VOLCLUSTER *vc, MRI *vol, int frame, int thsign);
 
 
@@ -59,6 +59,7 @@ static void print_help(void) ;
 static void print_version(void) ;
 static void argnerr(char *option, int n);
 static void dump_options(FILE *fp);
+static int StreamConcat(int nc, int nr, int ns, int nframestot, int datatype);
 //static int  singledash(char *flag);
 
 int main(int argc, char *argv[]) ;
@@ -133,6 +134,7 @@ int DoRMS = 0; // compute root-mean-square on multi-frame input
 int DoCumSum = 0;
 int DoFNorm = 0;
 char *rusage_file=NULL;
+int DoStream = 0; // read inputs one at a time, see StreamConcat()
 
 /*--------------------------------------------------*/
 int main(int argc, char **argv)
@@ -282,6 +284,15 @@ int main(int argc, char **argv)
     }
   }
 
+  if(DoStream)
+  {
+    err = StreamConcat(nc,nr,ns,nframestot,inputDatatype);
+    if(err) exit(err);
+    if(debug) PrintRUsage(RUSAGE_SELF, "mri_ca_label ", stdout);
+    if(rusage_file) WriteRUsage(RUSAGE_SELF, "", rusage_file);
+    return(0);
+  }
+
   printf("Allocing output\n");
   fflush(stdout);
   int datatype=MRI_FLOAT;
@@ -957,6 +968,8 @@ static int parse_commandline(int argc, char **argv)
     {
       DoPCA = 1;
     }
+    else if (!strcasecmp(option, "--stream")) DoStream = 1;
+    else if (!strcasecmp(option, "--no-stream")) DoStream = 0;
     else if (!strcasecmp(option, "--chunk")) setenv("FS_USE_MRI_CHUNK","1",1);
     else if (!strcasecmp(option, "--no-chunk") ) unsetenv("FS_USE_MRI_CHUNK");
       
@@ -1184,6 +1197,10 @@ static void print_usage(void)
   printf("   --rms : root mean square (eg. combine memprage)\n");
   printf("           (square, sum, div-by-nframes, square root)\n");
   printf("   --no-check : do not check inputs (faster)\n");
+  printf("   --stream : read one input at a time instead of holding all of them in memory\n");
+  printf("              (plain concatenation, --mean, --sum, --mean-div-n, --std, --var,\n");
+  printf("               --max, --min, --paired-xxx, --abs/--pos/--neg, --mul, --add;\n");
+  printf("               concatenated output must be .mgh or .mgz)\n");
   printf("   --help      print out information on how to use this program\n");
   printf("   --version   print out version and exit\n");
   printf("\n");
@@ -1288,6 +1305,26 @@ static void check_options(void)
     printf("ERROR: do not use more than one of --abs, --pos, --neg\n");
     exit(1);
   }
+  if(DoStream)
+  {
+    // only operations that can be done in one pass over the frames
+    if(DoMedian || DoMaxIndex || DoConjunction || DoVote || DoSort ||
+       DoNormMean || DoNorm1 || DoASL || M != NULL || ngroups != 0 ||
+       DoCombine || DoPrune || DoPCA || DoSCM || DoTAR1 || DoFNorm ||
+       NReplications > 0 || DoRMS || DoCumSum)
+    {
+      printf("ERROR: --stream only supports concatenation, --mean, --sum, --mean-div-n,\n");
+      printf("       --std, --var, --max, --min, --paired-xxx, --abs, --pos, --neg,\n");
+      printf("       --mul, --add and --max-bonfcor\n");
+      exit(1);
+    }
+    if(DoMean + DoSum + DoMeanDivN + DoStd + DoVar + DoMax + DoMin > 1)
+    {
+      printf("ERROR: --stream can compute only one of --mean, --sum, --mean-div-n,\n");
+      printf("       --std, --var, --max, --min\n");
+      exit(1);
+    }
+  }
 
 
   return;
@@ -1299,6 +1336,282 @@ static void dump_options(FILE *fp)
   return;
 }
 
+/* State of a --stream run, see StreamConcat() */
+typedef struct
+{
+  int nvox, nc, nr, ns;
+  int DoReduce;
+  int nacc;         // number of frames folded into the accumulators
+  int npending;     // 1 if the first frame of a pair is waiting
+  float *frame;     // current frame, column fastest
+  float *pending;   // first frame of a pair
+  double *acc;      // sum, mean (std/var) or extreme value (max/min)
+  double *m2;       // sum of squared deviations (std/var)
+  MRI *mriframe;    // one output frame of the output datatype
+  MRI_FRAME_WRITER *writer;
+} STREAMCONCAT;
+
+/* Pairs up frames if needed, then writes or accumulates sc->frame */
+static int StreamConsumeFrame(STREAMCONCAT *sc)
+{
+  int n, c, r, s;
+  double v, v1, v2, vavg, delta;
+
+  if(DoPaired)
+  {
+    if(! sc->npending)
+    {
+      memcpy(sc->pending, sc->frame, sc->nvox*sizeof(float));
+      sc->npending = 1;
+      return(0);
+    }
+    sc->npending = 0;
+    for(n=0; n < sc->nvox; n++)
+    {
+      v1 = sc->pending[n];
+      v2 = sc->frame[n];
+      v = 0;
+      if(DoPairedAvg) v = (v1+v2)/2.0;
+      if(DoPairedSum) v = (v1+v2);
+      if(DoPairedDiff) v = v1-v2;  // difference
+      if(DoPairedDiffNorm){
+        v = v1-v2; // difference
+        vavg = (v1+v2)/2.0;
+        if (vavg != 0.0) v = v/vavg;
+        else             v = 0;
+      }
+      if(DoPairedDiffNorm1)
+      {
+        v = v1-v2; // difference
+        if (v1 != 0.0) v = v/v1;
+        else           v = 0;
+      }
+      if(DoPairedDiffNorm2)
+      {
+        v = v1-v2; // difference
+        if (v2 != 0.0) v = v/v2;
+        else v = 0;
+      }
+      sc->frame[n] = v;
+    }
+  }
+
+  if(! sc->DoReduce)
+  {
+    // concatenation: scale/offset and write this frame out
+    n = 0;
+    for(s=0; s < sc->ns; s++)
+      for(r=0; r < sc->nr; r++)
+        for(c=0; c < sc->nc; c++)
+        {
+          v = sc->frame[n++];
+          if(DoMultiply) v *= MultiplyVal;
+          if(DoAdd)      v += AddVal;
+          MRIsetVoxVal(sc->mriframe,c,r,s,0,v);
+        }
+    return(MRIframeWriterWrite(sc->writer, sc->mriframe, 0));
+  }
+
+  sc->nacc++;
+  for(n=0; n < sc->nvox; n++)
+  {
+    v = sc->frame[n];
+    if(DoStd || DoVar)
+    {
+      delta = v - sc->acc[n];
+      sc->acc[n] += delta/sc->nacc;
+      sc->m2[n] += delta*(v - sc->acc[n]);
+    }
+    else if(DoMax)
+    {
+      if(sc->nacc == 1 || v > sc->acc[n]) sc->acc[n] = v;
+    }
+    else if(DoMin)
+    {
+      if(sc->nacc == 1 || v < sc->acc[n]) sc->acc[n] = v;
+    }
+    else sc->acc[n] += v;  // mean, sum, mean-div-n
+  }
+  return(0);
+}
+
+/* Feeds each frame of one input through StreamConsumeFrame() */
+static int StreamConsumeInput(STREAMCONCAT *sc, MRI *mri)
+{
+  int c, r, s, f, n, err;
+  double v;
+
+  if(mri->width != sc->nc || mri->height != sc->nr || mri->depth != sc->ns)
+  {
+    printf("ERROR: dimension mismatch between %s and %s\n",
+           inlist[0],mri->fname);
+    return(1);
+  }
+  for(f=0; f < mri->nframes; f++)
+  {
+    n = 0;
+    for(s=0; s < sc->ns; s++)
+      for(r=0; r < sc->nr; r++)
+        for(c=0; c < sc->nc; c++)
+        {
+          v = MRIgetVoxVal(mri,c,r,s,f);
+          if(DoAbs) v = fabs(v);
+          if(DoPos && v < 0.0) v = 0.0;
+          if(DoNeg && v > 0.0) v = 0.0;
+          sc->frame[n++] = v;
+        }
+    err = StreamConsumeFrame(sc);
+    if(err) return(err);
+  }
+  return(0);
+}
+
+/*---------------------------------------------------------------
+  StreamConcat() - bounded-memory version of main() for --stream.
+  The inputs are read one at a time, with the next input read on a
+  second thread while the current one is consumed, so at most two
+  inputs are in memory. Each frame (or pair of frames with
+  --paired-xxx) is either written straight to the output with an
+  MRI_FRAME_WRITER or folded into running per-voxel accumulators.
+  The variance is accumulated with Welford's update so a single pass
+  is enough.
+  ---------------------------------------------------------------*/
+static int StreamConcat(int nc, int nr, int ns, int nframestot, int datatype)
+{
+  STREAMCONCAT sc;
+  MRI *mricur, *mrinext;
+  int nthin, c, r, s, n, err, nframesout;
+  double v;
+
+  memset(&sc, 0, sizeof(sc));
+  sc.nc = nc;
+  sc.nr = nr;
+  sc.ns = ns;
+  sc.nvox = nc*nr*ns;
+  sc.DoReduce = (DoMean || DoSum || DoMeanDivN || DoStd || DoVar || DoMax || DoMin);
+  sc.frame   = (float *) calloc(sc.nvox,sizeof(float));
+  sc.pending = (float *) calloc(sc.nvox,sizeof(float));
+  sc.acc     = (double *) calloc(sc.nvox,sizeof(double));
+  if(DoStd || DoVar) sc.m2 = (double *) calloc(sc.nvox,sizeof(double));
+  if(! DoKeepDatatype) datatype = MRI_FLOAT;
+  sc.mriframe = MRIallocSequence(nc,nr,ns,datatype,1);
+  if(sc.mriframe == NULL) return(1);
+
+  nframesout = nframestot;
+  if(DoPaired) nframesout = nframestot/2;
+
+  printf("Streaming %d inputs\n",ninputs);
+  mrinext = MRIread(inlist[0]);
+  err = 0;
+  for(nthin = 0; nthin < ninputs && !err; nthin++)
+  {
+    mricur = mrinext;
+    mrinext = NULL;
+    if(mricur == NULL)
+    {
+      printf("ERROR: loading %s\n",inlist[nthin]);
+      err = 1;
+      break;
+    }
+    if(Gdiag_no > 0 || debug)
+    {
+      printf("Streaming %dth input %s\n",
+             nthin+1,fio_basename(inlist[nthin],NULL));
+      fflush(stdout);
+    }
+    if(nthin == 0)
+    {
+      MRIcopyHeader(mricur, sc.mriframe);
+      if(! sc.DoReduce)
+      {
+        sc.writer = MRIframeWriterOpen(sc.mriframe, nframesout, out);
+        if(sc.writer == NULL)
+        {
+          err = 1;
+          break;
+        }
+      }
+    }
+    // read the next input while this one is consumed
+#ifdef HAVE_OPENMP
+    #pragma omp parallel sections num_threads(2)
+#endif
+    {
+#ifdef HAVE_OPENMP
+      #pragma omp section
+#endif
+      {
+        if(nthin+1 < ninputs) mrinext = MRIread(inlist[nthin+1]);
+      }
+#ifdef HAVE_OPENMP
+      #pragma omp section
+#endif
+      {
+        err = StreamConsumeInput(&sc, mricur);
+      }
+    }
+    MRIfree(&mricur);
+  }
+  if(mrinext) MRIfree(&mrinext);
+
+  if(! err && sc.npending)
+  {
+    printf("ERROR: --paired-xxx specified but there are an "
+           "odd number of frames\n");
+    err = 1;
+  }
+
+  if(! err && ! sc.DoReduce)
+  {
+    printf("Wrote %d frames to %s\n",nframesout,out);
+    err = MRIframeWriterClose(&sc.writer);
+  }
+  else if(sc.writer) MRIframeWriterClose(&sc.writer);
+
+  if(! err && sc.DoReduce)
+  {
+    if((DoStd || DoVar) && sc.nacc < 2)
+    {
+      printf("ERROR: cannot compute std from one frame\n");
+      err = 1;
+    }
+  }
+
+  if(! err && sc.DoReduce)
+  {
+    printf("nframes = %d\n",sc.nacc);
+    if(DoBonfCor)
+    {
+      DoAdd = 1;
+      AddVal = -log10(sc.nacc);
+    }
+    n = 0;
+    for(s=0; s < ns; s++)
+      for(r=0; r < nr; r++)
+        for(c=0; c < nc; c++)
+        {
+          v = sc.acc[n];
+          if(DoMean) v = v/sc.nacc;
+          if(DoMeanDivN) v = v/((double)sc.nacc*sc.nacc);
+          if(DoVar || DoStd) v = sc.m2[n]/(sc.nacc-1);
+          if(DoStd) v = sqrt(v);
+          if(DoMultiply) v *= MultiplyVal;
+          if(DoAdd)      v += AddVal;
+          MRIsetVoxVal(sc.mriframe,c,r,s,0,v);
+          n++;
+        }
+    printf("Writing to %s\n",out);
+    err = MRIwrite(sc.mriframe,out);
+  }
+
+  free(sc.frame);
+  free(sc.pending);
+  free(sc.acc);
+  if(sc.m2) free(sc.m2);
+  MRIfree(&sc.mriframe);
+  return(err);
+}
+
 MATRIX *GroupedMeanMatrix(int ngroups, int ntotal)
 {
   int nper,r,c;
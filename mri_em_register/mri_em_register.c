@@ -2269,6 +2269,11 @@ find_optimal_linear_xform
   double x_angle, y_angle, z_angle;
   double log_p;
 #endif
+  // packed samples and candidate buffers for the concurrent search
+  GCA_SAMPLE_PACK *pack = NULL ;
+  MATRIX **cand_L = NULL ;
+  double *cand_trans = NULL, *cand_log_p = NULL ;
+  int ncand = 0, max_cand = 0 ;
 
 
 #ifdef FS_CUDA
@@ -2293,8 +2298,17 @@ find_optimal_linear_xform
 #ifdef FS_CUDA
   max_log_p = CUDA_ComputeLogSampleProbability( m_L, Gclamp );
 #else
-  max_log_p = local_GCAcomputeLogSampleProbability
-    (gca, gcas, mri, m_L, nsamples, exvivo, Gclamp) ;
+  // the packed kernel only implements the plain log likelihood. The
+  // starting value comes from the same kernel as the candidates so
+  // they are compared against a consistent baseline.
+  if (!exvivo && !robust && !use_variance)
+  {
+    pack = GCAsamplePackAlloc(gca, gcas, nsamples) ;
+    max_log_p = GCAcomputeLogSampleProbabilityPacked(pack, mri, m_L, Gclamp) ;
+  }
+  else
+    max_log_p = local_GCAcomputeLogSampleProbability
+      (gca, gcas, mri, m_L, nsamples, exvivo, Gclamp) ;
 #endif
 
   // Loop a set number of times to polish transform
@@ -2421,6 +2435,76 @@ find_optimal_linear_xform
                 m_tmp3 = MatrixMultiply(m_tmp2, m_L, m_tmp3) ;
 
                 // translation //////////
+                // The translations are independent candidates, so score
+                // them concurrently and keep the first best one in the
+                // original scan order.
+                if (pack)
+                {
+                  int c ;
+
+                  ncand = 0 ;
+                  for (x_trans = min_trans ;
+                       x_trans <= max_trans ;
+                       x_trans += delta_trans)
+                    for (y_trans = min_trans ;
+                         y_trans <= max_trans ;
+                         y_trans += delta_trans)
+                      for (z_trans= min_trans ;
+                           z_trans <= max_trans ;
+                           z_trans += delta_trans)
+                      {
+                        if (ncand >= max_cand)
+                        {
+                          max_cand = 2*max_cand + 64 ;
+                          cand_L = (MATRIX **)realloc(cand_L, max_cand*sizeof(MATRIX *)) ;
+                          cand_trans = (double *)realloc(cand_trans, 3*max_cand*sizeof(double)) ;
+                          cand_log_p = (double *)realloc(cand_log_p, max_cand*sizeof(double)) ;
+                          for (c = ncand ; c < max_cand ; c++)
+                          {
+                            cand_L[c] = NULL ;
+                          }
+                        }
+                        *MATRIX_RELT(m_trans, 1, 4) = x_trans ;
+                        *MATRIX_RELT(m_trans, 2, 4) = y_trans ;
+                        *MATRIX_RELT(m_trans, 3, 4) = z_trans ;
+                        cand_L[ncand] = MatrixMultiply(m_trans, m_tmp3, cand_L[ncand]) ;
+                        cand_trans[3*ncand] = x_trans ;
+                        cand_trans[3*ncand+1] = y_trans ;
+                        cand_trans[3*ncand+2] = z_trans ;
+                        ncand++ ;
+                      }
+
+                  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+                  #pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+                  for (c = 0 ; c < ncand ; c++)
+                  {
+                    ROMP_PFLB_begin
+                    cand_log_p[c] =
+                      GCAcomputeLogSampleProbabilityPacked(pack, mri, cand_L[c], Gclamp) ;
+                    ROMP_PFLB_end
+                  }
+                  ROMP_PF_end
+
+                  for (c = 0 ; c < ncand ; c++)
+                  {
+                    if (cand_log_p[c] > max_log_p)
+                    {
+                      max_log_p = cand_log_p[c] ;
+                      x_max_scale = x_scale ;
+                      y_max_scale = y_scale ;
+                      z_max_scale = z_scale ;
+                      x_max_rot = x_angle ;
+                      y_max_rot = y_angle ;
+                      z_max_rot = z_angle ;
+                      x_max_trans = cand_trans[3*c] ;
+                      y_max_trans = cand_trans[3*c+1] ;
+                      z_max_trans = cand_trans[3*c+2] ;
+                    }
+                  }
+                }
+                else
                 for (x_trans = min_trans ;
                      x_trans <= max_trans ;
                      x_trans += delta_trans)
@@ -2563,6 +2647,20 @@ find_optimal_linear_xform
   MatrixFree(&m_trans) ;
   MatrixFree(&m_tmp3) ;
 
+  if (pack)
+  {
+    GCAsamplePackFree(&pack) ;
+  }
+  for (i = 0 ; i < max_cand ; i++)
+  {
+    if (cand_L[i])
+    {
+      MatrixFree(&cand_L[i]) ;
+    }
+  }
+  free(cand_L) ;
+  free(cand_trans) ;
+  free(cand_log_p) ;
 
 #ifdef FS_CUDA
   CUDA_em_register_Release();
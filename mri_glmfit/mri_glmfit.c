@@ -648,7 +648,6 @@ int UseUniform = 0;
 double UniformMin = 0;
 double UniformMax = 0;
 
-SURFCLUSTERSUM *SurfClustList;
 int nClusters;
 char *subject=NULL, *hemi=NULL, *simbase=NULL;
 MRI_SURFACE *surf=NULL;
@@ -1798,18 +1797,24 @@ int main(int argc, char **argv) {
 	      MRIScopyMRI(surf, sig, 0, "val");
 	      if(debug || Gdiag_no > 0) printf("Clustering on surface %lf\n",
 					       TimerStop(&mytimer)/1000.0);
-	      SurfClustList = sclustMapSurfClusters(surf,threshadj,-1,csd->threshsign,
-						    0,&nClusters,NULL);
-	      csize = sclustMaxClusterArea(SurfClustList, nClusters);
+	      nClusters = sclustMaxClusterStats(surf,threshadj,-1,csd->threshsign,
+						&csize,NULL,NULL);
 	    } 
 	    else {
 	      // volume clustering -------------
 	      if (debug) printf("Clustering on volume\n");
-	      VolClustList = clustGetClusters(sig, 0, threshadj,-1,csd->threshsign,0,
-					      mriglm->mask, &nClusters, NULL);
-	      csize = voxelsize*clustMaxClusterCount(VolClustList,nClusters);
-	      if (Gdiag_no > 0) clustDumpSummary(stdout,VolClustList,nClusters);
-	      clustFreeClusterList(&VolClustList,nClusters);
+	      if (Gdiag_no > 0) {
+		VolClustList = clustGetClusters(sig, 0, threshadj,-1,csd->threshsign,0,
+						mriglm->mask, &nClusters, NULL);
+		csize = voxelsize*clustMaxClusterCount(VolClustList,nClusters);
+		clustDumpSummary(stdout,VolClustList,nClusters);
+		clustFreeClusterList(&VolClustList,nClusters);
+	      }
+	      else {
+		// only the max cluster size is needed
+		csize = voxelsize*clustMaxClusterSize(sig, 0, threshadj,-1,csd->threshsign,
+						      mriglm->mask, 6, &nClusters);
+	      }
 	    }
 	    if(debug) printf("%s %d nc=%d  maxcsize=%g  sigmax=%g  Fmax=%g\n",
 			     mriglm->glm->Cname[n],nthsim,nClusters,csize,sigmax,Fmax);
@@ -1862,7 +1867,6 @@ int main(int argc, char **argv) {
 	      MRIwrite(sig,tmpstr);
 	      exit(1);
 	    }
-	    free(SurfClustList);
 	  } // contrasts
 	} // sign list
       } // thresh list
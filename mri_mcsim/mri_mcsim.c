@@ -175,8 +175,8 @@ int main(int argc, char *argv[]) {
   int nthSign, nthFWHM, nthThresh;
   double sigmax, zmax, threshadj, csize, csizeavg, cweightvtx, searchspace,avgvtxarea;
   int csizen;
+  float cweightvtxf;
   int nClusters, cmax,rmax,smax;
-  SURFCLUSTERSUM *SurfClustList;
   struct timeb  mytimer;
   LABEL *clabel;
   FILE *fp, *fpLog=NULL;
@@ -470,14 +470,12 @@ int main(int argc, char *argv[]) {
 	  if(csd->threshsign == 0) threshadj = csd->thresh;
 	  else threshadj = csd->thresh - log10(2.0); // one-sided test
 	  // Compute clusters
-	  SurfClustList = sclustMapSurfClusters(surf,threshadj,-1,csd->threshsign,
-						0,&nClusters,NULL);
-	  // Actual area of cluster with max area
-	  csize  = sclustMaxClusterArea(SurfClustList, nClusters);
-	  // Number of vertices of cluster with max number of vertices. 
-	  // Note: this may be a different cluster from above!
-	  csizen = sclustMaxClusterCount(SurfClustList, nClusters);
-	  cweightvtx = sclustMaxClusterWeightVtx(SurfClustList, nClusters, csd->threshsign);
+	  // Actual area of cluster with max area, number of vertices of
+	  // cluster with max number of vertices (note: this may be a
+	  // different cluster), and max vertex-weighted cluster weight
+	  nClusters = sclustMaxClusterStats(surf,threshadj,-1,csd->threshsign,
+					    &csize,&csizen,&cweightvtxf);
+	  cweightvtx = cweightvtxf;
 	  // Area of this cluster based on average vertex area. This just scales
 	  // the number of vertices.
 	  csizeavg = csizen * avgvtxarea;
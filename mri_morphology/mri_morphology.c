@@ -41,6 +41,7 @@
 #include "timer.h"
 #include "version.h"
 #include "cma.h"
+#include "mritile.h"
 
 int main(int argc, char *argv[]) ;
 static int get_option(int argc, char *argv[]) ;
@@ -63,10 +64,12 @@ char *Progname ;
 static void usage_exit(int code) ;
 
 static int label = -1 ;
+static int label_given = 0 ;
 
 MRI *MRIerodeBottom(MRI *mri_src, int label, MRI *mri_dst) ;
 
 static MRI *mri_mask = NULL ;
+static int tile_size = 0 ;
 int
 main(int argc, char *argv[]) {
   char   *out_fname, **av ;
@@ -99,6 +102,30 @@ main(int argc, char *argv[]) {
     usage_exit(1) ;
 
   out_fname = argv[4] ;
+  if (tile_size > 0)  // stream the volume through in tiles instead of reading it
+  {
+    int tile_op = 0 ;
+
+    if (!stricmp(argv[2], "dilate"))
+      tile_op = MRI_TILE_DILATE ;
+    else if (!stricmp(argv[2], "erode"))
+      tile_op = MRI_TILE_ERODE ;
+    else if (!stricmp(argv[2], "open"))
+      tile_op = MRI_TILE_OPEN ;
+    else if (!stricmp(argv[2], "close"))
+      tile_op = MRI_TILE_CLOSE ;
+    if (tile_op == 0 || label_given || mri_mask)
+      ErrorExit(ERROR_UNSUPPORTED, "%s: -tiled only supports open, close, dilate and erode without -l or -mask",
+                Progname) ;
+    printf("applying %s %d times to %s in tiles of %d\n", argv[2], atoi(argv[3]), argv[1], tile_size) ;
+    if (MRItiledMorphology(argv[1], out_fname, tile_op, atoi(argv[3]), tile_size) != NO_ERROR)
+      ErrorExit(Gerror, "%s: tiled processing of %s failed", Progname, argv[1]) ;
+    msec = TimerStop(&start) ;
+    seconds = nint((float)msec/1000.0f) ;
+    fprintf(stderr, "morphological processing took %d minutes and %d seconds.\n",
+            seconds / 60, seconds % 60) ;
+    exit(0) ;
+  }
   mri_src = MRIread(argv[1]) ;
   if (mri_src == NULL)
     ErrorExit(ERROR_BADPARM, "%s: could not read input volume %s\n",
@@ -303,9 +330,15 @@ get_option(int argc, char *argv[]) {
     Gz = atoi(argv[4]) ;
     nargs = 3 ;
     printf("debugging voxel (%d, %d, %d)\n", Gx,Gy,Gz) ;
+  }
+  else if (!stricmp(option, "tiled"))
+  {
+    tile_size = atoi(argv[2]) ;
+    nargs = 1 ;
   } else switch (toupper(*option)) {
   case 'L':
     label = atoi(argv[2]) ;
+    label_given = 1 ;
     nargs = 1 ;
     printf("only applying operations to label %d\n", label) ;
     break ;
@@ -332,6 +365,7 @@ usage_exit(int code) {
   printf("\twhere <operation> can be [open,close,dilate,erode,mode,fill_holes,erode_bottom,dilate_thresh,erode_thresh]\n");
   printf("\tvalid options are:\n") ;
   printf("\t-l <label>  only apply operations to <label> instead of all nonzero voxels\n") ;
+  printf("\t-tiled <size>  process an uncompressed .mgh/.nii volume out of core in <size>^3 tiles\n") ;
   exit(code) ;
 }
 
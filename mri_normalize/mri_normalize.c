@@ -584,7 +584,7 @@ main(int argc, char *argv[])
     mri_dst = MRIscalarMul(mri_src, NULL, scale) ;
     MRIremoveWMOutliers(mri_dst, mri_ctrl, mri_ctrl, intensity_below/2) ;
     mri_bias = MRIbuildBiasImage(mri_dst, mri_ctrl, NULL, 0.0) ;
-    MRIsoapBubble(mri_bias, mri_ctrl, mri_bias, 50, 1) ;
+    MRIsoapBubbleMultigrid(mri_bias, mri_ctrl, mri_bias, 50, 1) ;
     MRIapplyBiasCorrectionSameGeometry(mri_dst, mri_bias, mri_dst,
                                        DEFAULT_DESIRED_WHITE_MATTER_VALUE);
     //    MRIwrite(mri_dst, out_fname) ;
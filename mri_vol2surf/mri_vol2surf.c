@@ -197,6 +197,9 @@ MATRIX *Mtrans = NULL;
 char *vsmfile = NULL;
 MRI *vsm = NULL;
 int UseOld = 1;
+static char *planfile = NULL;      // precomputed sampling plan to use
+static char *planfile_save = NULL; // save sampling plan here
+static VOL2SURF_PLAN *plan = NULL;
 MRI *MRIvol2surf(MRI *SrcVol, MATRIX *Rtk, MRI_SURFACE *TrgSurf, 
 		 MRI *vsm, int InterpMethod, MRI *SrcHitVol, 
 		 float ProjFrac, int ProjType, int nskip);
@@ -504,6 +507,56 @@ int main(int argc, char **argv) {
                                   mri_wm, mri_gm, mri_csf) ;
     MatrixFree(&Qsrc) ; MatrixFree(&QFWDsrc) ;
   }
+  else if (planfile || planfile_save)
+  {
+    if (planfile) {
+      printf("Reading sampling plan %s\n",planfile);
+      plan = VOL2SURFplanRead(planfile);
+      if (plan == NULL) exit(1);
+      if (plan->nvertices != Surf->nvertices) {
+        printf("ERROR: plan has %d vertices, surface has %d\n",
+               plan->nvertices,Surf->nvertices);
+        exit(1);
+      }
+      if (plan->interp != interpmethod) {
+        printf("ERROR: plan was built with interp %s, not %s\n",
+               (plan->interp == SAMPLE_TRILINEAR) ? "trilinear" : "nearest",
+               (interpmethod == SAMPLE_TRILINEAR) ? "trilinear" : "nearest");
+        exit(1);
+      }
+      if (plan->ProjDistFlag != ProjDistFlag) {
+        printf("ERROR: plan projects by %s, command line by %s\n",
+               plan->ProjDistFlag ? "distance" : "fraction of thickness",
+               ProjDistFlag ? "distance" : "fraction of thickness");
+        exit(1);
+      }
+      if (fabs(plan->ProjFracMin - ProjFracMin) > 1e-6 ||
+          fabs(plan->ProjFracMax - ProjFracMax) > 1e-6 ||
+          fabs(plan->ProjFracDelta - ProjFracDelta) > 1e-6) {
+        printf("ERROR: plan projects %g to %g by %g, command line %g to %g by %g\n",
+               plan->ProjFracMin,plan->ProjFracMax,plan->ProjFracDelta,
+               ProjFracMin,ProjFracMax,ProjFracDelta);
+        exit(1);
+      }
+    }
+    else {
+      printf("Building sampling plan\n");
+      plan = VOL2SURFplanBuild(SrcVol, Qsrc, Fsrc, Wsrc, Dsrc, Surf,
+                               ProjFracMin, ProjFracMax, ProjFracDelta,
+                               ProjDistFlag, interpmethod, float2int);
+      if (plan == NULL) exit(1);
+      printf("Saving sampling plan to %s\n",planfile_save);
+      err = VOL2SURFplanWrite(plan,planfile_save);
+      if (err) exit(1);
+    }
+    printf("Applying sampling plan (%d projections)\n",plan->nproj);
+    SurfVals = VOL2SURFplanApply(plan, SrcVol, GetProjMax, SrcHitVol, NULL);
+    if (SurfVals == NULL) {
+      printf("ERROR: mapping volume to source\n");
+      exit(1);
+    }
+    VOL2SURFplanFree(&plan);
+  }
   else
   {
     nproj = 0;
@@ -1044,6 +1097,16 @@ static int parse_commandline(int argc, char **argv) {
       outfile = pargv[0];
       nargsused = 1;
     } 
+    else if (!strcmp(option, "--plan")) {
+      if (nargc < 1) argnerr(option,1);
+      planfile = pargv[0];
+      nargsused = 1;
+    } 
+    else if (!strcmp(option, "--plan-save")) {
+      if (nargc < 1) argnerr(option,1);
+      planfile_save = pargv[0];
+      nargsused = 1;
+    } 
     else if (!strcmp(option, "--vsm")) {
       if (nargc < 1) argnerr(option,1);
       vsmfile = pargv[0];
@@ -1155,6 +1218,8 @@ static void print_usage(void) {
          "computed volume fractions (see mri_compute_volume_fractions)\n");
   printf("   --projdist-max min max del : max along normal\n");
   printf("   --mask label : mask the output with the given label file (usually cortex)\n");
+  printf("   --plan-save planfile : save the sampling geometry for reuse with --plan\n");
+  printf("   --plan planfile : sample using a saved plan instead of recomputing it\n");
   printf("   --cortex : use hemi.cortex.label from trgsubject\n");
   
   //printf("   --thickness thickness file (thickness)\n");
@@ -1464,6 +1529,21 @@ static void check_options(void) {
     exit(1);
   }
 
+  if (planfile || planfile_save) {
+    if (planfile && planfile_save) {
+      printf("ERROR: cannot specify both --plan and --plan-save\n");
+      exit(1);
+    }
+    if (!UseOld || ProjOpt) {
+      printf("ERROR: --plan and --plan-save cannot be used with --vsm or --projopt\n");
+      exit(1);
+    }
+    if (interpmethod != SAMPLE_NEAREST && interpmethod != SAMPLE_TRILINEAR) {
+      printf("ERROR: --plan and --plan-save require nearest or trilinear interpolation\n");
+      exit(1);
+    }
+  }
+
   if (srctype == MRI_VOLUME_TYPE_UNKNOWN) {
     if (defaulttype == MRI_VOLUME_TYPE_UNKNOWN)
       srctype = mri_identify(srcvolid);
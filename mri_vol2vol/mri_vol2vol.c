@@ -457,6 +457,7 @@ ENDHELP --------------------------------------------------------------
 #include "chronometer.h"
 #include "timer.h"
 #include "mrinorm.h"
+#include "romp_support.h"
 
 #ifdef FS_CUDA
 #include "devicemanagement.h"
@@ -2179,12 +2180,10 @@ MATRIX *LoadRfsl(char *fname) {
  */
 MRI *MRIvol2volGCAM(MRI *src, LTA *srclta, GCA_MORPH *gcam, LTA *dstlta, MRI *vsm, int sample_type, MRI *dst)
 {
-  int c,r,s,f,out_of_gcam,cvsm,rvsm,iss;
+  int c;
   VOL_GEOM *vgdst_src,*vgdst_dst;
-  MATRIX *crsDst, *crsGCAM=NULL, *crsAnat=NULL, *crsSrc=NULL, *Vdst, *Vsrc;
-  double val,v;
+  MATRIX *Vdst, *Vsrc;
   MRI_BSPLINE * bspline = NULL;
-  float drvsm, *valvect;
   struct timeb timer;
 
   if(!vsm) printf("MRIvol2volGCAM(): VSM not used\n");
@@ -2245,15 +2244,27 @@ MRI *MRIvol2volGCAM(MRI *src, LTA *srclta, GCA_MORPH *gcam, LTA *dstlta, MRI *vs
   }
 
   if(sample_type == SAMPLE_CUBIC_BSPLINE) bspline = MRItoBSpline(src,NULL,3);
-  valvect = (float *) calloc(sizeof(float),src->nframes);
 
-  crsDst = MatrixAlloc(4,1,MATRIX_REAL);
-  crsDst->rptr[4][1] = 1;
-  crsAnat = MatrixAlloc(4,1,MATRIX_REAL);
-  crsAnat->rptr[4][1] = 1;
-  // scroll thru the CRS in the output/dest volume
+  // scroll thru the CRS in the output/dest volume. Columns are
+  // independent, so each one gets its own coordinate vectors and
+  // frame buffer.
   TimerStart(&timer);
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
   for(c=0; c < dst->width; c++){
+    ROMP_PFLB_begin
+    int r,s,f,out_of_gcam,cvsm,rvsm,iss;
+    MATRIX *crsDst, *crsGCAM=NULL, *crsAnat=NULL, *crsSrc=NULL;
+    double val,v;
+    float drvsm, *valvect;
+
+    valvect = (float *) calloc(sizeof(float),src->nframes);
+    crsDst = MatrixAlloc(4,1,MATRIX_REAL);
+    crsDst->rptr[4][1] = 1;
+    crsAnat = MatrixAlloc(4,1,MATRIX_REAL);
+    crsAnat->rptr[4][1] = 1;
     for(r=0; r < dst->height; r++){
       for(s=0; s < dst->depth; s++){
 	// CRS in destination volume
@@ -2309,35 +2320,43 @@ MRI *MRIvol2volGCAM(MRI *src, LTA *srclta, GCA_MORPH *gcam, LTA *dstlta, MRI *vs
 	if(crsSrc->rptr[2][1] < 0 || crsSrc->rptr[2][1] >= src->height) continue;
 	if(crsSrc->rptr[3][1] < 0 || crsSrc->rptr[3][1] >= src->depth)  continue;
 
-        if(sample_type != SAMPLE_TRILINEAR)
+        if(sample_type == SAMPLE_TRILINEAR || sample_type == SAMPLE_CUBIC_BSPLINE){
+	  // Same as sampling frame by frame, but the interpolation
+	  // weights are computed once for all frames
+	  if(sample_type == SAMPLE_TRILINEAR)
+	    MRIsampleSeqVolume(src, crsSrc->rptr[1][1],crsSrc->rptr[2][1],crsSrc->rptr[3][1],
+			       valvect,0, src->nframes-1) ;
+	  else
+	    MRIsampleSeqBSpline(bspline, crsSrc->rptr[1][1],crsSrc->rptr[2][1],crsSrc->rptr[3][1],
+				valvect,0, src->nframes-1) ;
+	  if(dst->type == MRI_FLOAT)
+	    for(f=0; f < src->nframes; f++) MRIFseq_vox(dst,c,r,s,f) = valvect[f];
+	  else
+	    for(f=0; f < src->nframes; f++) MRIsetVoxVal(dst,c,r,s,f, valvect[f]);
+	}
+	else {
 	  for(f=0; f < src->nframes; f++){
-	    if(sample_type == SAMPLE_CUBIC_BSPLINE)
-	      MRIsampleBSpline(bspline, crsSrc->rptr[1][1],crsSrc->rptr[2][1],crsSrc->rptr[3][1], f, &val);
-	    else
-	      MRIsampleVolumeFrameType(src,
-				       crsSrc->rptr[1][1],crsSrc->rptr[2][1],crsSrc->rptr[3][1],
-				       f, sample_type, &val) ;
+	    MRIsampleVolumeFrameType(src,
+				     crsSrc->rptr[1][1],crsSrc->rptr[2][1],crsSrc->rptr[3][1],
+				     f, sample_type, &val) ;
 	    MRIsetVoxVal(dst,c,r,s,f, val);
 	  }
-	else {
-	  // This will do the same as above, it is just faster with multiple frames
-          MRIsampleSeqVolume(src, crsSrc->rptr[1][1],crsSrc->rptr[2][1],crsSrc->rptr[3][1],
-			     valvect,0, src->nframes-1) ;
-	  for(f=0; f < src->nframes; f++)  MRIsetVoxVal(dst,c,r,s,f, valvect[f]);
 	}
 
       } // s
     } // r
+    MatrixFree(&crsDst);
+    MatrixFree(&crsGCAM);
+    MatrixFree(&crsAnat);
+    MatrixFree(&crsSrc);
+    free(valvect);
+    ROMP_PFLB_end
   } // c
+  ROMP_PF_end
 
-  MatrixFree(&crsDst);
-  MatrixFree(&crsGCAM);
-  MatrixFree(&crsAnat);
-  MatrixFree(&crsSrc);
   MatrixFree(&Vdst);
   MatrixFree(&Vsrc);
   if(bspline) MRIfreeBSpline(&bspline);
-  free(valvect);
 
   printf("MRIvol2volGCAM: t=%6.4f\n",TimerStop(&timer)/1000.0);
   fflush(stdout);
@@ -148,7 +148,7 @@ float distthresh =   0.0;
 int   allowdiag  = 0;
 int sig2pmax = 0; // convert max value from -log10(p) to p
 
-MRI *vol, *HitMap, *outvol, *maskvol, *binmask;
+MRI *vol, *outvol, *maskvol, *binmask;
 VOLCLUSTER **ClusterList, **ClusterList2;
 MATRIX *CRS2MNI, *CRS2FSA, *FSA2Func;
 LABEL *label;
@@ -202,9 +202,9 @@ int regheader = 0;
 /*--------------------- MAIN -----------------------------------*/
 /*--------------------------------------------------------------*/
 int main(int argc, char **argv) {
-  int nhits, *hitcol, *hitrow, *hitslc,nargs;
+  int nhits, *ClustNo, nargs;
   int col, row, slc;
-  int nthhit, n, m, nclusters, nprunedclusters;
+  int n, m, nclusters, nprunedclusters;
   float x,y,z,val,pval;
   char *stem;
   COLOR_TABLE *ct;
@@ -374,55 +374,31 @@ int main(int argc, char **argv) {
   }
 
 
-  /* Initialize the hit map - this is a map of voxels that have been
-     accounted for as either outside of a the threshold range or
-     belonging to a cluster. The initialization is for thresholding */
-  HitMap = clustInitHitMap(vol, frame, threshminadj, threshmaxadj, threshsign,
-                           &nhits, &hitcol, &hitrow, &hitslc,
-                           binmask, maskframe);
-  if (HitMap == NULL) {
-    printf("ERROR: initializing hit map\n");
-    if(nhits == 0){
-      printf("  No voxels were found that met the threshold criteria");      
-      if(binmask) printf(" within the mask");      
-      printf(".\n");
-    }
+  /* Label the voxels within the threshold range by cluster */
+  ClustNo = clustLabelVolume(vol, frame, threshminadj, threshmaxadj, threshsign,
+                             binmask, maskframe, allowdiag ? 26 : 6,
+                             &nclusters, &nhits);
+  if (ClustNo == NULL) {
+    printf("ERROR: labeling clusters\n");
     exit(1);
   }
-  //MRIwriteType(HitMap,"hitmap",BSHORT_FILE);
 
   printf("INFO: Found %d voxels in threhold range\n",nhits);
 
-  /* Allocate an array of clusters equal to the number of hits -- this
-     is the maximum number of clusters possible */
-  ClusterList = clustAllocClusterList(nhits);
+  ClusterList = clustLabelsToClusterList(vol, ClustNo, nclusters,
+                                         allowdiag ? 26 : 6);
   if (ClusterList == NULL) {
-    fprintf(stderr,"ERROR: could not alloc %d clusters\n",nhits);
+    fprintf(stderr,"ERROR: could not alloc %d clusters\n",nclusters);
     exit(1);
   }
+  free(ClustNo);
 
-  nclusters = 0;
-  for (nthhit = 0; nthhit < nhits; nthhit ++) {
-
-    /* Determine whether this hit is still valid. It may
-       not be if it was assigned to the cluster of a
-       previous hit */
-    col = hitcol[nthhit];
-    row = hitrow[nthhit];
-    slc = hitslc[nthhit];
-    if (MRIgetVoxVal(HitMap,col,row,slc,0)) continue;
-
-    /* Grow cluster using this hit as a seed */
-    ClusterList[nclusters] = clustGrow(col,row,slc,HitMap,allowdiag);
-
+  for (n = 0; n < nclusters; n++) {
     /* Determine the member with the maximum value */
-    clustMaxMember(ClusterList[nclusters], vol, frame, threshsign);
-
-    //clustComputeXYZ(ClusterList[nclusters],CRS2FSA); /* for FSA coords */
-    clustComputeTal(ClusterList[nclusters],CRS2MNI); /*"true" Tal coords */
+    clustMaxMember(ClusterList[n], vol, frame, threshsign);
 
-    /* increment the number of clusters */
-    nclusters ++;
+    //clustComputeXYZ(ClusterList[n],CRS2FSA); /* for FSA coords */
+    clustComputeTal(ClusterList[n],CRS2MNI); /*"true" Tal coords */
   }
 
   printf("INFO: Found %d clusters that meet threshold criteria\n",
@@ -88,6 +88,7 @@ extern "C"
 
 #include "talairachex.h"
 #include "mri_circulars.h"
+#include "romp_support.h"
 }
 
 #define WM_CONST 110 /* not used anymore */
@@ -271,6 +272,11 @@ typedef struct
   int validation;
   int verbose_mode;
   int dark_iter;
+
+  // myWorldToVoxel() of mri_src and mri_orig as affine matrices so that
+  // the per-vertex forces can be computed in parallel (see FitShape)
+  double src_w2v[3][4];
+  double orig_w2v[3][4];
 }
 MRI_variables;
 
@@ -450,6 +456,41 @@ int (*myVoxelToWorld)(MRI *mri,
                       double *xw, double *yw, double *zw);
 ///////////////////////////////////////////////////////////////////
 
+// myWorldToVoxel is linear but not reentrant (it uses static work
+// vectors), so sample it once to get the affine matrix
+static void cacheWorldToVoxelMatrix(MRI *mri, double w2v[3][4])
+{
+  double x0, y0, z0, x, y, z;
+  int c;
+
+  myWorldToVoxel(mri, 0, 0, 0, &x0, &y0, &z0);
+  w2v[0][3] = x0;
+  w2v[1][3] = y0;
+  w2v[2][3] = z0;
+  for (c = 0; c < 3; c++)
+  {
+    myWorldToVoxel(mri, c == 0, c == 1, c == 2, &x, &y, &z);
+    w2v[0][c] = x - x0;
+    w2v[1][c] = y - y0;
+    w2v[2][c] = z - z0;
+  }
+}
+
+static void cacheWorldToVoxel(MRI_variables *MRI_var)
+{
+  cacheWorldToVoxelMatrix(MRI_var->mri_src, MRI_var->src_w2v);
+  cacheWorldToVoxelMatrix(MRI_var->mri_orig, MRI_var->orig_w2v);
+}
+
+static inline void cachedWorldToVoxel(const double w2v[3][4],
+                                      double xw, double yw, double zw,
+                                      double *xv, double *yv, double *zv)
+{
+  *xv = w2v[0][0]*xw + w2v[0][1]*yw + w2v[0][2]*zw + w2v[0][3];
+  *yv = w2v[1][0]*xw + w2v[1][1]*yw + w2v[1][2]*zw + w2v[1][3];
+  *zv = w2v[2][0]*xw + w2v[2][1]*yw + w2v[2][2]*zw + w2v[2][3];
+}
+
 #include "mri_watershed.help.xml.h"
 void usageHelp()
 {
@@ -1846,7 +1887,21 @@ void AnalyzeT1Volume(STRIP_PARMS *parms,MRI_variables *MRI_var)
   }
 
   /*detect if we are in a T1 volume*/
+  // slices are histogrammed in parallel; integer counts so the merge
+  // order does not matter
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(shown_reproducible) private(i,j,pb)
+#endif
   for (k=2; k<MRI_var->depth-2; k++)
+  {
+    ROMP_PFLB_begin
+    long slice_number[20];
+    int n;
+    for (n=0; n<20; n++)
+    {
+      slice_number[n]=0;
+    }
     for (j=2; j<MRI_var->height-2; j++)
     {
       pb=&MRIvox(MRI_var->mri_src,0,j,k);
@@ -1855,11 +1910,21 @@ void AnalyzeT1Volume(STRIP_PARMS *parms,MRI_variables *MRI_var)
       {
         if (((*pb)>99) && ((*pb)<120))
         {
-          T1number[(*pb)-100]++;
+          slice_number[(*pb)-100]++;
         }
         pb++;
       }
     }
+#ifdef HAVE_OPENMP
+    #pragma omp critical
+#endif
+    for (n=0; n<20; n++)
+    {
+      T1number[n]+=slice_number[n];
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
 
   /*look if intensity=110 > average around*/
   average=0;
@@ -2322,7 +2387,15 @@ int Pre_CharSorting(STRIP_PARMS *parms,MRI_variables *MRI_var)
     intensity_percent[k]=0;
   }
 
+  // each slice of the cube is independent
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(shown_reproducible) \
+    private(i,j,u,v,n,pbc,mean,var)
+#endif
   for (k=zmin; k<zmax; k++)
+  {
+    ROMP_PFLB_begin
     for (j=ymin; j<ymax; j++)
     {
       for (u=0; u<3; u++)
@@ -2370,6 +2443,9 @@ int Pre_CharSorting(STRIP_PARMS *parms,MRI_variables *MRI_var)
           }
       }
     }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
 
   /*- Find the mean variance (27 voxels)
     - And find the mean variance for each intensity
@@ -8396,14 +8472,23 @@ int mrisLimitGradientDistance(MRI_SURFACE *mris, MHT *mht, int vno)
 
 int mrisAverageGradients(MRIS *mris,int niter)
 {
-  int vno, vnum,*pnb,vnb;
-  float dx,dy,dz,dot,num;
-  VERTEX *v,*vn;
+  int vno;
+  VERTEX *v;
 
   while (niter--)
   {
+    // each vertex only reads the od* of its neighbors and writes its td*
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
     for (vno = 0 ; vno < mris->nvertices ; vno++)
     {
+      ROMP_PFLB_begin
+      int vnum,*pnb,vnb;
+      float dx,dy,dz,dot,num;
+      VERTEX *v,*vn;
+
       v = &mris->vertices[vno] ;
 
       dx = v->odx ;
@@ -8431,7 +8516,9 @@ int mrisAverageGradients(MRIS *mris,int niter)
       v->tdx = dx / num ;
       v->tdy = dy / num ;
       v->tdz = dz / num ;
+      ROMP_PFLB_end
     }
+    ROMP_PF_end
     for (vno = 0 ; vno < mris->nvertices ; vno++)
     {
       v = &mris->vertices[vno] ;
@@ -8821,6 +8908,7 @@ void MRISComputeLocalValues(MRI_variables *MRI_var)
   double gm_val,csf_val,val,x,y,z, xw, yw, zw;
   double xw1,yw1,zw1,xw2,yw2,zw2,nx, ny, nz, mag, max_mag ;
   double csf,gm;
+  double w2v[3][4], *csfgm;
   float mean_csf,mean_gray,mean_trans;
   float var_csf,var_gray,var_trans;
   int ninside,noutside;
@@ -8892,21 +8980,43 @@ void MRISComputeLocalValues(MRI_variables *MRI_var)
     fprintf(stdout,"\n      first pass on the vertices of the tesselation");
   }
 
-  for (ref=0,k=0; k<nvertices; k++)
+  /*
+    the search along the normal only reads the volume, so vertices are
+    processed in parallel and the statistics are summed in vertex order
+    afterwards. myWorldToVoxel is not reentrant, use its affine matrix.
+  */
+  cacheWorldToVoxelMatrix(mri, w2v);
+  csfgm = (double *)calloc(2*nvertices, sizeof(double));
+  if (!csfgm)
   {
-    v = &mris->vertices[k] ;
-    vsphere = &mrisphere->vertices[k];
+    Error("\nMRISComputeLocalValues: could not allocate vertex values\n");
+  }
+  ref=0;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (k=0; k<nvertices; k++)
+  {
+    ROMP_PFLB_begin
+    VERTEX *v = &mris->vertices[k] ;
+    float dist, distance = 0;
+    double gm_val,csf_val,val,x,y,z, xw, yw, zw;
+    double xw1,yw1,zw1,xw2,yw2,zw2,nx, ny, nz, mag, max_mag ;
+    double csf,gm;
+    int ninside,noutside;
+
     v->marked=0 ;
 
     /*determine the normal direction in Voxel coordinates*/
     x = v->x ;
     y = v->y ;
     z = v->z ;
-    myWorldToVoxel(mri, x, y, z, &xw, &yw, &zw) ;
+    cachedWorldToVoxel(w2v, x, y, z, &xw, &yw, &zw) ;
     x = v->x + v->nx ;
     y = v->y + v->ny ;
     z = v->z + v->nz ;
-    myWorldToVoxel(mri, x, y, z, &xw1, &yw1, &zw1) ;
+    cachedWorldToVoxel(w2v, x, y, z, &xw1, &yw1, &zw1) ;
     nx = xw1 - xw ;
     ny = yw1 - yw ;
     nz = zw1 - zw ;
@@ -8938,19 +9048,19 @@ void MRISComputeLocalValues(MRI_variables *MRI_var)
       x = v->x + v->nx*dist ;
       y = v->y + v->ny*dist ;
       z = v->z + v->nz*dist ;
-      myWorldToVoxel(mri, x, y, z, &xw, &yw, &zw) ;
+      cachedWorldToVoxel(w2v, x, y, z, &xw, &yw, &zw) ;
       MRIsampleVolume(mri, xw, yw, zw, &val) ;
       /*value at next location: potential gm intensity*/
       x = v->x + v->nx*(dist-1) ;
       y = v->y + v->ny*(dist-1) ;
       z = v->z + v->nz*(dist-1) ;
-      myWorldToVoxel(mri, x, y, z, &xw1, &yw1, &zw1) ;
+      cachedWorldToVoxel(w2v, x, y, z, &xw1, &yw1, &zw1) ;
       MRIsampleVolume(mri, xw1, yw1, zw1, &gm_val) ;
       /*value at previous location: potential csf value*/
       x = v->x + v->nx*(dist+1) ;
       y = v->y + v->ny*(dist+1) ;
       z = v->z + v->nz*(dist+1) ;
-      myWorldToVoxel(mri, x, y, z, &xw2, &yw2, &zw2) ;
+      cachedWorldToVoxel(w2v, x, y, z, &xw2, &yw2, &zw2) ;
       MRIsampleVolume(mri, xw2, yw2, zw2, &csf_val) ;
 
       if (csf_val< val &&
@@ -8980,18 +9090,33 @@ void MRISComputeLocalValues(MRI_variables *MRI_var)
       v->val = csf ;
       v->val2=gm;
       v->mean = distance ;
-      mean_csf += csf ;
+      csfgm[2*k] = csf ;
+      csfgm[2*k+1] = gm ;
+    }
+    else
+    {
+      v->val = 0.0f ;
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  for (k=0; k<nvertices; k++)
+  {
+    if (mris->vertices[k].marked)
+    {
+      mean_csf += csfgm[2*k] ;
       total_vertices++ ;
-      mean_gray += gm;
-      var_csf+=SQR(csf);
-      var_gray+=SQR(gm);
+      mean_gray += csfgm[2*k+1];
+      var_csf+=SQR(csfgm[2*k]);
+      var_gray+=SQR(csfgm[2*k+1]);
     }
     else
     {
       nmissing++ ;
-      v->val = 0.0f ;
     }
   }
+  free(csfgm);
   mean_gray /= (float)total_vertices ;
   mean_csf /= (float)total_vertices ;
   var_csf=var_csf/(float)total_vertices-mean_csf*mean_csf;
@@ -10628,7 +10753,7 @@ void calcForce1(double &fST, double &fSN, double &fN,
   for (h=-noutside; h<0; h++) // up to 15 voxels inside
   {
     // look at outside side voxels (h < 0) of the current position
-    myWorldToVoxel(mri_var->mri_src,(x-nx*h),
+    cachedWorldToVoxel(mri_var->src_w2v,(x-nx*h),
                    (y-ny*h),(z-nz*h),&tx,&ty,&tz);
     kt=(int)(tz+0.5);
     jt=(int)(ty+0.5);
@@ -10649,7 +10774,7 @@ void calcForce1(double &fST, double &fSN, double &fN,
   for (h=1; h<ninside; h++) // 10 voxels outside
   {
     // look at inside voxes (h > 0) of the current position
-    myWorldToVoxel(mri_var->mri_src,
+    cachedWorldToVoxel(mri_var->src_w2v,
                    (x-nx*h),(y-ny*h),(z-nz*h),&tx,&ty,&tz);
     kt=(int)(tz+0.5);
     jt=(int)(ty+0.5);
@@ -10722,7 +10847,7 @@ void calcForce2(double &force0, double &force1, double &force,
     for (a=-1; a<2; a++)
       for (b=-1; b<2; b++)
       {
-        myWorldToVoxel(MRI_var->mri_orig,(x-nx*h+n1[0]*a+n2[0]*b),
+        cachedWorldToVoxel(MRI_var->orig_w2v,(x-nx*h+n1[0]*a+n2[0]*b),
                        (y-ny*h+n1[1]*a+n2[1]*b),
                        (z-nz*h+n1[2]*a+n2[2]*b),&tx,&ty,&tz);
         kt=(int)(tz+0.5);
@@ -10881,9 +11006,6 @@ void FitShape(MRI_variables *MRI_var,  STRIP_PARMS *parms,
                MRI_variables *mri_var,  STRIP_PARMS *parms, int kv)
              )
 {
-  float x,y,z,sx,sy,sz,sd,sxn,syn,szn,sxt,syt,szt,nc;
-  double fN,fST,fSN;
-  float d,dx,dy,dz,nx,ny,nz;
   VERTEX *v;
   int iter,k,m,n;
 
@@ -10901,13 +11023,17 @@ void FitShape(MRI_variables *MRI_var,  STRIP_PARMS *parms,
   char fname[500];
 #endif
 
-  double lm,d10m[3],d10,f1m,f2m,dm,dbuff;
+  double lm,d10,f1m,f2m,dm;
   float ***dist;
+  // per-vertex terms of lm, f1m, f2m, dm and d10
+  std::vector<float> vsd, vd;
+  std::vector<double> vfSN, vfN, vd10;
   float cout,cout_prec,coutbuff,varbuff,mean_sd[10],mean_dist[10];
 
 
   mris=MRI_var->mris;
   MRIScomputeNormals(mris);
+  cacheWorldToVoxel(MRI_var);
 
   //////////////////////////////////////////////////////////////
   // initialize vars
@@ -10929,6 +11055,12 @@ void FitShape(MRI_variables *MRI_var,  STRIP_PARMS *parms,
         dist[k][m][n]=0;
       }
 
+  vsd.resize(mris->nvertices);
+  vd.resize(mris->nvertices);
+  vfSN.resize(mris->nvertices);
+  vfN.resize(mris->nvertices);
+  vd10.resize(mris->nvertices);
+
   for (n=0; n<10; n++)
   {
     mean_sd[n]=0;
@@ -10936,7 +11068,6 @@ void FitShape(MRI_variables *MRI_var,  STRIP_PARMS *parms,
   }
 
   niter =int_smooth;
-  fN = 0.0f ;
 
   cout_prec = 0;
 
@@ -10967,8 +11098,23 @@ void FitShape(MRI_variables *MRI_var,  STRIP_PARMS *parms,
     MRISwrite(mris,fname);
 #endif
 
+    // Each vertex only reads the positions saved in t(x,y,z) above and
+    // writes its own position, so the vertices are updated in parallel.
+    // The per-vertex terms are summed afterwards in vertex order so the
+    // result does not depend on the number of threads.
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
     for (k=0; k<mris->nvertices; k++)
     {
+      ROMP_PFLB_begin
+      float x,y,z,sx,sy,sz,sd,sxn,syn,szn,sxt,syt,szt,nc;
+      float d,dx,dy,dz,nx,ny,nz;
+      double fN,fST,fSN,d10m[3],dbuff;
+      VERTEX *v;
+      int m,n;
+
       v = &mris->vertices[k];
       // vertex position
       x = v->tx;
@@ -10999,7 +11145,7 @@ void FitShape(MRI_variables *MRI_var,  STRIP_PARMS *parms,
       sd = sd/n;
 
       // cache
-      lm+=sd;
+      vsd[k]=sd;
 
       // inner product of S and N
       nc = sx*nx+sy*ny+sz*nz;
@@ -11021,8 +11167,8 @@ void FitShape(MRI_variables *MRI_var,  STRIP_PARMS *parms,
       // force calculation
       calcForce(fST,fSN,fN, x,y,z, sx,sy,sz,sd, nx,ny,nz, MRI_var, parms, k);
 
-      f1m+=fSN;
-      f2m+=fN;
+      vfSN[k]=fSN;
+      vfN[k]=fN;
 
       ///////////////////////////////////////////////////////////////
       // keep tangential vector smaller < 1.0
@@ -11064,7 +11210,7 @@ void FitShape(MRI_variables *MRI_var,  STRIP_PARMS *parms,
       // calculate the size of the movement
       d=sqrt(dx*dx+dy*dy+dz*dz);
 
-      dm+=d;
+      vd[k]=d;
 
       /////////////////////////////////////////////
       dist[k][iter%4][0]=x;
@@ -11087,13 +11233,24 @@ void FitShape(MRI_variables *MRI_var,  STRIP_PARMS *parms,
           SQR(dist[k][n][1]-d10m[1])+
           SQR(dist[k][n][2]-d10m[2]);
 
-      d10+=dbuff/4;
+      vd10[k]=dbuff/4;
 
       ////////////////////////////////////////////////////////////
       // now move vertex by (dx, dy, dz)
       v->x += dx;
       v->y += dy;
       v->z += dz;
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
+
+    for (k=0; k<mris->nvertices; k++)
+    {
+      lm+=vsd[k];
+      f1m+=vfSN[k];
+      f2m+=vfN[k];
+      dm+=vd[k];
+      d10+=vd10[k];
     }
 
     lm /=mris->nvertices;
@@ -80,6 +80,7 @@ static char *sulc_name = "sulc" ;
 static char subjects_dir[STRLEN] ;
 extern char *gcsa_write_fname ;
 extern int gcsa_write_iterations ;
+extern int gcsa_colored_gibbs ;
 
 static int novar = 0 ;
 static int refine = 0;
@@ -480,6 +481,11 @@ get_option(int argc, char *argv[])
     nargs = 1 ;
     fprintf(stderr, "using neighborhood size=%d\n", nbrs) ;
   }
+  else if (!stricmp(option, "colored_gibbs"))
+  {
+    gcsa_colored_gibbs = 1 ;
+    printf("relabeling with a deterministic, parallel colored Gibbs schedule\n") ;
+  }
   else if (!stricmp(option, "seed"))
   {
     setRandomSeed(atol(argv[2])) ;
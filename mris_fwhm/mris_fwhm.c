@@ -501,6 +501,7 @@ static int parse_commandline(int argc, char **argv) {
     else if (!strcasecmp(option, "--sqr")) DoSqr = 1;
     else if (!strcasecmp(option, "--fast")) setenv("USE_FAST_SURF_SMOOTHER","1",1);
     else if (!strcasecmp(option, "--no-fast")) setenv("USE_FAST_SURF_SMOOTHER","0",1);
+    else if (!strcasecmp(option, "--cheb")) setenv("USE_FAST_SURF_SMOOTHER","2",1);
     else if (!strcasecmp(option, "--smooth-only") || !strcasecmp(option, "--so")) {
       DoDetrend = 0;
       SmoothOnly = 1;
@@ -721,6 +722,7 @@ static void print_usage(void) {
   printf("   \n");
   printf("   --fwhm fwhm : apply before measuring\n");
   printf("   --niters-only <niters> : only report on niters for fwhm\n");
+  printf("   --cheb : smooth with the truncated Chebyshev expansion (fewer passes at large fwhm)\n");
   printf("   --o output\n");
   printf("\n");
   printf("   --sd SUBJECTS_DIR \n");
@@ -834,6 +834,11 @@ get_option(int argc, char *argv[])
     fprintf(stderr, "disabling initial rigid alignment...\n") ;
     parms.flags |= IP_NO_RIGID_ALIGN ;
   }
+  else if (!stricmp(option, "rot_fft"))
+  {
+    fprintf(stderr, "ranking initial rigid alignment candidates with FFTs...\n") ;
+    parms.flags |= IP_RIGID_ALIGN_FFT ;
+  }
   else if (!stricmp(option, "inflated"))
   {
     fprintf(stderr, "using inflated surface for initial alignment\n") ;
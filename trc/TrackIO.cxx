@@ -58,6 +58,8 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "TrackIO.h"
+#include <sys/mman.h>
+#include <unistd.h>
 
 ///// CTrackIO reference //////////////////
 const char* error_message[] = 
@@ -114,6 +116,29 @@ CTrackReader::CTrackReader()
 {
 	m_bByteSwap = false;
 	m_bAllowOldFormat = true;
+	m_bOldFormat = false;
+	m_nSize = 0;
+	m_pMappedData = NULL;
+	m_bIndexed = false;
+}
+
+bool CTrackReader::Close()
+{
+	UnmapFile();
+	m_nTrackOffsets.clear();
+	m_nTrackPoints.clear();
+	m_bIndexed = false;
+
+	return CTrackIO::Close();
+}
+
+void CTrackReader::UnmapFile()
+{
+	if (m_pMappedData)
+	{
+		munmap(m_pMappedData, m_nSize);
+		m_pMappedData = NULL;
+	}
 }
 
 
@@ -303,48 +328,45 @@ bool CTrackReader::GetNextTrackData(int nCount, float* pt_data, float* scalars,
 	if (m_header.n_scalars == 0 && m_header.n_properties == 0)
 		return GetNextRawData(nCount, pt_data);
 
-	// read point and scalar data
-	for (int i = 0; i < nCount; i++)
-	{
-		if (fread(pt_data+i*3, sizeof(float)*3, 1, m_pFile) != 1)
-		{
-			m_nErrorCode = TE_CAN_NOT_READ;
-			break;
-		}
-		if (m_header.n_scalars && scalars)
-		{
-			if (fread(scalars+i*m_header.n_scalars, sizeof(float)*m_header.n_scalars, 1, m_pFile) != 1)
-			{
-				m_nErrorCode = TE_CAN_NOT_READ;
-				break;
-			}
-		}
-		else
-		{
-			fseek(m_pFile, sizeof(float)*m_header.n_scalars, SEEK_CUR);
-		}
-	}
-	if (!m_nErrorCode && m_bByteSwap)
-	{
-		SWAP_FLOAT(pt_data, nCount*3);
-		if (scalars)
-			SWAP_FLOAT(scalars, nCount*m_header.n_scalars);
-	}
-	
-	// read property data
-	if (m_header.n_properties && properties && 
-		fread(properties, sizeof(float)*m_header.n_properties, 1, m_pFile) != 1)
+	// read point, scalar and (if requested) property data in one go, 
+	// then split them into the given buffers
+	long nSize = (3+m_header.n_scalars)*(long)nCount;
+	if (properties)
+		nSize += m_header.n_properties;
+	if (nSize == 0)
+		return true;
+
+	std::vector<float> data(nSize);
+	if (fread(&data[0], sizeof(float)*nSize, 1, m_pFile) != 1)
 	{
 		m_nErrorCode = TE_CAN_NOT_READ;
+		return false;
 	}
-	
-	if (!m_nErrorCode && m_bByteSwap)
+
+	if (m_bByteSwap)
+		SWAP_FLOAT(&data[0], nSize);
+
+	SplitTrackData(nCount, &data[0], pt_data, scalars, properties);
+
+	return true;
+}
+
+// Split a block of interleaved point coords and scalars, followed by 
+// track properties, into seperated buffers
+void CTrackReader::SplitTrackData(int nCount, float* data, float* pt_data, float* scalars, float* properties)
+{
+	const int ns = m_header.n_scalars;
+	const float* src = data;
+	for (int i = 0; i < nCount; i++)
 	{
-		if (properties)
-			SWAP_FLOAT(properties, m_header.n_properties);
+		memcpy(pt_data+i*3, src, sizeof(float)*3);
+		if (ns && scalars)
+			memcpy(scalars+i*ns, src+3, sizeof(float)*ns);
+		src += 3+ns;
 	}
 
-	return m_nErrorCode == TE_NO_ERROR;
+	if (m_header.n_properties && properties)
+		memcpy(properties, src, sizeof(float)*m_header.n_properties);
 }
 
 // Static function. Get header info from a given track file directly
@@ -398,6 +420,148 @@ int CTrackReader::GetNumberOfTracks()
 	return n;
 }
 
+// Offset of the first track in the file
+long CTrackReader::GetDataOffset()
+{
+	return m_bOldFormat ? 3*(sizeof(int)+sizeof(float)) : sizeof(TRACK_HEADER);
+}
+
+// Read a block of track data at a given file offset. Reads from the memory 
+// mapped file if there is one, otherwise uses pread(). Neither changes the 
+// current file position, so this can be called from several threads.
+bool CTrackReader::ReadTrackBlock(long nOffset, long nBytes, float* data)
+{
+	if (nOffset < 0 || nOffset + nBytes > m_nSize)
+		return false;
+
+	if (m_pMappedData)
+	{
+		memcpy(data, m_pMappedData + nOffset, nBytes);
+		return true;
+	}
+
+	char* buf = (char*)data;
+	int fd = fileno(m_pFile);
+	while (nBytes > 0)
+	{
+		ssize_t n = pread(fd, buf, nBytes, nOffset);
+		if (n <= 0)
+			return false;
+		buf += n;
+		nOffset += n;
+		nBytes -= n;
+	}
+
+	return true;
+}
+
+// Scan through the file once and record where each track starts, so that 
+// tracks can then be read at random with GetTrackData(). Only the point 
+// counts are read during the scan. The file is memory mapped if possible.
+// Returns false if the file ends in the middle of a track; the tracks 
+// before it are still indexed.
+bool CTrackReader::BuildTrackIndex()
+{
+	if (!m_pFile)
+	{
+		m_nErrorCode = TE_NOT_INITIALIZED;
+		return false;
+	}
+	if (m_bIndexed)
+		return true;
+
+	if (!m_pMappedData && m_nSize > 0)
+	{
+		void* p = mmap(NULL, m_nSize, PROT_READ, MAP_SHARED, fileno(m_pFile), 0);
+		if (p != MAP_FAILED)
+			m_pMappedData = (char*)p;
+	}
+
+	m_nTrackOffsets.clear();
+	m_nTrackPoints.clear();
+	if (m_header.n_count > 0)
+	{
+		m_nTrackOffsets.reserve(m_header.n_count);
+		m_nTrackPoints.reserve(m_header.n_count);
+	}
+
+	m_nErrorCode = TE_NO_ERROR;
+	long nPos = GetDataOffset();
+	while (nPos + (long)sizeof(int) <= m_nSize)
+	{
+		int n;
+		if (!ReadTrackBlock(nPos, sizeof(int), (float*)&n))
+		{
+			m_nErrorCode = TE_CAN_NOT_READ;
+			break;
+		}
+		if (m_bByteSwap)
+			SWAP_INT(n);
+		nPos += sizeof(int);
+
+		long nBytes = sizeof(float)*((long)n*(3+m_header.n_scalars)+m_header.n_properties);
+		if (n < 0 || nPos + nBytes > m_nSize)
+		{
+			m_nErrorCode = TE_CAN_NOT_READ;
+			break;
+		}
+		m_nTrackOffsets.push_back(nPos);
+		m_nTrackPoints.push_back(n);
+		nPos += nBytes;
+	}
+
+	m_bIndexed = true;
+	if (m_header.n_count == 0)
+		m_header.n_count = (int)m_nTrackPoints.size();
+
+	return m_nErrorCode == TE_NO_ERROR;
+}
+
+int CTrackReader::GetTrackPointCount(int nTrack)
+{
+	if (nTrack < 0 || nTrack >= (int)m_nTrackPoints.size())
+		return 0;
+	return m_nTrackPoints[nTrack];
+}
+
+// Read track data by index. BuildTrackIndex() must be called first. 
+// Buffers have to be pre-allocated as for GetNextTrackData(). This does not 
+// move the file position used by GetNextPointCount()/GetNextTrackData() and 
+// is safe to call concurrently. Failure is reported through the return
+// value only; the error code is left untouched.
+bool CTrackReader::GetTrackData(int nTrack, float* pt_data, float* scalars, float* properties)
+{
+	if (!m_bIndexed)
+		return false;
+	if (nTrack < 0 || nTrack >= (int)m_nTrackPoints.size())
+		return false;
+
+	const int nCount = m_nTrackPoints[nTrack];
+	const long nSize = (3+m_header.n_scalars)*(long)nCount + m_header.n_properties;
+	if (nSize == 0)
+		return true;
+
+	if (m_header.n_scalars == 0 && m_header.n_properties == 0)
+	{
+		if (!ReadTrackBlock(m_nTrackOffsets[nTrack], sizeof(float)*nSize, pt_data))
+			return false;
+		if (m_bByteSwap)
+			SWAP_FLOAT(pt_data, nSize);
+		return true;
+	}
+
+	std::vector<float> data(nSize);
+	if (!ReadTrackBlock(m_nTrackOffsets[nTrack], sizeof(float)*nSize, &data[0]))
+		return false;
+
+	if (m_bByteSwap)
+		SWAP_FLOAT(&data[0], nSize);
+
+	SplitTrackData(nCount, &data[0], pt_data, scalars, properties);
+
+	return true;
+}
+
 ///////////////////////////////////////////////
 
 ///// CTrackReader reference //////////////////
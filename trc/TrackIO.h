@@ -55,6 +55,19 @@
 //
 //			reader.Close();
 //
+//			Tracks can also be accessed at random by index, once the
+//			track offset index has been built -
+//
+//			if (reader.BuildTrackIndex())
+//			{
+//				for (int i = 0; i < reader.GetNumberOfIndexedTracks(); i++)
+//				{
+//					float* pts = new float[reader.GetTrackPointCount(i)*3];
+//					reader.GetTrackData(i, pts);
+//					...
+//				}
+//			}
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifndef _TrackIO_H_
@@ -198,6 +211,7 @@ class CTrackReader : public CTrackIO
 {
 public:
 	CTrackReader();
+	virtual ~CTrackReader() { Close(); }
 
 	bool Open(const char* filename, TRACK_HEADER* header = NULL);
 	bool Open(const char* filename, int* dim, float* voxel_size);
@@ -213,11 +227,30 @@ public:
 
 	static bool GetHeader(const char* filename, TRACK_HEADER* header);
 
+	// random access by track index
+	bool BuildTrackIndex();
+	bool IsIndexed() { return m_bIndexed; }
+	int  GetNumberOfIndexedTracks() { return (int)m_nTrackPoints.size(); }
+	int  GetTrackPointCount(int nTrack);
+	bool GetTrackData(int nTrack, float* pt_data, float* scalars = NULL, float* properties = NULL);
+
+	virtual bool Close();
+
 protected:
+	void	UnmapFile();
+	long	GetDataOffset();
+	bool	ReadTrackBlock(long nOffset, long nBytes, float* data);
+	void	SplitTrackData(int nCount, float* data, float* pt_data, float* scalars, float* properties);
+
 	bool			m_bByteSwap;
 	bool			m_bOldFormat;
 	long			m_nSize;
 	bool			m_bAllowOldFormat;
+
+	char*			m_pMappedData;		// whole file mapped read-only, NULL if not mapped
+	bool			m_bIndexed;
+	std::vector<long>	m_nTrackOffsets;	// file offset of the first point of each track
+	std::vector<int>	m_nTrackPoints;		// number of points of each track
 };
 
 class CTrackWriter : public CTrackIO
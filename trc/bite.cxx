@@ -26,8 +26,9 @@ using namespace std;
 
 int Bite::mNumDir, Bite::mNumB0, Bite::mNumTract, Bite::mNumBedpost;
 float Bite::mFminPath;
-vector<unsigned int> Bite::mBaselineImages;
-vector<float> Bite::mGradients, Bite::mBvalues;
+vector<unsigned int> Bite::mBaselineImages, Bite::mShellIndices;
+vector<float> Bite::mGradients, Bite::mBvalues, Bite::mShellBvalues;
+vector<double> Bite::mIsoDecay, Bite::mSignal;
 
 Bite::Bite(MRI *Dwi, MRI **Phi, MRI **Theta, MRI **F,
            MRI **V0, MRI **F0, MRI *D0,
@@ -123,6 +124,21 @@ void Bite::SetStatic(const char *GradientFile, const char *BvalueFile,
 
   mNumB0 = mBaselineImages.size();
 
+  // Find unique b-values, so that the isotropic compartment can be computed
+  // once per shell rather than once per gradient direction
+  mShellBvalues.clear();
+  mShellIndices.clear();
+  for (vector<float>::const_iterator ival = mBvalues.begin();
+                                     ival < mBvalues.end(); ival++) {
+    vector<float>::const_iterator ishell = find(mShellBvalues.begin(),
+                                                mShellBvalues.end(), *ival);
+
+    mShellIndices.push_back(ishell - mShellBvalues.begin());
+
+    if (ishell == mShellBvalues.end())
+      mShellBvalues.push_back(*ival);
+  }
+
   cout << "Loading gradients from " << GradientFile << endl;
   mGradients.clear();
   mGradients.resize(3*mNumDir);
@@ -145,6 +161,11 @@ void Bite::SetStatic(const char *GradientFile, const char *BvalueFile,
   mNumTract = NumTract;
   mNumBedpost = NumBedpost;
   mFminPath = FminPath;
+
+  // Scratch space for ComputeSquaredError(), so that nothing is allocated
+  // in the MCMC loop (each pathway runs in its own process, not a thread)
+  mIsoDecay.resize(mShellBvalues.size());
+  mSignal.resize(mNumDir);
 }
 
 int Bite::GetNumTract() { return mNumTract; }
@@ -179,39 +200,7 @@ void Bite::SampleParameters() {
 // Compute likelihood given that voxel is off path
 //
 void Bite::ComputeLikelihoodOffPath() {
-  double like = 0;
-  vector<float>::const_iterator ri = mGradients.begin();
-  vector<float>::const_iterator bi = mBvalues.begin();
-  vector<float>::const_iterator sij = mDwi.begin();
-
-  for (int idir = mNumDir; idir > 0; idir--) {
-    double sbar = 0, fsum = 0;
-    const double bidj = (*bi) * mD;
-    vector<float>::const_iterator fjl = mF.begin();
-    vector<float>::const_iterator phijl = mPhi.begin();
-    vector<float>::const_iterator thetajl = mTheta.begin();
-
-    for (int itract = mNumTract; itract > 0; itract--) {
-      const double iprod =
-        (ri[0] * cos(*phijl) + ri[1] * sin(*phijl)) * sin(*thetajl)
-        + ri[2] * cos(*thetajl);
-
-      sbar += *fjl * exp(-bidj * iprod * iprod);
-      fsum += *fjl;
-
-      fjl++;
-      phijl++;
-      thetajl++;
-    }
-
-    sbar += (1-fsum) * exp(-bidj);
-    sbar *= mS0;
-    like += pow(*sij - sbar, 2);
-
-    ri+=3;
-    bi++;
-    sij++;
-  }
+  const double like = ComputeSquaredError(-1, 0, 0);
 
   mLikelihood0 = (float) log(like/2) * mNumDir/2;
 }
@@ -220,49 +209,66 @@ void Bite::ComputeLikelihoodOffPath() {
 // Compute likelihood given that voxel is on path
 //
 void Bite::ComputeLikelihoodOnPath(float PathPhi, float PathTheta) {
-  double like = 0;
-  vector<float>::const_iterator ri = mGradients.begin();
-  vector<float>::const_iterator bi = mBvalues.begin();
-  vector<float>::const_iterator sij = mDwi.begin();
+  double like;
 
   // Choose which anisotropic compartment in voxel corresponds to path
   ChoosePathTractAngle(PathPhi, PathTheta);
 
   // Calculate likelihood by replacing the chosen tract orientation from path
-  for (int idir = mNumDir; idir > 0; idir--) {
-    double sbar = 0, fsum = 0;
-    const double bidj = (*bi) * mD;
-    vector<float>::const_iterator fjl = mF.begin();
-    vector<float>::const_iterator phijl = mPhi.begin();
-    vector<float>::const_iterator thetajl = mTheta.begin();
+  like = ComputeSquaredError(mPathTract, PathPhi, PathTheta);
 
-    for (int itract = 0; itract < mNumTract; itract++) {
-      double iprod;
-      if (itract == mPathTract)
-        iprod = (ri[0] * cos(PathPhi) + ri[1] * sin(PathPhi)) * sin(PathTheta)
-              + ri[2] * cos(PathTheta);
-      else
-        iprod = (ri[0] * cos(*phijl) + ri[1] * sin(*phijl)) * sin(*thetajl)
-              + ri[2] * cos(*thetajl);
-
-      sbar += *fjl * exp(-bidj * iprod * iprod);
-      fsum += *fjl;
-
-      fjl++;
-      phijl++;
-      thetajl++;
+  mLikelihood1 = (float) log(like/2) * mNumDir/2;
+}
+
+//
+// Compute sum of squared differences between the measured DWI intensities
+// and those predicted by the ball-and-stick model
+// If PathTract is a valid tract index, the orientation of that tract is
+// replaced by the path orientation
+//
+double Bite::ComputeSquaredError(int PathTract, float PathPhi, float PathTheta) {
+  double like = 0, fsum = 0;
+  const float *ri = &mGradients[0];
+  const float *bi = &mBvalues[0];
+  double *sbar = &mSignal[0];
+
+  for (int idir = 0; idir < mNumDir; idir++)
+    sbar[idir] = 0;
+
+  // Anisotropic compartments, one tract at a time over all directions, so
+  // that trigonometric functions are evaluated once per tract and the inner
+  // loop runs over contiguous arrays
+  for (int itract = 0; itract < mNumTract; itract++) {
+    const double phi   = (itract == PathTract) ? PathPhi : mPhi[itract],
+                 theta = (itract == PathTract) ? PathTheta : mTheta[itract],
+                 sintheta = sin(theta),
+                 vx = cos(phi) * sintheta,
+                 vy = sin(phi) * sintheta,
+                 vz = cos(theta),
+                 fjl = mF[itract];
+
+    for (int idir = 0; idir < mNumDir; idir++) {
+      const double iprod = ri[3*idir]   * vx + ri[3*idir+1] * vy
+                                             + ri[3*idir+2] * vz;
+
+      sbar[idir] += fjl * exp(-bi[idir] * mD * iprod * iprod);
     }
 
-    sbar += (1-fsum) * exp(-bidj);
-    sbar *= mS0;
-    like += pow(*sij - sbar, 2);
+    fsum += mF[itract];
+  }
+
+  // Isotropic compartment, which only depends on the b-value
+  for (unsigned int k = 0; k < mShellBvalues.size(); k++)
+    mIsoDecay[k] = (1-fsum) * exp(-mShellBvalues[k] * mD);
 
-    ri+=3;
-    bi++;
-    sij++;
+  for (int idir = 0; idir < mNumDir; idir++) {
+    const double err = mDwi[idir]
+                     - (sbar[idir] + mIsoDecay[mShellIndices[idir]]) * mS0;
+
+    like += err * err;
   }
 
-  mLikelihood1 = (float) log(like/2) * mNumDir/2;
+  return like;
 }
 
 //
@@ -303,44 +309,10 @@ void Bite::ChoosePathTractLike(float PathPhi, float PathTheta) {
 
   for (int jtract = 0; jtract < mNumTract; jtract++)
     if (mF[jtract] > mFminPath) {
-      double dlike, like = 0;
-      vector<float>::const_iterator ri = mGradients.begin();
-      vector<float>::const_iterator bi = mBvalues.begin();
-      vector<float>::const_iterator sij = mDwi.begin();
+      double dlike, like;
 
       // Calculate likelihood by replacing the chosen tract orientation from path
-      for (int idir = mNumDir; idir > 0; idir--) {
-        double sbar = 0, fsum = 0;
-        const double bidj = (*bi) * mD;
-        vector<float>::const_iterator fjl = mF.begin();
-        vector<float>::const_iterator phijl = mPhi.begin();
-        vector<float>::const_iterator thetajl = mTheta.begin();
-
-        for (int itract = 0; itract < mNumTract; itract++) {
-          double iprod;
-          if (itract == jtract)
-            iprod = (ri[0] * cos(PathPhi) + ri[1] * sin(PathPhi)) * sin(PathTheta)
-                  + ri[2] * cos(PathTheta);
-          else
-            iprod = (ri[0] * cos(*phijl) + ri[1] * sin(*phijl)) * sin(*thetajl)
-                  + ri[2] * cos(*thetajl);
-
-          sbar += *fjl * exp(-bidj * iprod * iprod);
-          fsum += *fjl;
-
-          fjl++;
-          phijl++;
-          thetajl++;
-        }
-
-        sbar += (1-fsum) * exp(-bidj);
-        sbar *= mS0;
-        like += pow(*sij - sbar, 2);
-
-        ri+=3;
-        bi++;
-        sij++;
-      }
+      like = ComputeSquaredError(jtract, PathPhi, PathTheta);
 
       like = log(like/2) * mNumDir/2;
       dlike = fabs(like - (double) mLikelihood0);
@@ -42,9 +42,13 @@ class Bite {
   private:
     static int mNumDir, mNumB0, mNumTract, mNumBedpost;
     static float mFminPath;
-    static std::vector<unsigned int> mBaselineImages;
+    static std::vector<unsigned int> mBaselineImages,
+                                     mShellIndices;	// [mNumDir]
     static std::vector<float> mGradients,	// [3 x mNumDir]
-                              mBvalues;		// [mNumDir]
+                              mBvalues,		// [mNumDir]
+                              mShellBvalues;	// [number of unique b-values]
+    static std::vector<double> mIsoDecay,	// [number of unique b-values]
+                               mSignal;		// [mNumDir]
 
     int mCoordX, mCoordY, mCoordZ, mPathTract;
     float mS0, mD, mLikelihood0, mLikelihood1, mPrior0, mPrior1;
@@ -56,6 +60,8 @@ class Bite {
     std::vector<float> mTheta;			// [mNumTract]
     std::vector<float> mF;			// [mNumTract]
 
+    double ComputeSquaredError(int PathTract, float PathPhi, float PathTheta);
+
   public:
     static void SetStatic(const char *GradientFile, const char *BvalueFile,
                           int NumTract, int NumBedpost, float FminPath);
@@ -44,6 +44,7 @@ Aeon::Aeon() {
   mNx = mNy = mNz = mNxy = mNumVox = 0;
   mMask = 0;
   ClearPath();
+  ClearSamples();
 }
 
 Aeon::~Aeon() {
@@ -277,26 +278,16 @@ void Aeon::SetOutputDir(const char *OutDir) {
 const string &Aeon::GetOutputDir() const { return mOutDir; }
 
 //
-// Clear all path-related variables
+// Clear current and proposed path
 //
 void Aeon::ClearPath() {
-  // Path-related variables that are common among all time points
-  mMaxAPosterioriPath = -1;
-  mMaxAPosterioriPath0 = 0;
-  mPriorSamples.clear();
-  mBasePathPointSamples.clear();
-
-  // Path-related variables that are specific to this time point
   mPathPoints.clear();
   mPathPointsNew.clear();
-  mPathPointSamples.clear();
   mPathPhi.clear();
   mPathPhiNew.clear();
   mPathTheta.clear();
   mPathThetaNew.clear();
 
-  mDataFitSamples.clear();
-
   mRejectF = false;
   mAcceptF = false;
   mRejectTheta = false;
@@ -320,6 +311,23 @@ void Aeon::ClearPath() {
   mPosteriorOffPathNew = 0;
 }
 
+//
+// Clear saved path samples
+// Kept separate from ClearPath(), so that samples from multiple MCMC chains
+// can be pooled
+//
+void Aeon::ClearSamples() {
+  // Path samples that are common among all time points
+  mMaxAPosterioriPath = -1;
+  mMaxAPosterioriPath0 = 0;
+  mPriorSamples.clear();
+  mBasePathPointSamples.clear();
+
+  // Path samples that are specific to this time point
+  mPathPointSamples.clear();
+  mDataFitSamples.clear();
+}
+
 //
 // Map proposed path from the base space to this time point's native space
 // and calculate orientation angles along the path in the native space
@@ -1081,6 +1089,7 @@ Coffin::Coffin(const char *OutDir, vector<char *> InDirList,
                const bool Debug) :
                mDebug(Debug),
                mPriorSetLocal(LocalPriorSet), mPriorSetNear(NeighPriorSet),
+               mNumChain(1),
                mMask(0), mRoi1(0), mRoi2(0),
                mXyzPrior0(0), mXyzPrior1(0) {
   vector<char *>::const_iterator idir;
@@ -1419,6 +1428,10 @@ void Coffin::SetPathway(const char *InitFile,
 
   mNumArc = 0;
 
+  // Clear saved anatomical prior values, computed for the previous pathway
+  mAnatomicalPriorCache.clear();
+  mAnatomicalPriorCache.resize(mNxy*mNz);
+
   // Read path tangent prior
   if (TangPriorFile) {
     const int nbin = (int) ceil(2 / mTangentBinSize),
@@ -1697,6 +1710,20 @@ void Coffin::SetMcmcParameters(const int NumBurnIn, const int NumSample,
   }
 }
 
+//
+// Set number of independent MCMC chains, whose samples will be pooled
+//
+void Coffin::SetNumChains(const int NumChain) {
+  ostringstream infostr;
+
+  mNumChain = (NumChain > 1) ? NumChain : 1;
+
+  if (mNumChain > 1) {
+    infostr << "Number of MCMC chains: " << mNumChain << endl;
+    mInfoMcmc += infostr.str();
+  }
+}
+
 //
 // Read initial control points
 //
@@ -1947,7 +1974,6 @@ void Coffin::ReadProposalStds(const char *PropStdFile) {
 // Run MCMC (full spline updates)
 //
 bool Coffin::RunMcmcFull() {
-  int iprop, ikeep;
   char fname[PATH_MAX];
   string cmdline;
 
@@ -1962,13 +1988,66 @@ bool Coffin::RunMcmcFull() {
   // Write input parameters to log file
   mLog << mInfoGeneral << mInfoPathway << mInfoMcmc;
 
+  // Clear path samples from any previous pathway
+  for (vector<Aeon>::iterator idwi = mDwi.begin(); idwi < mDwi.end(); idwi++)
+    idwi->ClearSamples();
+
+  mPosteriorOnPathMap = numeric_limits<double>::max();
+
+  // Run independent chains from the same initial control points and pool
+  // their samples, splitting the post-burn-in samples among chains
+  mControlPointsInit.resize(mControlPoints.size());
+  copy(mControlPoints.begin(), mControlPoints.end(), mControlPointsInit.begin());
+
+  for (int ichain = 0; ichain < mNumChain; ichain++) {
+    const int nsample = mNumSample / mNumChain
+                      + ((ichain < mNumSample % mNumChain) ? 1 : 0);
+
+    if (mNumChain > 1) {
+      cout << "Running MCMC chain " << ichain+1 << " of " << mNumChain << endl;
+      mLog << "Running MCMC chain " << ichain+1 << " of " << mNumChain << endl;
+    }
+
+    copy(mControlPointsInit.begin(), mControlPointsInit.end(),
+         mControlPoints.begin());
+
+    if (!RunChainFull(nsample)) {
+      mLog.flush();
+      mLog.close();
+      return false;
+    }
+  }
+
+  // Close log file and copy it to other time points's output directories
+  mLog.flush();
+  mLog.close();
+
+  for (vector<Aeon>::const_iterator idwi = mDwi.begin() + 1; idwi < mDwi.end();
+                                                             idwi++) {
+    cmdline = "cp -f " + mDwi[0].GetOutputDir() + "/log.txt " +
+              idwi->GetOutputDir();
+
+    if (system(cmdline.c_str()) != 0) {
+      cout << "ERROR: Could not save log file in " << idwi->GetOutputDir()
+           << endl;
+      exit(1);
+    }
+  }
+
+  return true;
+}
+
+//
+// Run a single MCMC chain (full path updates)
+//
+bool Coffin::RunChainFull(const int NumSample) {
+  int iprop, ikeep;
+  char fname[PATH_MAX];
+
   cout << "Initializing MCMC" << endl;
   mLog << "Initializing MCMC" << endl;
-  if (! InitializeMcmc()) {
-    mLog.flush();
-    mLog.close();
+  if (! InitializeMcmc())
     return false;
-  }
 
   if (mDebug) {
     sprintf(fname, "%s/Finit.nii.gz", mOutDir.c_str());
@@ -2007,13 +2086,11 @@ bool Coffin::RunMcmcFull() {
       iprop++;
   }
 
-  mPosteriorOnPathMap = numeric_limits<double>::max();
-
   cout << "Running MCMC main jumps" << endl;
   mLog << "Running MCMC main jumps" << endl;
   iprop = 1;
   ikeep = 1;
-  for (int ijump = mNumSample; ijump > 0; ijump--) {
+  for (int ijump = NumSample; ijump > 0; ijump--) {
     if (JumpMcmcFull() || mAcceptF || mAcceptTheta) {	// Accept new path
       SavePathPosterior(true);
       UpdatePath();
@@ -2021,7 +2098,7 @@ bool Coffin::RunMcmcFull() {
 
       if (mDebug) {
         sprintf(fname, "%s/Faccept_%05d.nii.gz",
-                mOutDir.c_str(), mNumSample-ijump+1);
+                mOutDir.c_str(), NumSample-ijump+1);
         mSpline.WriteVolume(fname, true);
       }
     }
@@ -2031,7 +2108,7 @@ bool Coffin::RunMcmcFull() {
 
       if (mDebug) {
         sprintf(fname, "%s/Freject_%05d.nii.gz",
-                mOutDir.c_str(), mNumSample-ijump+1);
+                mOutDir.c_str(), NumSample-ijump+1);
         mSpline.WriteVolume(fname, true);
       }
     }
@@ -2051,6 +2128,57 @@ bool Coffin::RunMcmcFull() {
       ikeep++;
   }
 
+  return true;
+}
+
+//
+// Run MCMC (single control point updates)
+//
+bool Coffin::RunMcmcSingle() {
+  char fname[PATH_MAX];
+  string cmdline;
+
+  // Open log file in first time point's output directory
+  sprintf(fname, "%s/log.txt", mOutDir.c_str());
+  mLog.open(fname, ios::out | ios::app);
+  if (!mLog) {
+    cout << "ERROR: Could not open " << fname << " for writing" << endl;
+    exit(1);
+  }
+
+  // Write input parameters to log file
+  mLog << mInfoGeneral << mInfoPathway << mInfoMcmc;
+
+  // Clear path samples from any previous pathway
+  for (vector<Aeon>::iterator idwi = mDwi.begin(); idwi < mDwi.end(); idwi++)
+    idwi->ClearSamples();
+
+  mPosteriorOnPathMap = numeric_limits<double>::max();
+
+  // Run independent chains from the same initial control points and pool
+  // their samples, splitting the post-burn-in samples among chains
+  mControlPointsInit.resize(mControlPoints.size());
+  copy(mControlPoints.begin(), mControlPoints.end(), mControlPointsInit.begin());
+
+  for (int ichain = 0; ichain < mNumChain; ichain++) {
+    const int nsample = mNumSample / mNumChain
+                      + ((ichain < mNumSample % mNumChain) ? 1 : 0);
+
+    if (mNumChain > 1) {
+      cout << "Running MCMC chain " << ichain+1 << " of " << mNumChain << endl;
+      mLog << "Running MCMC chain " << ichain+1 << " of " << mNumChain << endl;
+    }
+
+    copy(mControlPointsInit.begin(), mControlPointsInit.end(),
+         mControlPoints.begin());
+
+    if (!RunChainSingle(nsample)) {
+      mLog.flush();
+      mLog.close();
+      return false;
+    }
+  }
+
   // Close log file and copy it to other time points's output directories
   mLog.flush();
   mLog.close();
@@ -2071,33 +2199,18 @@ bool Coffin::RunMcmcFull() {
 }
 
 //
-// Run MCMC (single control point updates)
+// Run a single MCMC chain (single control point updates)
 //
-bool Coffin::RunMcmcSingle() {
+bool Coffin::RunChainSingle(const int NumSample) {
   int iprop, ikeep;
   char fname[PATH_MAX];
-  string cmdline;
   vector<int> cptorder(mNumControl);
   vector<int>::const_iterator icpt;
 
-  // Open log file in first time point's output directory
-  sprintf(fname, "%s/log.txt", mOutDir.c_str());
-  mLog.open(fname, ios::out | ios::app);
-  if (!mLog) {
-    cout << "ERROR: Could not open " << fname << " for writing" << endl;
-    exit(1);
-  }
-
-  // Write input parameters to log file
-  mLog << mInfoGeneral << mInfoPathway << mInfoMcmc;
-
   cout << "Initializing MCMC" << endl;
   mLog << "Initializing MCMC" << endl;
-  if (! InitializeMcmc()) {
-    mLog.flush();
-    mLog.close();
+  if (! InitializeMcmc())
     return false;
-  }
 
   if (mDebug) {
     sprintf(fname, "%s/Finit.nii.gz", mOutDir.c_str());
@@ -2153,13 +2266,11 @@ bool Coffin::RunMcmcSingle() {
       iprop++;
   }
 
-  mPosteriorOnPathMap = numeric_limits<double>::max();
-
   cout << "Running MCMC main jumps" << endl;
   mLog << "Running MCMC main jumps" << endl;
   iprop = 1;
   ikeep = 1;
-  for (int ijump = mNumSample; ijump > 0; ijump--) {
+  for (int ijump = NumSample; ijump > 0; ijump--) {
     // Perturb control points in random order
     for (int k = 0; k < mNumControl; k++)
       cptorder[k] = k;
@@ -2181,7 +2292,7 @@ bool Coffin::RunMcmcSingle() {
 
         if (mDebug) {
           sprintf(fname, "%s/Faccept_%05d_%d.nii.gz",
-                  mOutDir.c_str(), mNumSample-ijump+1, *icpt);
+                  mOutDir.c_str(), NumSample-ijump+1, *icpt);
           mSpline.WriteVolume(fname, true);
         }
       }
@@ -2191,7 +2302,7 @@ bool Coffin::RunMcmcSingle() {
 
         if (mDebug) {
           sprintf(fname, "%s/Freject_%05d_%d.nii.gz",
-                  mOutDir.c_str(), mNumSample-ijump+1, *icpt);
+                  mOutDir.c_str(), NumSample-ijump+1, *icpt);
           mSpline.WriteVolume(fname, true);
         }
       }
@@ -2214,22 +2325,6 @@ bool Coffin::RunMcmcSingle() {
       ikeep++;
   }
 
-  // Close log file and copy it to other time points's output directories
-  mLog.flush();
-  mLog.close();
-
-  for (vector<Aeon>::const_iterator idwi = mDwi.begin() + 1; idwi < mDwi.end();
-                                                             idwi++) {
-    cmdline = "cp -f " + mDwi[0].GetOutputDir() + "/log.txt " +
-              idwi->GetOutputDir();
-
-    if (system(cmdline.c_str()) != 0) {
-      cout << "ERROR: Could not save log file in " << idwi->GetOutputDir()
-           << endl;
-      exit(1);
-    }
-  }
-
   return true;
 }
 
@@ -2360,7 +2455,7 @@ bool Coffin::InitializeMcmc() {
     // Compute atlas-derived prior terms on initial path
     mXyzPriorOnPathNew = ComputeXyzPriorOnPath(atlaspoints);
 
-    mAnatomicalPriorNew = ComputeAnatomicalPrior(atlaspoints);
+    mAnatomicalPriorNew = ComputeAnatomicalPrior(atlaspoints, mPathPointsNew);
 
     mShapePriorNew = ComputeShapePrior(atlaspoints);
 
@@ -2938,7 +3033,7 @@ bool Coffin::AcceptPath(bool UsePriorOnly) {
   mXyzPriorOffPathNew = ComputeXyzPriorOffPath(atlaspoints);
   mXyzPriorOnPathNew  = ComputeXyzPriorOnPath(atlaspoints);
 
-  mAnatomicalPriorNew = ComputeAnatomicalPrior(atlaspoints);
+  mAnatomicalPriorNew = ComputeAnatomicalPrior(atlaspoints, mPathPointsNew);
 
   mShapePriorNew = ComputeShapePrior(atlaspoints);
 
@@ -3100,115 +3195,140 @@ double Coffin::ComputeShapePrior(vector<int> &PathAtlasPoints) {
 
 //
 // Compute prior on path given anatomical segmentation labels around path
+// The contribution of each point depends only on its position and the arc
+// segment that it falls in, so it is saved and reused in subsequent MCMC
+// jumps, as long as that point stays on the same segment of the path
 //
-double Coffin::ComputeAnatomicalPrior(vector<int> &PathAtlasPoints) {
+double Coffin::ComputeAnatomicalPrior(vector<int> &PathAtlasPoints,
+                                      vector<int> &PathPoints) {
   const double darc = mNumArc / (double) (PathAtlasPoints.size()/3);
+  unsigned int iarc = 0;
   double larc = 0, prior = 0;
-  vector<float>::iterator iseg0;
-  vector<unsigned int>::const_iterator imatch;
-  vector< vector<unsigned int> >::const_iterator iidlocal = mIdsLocal.begin(),
-                                                 iidnear  = mIdsNear.begin(),
-                                                 iid;
-  vector< vector<float> >::const_iterator iprlocal = mPriorLocal.begin(), 
-                                          iprnear  = mPriorNear.begin(),
-                                          ipr;
-  vector<float> seg0(mAseg.size());
+  vector<int>::const_iterator iptbase = PathPoints.begin();
 
   if (mPriorLocal.empty() && mPriorNear.empty())
     return 0;
 
   for (vector<int>::const_iterator ipt = PathAtlasPoints.begin();
                                    ipt < PathAtlasPoints.end(); ipt += 3) {
-    const int ix0 = ipt[0], iy0 = ipt[1], iz0 = ipt[2];
+    vector<double> &ptprior = mAnatomicalPriorCache[iptbase[0] +
+                                                    iptbase[1]*mNx +
+                                                    iptbase[2]*mNxy];
 
-    // Find prior given local neighbor labels
-    iid = iidlocal;
-    ipr = iprlocal;
+    if (ptprior.empty())
+      ptprior.resize(mNumArc, numeric_limits<double>::quiet_NaN());
 
-    for (vector<int>::const_iterator idir = mDirLocal.begin();
-                                     idir != mDirLocal.end(); idir += 3) {
-      const int ix = ix0 + idir[0],
-                iy = iy0 + idir[1],
-                iz = iz0 + idir[2];
-
-      for (vector<MRI *>::const_iterator iaseg = mAseg.begin();
-                                         iaseg < mAseg.end(); iaseg++) {
-        imatch = find(iid->begin(), iid->end(),
-                      (unsigned int) MRIgetVoxVal(*iaseg,
-                                     ((ix > -1 && ix < mNxAtlas) ? ix : ix0),
-                                     ((iy > -1 && iy < mNyAtlas) ? iy : iy0),
-                                     ((iz > -1 && iz < mNzAtlas) ? iz : iz0),
-                                     0));
-
-        if (imatch < iid->end())
-          prior += ipr->at(imatch - iid->begin());
-        else
-          prior += *(ipr->end() - 1);
-      }
+    if (ptprior[iarc] != ptprior[iarc])		// Not computed yet (NaN)
+      ptprior[iarc] = ComputeAnatomicalPriorPoint(ipt, iarc);
 
-      iid += mNumArc;
-      ipr += mNumArc;
+    prior += ptprior[iarc];
+
+    iptbase += 3;
+
+    larc += darc;
+
+    if (larc > 1)  {	// Move to the next segment
+      larc -= 1;
+      if ((int) iarc < mNumArc-1)
+        iarc++;
     }
+  }
 
-    // Find prior given nearest neighbor labels
-    iid = iidnear;
-    ipr = iprnear;
+  return prior / (PathAtlasPoints.size()/3);
+}
+
+//
+// Compute prior on a single path point given anatomical segmentation labels
+// around it and the arc segment that it falls in
+//
+double Coffin::ComputeAnatomicalPriorPoint(
+                                       vector<int>::const_iterator AtlasPoint,
+                                       const unsigned int ArcIndex) {
+  const int ix0 = AtlasPoint[0], iy0 = AtlasPoint[1], iz0 = AtlasPoint[2];
+  double prior = 0;
+  vector<float>::iterator iseg0;
+  vector<unsigned int>::const_iterator imatch;
+  vector< vector<unsigned int> >::const_iterator iid;
+  vector< vector<float> >::const_iterator ipr;
+  vector<float> seg0(mAseg.size());
+
+  // Find prior given local neighbor labels
+  iid = mIdsLocal.begin() + ArcIndex;
+  ipr = mPriorLocal.begin() + ArcIndex;
+
+  for (vector<int>::const_iterator idir = mDirLocal.begin();
+                                   idir != mDirLocal.end(); idir += 3) {
+    const int ix = ix0 + idir[0],
+              iy = iy0 + idir[1],
+              iz = iz0 + idir[2];
 
-    iseg0 = seg0.begin();
     for (vector<MRI *>::const_iterator iaseg = mAseg.begin();
                                        iaseg < mAseg.end(); iaseg++) {
-      *iseg0 = MRIgetVoxVal(*iaseg, ix0, iy0, iz0, 0);
-      iseg0++;
+      imatch = find(iid->begin(), iid->end(),
+                    (unsigned int) MRIgetVoxVal(*iaseg,
+                                   ((ix > -1 && ix < mNxAtlas) ? ix : ix0),
+                                   ((iy > -1 && iy < mNyAtlas) ? iy : iy0),
+                                   ((iz > -1 && iz < mNzAtlas) ? iz : iz0),
+                                   0));
+
+      if (imatch < iid->end())
+        prior += ipr->at(imatch - iid->begin());
+      else
+        prior += *(ipr->end() - 1);
     }
 
-    for (vector<int>::const_iterator idir = mDirNear.begin();
-                                     idir != mDirNear.end(); idir += 3) {
-      int dist = 0, ix = ix0 + idir[0],
-                    iy = iy0 + idir[1],
-                    iz = iz0 + idir[2];
-
-      iseg0 = seg0.begin();
-      for (vector<MRI *>::const_iterator iaseg = mAseg.begin();
-                                         iaseg < mAseg.end(); iaseg++) {
-        float seg = *iseg0;
-
-        while ((ix > -1) && (ix < mNxAtlas) &&
-               (iy > -1) && (iy < mNyAtlas) &&
-               (iz > -1) && (iz < mNzAtlas) && (seg == *iseg0)) {
-          seg = MRIgetVoxVal(*iaseg, ix, iy, iz, 0);
-          dist++;
-
-          ix += idir[0];
-          iy += idir[1];
-          iz += idir[2];
-        }
+    iid += mNumArc;
+    ipr += mNumArc;
+  }
 
-        imatch = find(iid->begin(), iid->end(), (unsigned int) seg);
+  // Find prior given nearest neighbor labels
+  iid = mIdsNear.begin() + ArcIndex;
+  ipr = mPriorNear.begin() + ArcIndex;
 
-        if (imatch < iid->end())
-          prior += ipr->at(imatch - iid->begin());
-        else
-          prior += *(ipr->end() - 1);
+  iseg0 = seg0.begin();
+  for (vector<MRI *>::const_iterator iaseg = mAseg.begin();
+                                     iaseg < mAseg.end(); iaseg++) {
+    *iseg0 = MRIgetVoxVal(*iaseg, ix0, iy0, iz0, 0);
+    iseg0++;
+  }
 
-        iseg0++;
+  for (vector<int>::const_iterator idir = mDirNear.begin();
+                                   idir != mDirNear.end(); idir += 3) {
+    int dist = 0, ix = ix0 + idir[0],
+                  iy = iy0 + idir[1],
+                  iz = iz0 + idir[2];
+
+    iseg0 = seg0.begin();
+    for (vector<MRI *>::const_iterator iaseg = mAseg.begin();
+                                       iaseg < mAseg.end(); iaseg++) {
+      float seg = *iseg0;
+
+      while ((ix > -1) && (ix < mNxAtlas) &&
+             (iy > -1) && (iy < mNyAtlas) &&
+             (iz > -1) && (iz < mNzAtlas) && (seg == *iseg0)) {
+        seg = MRIgetVoxVal(*iaseg, ix, iy, iz, 0);
+        dist++;
+
+        ix += idir[0];
+        iy += idir[1];
+        iz += idir[2];
       }
 
-      iid += mNumArc;
-      ipr += mNumArc;
-    }
+      imatch = find(iid->begin(), iid->end(), (unsigned int) seg);
 
-    larc += darc;
+      if (imatch < iid->end())
+        prior += ipr->at(imatch - iid->begin());
+      else
+        prior += *(ipr->end() - 1);
 
-    if (larc > 1)  {	// Move to the next segment
-      larc -= 1;
-      iidlocal++;
-      iprlocal++;
-      iidnear++;
-      iprnear++;
+      iseg0++;
     }
+
+    iid += mNumArc;
+    ipr += mNumArc;
   }
 
-  return prior / (PathAtlasPoints.size()/3);
+  return prior;
 }
 
 //
@@ -65,6 +65,7 @@ class Aeon {		// One point in time
     void SetOutputDir(const char *OutDir);
     const string &GetOutputDir() const;
     void ClearPath();
+    void ClearSamples();
     bool MapPathFromBase(Spline &BaseSpline);
     void FindDuplicatePathPoints(std::vector<bool> &IsDuplicate);
     void RemovePathPoints(std::vector<bool> &DoRemove, unsigned int NewSize=0);
@@ -171,6 +172,7 @@ class Coffin {		// The main container
     void SetMcmcParameters(const int NumBurnIn, const int NumSample,
                            const int KeepSampleNth, const int UpdatePropNth,
                            const char *PropStdFile);
+    void SetNumChains(const int NumChain);
     bool RunMcmcFull();
     bool RunMcmcSingle();
     void WriteOutputs();
@@ -184,7 +186,7 @@ class Coffin {		// The main container
     int mNx, mNy, mNz, mNxy, mNumControl,
         mNxAtlas, mNyAtlas, mNzAtlas, mNumArc,
         mPriorSetLocal, mPriorSetNear,
-        mNumBurnIn, mNumSample, mKeepSampleNth, mUpdatePropNth;
+        mNumBurnIn, mNumSample, mKeepSampleNth, mUpdatePropNth, mNumChain;
     double mDataPosteriorOnPath, mDataPosteriorOnPathNew,
            mDataPosteriorOffPath, mDataPosteriorOffPathNew,
            mXyzPriorOnPath, mXyzPriorOnPathNew,
@@ -196,7 +198,7 @@ class Coffin {		// The main container
     std::string mOutDir, mInfoGeneral, mInfoPathway, mInfoMcmc;
     std::vector<bool> mRejectControl;			// [mNumControl]
     std::vector<int> mAcceptCount, mRejectCount,	// [mNumControl]
-                     mControlPoints, mControlPointsNew,
+                     mControlPoints, mControlPointsNew, mControlPointsInit,
                      mPathPoints, mPathPointsNew,
                      mDirLocal, mDirNear;
     std::vector<float> mResolution,			// [3]
@@ -204,6 +206,7 @@ class Coffin {		// The main container
                        mControlPointJumps,		// [mNumControl x 3]
                        mAcceptSpan, mRejectSpan;	// [mNumControl x 3]
     std::vector< std::vector<int> > mAtlasCoords;
+    std::vector< std::vector<double> > mAnatomicalPriorCache;	// [mNx x mNy x mNz][mNumArc]
     std::vector< std::vector<unsigned int> > mIdsLocal, mIdsNear;
     std::vector< std::vector<float> > mPriorTangent,	// [mNumArc]
                                       mPriorCurvature,	// [mNumArc]
@@ -222,6 +225,8 @@ class Coffin {		// The main container
     void ReadControlPoints(const char *ControlPointFile);
     void ReadProposalStds(const char *PropStdFile);
     bool InitializeMcmc();
+    bool RunChainFull(const int NumSample);
+    bool RunChainSingle(const int NumSample);
     bool InitializeFixOffMask(int FailSegment);
     bool InitializeFixOffWhite(int FailSegment);
     int FindErrorSegment();
@@ -233,7 +238,11 @@ class Coffin {		// The main container
     bool AcceptPath(bool UsePriorOnly=false);
     double ComputeXyzPriorOffPath(std::vector<int> &PathAtlasPoints);
     double ComputeXyzPriorOnPath(std::vector<int> &PathAtlasPoints);
-    double ComputeAnatomicalPrior(std::vector<int> &PathAtlasPoints);
+    double ComputeAnatomicalPrior(std::vector<int> &PathAtlasPoints,
+                                  std::vector<int> &PathPoints);
+    double ComputeAnatomicalPriorPoint(
+                                 std::vector<int>::const_iterator AtlasPoint,
+                                 const unsigned int ArcIndex);
     double ComputeShapePrior(std::vector<int> &PathAtlasPoints);
     void UpdatePath();
     void UpdateAcceptanceRateFull();
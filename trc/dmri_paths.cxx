@@ -32,6 +32,7 @@ double round(double x);
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/utsname.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <float.h>
 
@@ -72,7 +73,8 @@ const char *Progname = "dmri_paths";
 unsigned int nlab1 = 0, nlab2 = 0;
 unsigned int nTract = 1, 
              nBurnIn = 5000, nSample = 5000, nKeepSample = 10, nUpdateProp = 40,
-             localPriorSet = 15, neighPriorSet = 14;
+             localPriorSet = 15, neighPriorSet = 14,
+             nChain = 1, nProc = 1;
 float fminPath = 0;
 char *dwiFile = NULL, *gradFile = NULL, *bvalFile = NULL,
      *maskFile = NULL, *bedpostDir = NULL,
@@ -97,7 +99,8 @@ int main(int argc, char **argv) {
        doneighprior = true,
        dolocalprior = true,
        dopropinit = true;
-  int nargs, cputime, ilab1 = 0, ilab2 = 0;
+  int nargs, cputime, ilab1 = 0, ilab2 = 0, iproc = 0, nfail = 0;
+  vector<pid_t> workers;
 
   /* rkt: check for and handle version tag */
   nargs = handle_version_option (argc, argv, vcid, "$Name:  $");
@@ -161,7 +164,39 @@ int main(int argc, char **argv) {
   if (strstr(roiFile1[0], ".label")) ilab1++;
   if (strstr(roiFile2[0], ".label")) ilab2++;
 
+  // Pathways are independent of each other, so they can be reconstructed by
+  // separate worker processes, which share the DWI data loaded above
+  if (nProc > 1) {
+    cout.flush();
+    fflush(stdout);
+
+    for (unsigned int k = 1; k < nProc; k++) {
+      const pid_t pid = fork();
+
+      if (pid < 0) {
+        cout << "ERROR: Could not start worker process " << k << endl;
+        exit(1);
+      }
+
+      if (pid == 0) {
+        iproc = k;
+        workers.clear();
+        break;
+      }
+
+      workers.push_back(pid);
+    }
+  }
+
   for (unsigned int iout = 0; iout < outDir.size(); iout++) {
+    const bool doprocess = ((int) (iout % nProc) == iproc);
+
+    if (iout > 0 && !doprocess) {	// Pathway assigned to another worker
+      if (strstr(roiFile1[iout], ".label")) ilab1++;
+      if (strstr(roiFile2[iout], ".label")) ilab2++;
+      continue;
+    }
+
     if (iout > 0) {
       mycoffin.SetOutputDir(outDir[iout]);
       mycoffin.SetPathway(initFile[iout],
@@ -185,6 +220,18 @@ int main(int argc, char **argv) {
       if (strstr(roiFile2[iout], ".label")) ilab2++;
     }
 
+    if (!doprocess)
+      continue;
+
+    // With multiple workers, seed each pathway separately, so that results
+    // do not depend on how pathways are assigned to workers
+    if (nProc > 1) {
+      srand(6875 + iout);
+      srand48(6875 + iout);
+    }
+
+    mycoffin.SetNumChains(nChain);
+
     cout << "Processing pathway " << iout+1 << " of " << outDir.size() << "..."
          << endl;
     TimerStart(&cputimer);
@@ -192,13 +239,38 @@ int main(int argc, char **argv) {
     //if (mycoffin.RunMcmcFull())
     if (mycoffin.RunMcmcSingle())
       mycoffin.WriteOutputs();
-    else
+    else {
       cout << "ERROR: Pathway reconstruction failed" << endl;
+      nfail++;
+    }
 
     cputime = TimerStop(&cputimer);
     printf("Done in %g sec.\n", cputime/1000.0);
   }
 
+  if (iproc > 0) {			// Worker process is done
+    cout.flush();
+    fflush(stdout);
+    _exit(nfail > 0);
+  }
+
+  for (vector<pid_t>::const_iterator ipid = workers.begin();
+                                     ipid < workers.end(); ipid++) {
+    int status;
+
+    if (waitpid(*ipid, &status, 0) < 0 ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      cout << "ERROR: Worker process " << ipid - workers.begin() + 1
+           << " failed" << endl;
+      nfail++;
+    }
+  }
+
+  if (nfail > 0) {
+    cout << "ERROR: " << nfail << " pathway(s) or worker(s) failed" << endl;
+    exit(1);
+  }
+
   printf("dmri_paths done\n");
   return(0);
   exit(0);
@@ -445,6 +517,16 @@ static int parse_commandline(int argc, char **argv) {
       sscanf(pargv[0],"%u",&nUpdateProp);
       nargsused = 1;
     }
+    else if (!strcmp(option, "--nchain")) {
+      if (nargc < 1) CMDargNErr(option,1);
+      sscanf(pargv[0],"%u",&nChain);
+      nargsused = 1;
+    }
+    else if (!strcmp(option, "--nproc")) {
+      if (nargc < 1) CMDargNErr(option,1);
+      sscanf(pargv[0],"%u",&nProc);
+      nargsused = 1;
+    }
     else {
       fprintf(stderr,"ERROR: Option %s unknown\n",option);
       if (CMDsingleDash(option))
@@ -547,6 +629,12 @@ static void print_usage(void) {
   << "     Text file with initial proposal standard deviations" << endl
   << "     for control point perturbations (one per path or" << endl
   << "     default SD=1 for all control points and all paths)" << endl
+  << "   --nchain <num>:" << endl
+  << "     Number of independent MCMC chains per path, each with its own" << endl
+  << "     burn-in, whose post-burn-in samples are pooled (default 1)" << endl
+  << "   --nproc <num>:" << endl
+  << "     Number of worker processes to reconstruct paths in parallel" << endl
+  << "     (default 1)" << endl
   << endl
   << "Other options" << endl
   << "   --debug:     turn on debugging" << endl
@@ -585,6 +673,17 @@ static void check_options(void) {
     cout << "ERROR: Must specify output directory" << endl;
     exit(1);
   }
+  if (nChain < 1 || nChain > nSample) {
+    cout << "ERROR: Number of MCMC chains must be between 1 and the number"
+         << " of post-burn-in samples" << endl;
+    exit(1);
+  }
+  if (nProc < 1) {
+    cout << "ERROR: Number of worker processes must be at least 1" << endl;
+    exit(1);
+  }
+  if (nProc > outDir.size())
+    nProc = outDir.size();
   if (!dwiFile) {
     cout << "ERROR: Must specify DWI volume series" << endl;
     exit(1);
@@ -801,6 +900,12 @@ static void dump_options() {
        << "Keep every: " << nKeepSample << "-th sample" << endl
        << "Update proposal every: " << nUpdateProp << "-th sample" << endl;
 
+  if (nChain > 1)
+    cout << "Number of MCMC chains: " << nChain << endl;
+
+  if (nProc > 1)
+    cout << "Number of worker processes: " << nProc << endl;
+
   if (!stdPropFile.empty()) {
     cout << "Initial proposal SD file:";
     for (istr = stdPropFile.begin(); istr < stdPropFile.end(); istr++)
@@ -93,7 +93,6 @@ struct timeb cputimer;
 int main(int argc, char **argv) {
   int nargs, cputime;
   char fname[PATH_MAX], outorient[4];
-  vector<float> point(3), step(3, 0);
   MATRIX *outv2r;
   MRI *inref = 0, *outref = 0, *outvol = 0;
   AffineReg affinereg;
@@ -178,36 +177,58 @@ int main(int argc, char **argv) {
         exit(1);
       }
 
-      while (trkreader.GetNextPointCount(&npts)) {
-        const int veclen = npts*3;
-        float *iraw, *rawpts = new float[veclen];
-        vector<float> newpts(veclen);
+      // Index the streamlines in the file, so that the ones that will be
+      // excluded based on their index or length do not have to be read
+      if (!trkreader.BuildTrackIndex())
+        cout << "WARN: Input file " << fname << " ends in the middle of a "
+             << "streamline, ignoring the incomplete streamline" << endl;
 
-        // Read a streamline from input file
-        trkreader.GetNextTrackData(npts, rawpts);
+      vector<int> strsel;
 
-        if ( (doNth && nstr != strNum) ||
+      for (int kstr = 0; kstr < trkreader.GetNumberOfIndexedTracks(); kstr++) {
+        npts = trkreader.GetTrackPointCount(kstr);
+
+        if ( (doNth && kstr != strNum) ||
              (lengthMin > -1 && npts <= lengthMin) ||
-             (lengthMax > -1 && npts >= lengthMax) ) {
-          delete[] rawpts;
-          nstr++;
+             (lengthMax > -1 && npts >= lengthMax) )
+          continue;
+
+        strsel.push_back(kstr);
+      }
+
+      // Read the selected streamlines from input file
+      int nfail = 0;
+
+      streamlines.resize(strsel.size());
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:nfail)
+#endif
+      for (int ksel = 0; ksel < (int) strsel.size(); ksel++) {
+        const int veclen = trkreader.GetTrackPointCount(strsel[ksel]) * 3;
+        vector<float> rawpts(veclen);
+        vector<float>::const_iterator iraw = rawpts.begin();
+
+        if (veclen > 0 && !trkreader.GetTrackData(strsel[ksel], &rawpts[0])) {
+          nfail++;
           continue;
         }
 
-        iraw = rawpts;
+        streamlines[ksel].resize(veclen);
 
         // Divide by input voxel size and make 0-based to get voxel coords
-        for (vector<float>::iterator ipt = newpts.begin(); ipt < newpts.end();
-                                                           ipt += 3)
+        for (vector<float>::iterator ipt = streamlines[ksel].begin();
+                                     ipt < streamlines[ksel].end(); ipt += 3)
           for (int k = 0; k < 3; k++) {
             ipt[k] = *iraw / trkheadin.voxel_size[k] - .5;
             iraw++;
           }
+      }
 
-        delete[] rawpts;
-        streamlines.push_back(newpts);
-
-        nstr++;
+      if (nfail > 0) {
+        cout << "ERROR: Cannot read " << nfail << " streamline(s) from input "
+             << "file " << fname << endl;
+        exit(1);
       }
     }
     else if (!inAscList.empty()) {	// Read streamlines from text file
@@ -257,8 +278,18 @@ int main(int argc, char **argv) {
 
     nstr = streamlines.size();
 
-    for (int kstr = nstr-1; kstr >= 0; kstr--) {
-      vector<float> newpts;
+    // The nonlinear warp goes through transform routines that keep static
+    // work buffers, so in that case streamlines are transformed serially
+    bool doparallel = true;
+#ifndef NO_CVS_UP_IN_HERE
+    doparallel = nonlinreg.IsEmpty();
+#endif
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic) if (doparallel)
+#endif
+    for (int kstr = 0; kstr < nstr; kstr++) {
+      vector<float> newpts, point(3), step(3, 0);
 
       for (vector<float>::iterator ipt = streamlines[kstr].begin();
                                    ipt < streamlines[kstr].end(); ipt += 3) {
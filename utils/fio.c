@@ -321,6 +321,84 @@ int fwriteFloat(float f, FILE *fp)
   // ret = fwrite(&f,sizeof(float),1,fp);  // old way
   return (ret);
 }
+/*----------------------------------------------------------------
+  Bulk big-endian array I/O. These move n values with a single
+  fread/fwrite and byte-swap the whole buffer in one pass instead of
+  making one stdio call per element. The swap loops work on unsigned
+  words so the compiler can vectorize them. They return the number
+  of complete items transferred.
+  ----------------------------------------------------------------*/
+static void fioSwapBuf4(void *buf, size_t n)
+{
+  unsigned char *cbuf = (unsigned char *)buf;
+  unsigned int w;
+  size_t k;
+
+  for (k = 0; k < n; k++) {
+    memcpy(&w, cbuf + 4 * k, 4);
+    w = (w >> 24) | ((w >> 8) & 0x0000ff00u) | ((w << 8) & 0x00ff0000u) | (w << 24);
+    memcpy(cbuf + 4 * k, &w, 4);
+  }
+}
+static void fioSwapBuf2(void *buf, size_t n)
+{
+  unsigned char *cbuf = (unsigned char *)buf;
+  unsigned short h;
+  size_t k;
+
+  for (k = 0; k < n; k++) {
+    memcpy(&h, cbuf + 2 * k, 2);
+    h = (unsigned short)((h >> 8) | (h << 8));
+    memcpy(cbuf + 2 * k, &h, 2);
+  }
+}
+static int fioRead4(void *buf, int n, FILE *fp)
+{
+  size_t nread;
+
+  if (n <= 0) return (0);
+  nread = fread(buf, 4, n, fp);
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+  fioSwapBuf4(buf, nread);
+#endif
+  return ((int)nread);
+}
+static int fioWrite4(const void *buf, int n, FILE *fp)
+{
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+  unsigned char tmp[4 * 1024];
+  const unsigned char *cbuf = (const unsigned char *)buf;
+  int nwritten = 0, nchunk;
+
+  // swap through a fixed chunk so the caller's buffer is untouched
+  while (nwritten < n) {
+    nchunk = MIN(n - nwritten, 1024);
+    memcpy(tmp, cbuf + 4 * (size_t)nwritten, 4 * (size_t)nchunk);
+    fioSwapBuf4(tmp, nchunk);
+    if ((int)fwrite(tmp, 4, nchunk, fp) != nchunk) break;
+    nwritten += nchunk;
+  }
+  return (nwritten);
+#else
+  if (n <= 0) return (0);
+  return ((int)fwrite(buf, 4, n, fp));
+#endif
+}
+int freadIntArray(int *buf, int n, FILE *fp) { return (fioRead4(buf, n, fp)); }
+int freadFloatArray(float *buf, int n, FILE *fp) { return (fioRead4(buf, n, fp)); }
+int fwriteIntArray(const int *buf, int n, FILE *fp) { return (fioWrite4(buf, n, fp)); }
+int fwriteFloatArray(const float *buf, int n, FILE *fp) { return (fioWrite4(buf, n, fp)); }
+int freadShortArray(short *buf, int n, FILE *fp)
+{
+  size_t nread;
+
+  if (n <= 0) return (0);
+  nread = fread(buf, 2, n, fp);
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+  fioSwapBuf2(buf, nread);
+#endif
+  return ((int)nread);
+}
 /*----------------------------------------*/
 int fwriteDouble(double d, FILE *fp)
 {
@@ -4721,6 +4721,193 @@ float GCAcomputeLogSampleProbability(
   return ((float)total_log_p / nsamples);
 }
 
+/*-------------------------------------------------------------------
+  GCAsamplePackAlloc() - copies a sample set into contiguous arrays so
+  that it can be scored under many linear transforms by
+  GCAcomputeLogSampleProbabilityPacked(). The prior coordinates,
+  log(prior), means, inverse covariances and the normalization
+  -log(sqrt(det)) are computed once here instead of for every
+  evaluation (the multi-input path used to invert every covariance
+  matrix each time, through static matrices that are not thread safe).
+  The pack does not track later changes to gcas.
+  -------------------------------------------------------------------*/
+GCA_SAMPLE_PACK *GCAsamplePackAlloc(GCA *gca, GCA_SAMPLE *gcas, int nsamples)
+{
+  GCA_SAMPLE_PACK *pack;
+  MATRIX *m_cov = NULL, *m_inv_cov = NULL;
+  int i, n, m, ninputs;
+
+  ninputs = gca->ninputs;
+  pack = (GCA_SAMPLE_PACK *)calloc(1, sizeof(GCA_SAMPLE_PACK));
+  if (!pack) ErrorExit(ERROR_NOMEMORY, "GCAsamplePackAlloc: could not allocate pack");
+  pack->nsamples = nsamples;
+  pack->ninputs = ninputs;
+  pack->xp = (float *)calloc(nsamples, sizeof(float));
+  pack->yp = (float *)calloc(nsamples, sizeof(float));
+  pack->zp = (float *)calloc(nsamples, sizeof(float));
+  pack->prior_log = (double *)calloc(nsamples, sizeof(double));
+  pack->log_norm = (double *)calloc(nsamples, sizeof(double));
+  pack->means = (float *)calloc(nsamples * ninputs, sizeof(float));
+  pack->icovars = (float *)calloc(nsamples * ninputs * ninputs, sizeof(float));
+  if (!pack->xp || !pack->yp || !pack->zp || !pack->prior_log || !pack->log_norm || !pack->means || !pack->icovars)
+    ErrorExit(ERROR_NOMEMORY, "GCAsamplePackAlloc: could not allocate %d samples", nsamples);
+
+  // prior voxel -> template voxel; the candidate transform is applied on top
+  pack->m_prior2voxel = MatrixMultiply(gca->mri_tal__->r_to_i__, gca->prior_i_to_r__, NULL);
+
+  for (i = 0; i < nsamples; i++) {
+    pack->xp[i] = gcas[i].xp;
+    pack->yp[i] = gcas[i].yp;
+    pack->zp[i] = gcas[i].zp;
+    pack->prior_log[i] = gcas_getPriorLog(gcas[i]);
+    for (n = 0; n < ninputs; n++) pack->means[i * ninputs + n] = gcas[i].means[n];
+    if (ninputs == 1) {
+      pack->log_norm[i] = -log(sqrt(gcas[i].covars[0]));
+      pack->icovars[i] = 1.0 / gcas[i].covars[0];
+      continue;
+    }
+    // same matrix as GCAsampleMahDist() and sample_covariance_determinant()
+    m_cov = load_sample_covariance_matrix(&gcas[i], m_cov, ninputs);
+    pack->log_norm[i] = -log(sqrt(MatrixDeterminant(m_cov)));
+    m_inv_cov = MatrixInverse(m_cov, m_inv_cov);
+    if (!m_inv_cov) ErrorExit(ERROR_BADPARM, "GCAsamplePackAlloc: singular covariance matrix for sample %d", i);
+    for (n = 0; n < ninputs; n++)
+      for (m = 0; m < ninputs; m++)
+        pack->icovars[(i * ninputs + n) * ninputs + m] = *MATRIX_RELT(m_inv_cov, n + 1, m + 1);
+  }
+  if (m_cov) MatrixFree(&m_cov);
+  if (m_inv_cov) MatrixFree(&m_inv_cov);
+  return (pack);
+}
+
+void GCAsamplePackFree(GCA_SAMPLE_PACK **ppack)
+{
+  GCA_SAMPLE_PACK *pack = *ppack;
+
+  if (!pack) return;
+  free(pack->xp);
+  free(pack->yp);
+  free(pack->zp);
+  free(pack->prior_log);
+  free(pack->log_norm);
+  free(pack->means);
+  free(pack->icovars);
+  MatrixFree(&pack->m_prior2voxel);
+  free(pack);
+  *ppack = NULL;
+}
+
+#define GCAS_PACK_BLOCK 256
+
+/*-------------------------------------------------------------------
+  GCAcomputeLogSampleProbabilityPacked() - same value as
+  GCAcomputeLogSampleProbability() for a LINEAR_VOX_TO_VOX transform
+  whose matrix is m_L (source voxel -> template voxel), but computed
+  from a GCA_SAMPLE_PACK and without writing back into the GCA_SAMPLEs.
+  The samples are processed in fixed blocks: the coordinate transform
+  and single-input density loops run over contiguous arrays so that
+  they vectorize, blocks are spread over threads, and the block sums
+  are added in block order so the result does not depend on the
+  number of threads. When called from inside a parallel region (eg,
+  to score several candidate transforms concurrently) it runs
+  serially in the calling thread.
+  -------------------------------------------------------------------*/
+float GCAcomputeLogSampleProbabilityPacked(GCA_SAMPLE_PACK *pack, MRI *mri_inputs, MATRIX *m_L, double clamp)
+{
+  MATRIX *m_L_inv, *m_prior2source;
+  double M[3][4], total_log_p, *block_log_p;
+  int nblocks, block, r, c;
+
+  m_L_inv = MatrixInverse(m_L, NULL);
+  if (!m_L_inv) ErrorReturn(-1e10, (ERROR_BADPARM, "GCAcomputeLogSampleProbabilityPacked: singular transform"));
+  m_prior2source = MatrixMultiply(m_L_inv, pack->m_prior2voxel, NULL);
+  for (r = 0; r < 3; r++)
+    for (c = 0; c < 4; c++) M[r][c] = *MATRIX_RELT(m_prior2source, r + 1, c + 1);
+  MatrixFree(&m_L_inv);
+  MatrixFree(&m_prior2source);
+
+  nblocks = (pack->nsamples + GCAS_PACK_BLOCK - 1) / GCAS_PACK_BLOCK;
+  block_log_p = (double *)calloc(nblocks, sizeof(double));
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (block = 0; block < nblocks; block++) {
+    ROMP_PFLB_begin
+    int x[GCAS_PACK_BLOCK], y[GCAS_PACK_BLOCK], z[GCAS_PACK_BLOCK];
+    float vals[GCAS_PACK_BLOCK * MAX_GCA_INPUTS];
+    double log_p[GCAS_PACK_BLOCK], sum;
+    int j, n, m, i0, nb, ninputs, inside;
+
+    ninputs = pack->ninputs;
+    i0 = block * GCAS_PACK_BLOCK;
+    nb = MIN(GCAS_PACK_BLOCK, pack->nsamples - i0);
+
+    // prior -> source voxel
+    for (j = 0; j < nb; j++) {
+      x[j] = nint(M[0][0] * pack->xp[i0 + j] + M[0][1] * pack->yp[i0 + j] + M[0][2] * pack->zp[i0 + j] + M[0][3]);
+      y[j] = nint(M[1][0] * pack->xp[i0 + j] + M[1][1] * pack->yp[i0 + j] + M[1][2] * pack->zp[i0 + j] + M[1][3]);
+      z[j] = nint(M[2][0] * pack->xp[i0 + j] + M[2][1] * pack->yp[i0 + j] + M[2][2] * pack->zp[i0 + j] + M[2][3]);
+    }
+
+    // gather the intensities; out of volume samples are flagged with x = -1
+    for (j = 0; j < nb; j++) {
+      inside = (x[j] >= 0 && x[j] < mri_inputs->width && y[j] >= 0 && y[j] < mri_inputs->height && z[j] >= 0 &&
+                z[j] < mri_inputs->depth);
+      if (!inside) {
+        x[j] = -1;
+        for (n = 0; n < ninputs; n++) vals[j * ninputs + n] = 0;
+        continue;
+      }
+      if (ninputs == 1 && mri_inputs->type == MRI_UCHAR)
+        vals[j] = MRIvox(mri_inputs, x[j], y[j], z[j]);
+      else if (ninputs == 1 && mri_inputs->type == MRI_FLOAT)
+        vals[j] = MRIFvox(mri_inputs, x[j], y[j], z[j]);
+      else
+        for (n = 0; n < ninputs; n++) vals[j * ninputs + n] = MRIgetVoxVal(mri_inputs, x[j], y[j], z[j], n);
+    }
+
+    // Gaussian log density plus log prior
+    if (ninputs == 1) {
+      for (j = 0; j < nb; j++) {
+        double v = vals[j] - pack->means[i0 + j];
+        log_p[j] = pack->log_norm[i0 + j] - .5 * v * v * pack->icovars[i0 + j] + pack->prior_log[i0 + j];
+      }
+    }
+    else {
+      for (j = 0; j < nb; j++) {
+        const float *means = &pack->means[(i0 + j) * ninputs];
+        const float *icov = &pack->icovars[(i0 + j) * ninputs * ninputs];
+        double dsq = 0, dn, dm;
+        for (n = 0; n < ninputs; n++) {
+          dn = vals[j * ninputs + n] - means[n];
+          for (m = 0; m < ninputs; m++) {
+            dm = vals[j * ninputs + m] - means[m];
+            dsq += dn * icov[n * ninputs + m] * dm;
+          }
+        }
+        log_p[j] = pack->log_norm[i0 + j] - .5 * dsq + pack->prior_log[i0 + j];
+      }
+    }
+
+    for (sum = 0.0, j = 0; j < nb; j++) {
+      if (x[j] < 0)
+        log_p[j] = -1000000;  // BIG_AND_NEGATIVE, as in GCAcomputeLogSampleProbability
+      else if (log_p[j] < -clamp)
+        log_p[j] = -clamp;
+      sum += log_p[j];
+    }
+    block_log_p[block] = sum;
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  for (total_log_p = 0.0, block = 0; block < nblocks; block++) total_log_p += block_log_p[block];
+  free(block_log_p);
+  return ((float)total_log_p / pack->nsamples);
+}
+
 float GCAcomputeLogSampleProbabilityLongitudinal(
     GCA *gca, GCA_SAMPLE *gcas, MRI *mri_inputs, TRANSFORM *transform, int nsamples, double clamp)
 {
@@ -42,6 +42,7 @@
 #include "macros.h"
 #include "mrishash.h"
 #include "proto.h"
+#include "romp_support.h"
 #include "tags.h"
 #include "transform.h"
 #include "utils.h"
@@ -58,11 +59,35 @@ static int MRIScomputeVertexPermutation(MRI_SURFACE *mris, int *indices);
 static int GCSAupdateNodeMeans(GCSA_NODE *gcsan, int label, double *v_inputs, int ninputs);
 static int GCSAupdateNodeGibbsPriors(CP_NODE *cpn, int label, MRI_SURFACE *mris, int vno);
 static int GCSAupdateNodeCovariance(GCSA_NODE *gcsan, int label, double *v_inputs, int ninputs);
-static int GCSANclassify(
-    GCSA_NODE *gcsa_node, CP_NODE *cpn, double *v_inputs, int ninputs, double *pprob, int *exlude_list, int nexcluded);
-static double gcsaNbhdGibbsLogLikelihood(
-    GCSA *gcsa, MRI_SURFACE *mris, double *v_inputs, int vno, double gibbs_coef, int label);
-static double gcsaVertexGibbsLogLikelihood(GCSA *gcsa, MRI_SURFACE *mris, double *v_inputs, int vno, double gibbs_coef);
+static int GCSANclassify(GCSA *gcsa,
+                         int vno_classifier,
+                         CP_NODE *cpn,
+                         double *v_inputs,
+                         double *pprob,
+                         int *exlude_list,
+                         int nexcluded);
+static double gcsaNbhdGibbsLogLikelihood(GCSA *gcsa,
+                                         MRI_SURFACE *mris,
+                                         double *v_inputs,
+                                         int vno,
+                                         double gibbs_coef,
+                                         int label,
+                                         const int *vno_priors,
+                                         const int *vno_classifiers);
+static double gcsaVertexGibbsLogLikelihood(GCSA *gcsa,
+                                           MRI_SURFACE *mris,
+                                           double *v_inputs,
+                                           int vno,
+                                           double gibbs_coef,
+                                           const int *vno_priors,
+                                           const int *vno_classifiers);
+static int gcsaEnsureFlatClassifiers(GCSA *gcsa);
+static void gcsaFreeFlatClassifiers(GCSA *gcsa);
+static float gcsaFlatMahalanobis(GCSA *gcsa, int k, double *v_inputs);
+static int gcsaMapSourceVertices(GCSA *gcsa, MRI_SURFACE *mris, int *vno_priors, int *vno_classifiers);
+static int gcsaColorVertices(MRI_SURFACE *mris, int *colors);
+static int gcsaGibbsRelabelVertex(
+    GCSA *gcsa, MRI_SURFACE *mris, int vno, const int *vno_priors, const int *vno_classifiers);
 static int add_gc_to_gcsan(GCSA_NODE *gcsan_src, int nsrc, GCSA_NODE *gcsan_dst);
 #if 0
 static int add_cp_to_cpn(CP_NODE *cpn_src, int nsrc, CP_NODE *cpn_dst) ;
@@ -208,6 +233,7 @@ int GCSAfree(GCSA **pgcsa)
   MRISfree(&gcsa->mris_priors);
   free(gcsa->cp_nodes);
   free(gcsa->gc_nodes);
+  gcsaFreeFlatClassifiers(gcsa);
   free(gcsa);
 
   return (NO_ERROR);
@@ -226,6 +252,8 @@ int GCSAtrainMeans(GCSA *gcsa, MRI_SURFACE *mris)
   CP_NODE *cpn;
   double v_inputs[100];
 
+  gcsaFreeFlatClassifiers(gcsa);
+
   for (vno = 0; vno < mris->nvertices; vno++) {
     v = &mris->vertices[vno];
     if (v->ripflag) continue;
@@ -268,6 +296,8 @@ int GCSAtrainCovariances(GCSA *gcsa, MRI_SURFACE *mris)
   GCSA_NODE *gcsan;
   double v_inputs[100];
 
+  gcsaFreeFlatClassifiers(gcsa);
+
   for (vno = 0; vno < mris->nvertices; vno++) {
     v = &mris->vertices[vno];
     if (v->ripflag) continue;
@@ -384,6 +414,8 @@ int GCSAnormalizeMeans(GCSA *gcsa)
   GCSA_NODE *gcsan;
   GCS *gcs;
 
+  gcsaFreeFlatClassifiers(gcsa);
+
   for (total_gcs = vno = 0; vno < gcsa->mris_classifiers->nvertices; vno++) {
     gcsan = &gcsa->gc_nodes[vno];
     total_gcs += gcsan->nlabels;
@@ -446,6 +478,8 @@ int GCSAnormalizeCovariances(GCSA *gcsa)
 
 #define MIN_VAR 0.01
 
+  gcsaFreeFlatClassifiers(gcsa);
+
   for (vno = 0; vno < gcsa->mris_classifiers->nvertices; vno++) {
     if (vno == Gdiag_no) DiagBreak();
     gcsan = &gcsa->gc_nodes[vno];
@@ -715,8 +749,155 @@ GCSA *GCSAread(char *fname)
 
   fclose(fp);
   gcsaFixSingularCovarianceMatrices(gcsa);
+  GCSAflattenClassifiers(gcsa);
   return (gcsa);
 }
+
+/*-----------------------------------------------------
+  Parameters:
+
+  Returns value:
+
+  Description
+    Copy the classifier means, inverse covariances and
+    determinants of every (node, label) pair into contiguous
+    float tables indexed by gcs_index[vno_classifier] + n, so
+    that labeling doesn't invert a covariance matrix per vertex
+    and label. The tables are freed by anything that changes the
+    classifiers and rebuilt on the next labeling call.
+------------------------------------------------------*/
+int GCSAflattenClassifiers(GCSA *gcsa)
+{
+  int vno, n, i, j, k, ninputs, nclassifiers, ntotal, nsingular;
+  GCSA_NODE *gcsan;
+  GCS *gcs;
+  MATRIX *m_cov_inv, *m_tmp;
+
+  gcsaFreeFlatClassifiers(gcsa);
+
+  ninputs = gcsa->ninputs;
+  nclassifiers = gcsa->mris_classifiers->nvertices;
+  gcsa->gcs_index = (int *)calloc(nclassifiers + 1, sizeof(int));
+  if (!gcsa->gcs_index) ErrorExit(ERROR_NOMEMORY, "GCSAflattenClassifiers: could not allocate index");
+  for (ntotal = vno = 0; vno < nclassifiers; vno++) {
+    gcsa->gcs_index[vno] = ntotal;
+    ntotal += gcsa->gc_nodes[vno].nlabels;
+  }
+  gcsa->gcs_index[nclassifiers] = ntotal;
+
+  gcsa->gcs_means = (float *)calloc(ntotal * ninputs + 1, sizeof(float));
+  gcsa->gcs_icov = (float *)calloc(ntotal * ninputs * ninputs + 1, sizeof(float));
+  gcsa->gcs_det = (float *)calloc(ntotal + 1, sizeof(float));
+  gcsa->gcs_singular = (char *)calloc(ntotal + 1, sizeof(char));
+  if (!gcsa->gcs_means || !gcsa->gcs_icov || !gcsa->gcs_det || !gcsa->gcs_singular)
+    ErrorExit(ERROR_NOMEMORY, "GCSAflattenClassifiers: could not allocate %d classifiers", ntotal);
+
+  for (nsingular = vno = 0; vno < nclassifiers; vno++) {
+    gcsan = &gcsa->gc_nodes[vno];
+    for (n = 0; n < gcsan->nlabels; n++) {
+      k = gcsa->gcs_index[vno] + n;
+      gcs = &gcsan->gcs[n];
+      for (i = 0; i < ninputs; i++) gcsa->gcs_means[k * ninputs + i] = VECTOR_ELT(gcs->v_means, i + 1);
+
+      m_cov_inv = MatrixInverse(gcs->m_cov, NULL);
+      if (!m_cov_inv) /* same regularization GCSANclassify used to apply */
+      {
+        m_tmp = MatrixIdentity(ninputs, NULL);
+        MatrixScalarMul(m_tmp, 0.1, m_tmp);
+        MatrixAdd(m_tmp, gcs->m_cov, m_tmp);
+        m_cov_inv = MatrixInverse(m_tmp, NULL);
+        MatrixFree(&m_tmp);
+        gcsa->gcs_singular[k] = m_cov_inv ? 1 : 2;
+        nsingular++;
+      }
+      if (m_cov_inv) {
+        for (i = 0; i < ninputs; i++)
+          for (j = 0; j < ninputs; j++)
+            gcsa->gcs_icov[(k * ninputs + i) * ninputs + j] = *MATRIX_RELT(m_cov_inv, i + 1, j + 1);
+        MatrixFree(&m_cov_inv);
+      }
+      gcsa->gcs_det[k] = MatrixDeterminant(gcs->m_cov);
+    }
+  }
+  if (nsingular > 0) printf("%d singular classifier covariance matrices regularized for labeling\n", nsingular);
+
+  return (NO_ERROR);
+}
+
+static int gcsaEnsureFlatClassifiers(GCSA *gcsa)
+{
+  if (gcsa->gcs_index == NULL) GCSAflattenClassifiers(gcsa);
+  return (NO_ERROR);
+}
+
+static void gcsaFreeFlatClassifiers(GCSA *gcsa)
+{
+  if (gcsa->gcs_index) free(gcsa->gcs_index);
+  if (gcsa->gcs_means) free(gcsa->gcs_means);
+  if (gcsa->gcs_icov) free(gcsa->gcs_icov);
+  if (gcsa->gcs_det) free(gcsa->gcs_det);
+  if (gcsa->gcs_singular) free(gcsa->gcs_singular);
+  gcsa->gcs_index = NULL;
+  gcsa->gcs_means = NULL;
+  gcsa->gcs_icov = NULL;
+  gcsa->gcs_det = NULL;
+  gcsa->gcs_singular = NULL;
+}
+
+/*
+  (mean - x)' * inv(cov) * (mean - x) for flat classifier k, accumulated
+  in float like the VectorCopy/MatrixMultiply/VectorDot sequence it replaces.
+*/
+static float gcsaFlatMahalanobis(GCSA *gcsa, int k, double *v_inputs)
+{
+  int i, j, ninputs;
+  float v_x[100], val, dot;
+  const float *means, *icov;
+
+  ninputs = gcsa->ninputs;
+  means = &gcsa->gcs_means[k * ninputs];
+  icov = &gcsa->gcs_icov[k * ninputs * ninputs];
+  for (i = 0; i < ninputs; i++) v_x[i] = means[i] - v_inputs[i];
+  for (dot = 0.0f, i = 0; i < ninputs; i++) {
+    for (val = 0.0f, j = 0; j < ninputs; j++) val += icov[i * ninputs + j] * v_x[j];
+    dot += v_x[i] * val;
+  }
+  return (dot);
+}
+
+/*
+  look up the prior and classifier node of every vertex in mris once,
+  instead of two hash table searches per vertex per label evaluation.
+  Ripped vertices that have no node nearby are given -1.
+*/
+static int gcsaMapSourceVertices(GCSA *gcsa, MRI_SURFACE *mris, int *vno_priors, int *vno_classifiers)
+{
+  int vno;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    ROMP_PFLB_begin
+    VERTEX *v, *v_prior, *v_classifier;
+
+    v = &mris->vertices[vno];
+    vno_priors[vno] = vno_classifiers[vno] = -1;
+    v_prior = GCSAsourceToPriorVertex(gcsa, v);
+    v_classifier = v_prior ? GCSAsourceToClassifierVertex(gcsa, v_prior) : NULL;
+    if (v_classifier == NULL) {
+      if (!v->ripflag) ErrorExit(ERROR_BADPARM, "gcsaMapSourceVertices: no atlas node found for vertex %d", vno);
+      ROMP_PFLB_continue;
+    }
+    vno_priors[vno] = v_prior - gcsa->mris_priors->vertices;
+    vno_classifiers[vno] = v_classifier - gcsa->mris_classifiers->vertices;
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  return (NO_ERROR);
+}
 /*---------------------------------------------------------*/
 int GCSAbuildMostLikelyLabels(GCSA *gcsa, MRI_SURFACE *mris)
 {
@@ -753,31 +934,42 @@ int GCSAbuildMostLikelyLabels(GCSA *gcsa, MRI_SURFACE *mris)
   return (NO_ERROR);
 }
 
-static int Gvno = -1;
 int GCSAlabel(GCSA *gcsa, MRI_SURFACE *mris)
 {
-  int vno, vno_classifier, label, vno_prior;
-  VERTEX *v, *v_classifier, *v_prior;
-  GCSA_NODE *gcsan;
-  CP_NODE *cpn;
-  double v_inputs[100], p;
-
+  int vno, *vno_priors, *vno_classifiers;
+
+  gcsaEnsureFlatClassifiers(gcsa);
+  vno_priors = (int *)calloc(mris->nvertices, sizeof(int));
+  vno_classifiers = (int *)calloc(mris->nvertices, sizeof(int));
+  if (!vno_priors || !vno_classifiers) ErrorExit(ERROR_NOMEMORY, "GCSAlabel: could not allocate vertex maps");
+  gcsaMapSourceVertices(gcsa, mris, vno_priors, vno_classifiers);
+
+  /* each vertex is classified independently of all the others */
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
   for (vno = 0; vno < mris->nvertices; vno++) {
+    ROMP_PFLB_begin
+    int vno_classifier, label, vno_prior;
+    VERTEX *v;
+    GCSA_NODE *gcsan;
+    CP_NODE *cpn;
+    double v_inputs[100], p;
+
     v = &mris->vertices[vno];
-    if (v->ripflag) continue;
+    if (v->ripflag) ROMP_PFLB_continue;
     if (vno == Gdiag_no) DiagBreak();
     load_inputs(v, v_inputs, gcsa->ninputs);
 
-    v_prior = GCSAsourceToPriorVertex(gcsa, v);
-    vno_prior = v_prior - gcsa->mris_priors->vertices;
+    vno_prior = vno_priors[vno];
     if (vno_prior == Gdiag_no) DiagBreak();
-    v_classifier = GCSAsourceToClassifierVertex(gcsa, v_prior);
-    vno_classifier = v_classifier - gcsa->mris_classifiers->vertices;
+    vno_classifier = vno_classifiers[vno];
     if (vno_classifier == Gdiag_no) DiagBreak();
     gcsan = &gcsa->gc_nodes[vno_classifier];
 
     cpn = &gcsa->cp_nodes[vno_prior];
-    label = GCSANclassify(gcsan, cpn, v_inputs, gcsa->ninputs, &p, NULL, 0);
+    label = GCSANclassify(gcsa, vno_classifier, cpn, v_inputs, &p, NULL, 0);
     v->annotation = label;
     // O.Hinds needs this for vertex probability feature (mris_ca_label -p) but it breaks mris_ca_label    v->val = p ;
     if (vno == Gdiag_no) {
@@ -804,27 +996,29 @@ int GCSAlabel(GCSA *gcsa, MRI_SURFACE *mris)
         MatrixPrint(stdout, gcs->v_means);
       }
     }
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
 
+  free(vno_priors);
+  free(vno_classifiers);
   return (NO_ERROR);
 }
 
-static int GCSANclassify(
-    GCSA_NODE *gcsan, CP_NODE *cpn, double *v_inputs, int ninputs, double *pprob, int *exclude_list, int nexcluded)
+static int GCSANclassify(GCSA *gcsa,
+                         int vno_classifier,
+                         CP_NODE *cpn,
+                         double *v_inputs,
+                         double *pprob,
+                         int *exclude_list,
+                         int nexcluded)
 {
-  int n, best_label, i, j, skip;
-  double p, ptotal, max_p, det;
+  int n, nc, k, best_label, j, skip;
+  double p, ptotal, max_p;
   CP *cp;
-  GCS *gcs;
-  static MATRIX *m_cov_inv = NULL;
-  static VECTOR *v_tmp = NULL, *v_x = NULL;
-
-  if (v_x && ninputs != v_x->rows) {
-    MatrixFree(&m_cov_inv);
-    MatrixFree(&v_tmp);
-    VectorFree(&v_x);
-  }
+  GCSA_NODE *gcsan;
 
+  gcsan = &gcsa->gc_nodes[vno_classifier];
   ptotal = 0.0;
   max_p = -10000;
   best_label = -1;
@@ -838,34 +1032,14 @@ static int GCSANclassify(
     if (skip) continue;
 
     cp = &cpn->cps[n];
-    gcs = getGC(gcsan, cpn->labels[n], NULL);
-    if (!gcs) {
+    if (!getGC(gcsan, cpn->labels[n], &nc)) {
       ErrorPrintf(ERROR_BADPARM, "GCSANclassify: could not find GCS for node %d!", n);
       continue;
     }
-    v_x = VectorCopy(gcs->v_means, v_x);
-    for (i = 0; i < ninputs; i++) VECTOR_ELT(v_x, i + 1) -= v_inputs[i];
-    m_cov_inv = MatrixInverse(gcs->m_cov, m_cov_inv);
-    if (!m_cov_inv) {
-      MATRIX *m_tmp;
-      fprintf(stderr, "Singular matrix in GCSAclassify,vno=%d,n=%d:\n", Gvno, n);
-      MatrixPrint(stderr, gcs->m_cov);
-#if 0
-      ErrorExit(ERROR_BADPARM, "") ;
-#else
-      m_tmp = MatrixIdentity(ninputs, NULL);
-      MatrixScalarMul(m_tmp, 0.1, m_tmp);
-      MatrixAdd(m_tmp, gcs->m_cov, m_tmp);
-      m_cov_inv = MatrixInverse(m_tmp, NULL);
-      if (!m_cov_inv) {
-        ErrorExit(ERROR_BADPARM, "GCSANclassify: could not regularize matrix");
-      }
-#endif
-    }
-    v_tmp = MatrixMultiply(m_cov_inv, v_x, v_tmp);
-    p = VectorDot(v_x, v_tmp);
-    det = MatrixDeterminant(gcs->m_cov);
-    p = cp->prior * exp(-0.5 * p) * 1.0 / (sqrt(det));
+    k = gcsa->gcs_index[vno_classifier] + nc;
+    if (gcsa->gcs_singular[k] > 1) ErrorExit(ERROR_BADPARM, "GCSANclassify: could not regularize matrix");
+    p = gcsaFlatMahalanobis(gcsa, k, v_inputs);
+    p = cp->prior * exp(-0.5 * p) * 1.0 / (sqrt(gcsa->gcs_det[k]));
     ptotal += p;
     if (p > max_p) {
       max_p = p;
@@ -1089,18 +1263,47 @@ static int edge_to_index(VERTEX *v, VERTEX *vn)
 
 int gcsa_write_iterations = 0;
 char *gcsa_write_fname = NULL;
+int gcsa_colored_gibbs = 0;
 
+/*
+  When gcsa_colored_gibbs is set the vertices are visited color by color
+  using a distance-2 coloring of the surface instead of a random
+  permutation. Relabeling a vertex reads the labels of its 2-ring only,
+  so all the vertices of one color can be relabeled concurrently and the
+  result doesn't depend on the number of threads or on the random seed.
+*/
 int GCSAreclassifyUsingGibbsPriors(GCSA *gcsa, MRI_SURFACE *mris)
 {
-  int *indices;
-  int n, vno, i, nchanged, label, best_label, old_label, vno_prior, vno_classifier, niter, examined;
-  double ll, max_ll;
-  VERTEX *v, *v_classifier, *v_prior, *vn;
-  // GCSA_NODE *gcsan;
-  CP_NODE *cpn;
-  double v_inputs[100];
+  int *indices, *vno_priors, *vno_classifiers, *colors, *color_index;
+  int n, vno, i, c, nchanged, niter, examined, ncolors;
+  VERTEX *v, *vn;
 
   indices = (int *)calloc(mris->nvertices, sizeof(int));
+  vno_priors = (int *)calloc(mris->nvertices, sizeof(int));
+  vno_classifiers = (int *)calloc(mris->nvertices, sizeof(int));
+  if (!indices || !vno_priors || !vno_classifiers)
+    ErrorExit(ERROR_NOMEMORY, "GCSAreclassifyUsingGibbsPriors: could not allocate vertex maps");
+
+  gcsaEnsureFlatClassifiers(gcsa);
+  gcsaMapSourceVertices(gcsa, mris, vno_priors, vno_classifiers);
+
+  colors = color_index = NULL;
+  ncolors = 0;
+  if (gcsa_colored_gibbs) {
+    colors = (int *)calloc(mris->nvertices, sizeof(int));
+    if (!colors) ErrorExit(ERROR_NOMEMORY, "GCSAreclassifyUsingGibbsPriors: could not allocate colors");
+    ncolors = gcsaColorVertices(mris, colors);
+    color_index = (int *)calloc(ncolors + 1, sizeof(int));
+    if (!color_index) ErrorExit(ERROR_NOMEMORY, "GCSAreclassifyUsingGibbsPriors: could not allocate colors");
+
+    /* bucket the vertices by color, in vertex order within each color */
+    for (vno = 0; vno < mris->nvertices; vno++) color_index[colors[vno] + 1]++;
+    for (c = 0; c < ncolors; c++) color_index[c + 1] += color_index[c];
+    for (vno = 0; vno < mris->nvertices; vno++) indices[color_index[colors[vno]]++] = vno;
+    for (c = ncolors; c > 0; c--) color_index[c] = color_index[c - 1];
+    color_index[0] = 0;
+    printf("relabeling with a %d-color Gibbs schedule\n", ncolors);
+  }
 
   niter = 0;
   if (gcsa_write_iterations != 0) {
@@ -1115,58 +1318,33 @@ int GCSAreclassifyUsingGibbsPriors(GCSA *gcsa, MRI_SURFACE *mris)
   do {
     nchanged = 0;
     examined = 0;
-    MRIScomputeVertexPermutation(mris, indices);
-    for (i = 0; i < mris->nvertices; i++) {
-      vno = indices[i];
-      v = &mris->vertices[vno];
-      if (v->marked == 0) continue;
-      v->marked = 0;
-      examined++;
-
-      if (vno == Gdiag_no) DiagBreak();
-
-      load_inputs(v, v_inputs, gcsa->ninputs);
-
-      v_prior = GCSAsourceToPriorVertex(gcsa, v);
-      vno_prior = v_prior - gcsa->mris_priors->vertices;
-      if (vno_prior == Gdiag_no) DiagBreak();
-      cpn = &gcsa->cp_nodes[vno_prior];
-      if (cpn->nlabels <= 1) continue;
-
-      v_classifier = GCSAsourceToClassifierVertex(gcsa, v_prior);
-      vno_classifier = v_classifier - gcsa->mris_classifiers->vertices;
-      // gcsan = &gcsa->gc_nodes[vno_classifier];
-      if (vno_classifier == Gdiag_no) DiagBreak();
+    if (gcsa_colored_gibbs) {
+      for (c = 0; c < ncolors; c++) {
+        int nchanged_color = 0, examined_color = 0;
 
-      best_label = old_label = v->annotation;
-      if (vno == Gdiag_no) printf("reclassifying vertex %d...\n", vno);
-      max_ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, v_inputs, vno, 1.0, old_label);
-      for (n = 0; n < cpn->nlabels; n++) {
-        label = cpn->labels[n];
-        ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, v_inputs, vno, 1.0, label);
-        if (vno == Gdiag_no)
-          printf("\tlabel %s (%d, %d): ll=%2.3f\n",
-                 annotation_to_name(label, NULL),
-                 label,
-                 annotation_to_index(label),
-                 ll);
-        if (ll > max_ll) {
-          max_ll = ll;
-          best_label = label;
-          if (vno == Gdiag_no) printf("\tlabel %s NEW MAX\n", annotation_to_name(label, NULL));
+        ROMP_PF_begin
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if_ROMP(shown_reproducible) reduction(+ : nchanged_color, examined_color)
+#endif
+        for (i = color_index[c]; i < color_index[c + 1]; i++) {
+          ROMP_PFLB_begin
+          int changed = gcsaGibbsRelabelVertex(gcsa, mris, indices[i], vno_priors, vno_classifiers);
+          if (changed >= 0) examined_color++;
+          if (changed > 0) nchanged_color++;
+          ROMP_PFLB_end
         }
+        ROMP_PF_end
+
+        nchanged += nchanged_color;
+        examined += examined_color;
       }
-      if (best_label != old_label) {
-        if (vno == Gdiag_no)
-          printf("v %d: label changed from %s (%d) to %s (%d)\n",
-                 vno,
-                 annotation_to_name(old_label, NULL),
-                 old_label,
-                 annotation_to_name(best_label, NULL),
-                 best_label);
-        v->marked = 1;
-        nchanged++;
-        v->annotation = best_label;
+    }
+    else {
+      MRIScomputeVertexPermutation(mris, indices);
+      for (i = 0; i < mris->nvertices; i++) {
+        c = gcsaGibbsRelabelVertex(gcsa, mris, indices[i], vno_priors, vno_classifiers);
+        if (c >= 0) examined++;
+        if (c > 0) nchanged++;
       }
     }
     printf("%03d: %6d changed, %d examined...\n", niter, nchanged, examined);
@@ -1188,10 +1366,110 @@ int GCSAreclassifyUsingGibbsPriors(GCSA *gcsa, MRI_SURFACE *mris)
     }
   } while (nchanged > MIN_CHANGED);
 
+  if (colors) free(colors);
+  if (color_index) free(color_index);
+  free(vno_priors);
+  free(vno_classifiers);
   free(indices);
   return (NO_ERROR);
 }
 
+/*
+  Gibbs relabeling of a single vertex. Returns -1 if the vertex wasn't
+  marked for examination, 1 if its label changed and 0 otherwise.
+  Only the annotations of vno's 2-ring are read and only vno is written.
+*/
+static int gcsaGibbsRelabelVertex(
+    GCSA *gcsa, MRI_SURFACE *mris, int vno, const int *vno_priors, const int *vno_classifiers)
+{
+  int n, label, best_label, old_label, vno_prior;
+  double ll, max_ll;
+  VERTEX *v;
+  CP_NODE *cpn;
+  double v_inputs[100];
+
+  v = &mris->vertices[vno];
+  if (v->marked == 0) return (-1);
+  v->marked = 0;
+
+  if (vno == Gdiag_no) DiagBreak();
+
+  load_inputs(v, v_inputs, gcsa->ninputs);
+
+  vno_prior = vno_priors[vno];
+  if (vno_prior < 0) return (0);
+  if (vno_prior == Gdiag_no) DiagBreak();
+  cpn = &gcsa->cp_nodes[vno_prior];
+  if (cpn->nlabels <= 1) return (0);
+  if (vno_classifiers[vno] == Gdiag_no) DiagBreak();
+
+  best_label = old_label = v->annotation;
+  if (vno == Gdiag_no) printf("reclassifying vertex %d...\n", vno);
+  max_ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, v_inputs, vno, 1.0, old_label, vno_priors, vno_classifiers);
+  for (n = 0; n < cpn->nlabels; n++) {
+    label = cpn->labels[n];
+    ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, v_inputs, vno, 1.0, label, vno_priors, vno_classifiers);
+    if (vno == Gdiag_no)
+      printf("\tlabel %s (%d, %d): ll=%2.3f\n",
+             annotation_to_name(label, NULL),
+             label,
+             annotation_to_index(label),
+             ll);
+    if (ll > max_ll) {
+      max_ll = ll;
+      best_label = label;
+      if (vno == Gdiag_no) printf("\tlabel %s NEW MAX\n", annotation_to_name(label, NULL));
+    }
+  }
+  if (best_label == old_label) return (0);
+
+  if (vno == Gdiag_no)
+    printf("v %d: label changed from %s (%d) to %s (%d)\n",
+           vno,
+           annotation_to_name(old_label, NULL),
+           old_label,
+           annotation_to_name(best_label, NULL),
+           best_label);
+  v->marked = 1;
+  v->annotation = best_label;
+  return (1);
+}
+
+/*
+  greedy distance-2 coloring in vertex order: no two vertices within two
+  edges of each other get the same color. Returns the number of colors.
+*/
+static int gcsaColorVertices(MRI_SURFACE *mris, int *colors)
+{
+  int vno, n, m, c, ncolors, *stamp;
+  VERTEX *v, *vn;
+
+  stamp = (int *)calloc(mris->nvertices + 1, sizeof(int));
+  if (!stamp) ErrorExit(ERROR_NOMEMORY, "gcsaColorVertices: could not allocate stamps");
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    colors[vno] = -1;
+    stamp[vno] = -1;
+  }
+  stamp[mris->nvertices] = -1;
+
+  for (ncolors = vno = 0; vno < mris->nvertices; vno++) {
+    v = &mris->vertices[vno];
+    for (n = 0; n < v->vnum; n++) {
+      vn = &mris->vertices[v->v[n]];
+      if (colors[v->v[n]] >= 0) stamp[colors[v->v[n]]] = vno;
+      for (m = 0; m < vn->vnum; m++)
+        if (colors[vn->v[m]] >= 0) stamp[colors[vn->v[m]]] = vno;
+    }
+    for (c = 0; stamp[c] == vno; c++)
+      ;
+    colors[vno] = c;
+    if (c >= ncolors) ncolors = c + 1;
+  }
+
+  free(stamp);
+  return (ncolors);
+}
+
 int MRIScomputeVertexPermutation(MRI_SURFACE *mris, int *indices)
 {
   int i, index, tmp;
@@ -1209,8 +1487,14 @@ int MRIScomputeVertexPermutation(MRI_SURFACE *mris, int *indices)
   return (NO_ERROR);
 }
 
-static double gcsaNbhdGibbsLogLikelihood(
-    GCSA *gcsa, MRI_SURFACE *mris, double *v_inputs, int vno, double gibbs_coef, int label)
+static double gcsaNbhdGibbsLogLikelihood(GCSA *gcsa,
+                                         MRI_SURFACE *mris,
+                                         double *v_inputs,
+                                         int vno,
+                                         double gibbs_coef,
+                                         int label,
+                                         const int *vno_priors,
+                                         const int *vno_classifiers)
 {
   double total_ll, ll;
   int n, old_annotation;
@@ -1220,10 +1504,10 @@ static double gcsaNbhdGibbsLogLikelihood(
   old_annotation = v->annotation;
   v->annotation = label;
 
-  total_ll = gcsaVertexGibbsLogLikelihood(gcsa, mris, v_inputs, vno, gibbs_coef);
+  total_ll = gcsaVertexGibbsLogLikelihood(gcsa, mris, v_inputs, vno, gibbs_coef, vno_priors, vno_classifiers);
 
   for (n = 0; n < v->vnum; n++) {
-    ll = gcsaVertexGibbsLogLikelihood(gcsa, mris, v_inputs, v->v[n], gibbs_coef);
+    ll = gcsaVertexGibbsLogLikelihood(gcsa, mris, v_inputs, v->v[n], gibbs_coef, vno_priors, vno_classifiers);
     total_ll += ll;
   }
 
@@ -1232,33 +1516,41 @@ static double gcsaNbhdGibbsLogLikelihood(
   return (total_ll);
 }
 
-static double gcsaVertexGibbsLogLikelihood(GCSA *gcsa, MRI_SURFACE *mris, double *v_inputs, int vno, double gibbs_coef)
+/*
+  vno_priors and vno_classifiers map surface vertices to atlas nodes
+  (see gcsaMapSourceVertices). If they are NULL the nodes are found
+  with the hash tables.
+*/
+static double gcsaVertexGibbsLogLikelihood(GCSA *gcsa,
+                                           MRI_SURFACE *mris,
+                                           double *v_inputs,
+                                           int vno,
+                                           double gibbs_coef,
+                                           const int *vno_priors,
+                                           const int *vno_classifiers)
 {
-  double ll, nbr_prior, det;
-  int nbr_label, label, i, j, np, n, nc, vno_prior, vno_classifier;
+  double ll, nbr_prior;
+  int nbr_label, label, i, j, np, n, nc, k, vno_prior, vno_classifier;
   GCSA_NODE *gcsan;
   CP_NODE *cpn;
   CP *cp;
-  GCS *gcs;
   VERTEX *v, *v_prior, *v_classifier;
-  static MATRIX *m_cov_inv = NULL;
-  static VECTOR *v_tmp = NULL, *v_x = NULL;
-
-  if (v_x && gcsa->ninputs != v_x->cols) {
-    MatrixFree(&m_cov_inv);
-    MatrixFree(&v_tmp);
-    VectorFree(&v_x);
-  }
 
   v = &mris->vertices[vno];
 
-  v_prior = GCSAsourceToPriorVertex(gcsa, v);
-  vno_prior = v_prior - gcsa->mris_priors->vertices;
+  if (vno_priors) {
+    vno_prior = vno_priors[vno];
+    vno_classifier = vno_classifiers[vno];
+    if (vno_prior < 0 || vno_classifier < 0) return (BIG_AND_NEGATIVE);
+  }
+  else {
+    v_prior = GCSAsourceToPriorVertex(gcsa, v);
+    vno_prior = v_prior - gcsa->mris_priors->vertices;
+    v_classifier = GCSAsourceToClassifierVertex(gcsa, v_prior);
+    vno_classifier = v_classifier - gcsa->mris_classifiers->vertices;
+  }
   if (vno_prior == Gdiag_no) DiagBreak();
   cpn = &gcsa->cp_nodes[vno_prior];
-
-  v_classifier = GCSAsourceToClassifierVertex(gcsa, v_prior);
-  vno_classifier = v_classifier - gcsa->mris_classifiers->vertices;
   if (vno_classifier == Gdiag_no) DiagBreak();
   gcsan = &gcsa->gc_nodes[vno_classifier];
 
@@ -1276,18 +1568,12 @@ static double gcsaVertexGibbsLogLikelihood(GCSA *gcsa, MRI_SURFACE *mris, double
   if (nc >= gcsan->nlabels) /* never occured here */
     return (BIG_AND_NEGATIVE);
 
-  gcs = &gcsan->gcs[nc];
   cp = &cpn->cps[np];
 
   /* compute Mahalanobis distance */
-  v_x = VectorCopy(gcs->v_means, v_x);
-  for (i = 0; i < gcsa->ninputs; i++) VECTOR_ELT(v_x, i + 1) -= v_inputs[i];
-  m_cov_inv = MatrixInverse(gcs->m_cov, m_cov_inv);
-  if (!m_cov_inv) ErrorExit(ERROR_BADPARM, "GCSAvertexLogLikelihood: could not invert matrix");
-
-  det = MatrixDeterminant(gcs->m_cov);
-  v_tmp = MatrixMultiply(m_cov_inv, v_x, v_tmp);
-  ll = -0.5 * VectorDot(v_x, v_tmp) - 0.5 * log(det);
+  k = gcsa->gcs_index[vno_classifier] + nc;
+  if (gcsa->gcs_singular[k]) ErrorExit(ERROR_BADPARM, "GCSAvertexLogLikelihood: could not invert matrix");
+  ll = -0.5 * gcsaFlatMahalanobis(gcsa, k, v_inputs) - 0.5 * log(gcsa->gcs_det[k]);
 
   nbr_prior = 0.0;
   for (n = 0; n < v->vnum; n++) {
@@ -1343,6 +1629,7 @@ int GCSAreclassifyLabel(GCSA *gcsa, MRI_SURFACE *mris, LABEL *area)
   VERTEX *v, *vn;
   double v_inputs[100];
 
+  gcsaEnsureFlatClassifiers(gcsa);
   total = 0;
   annotation = mris->vertices[area->lv[0].vno].annotation;
   do {
@@ -1362,7 +1649,7 @@ int GCSAreclassifyLabel(GCSA *gcsa, MRI_SURFACE *mris, LABEL *area)
         vn = &mris->vertices[v->v[n]];
         if (vn->annotation == annotation) continue;
         ;
-        ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, v_inputs, vno, 1.0, vn->annotation);
+        ll = gcsaNbhdGibbsLogLikelihood(gcsa, mris, v_inputs, vno, 1.0, vn->annotation, NULL, NULL);
 
         // if likelihood increased, or annotation is still at its
         // initial (v->annotation) value
@@ -1918,6 +2205,8 @@ int GCSAsetCovariancesToIdentity(GCSA *gcsa)
   GCS *gcs;
   int i, n;
 
+  gcsaFreeFlatClassifiers(gcsa);
+
   for (i = 0; i < gcsa->mris_classifiers->nvertices; i++) {
     if (i == Gdiag_no) DiagBreak();
     gcsan = &gcsa->gc_nodes[i];
@@ -1939,6 +2228,7 @@ int gcsaFixSingularCovarianceMatrices(GCSA *gcsa)
   double det, vars[1000], min_det;
   MATRIX *m_cov_inv, *m_cov = NULL;
 
+  gcsaFreeFlatClassifiers(gcsa);
   nparams = (gcsa->ninputs * (gcsa->ninputs + 1)) / 2 + gcsa->ninputs;
   /* covariance matrix and means */
 
@@ -2028,11 +2318,11 @@ int GCSArelabelWithAseg(GCSA *gcsa, MRI_SURFACE *mris, MRI *mri_aseg)
 {
   int old_index, vno, vno_classifier, vno_prior, label, index, changed, cc_annotation;
   VERTEX *v, *v_classifier, *v_prior;
-  GCSA_NODE *gcsan;
   CP_NODE *cpn;
   double v_inputs[100], p;
   double x, y, z;
 
+  gcsaEnsureFlatClassifiers(gcsa);
   for (changed = vno = 0; vno < mris->nvertices; vno++) {
     v = &mris->vertices[vno];
     if (v->ripflag) continue;
@@ -2047,7 +2337,6 @@ int GCSArelabelWithAseg(GCSA *gcsa, MRI_SURFACE *mris, MRI *mri_aseg)
     v_classifier = GCSAsourceToClassifierVertex(gcsa, v_prior);
     vno_classifier = v_classifier - gcsa->mris_classifiers->vertices;
     if (vno_classifier == Gdiag_no) DiagBreak();
-    gcsan = &gcsa->gc_nodes[vno_classifier];
 
     CTABfindAnnotation(mris->ct, v->annotation, &old_index);
 
@@ -2071,7 +2360,7 @@ int GCSArelabelWithAseg(GCSA *gcsa, MRI_SURFACE *mris, MRI *mri_aseg)
     else if (old_index >= 0 && mris->ct && !stricmp(mris->ct->entries[old_index]->name, "corpuscallosum")) {
       // find 2nd most likely label that isn't callosum
       CTABannotationAtIndex(mris->ct, old_index, &cc_annotation);
-      label = GCSANclassify(gcsan, cpn, v_inputs, gcsa->ninputs, &p, &cc_annotation, 1);
+      label = GCSANclassify(gcsa, vno_classifier, cpn, v_inputs, &p, &cc_annotation, 1);
       if (label != v->annotation) {
         changed++;
         v->annotation = label;
@@ -2085,10 +2374,10 @@ int GCSAreclassifyMarked(GCSA *gcsa, MRI_SURFACE *mris, int mark, int *exclude_l
 {
   int old_index, vno, vno_classifier, vno_prior, label, index, changed, num, n;
   VERTEX *v, *v_classifier, *v_prior, *vn;
-  GCSA_NODE *gcsan;
   CP_NODE *cpn;
   double v_inputs[100], p;
 
+  gcsaEnsureFlatClassifiers(gcsa);
   for (changed = vno = 0; vno < mris->nvertices; vno++) {
     v = &mris->vertices[vno];
     if (v->ripflag || v->marked != mark) continue;
@@ -2101,12 +2390,11 @@ int GCSAreclassifyMarked(GCSA *gcsa, MRI_SURFACE *mris, int mark, int *exclude_l
     v_classifier = GCSAsourceToClassifierVertex(gcsa, v_prior);
     vno_classifier = v_classifier - gcsa->mris_classifiers->vertices;
     if (vno_classifier == Gdiag_no) DiagBreak();
-    gcsan = &gcsa->gc_nodes[vno_classifier];
 
     CTABfindAnnotation(mris->ct, v->annotation, &old_index);
 
     cpn = &gcsa->cp_nodes[vno_prior];
-    label = GCSANclassify(gcsan, cpn, v_inputs, gcsa->ninputs, &p, exclude_list, nexcluded);
+    label = GCSANclassify(gcsa, vno_classifier, cpn, v_inputs, &p, exclude_list, nexcluded);
     if (label >= 0 && label != v->annotation) {
       changed++;
       v->annotation = label;
@@ -52,13 +52,16 @@ static int update_vertex_indices(LABEL *area);
 ;
 static LABEL_VERTEX *labelFindVertexNumber(LABEL *area, int vno);
 static Transform *labelLoadTransform(const char *subject_name, const char *sdir, General_transform *transform);
+static LABEL *labelReadBinaryBlock(FILE *fp, const char *subject_name);
+static int labelWriteBinaryBlock(LABEL *area, FILE *fp);
+static int labelSetSubject(LABEL *area, const char *subject_name);
 #define MAX_VERTICES 500000
 /*-----------------------------------------------------
 ------------------------------------------------------*/
 LABEL *LabelReadFrom(const char *subject_name, FILE *fp)
 {
   LABEL *area;
-  char line[STRLEN], subjects_dir[STRLEN], *cp, *str;
+  char line[STRLEN], *cp, *str;
   int vno, nlines;
   float x, y, z, stat;
 
@@ -106,20 +109,30 @@ LABEL *LabelReadFrom(const char *subject_name, FILE *fp)
   }
 
   if (!nlines) ErrorReturn(NULL, (ERROR_BADFILE, "%s: no data in label file", Progname));
-  if (subject_name) {
-    cp = getenv("SUBJECTS_DIR");
-    if (!cp)
-      ErrorExit(ERROR_BADPARM,
-                "%s: no subject's directory specified in environment "
-                "(SUBJECTS_DIR)",
-                Progname);
-    strncpy(subjects_dir, cp, STRLEN - 1);
-    strncpy(area->subject_name, subject_name, STRLEN - 1);
-    area->linear_transform = labelLoadTransform(subject_name, subjects_dir, &area->transform);
-    area->inverse_linear_transform = get_inverse_linear_transform_ptr(&area->transform);
-  }
+  labelSetSubject(area, subject_name);
   return (area);
 }
+/*-----------------------------------------------------
+  Attach the subject name and talairach transform to a label
+  that was just read. Does nothing if subject_name is NULL.
+------------------------------------------------------*/
+static int labelSetSubject(LABEL *area, const char *subject_name)
+{
+  char *cp, subjects_dir[STRLEN];
+
+  if (subject_name == NULL) return (NO_ERROR);
+  cp = getenv("SUBJECTS_DIR");
+  if (!cp)
+    ErrorExit(ERROR_BADPARM,
+              "%s: no subject's directory specified in environment "
+              "(SUBJECTS_DIR)",
+              Progname);
+  strncpy(subjects_dir, cp, STRLEN - 1);
+  strncpy(area->subject_name, subject_name, STRLEN - 1);
+  area->linear_transform = labelLoadTransform(subject_name, subjects_dir, &area->transform);
+  area->inverse_linear_transform = get_inverse_linear_transform_ptr(&area->transform);
+  return (NO_ERROR);
+}
 
 LABEL *LabelRead(const char *subject_name, const char *label_name)
 {
@@ -127,6 +140,7 @@ LABEL *LabelRead(const char *subject_name, const char *label_name)
   char fname[STRLEN], *cp, subjects_dir[STRLEN], lname[STRLEN];
   char label_name0[STRLEN];
   FILE *fp;
+  int binary = 0, magic;
 
   sprintf(label_name0, "%s", label_name);  // keep a copy
 
@@ -141,7 +155,11 @@ LABEL *LabelRead(const char *subject_name, const char *label_name)
                 Progname);
     strcpy(subjects_dir, cp);
     strcpy(lname, label_name);
-    cp = strstr(lname, ".label");
+    cp = strrchr(lname, '.');
+    if (cp && stricmp(cp, LABEL_BINARY_EXT) == 0)
+      binary = 1;
+    else
+      cp = strstr(lname, ".label");
     if (cp) *cp = 0;
 
     cp = strrchr(lname, '/');
@@ -150,7 +168,7 @@ LABEL *LabelRead(const char *subject_name, const char *label_name)
     else
       label_name = lname;
 
-    sprintf(fname, "%s/%s/label/%s.label", subjects_dir, subject_name, label_name);
+    sprintf(fname, "%s/%s/label/%s%s", subjects_dir, subject_name, label_name, binary ? LABEL_BINARY_EXT : ".label");
   }
   else {
     strcpy(fname, label_name);
@@ -161,7 +179,7 @@ LABEL *LabelRead(const char *subject_name, const char *label_name)
       strcpy(subjects_dir, cp);
     strcpy(lname, label_name);
     cp = strstr(lname, ".label");
-    if (cp == NULL)
+    if (cp == NULL && !LabelIsBinaryFile(lname))
       sprintf(fname, "%s.label", lname);
     else
       strcpy(fname, label_name);
@@ -179,6 +197,13 @@ LABEL *LabelRead(const char *subject_name, const char *label_name)
 
   if (!fp) ErrorReturn(NULL, (ERROR_NOFILE, "%s: could not open label file %s", Progname, fname));
 
+  // binary labels and containers are recognized by content, not name
+  if (freadIntArray(&magic, 1, fp) == 1 && magic == LABEL_BINARY_MAGIC) {
+    fclose(fp);
+    return (LabelReadMultiByName(fname, NULL, subject_name));
+  }
+  rewind(fp);
+
   area = LabelReadFrom(subject_name, fp);
   if (area)
     strcpy(area->name, fname);
@@ -578,11 +603,15 @@ int LabelWrite(LABEL *area, const char *label_name)
 {
   char fname[STRLEN], *cp, subjects_dir[STRLEN], lname[STRLEN];
   FILE *fp;
-  int ret;
+  int ret, binary = 0;
 
   strcpy(lname, label_name);
   cp = strrchr(lname, '.');
-  if (cp && stricmp(cp, ".label") == 0) {
+  if (cp && stricmp(cp, LABEL_BINARY_EXT) == 0) {
+    *cp = 0;
+    binary = 1;
+  }
+  else if (cp && stricmp(cp, ".label") == 0) {
     *cp = 0;
   }
   label_name = lname;
@@ -595,7 +624,7 @@ int LabelWrite(LABEL *area, const char *label_name)
                 "(SUBJECTS_DIR)",
                 Progname);
     strcpy(subjects_dir, cp);
-    sprintf(fname, "%s/%s/label/%s.label", subjects_dir, area->subject_name, label_name);
+    sprintf(fname, "%s/%s/label/%s%s", subjects_dir, area->subject_name, label_name, binary ? LABEL_BINARY_EXT : ".label");
   }
   else {
     cp = strrchr(lname, '.');
@@ -603,9 +632,10 @@ int LabelWrite(LABEL *area, const char *label_name)
       strcpy(fname, label_name);
     }
     else {
-      sprintf(fname, "%s.label", label_name);
+      sprintf(fname, "%s%s", label_name, binary ? LABEL_BINARY_EXT : ".label");
     }
   }
+  if (binary) return (LabelWriteMulti(&area, 1, fname));
 
   fp = fopen(fname, "w");
   if (!fp) ErrorReturn(ERROR_NOFILE, (ERROR_NO_FILE, "%s: could not open label file %s", Progname, fname));
@@ -614,6 +644,335 @@ int LabelWrite(LABEL *area, const char *label_name)
   fclose(fp);
   return (ret);
 }
+/*-----------------------------------------------------
+  Binary label container.
+
+  A .blabel file holds one or more labels. All values are big-endian,
+  like the other binary surface files:
+
+    int   LABEL_BINARY_MAGIC
+    int   LABEL_BINARY_VERSION
+    int   nlabels
+    index, nlabels entries of:
+      int        name length, followed by the name (no terminator)
+      int        number of points
+      long long  byte offset of the label block
+    label blocks, each:
+      int   coords (LABEL_COORDS_*)
+      int   space length, space string
+      int   subject length, subject string
+      int   npoints
+      int   vno[npoints]
+      float x[npoints], y[npoints], z[npoints], stat[npoints]
+
+  The point data are stored column-wise so each column is one bulk
+  read. Coordinates and stats are written at full float precision, so
+  ASCII -> binary -> ASCII reproduces the ASCII file. Deleted points
+  are skipped, as in LabelWriteInto().
+------------------------------------------------------*/
+int LabelIsBinaryFile(const char *fname)
+{
+  FILE *fp;
+  int magic;
+
+  fp = fopen(fname, "r");
+  if (fp == NULL) return (0);
+  if (freadIntArray(&magic, 1, fp) != 1) magic = 0;
+  fclose(fp);
+  return (magic == LABEL_BINARY_MAGIC);
+}
+
+static int labelWriteString(const char *str, FILE *fp)
+{
+  int len = strlen(str);
+  fwriteInt(len, fp);
+  if (len > 0 && (int)fwrite(str, 1, len, fp) != len) return (ERROR_BADFILE);
+  return (NO_ERROR);
+}
+
+static int labelReadString(char *str, int maxlen, FILE *fp)
+{
+  int len;
+
+  if (freadIntArray(&len, 1, fp) != 1 || len < 0 || len >= maxlen) return (ERROR_BADFILE);
+  if (len > 0 && (int)fread(str, 1, len, fp) != len) return (ERROR_BADFILE);
+  str[len] = 0;
+  return (NO_ERROR);
+}
+
+/* key under which a label is indexed in a container: its file
+   name without directory and .label/.blabel extension */
+static void labelIndexName(LABEL *area, int n, char *name)
+{
+  char *cp;
+
+  if (strlen(area->name) == 0) {
+    sprintf(name, "label%d", n);
+    return;
+  }
+  cp = strrchr(area->name, '/');
+  strcpy(name, cp ? cp + 1 : area->name);
+  cp = strrchr(name, '.');
+  if (cp && (stricmp(cp, ".label") == 0 || stricmp(cp, LABEL_BINARY_EXT) == 0)) *cp = 0;
+}
+
+static int labelWriteBinaryBlock(LABEL *area, FILE *fp)
+{
+  int n, num, *ibuf;
+  float *fbuf;
+
+  for (num = n = 0; n < area->n_points; n++)
+    if (!area->lv[n].deleted) num++;
+
+  fwriteInt(area->coords, fp);
+  labelWriteString(area->space, fp);
+  labelWriteString(area->subject_name, fp);
+  fwriteInt(num, fp);
+  if (num == 0) return (NO_ERROR);
+
+  ibuf = (int *)calloc(num, sizeof(int));
+  fbuf = (float *)calloc(num, sizeof(float));
+  if (!ibuf || !fbuf) ErrorExit(ERROR_NOMEMORY, "%s: could not allocate %d-point label buffer", Progname, num);
+
+#define LABEL_WRITE_COLUMN(buf, field, fwritefn)                   \
+  {                                                                \
+    int k = 0;                                                     \
+    for (n = 0; n < area->n_points; n++)                           \
+      if (!area->lv[n].deleted) buf[k++] = area->lv[n].field;      \
+    if (fwritefn(buf, num, fp) != num) {                           \
+      free(ibuf);                                                  \
+      free(fbuf);                                                  \
+      return (ERROR_BADFILE);                                      \
+    }                                                              \
+  }
+  LABEL_WRITE_COLUMN(ibuf, vno, fwriteIntArray)
+  LABEL_WRITE_COLUMN(fbuf, x, fwriteFloatArray)
+  LABEL_WRITE_COLUMN(fbuf, y, fwriteFloatArray)
+  LABEL_WRITE_COLUMN(fbuf, z, fwriteFloatArray)
+  LABEL_WRITE_COLUMN(fbuf, stat, fwriteFloatArray)
+#undef LABEL_WRITE_COLUMN
+
+  free(ibuf);
+  free(fbuf);
+  return (NO_ERROR);
+}
+
+/*-----------------------------------------------------
+  Write nlabels labels into a single binary container. A single
+  label written with LabelWrite(area, "x.blabel") is a container
+  with one entry.
+------------------------------------------------------*/
+int LabelWriteMulti(LABEL **labels, int nlabels, const char *fname)
+{
+  FILE *fp;
+  int n, num, k;
+  long *offset_pos;
+  long long offset;
+  char name[STRLEN];
+
+  fp = fopen(fname, "w");
+  if (!fp) ErrorReturn(ERROR_NOFILE, (ERROR_NOFILE, "%s: could not open label file %s", Progname, fname));
+
+  offset_pos = (long *)calloc(nlabels > 0 ? nlabels : 1, sizeof(long));
+  fwriteInt(LABEL_BINARY_MAGIC, fp);
+  fwriteInt(LABEL_BINARY_VERSION, fp);
+  fwriteInt(nlabels, fp);
+
+  // index, with the block offsets patched in once they are known
+  for (n = 0; n < nlabels; n++) {
+    labelIndexName(labels[n], n, name);
+    labelWriteString(name, fp);
+    for (num = k = 0; k < labels[n]->n_points; k++)
+      if (!labels[n]->lv[k].deleted) num++;
+    fwriteInt(num, fp);
+    offset_pos[n] = ftell(fp);
+    fwriteLong(0, fp);
+  }
+
+  for (n = 0; n < nlabels; n++) {
+    offset = ftell(fp);
+    if (labelWriteBinaryBlock(labels[n], fp) != NO_ERROR) {
+      printf("ERROR: writing label %d to %s\n", n, fname);
+      free(offset_pos);
+      fclose(fp);
+      return (ERROR_BADFILE);
+    }
+    fseek(fp, offset_pos[n], SEEK_SET);
+    fwriteLong(offset, fp);
+    fseek(fp, 0, SEEK_END);
+  }
+
+  free(offset_pos);
+  if (fclose(fp) != 0) ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "%s: error writing %s", Progname, fname));
+  return (NO_ERROR);
+}
+
+static LABEL *labelReadBinaryBlock(FILE *fp, const char *subject_name)
+{
+  LABEL *area;
+  int n, npoints, *ibuf;
+  float *fbuf;
+
+  area = (LABEL *)calloc(1, sizeof(LABEL));
+  if (!area) ErrorExit(ERROR_NOMEMORY, "%s: could not allocate LABEL struct.", Progname);
+
+  if (freadIntArray(&area->coords, 1, fp) != 1 || labelReadString(area->space, sizeof(area->space), fp) != NO_ERROR ||
+      labelReadString(area->subject_name, STRLEN, fp) != NO_ERROR || freadIntArray(&npoints, 1, fp) != 1 ||
+      npoints < 0) {
+    free(area);
+    ErrorReturn(NULL, (ERROR_BADFILE, "%s: could not read binary label header", Progname));
+  }
+
+  area->n_points = area->max_points = npoints;
+  area->lv = (LABEL_VERTEX *)calloc(npoints > 0 ? npoints : 1, sizeof(LABEL_VERTEX));
+  ibuf = (int *)calloc(npoints > 0 ? npoints : 1, sizeof(int));
+  fbuf = (float *)calloc(npoints > 0 ? npoints : 1, sizeof(float));
+  if (!area->lv || !ibuf || !fbuf)
+    ErrorExit(ERROR_NOMEMORY, "%s: could not allocate %d-point binary label", Progname, npoints);
+
+#define LABEL_READ_COLUMN(buf, field, freadfn)                                                     \
+  if (freadfn(buf, npoints, fp) != npoints) {                                                      \
+    free(ibuf);                                                                                    \
+    free(fbuf);                                                                                    \
+    LabelFree(&area);                                                                              \
+    ErrorReturn(NULL, (ERROR_BADFILE, "%s: truncated binary label (%d points)", Progname, npoints)); \
+  }                                                                                                \
+  for (n = 0; n < npoints; n++) area->lv[n].field = buf[n];
+  LABEL_READ_COLUMN(ibuf, vno, freadIntArray)
+  LABEL_READ_COLUMN(fbuf, x, freadFloatArray)
+  LABEL_READ_COLUMN(fbuf, y, freadFloatArray)
+  LABEL_READ_COLUMN(fbuf, z, freadFloatArray)
+  LABEL_READ_COLUMN(fbuf, stat, freadFloatArray)
+#undef LABEL_READ_COLUMN
+
+  free(ibuf);
+  free(fbuf);
+  labelSetSubject(area, subject_name);
+  return (area);
+}
+
+/* reads the container header and index. Returns the open file
+   positioned after the index, or NULL. Caller frees names/offsets. */
+static FILE *labelReadBinaryIndex(const char *fname, int *pnlabels, char ***pnames, long long **poffsets)
+{
+  FILE *fp;
+  int magic, version, nlabels, n, npoints;
+  char name[STRLEN], **names;
+  long long *offsets;
+
+  fp = fopen(fname, "r");
+  if (!fp) ErrorReturn(NULL, (ERROR_NOFILE, "%s: could not open label file %s", Progname, fname));
+  if (freadIntArray(&magic, 1, fp) != 1 || magic != LABEL_BINARY_MAGIC) {
+    fclose(fp);
+    ErrorReturn(NULL, (ERROR_BADFILE, "%s: %s is not a binary label file", Progname, fname));
+  }
+  version = freadInt(fp);
+  if (version != LABEL_BINARY_VERSION) {
+    fclose(fp);
+    ErrorReturn(NULL, (ERROR_BADFILE, "%s: %s has unsupported binary label version %d", Progname, fname, version));
+  }
+  if (freadIntArray(&nlabels, 1, fp) != 1 || nlabels < 0) {
+    fclose(fp);
+    ErrorReturn(NULL, (ERROR_BADFILE, "%s: could not read label count from %s", Progname, fname));
+  }
+
+  names = (char **)calloc(nlabels > 0 ? nlabels : 1, sizeof(char *));
+  offsets = (long long *)calloc(nlabels > 0 ? nlabels : 1, sizeof(long long));
+  for (n = 0; n < nlabels; n++) {
+    if (labelReadString(name, STRLEN, fp) != NO_ERROR || freadIntArray(&npoints, 1, fp) != 1) {
+      for (n--; n >= 0; n--) free(names[n]);
+      free(names);
+      free(offsets);
+      fclose(fp);
+      ErrorReturn(NULL, (ERROR_BADFILE, "%s: could not read label index of %s", Progname, fname));
+    }
+    names[n] = strcpyalloc(name);
+    offsets[n] = freadLong(fp);
+  }
+
+  *pnlabels = nlabels;
+  *pnames = names;
+  *poffsets = offsets;
+  return (fp);
+}
+
+/*-----------------------------------------------------
+  Read every label in a binary container. Returns an array of
+  *pnlabels labels (free each with LabelFree and the array with
+  free), or NULL on error. Each label's name is its index key.
+------------------------------------------------------*/
+LABEL **LabelReadMulti(const char *fname, int *pnlabels, const char *subject_name)
+{
+  FILE *fp;
+  int nlabels, n;
+  char **names;
+  long long *offsets;
+  LABEL **labels;
+
+  fp = labelReadBinaryIndex(fname, &nlabels, &names, &offsets);
+  if (fp == NULL) return (NULL);
+
+  labels = (LABEL **)calloc(nlabels > 0 ? nlabels : 1, sizeof(LABEL *));
+  for (n = 0; n < nlabels; n++) {
+    fseek(fp, offsets[n], SEEK_SET);
+    labels[n] = labelReadBinaryBlock(fp, subject_name);
+    if (labels[n] == NULL) {
+      for (n--; n >= 0; n--) LabelFree(&labels[n]);
+      free(labels);
+      labels = NULL;
+      break;
+    }
+    strcpy(labels[n]->name, names[n]);
+  }
+
+  for (n = 0; n < nlabels; n++) free(names[n]);
+  free(names);
+  free(offsets);
+  fclose(fp);
+  if (labels) *pnlabels = nlabels;
+  return (labels);
+}
+
+/*-----------------------------------------------------
+  Read one label out of a binary container by its index key,
+  seeking straight to its block. With label_name == NULL the first
+  label is returned and named after the file, which is how
+  LabelRead() handles single-label .blabel files.
+------------------------------------------------------*/
+LABEL *LabelReadMultiByName(const char *fname, const char *label_name, const char *subject_name)
+{
+  FILE *fp;
+  int nlabels, n, which = -1;
+  char **names;
+  long long *offsets;
+  LABEL *area = NULL;
+
+  fp = labelReadBinaryIndex(fname, &nlabels, &names, &offsets);
+  if (fp == NULL) return (NULL);
+
+  if (label_name == NULL)
+    which = nlabels > 0 ? 0 : -1;
+  else
+    for (n = 0; n < nlabels; n++)
+      if (strcmp(names[n], label_name) == 0) {
+        which = n;
+        break;
+      }
+
+  if (which < 0)
+    ErrorPrintf(ERROR_BADPARM, "%s: label %s not found in %s", Progname, label_name ? label_name : "", fname);
+  else {
+    fseek(fp, offsets[which], SEEK_SET);
+    area = labelReadBinaryBlock(fp, subject_name);
+    if (area) strcpy(area->name, label_name ? names[which] : fname);
+  }
+
+  for (n = 0; n < nlabels; n++) free(names[n]);
+  free(names);
+  free(offsets);
+  fclose(fp);
+  return (area);
+}
 /*-----------------------------------------------------
         Parameters:
 
@@ -15127,15 +15127,287 @@ char *MRIsliceDirectionName(MRI *mri)
   return (rtstr);
 }
 
+#define EDT_INF 1e20f
+
+/*-------------------------------------------------------------------
+  mriSquaredEDT1d() - one dimensional squared distance transform of
+  the sampled function f (n samples spaced h apart), computed as the
+  lower envelope of the parabolas rooted at each sample (Felzenszwalb
+  and Huttenlocher). Samples >= EDT_INF are not seeds. v and zb are
+  scratch of length n and n+1. src[q] is set to the sample whose
+  parabola gives d[q], or -1 if there are no seeds.
+  -------------------------------------------------------------------*/
+static void mriSquaredEDT1d(const float *f, float *d, int n, float h, int *v, double *zb, int *src)
+{
+  int q, k = -1;
+  double s, h2 = (double)h * h;
+
+  for (q = 0; q < n; q++) {
+    if (f[q] >= EDT_INF) continue;
+    if (k < 0) {
+      k = 0;
+      v[0] = q;
+      zb[0] = -EDT_INF;
+      zb[1] = EDT_INF;
+      continue;
+    }
+    // intersection of the parabola at q with the rightmost one in the envelope
+    s = ((f[q] / h2 + (double)q * q) - (f[v[k]] / h2 + (double)v[k] * v[k])) / (2.0 * (q - v[k]));
+    while (s <= zb[k]) {
+      k--;
+      s = ((f[q] / h2 + (double)q * q) - (f[v[k]] / h2 + (double)v[k] * v[k])) / (2.0 * (q - v[k]));
+    }
+    k++;
+    v[k] = q;
+    zb[k] = s;
+    zb[k + 1] = EDT_INF;
+  }
+
+  if (k < 0) {
+    for (q = 0; q < n; q++) {
+      d[q] = EDT_INF;
+      src[q] = -1;
+    }
+    return;
+  }
+  for (k = 0, q = 0; q < n; q++) {
+    while (zb[k + 1] < q) k++;
+    d[q] = (float)(h2 * (q - v[k]) * (q - v[k]) + f[v[k]]);
+    src[q] = v[k];
+  }
+}
+
+/*-------------------------------------------------------------------
+  mriSquaredEDT() - fills the float volume mri_sq with the squared
+  distance in mm from each voxel center to the nearest seed voxel
+  center. Seeds are voxels that are label if seed_is_label is set
+  and voxels that are not label otherwise. The transform is separable,
+  so it is done as 1D passes along x, y and z, each parallel over the
+  rows it touches. Frames 0, 1 and 2 of the short volume mri_src_idx
+  get the seed column, row and slice chosen by the x, y and z passes,
+  from which mriNearestSeed() recovers the nearest seed of a voxel.
+  -------------------------------------------------------------------*/
+static void mriSquaredEDT(MRI *mri_src, int label, int seed_is_label, MRI *mri_sq, MRI *mri_src_idx)
+{
+  const int width = mri_src->width, height = mri_src->height, depth = mri_src->depth;
+  const int nmax = MAX(MAX(width, height), depth);
+  int z, y;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+  for (z = 0; z < depth; z++) {
+    ROMP_PFLB_begin
+
+    float *f = (float *)calloc(nmax, sizeof(float));
+    int *v = (int *)calloc(nmax, sizeof(int));
+    int *src = (int *)calloc(nmax, sizeof(int));
+    double *zb = (double *)calloc(nmax + 1, sizeof(double));
+    int x, y, is_label;
+
+    // pass 1: along x, straight from the label volume
+    for (y = 0; y < height; y++) {
+      for (x = 0; x < width; x++) {
+        is_label = (nint(MRIgetVoxVal(mri_src, x, y, z, 0)) == label);
+        f[x] = (is_label == seed_is_label) ? 0 : EDT_INF;
+      }
+      mriSquaredEDT1d(f, &MRIFvox(mri_sq, 0, y, z), width, mri_src->xsize, v, zb, src);
+      for (x = 0; x < width; x++) MRISseq_vox(mri_src_idx, x, y, z, 0) = src[x];
+    }
+
+    // pass 2: along y within this slice
+    {
+      float *d = (float *)calloc(nmax, sizeof(float));
+      for (x = 0; x < width; x++) {
+        for (y = 0; y < height; y++) f[y] = MRIFvox(mri_sq, x, y, z);
+        mriSquaredEDT1d(f, d, height, mri_src->ysize, v, zb, src);
+        for (y = 0; y < height; y++) {
+          MRIFvox(mri_sq, x, y, z) = d[y];
+          MRISseq_vox(mri_src_idx, x, y, z, 1) = src[y];
+        }
+      }
+      free(d);
+    }
+    free(f);
+    free(v);
+    free(src);
+    free(zb);
+
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  // pass 3: along z, parallel over rows
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+  for (y = 0; y < height; y++) {
+    ROMP_PFLB_begin
+
+    float *f = (float *)calloc(nmax, sizeof(float));
+    float *d = (float *)calloc(nmax, sizeof(float));
+    int *v = (int *)calloc(nmax, sizeof(int));
+    int *src = (int *)calloc(nmax, sizeof(int));
+    double *zb = (double *)calloc(nmax + 1, sizeof(double));
+    int x, z;
+
+    for (x = 0; x < width; x++) {
+      for (z = 0; z < depth; z++) f[z] = MRIFvox(mri_sq, x, y, z);
+      mriSquaredEDT1d(f, d, depth, mri_src->zsize, v, zb, src);
+      for (z = 0; z < depth; z++) {
+        MRIFvox(mri_sq, x, y, z) = d[z];
+        MRISseq_vox(mri_src_idx, x, y, z, 2) = src[z];
+      }
+    }
+    free(f);
+    free(d);
+    free(v);
+    free(src);
+    free(zb);
+
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+/*-------------------------------------------------------------------
+  mriSeedFaceHalf() - half the voxel size along the axis of the face
+  through which the segment from voxel (x,y,z) to its nearest seed
+  center enters the seed voxel, i.e. the axis on which the offset is
+  largest relative to the voxel size. The seed is traced back through
+  the z, y and x pass indices left in mri_src_idx by mriSquaredEDT().
+  -------------------------------------------------------------------*/
+static float mriSeedFaceHalf(MRI *mri_src, MRI *mri_src_idx, int x, int y, int z)
+{
+  int sx, sy, sz;
+  float ax, ay, az;
+
+  sz = MRISseq_vox(mri_src_idx, x, y, z, 2);
+  sy = MRISseq_vox(mri_src_idx, x, y, sz, 1);
+  sx = MRISseq_vox(mri_src_idx, x, sy, sz, 0);
+  ax = fabs((float)(x - sx));
+  ay = fabs((float)(y - sy));
+  az = fabs((float)(z - sz));
+  if (ax >= ay && ax >= az) return (0.5f * mri_src->xsize);
+  if (ay >= az) return (0.5f * mri_src->ysize);
+  return (0.5f * mri_src->zsize);
+}
+
+/*-------------------------------------------------------------------
+  mriExactDistanceToSeeds() - writes the distance in mm from each
+  non-seed voxel to the boundary with the seed voxels into mri_dist,
+  as the distance to the nearest seed center less half the voxel size
+  along the axis of the face crossed, clamped at cap. Seed voxels are
+  left untouched. The distance is negated if negate is set.
+  -------------------------------------------------------------------*/
+static void mriExactDistanceToSeeds(MRI *mri_src, MRI *mri_dist, int label, int seed_is_label, float cap, int negate)
+{
+  const int width = mri_src->width, height = mri_src->height, depth = mri_src->depth;
+  MRI *mri_sq, *mri_src_idx;
+  int z;
+
+  mri_sq = MRIalloc(width, height, depth, MRI_FLOAT);
+  mri_src_idx = MRIallocSequence(width, height, depth, MRI_SHORT, 3);
+  mriSquaredEDT(mri_src, label, seed_is_label, mri_sq, mri_src_idx);
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+  for (z = 0; z < depth; z++) {
+    ROMP_PFLB_begin
+
+    int x, y, is_label;
+    float sq, dist;
+
+    for (y = 0; y < height; y++)
+      for (x = 0; x < width; x++) {
+        is_label = (nint(MRIgetVoxVal(mri_src, x, y, z, 0)) == label);
+        if (is_label == seed_is_label) continue;
+        sq = MRIFvox(mri_sq, x, y, z);
+        if (sq >= EDT_INF)
+          dist = cap;
+        else
+          dist = MIN(sqrt(sq) - mriSeedFaceHalf(mri_src, mri_src_idx, x, y, z), cap);
+        MRIsetVoxVal(mri_dist, x, y, z, 0, negate ? -dist : dist);
+      }
+
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  MRIfree(&mri_sq);
+  MRIfree(&mri_src_idx);
+}
+
+/*-------------------------------------------------------------------
+  MRIexactDistanceTransform() - exact Euclidean distance transform of
+  the voxels labeled label, in mm and honoring anisotropic voxel sizes.
+  Distances are measured to the boundary between label and non-label
+  voxels, i.e. to the nearest voxel center of the other class less half
+  the voxel size along the axis of the face crossed, so that voxels on
+  either side of a face are at +/-0.5 voxel as with
+  MRIextractDistanceMap().
+  mode is one of the DTRANS_MODE_ values:
+    SIGNED   - negative inside, positive outside
+    UNSIGNED - positive inside and outside
+    OUTSIDE  - positive outside, 0 inside
+    INSIDE   - positive inside, 0 outside
+  Distances are clamped at max_dist voxels (max_dist*xsize mm); with
+  max_dist <= 0 they are clamped at twice the largest dimension.
+  outside_val is set to max_dist as passed, as MRIdistanceTransform()
+  has always done.
+  Runs in time linear in the number of voxels regardless of max_dist.
+  -------------------------------------------------------------------*/
+MRI *MRIexactDistanceTransform(MRI *mri_src, MRI *mri_dist, int label, float max_dist, int mode)
+{
+  const int width = mri_src->width, height = mri_src->height, depth = mri_src->depth;
+  float cap;
+
+  if (mode != DTRANS_MODE_SIGNED && mode != DTRANS_MODE_UNSIGNED && mode != DTRANS_MODE_OUTSIDE &&
+      mode != DTRANS_MODE_INSIDE)
+    ErrorReturn(NULL, (ERROR_BADPARM, "MRIexactDistanceTransform: unknown mode %d", mode));
+
+  if (mri_dist == NULL) {
+    mri_dist = MRIalloc(width, height, depth, MRI_FLOAT);
+    MRIcopyHeader(mri_src, mri_dist);
+  }
+  else
+    MRIclear(mri_dist);
+
+  if (max_dist <= 0)
+    cap = 2 * MAX(MAX(width, height), depth) * mri_src->xsize;
+  else
+    cap = max_dist * mri_src->xsize;
+
+  // distance outside the label is the distance to the nearest label voxel, and vice versa
+  if (mode != DTRANS_MODE_INSIDE) mriExactDistanceToSeeds(mri_src, mri_dist, label, 1, cap, 0);
+  if (mode != DTRANS_MODE_OUTSIDE)
+    mriExactDistanceToSeeds(mri_src, mri_dist, label, 0, cap, mode == DTRANS_MODE_SIGNED);
+
+  mri_dist->outside_val = max_dist;
+  return (mri_dist);
+}
+
 /**
- * This is deprecated.  Please use MRIextractDistanceMap in fastmarching.h
- * instead
+ * Computes the distance transform with MRIexactDistanceTransform(),
+ * which is exact and parallel. The fast marching MRIextractDistanceMap()
+ * is still used when a mask is given, since the mask there acts as a
+ * barrier to propagation, or when FS_DTRANS_FASTMARCHING is set to 1.
  **/
 MRI *MRIdistanceTransform(MRI *mri_src, MRI *mri_dist, int label, float max_dist, int mode, MRI *mri_mask)
 {
   const int width = mri_src->width;
   const int height = mri_src->height;
   const int depth = mri_src->depth;
+  char *cp;
+
+  cp = getenv("FS_DTRANS_FASTMARCHING");
+  if (mri_mask == NULL && (cp == NULL || strcmp(cp, "1"))) {
+    return (MRIexactDistanceTransform(mri_src, mri_dist, label, max_dist, mode));
+  }
 
   if (mri_dist == NULL) {
     mri_dist = MRIalloc(width, height, depth, MRI_FLOAT);
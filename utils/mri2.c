@@ -770,6 +770,7 @@ int MRIvol2Vol(MRI *src, MRI *targ, MATRIX *Vt2s, int InterpCode, float param)
     int rt, st, f;
     int ics, irs, iss;
     float fcs, frs, fss, *valvect;
+    float rcs, rrs, rss;
     double rval;
 
 #ifdef HAVE_OPENMP
@@ -779,36 +780,47 @@ int MRIvol2Vol(MRI *src, MRI *targ, MATRIX *Vt2s, int InterpCode, float param)
     valvect = valvects[0];
 #endif
 
+    /* The column/row part of the vox2vox is constant along a slice
+       run, so it is evaluated once per row and only the slice term is
+       added in the inner loop. The partial sums keep the left-to-right
+       float evaluation order of the full expression, so the sampled
+       coordinates are unchanged. */
+    const float m11 = Vt2s->rptr[1][1], m12 = Vt2s->rptr[1][2], m13 = Vt2s->rptr[1][3], m14 = Vt2s->rptr[1][4];
+    const float m21 = Vt2s->rptr[2][1], m22 = Vt2s->rptr[2][2], m23 = Vt2s->rptr[2][3], m24 = Vt2s->rptr[2][4];
+    const float m31 = Vt2s->rptr[3][1], m32 = Vt2s->rptr[3][2], m33 = Vt2s->rptr[3][3], m34 = Vt2s->rptr[3][4];
+
     for (rt = 0; rt < targ->height; rt++) {
+      rcs = m11 * ct + m12 * rt;
+      rrs = m21 * ct + m22 * rt;
+      rss = m31 * ct + m32 * rt;
       for (st = 0; st < targ->depth; st++) {
         /* Column in source corresponding to CRS in Target */
-        fcs = Vt2s->rptr[1][1] * ct + Vt2s->rptr[1][2] * rt + Vt2s->rptr[1][3] * st + Vt2s->rptr[1][4];
+        fcs = rcs + m13 * st + m14;
         ics = nint(fcs);
         if (ics < 0 || ics >= src->width) continue;
 
         /* Row in source corresponding to CRS in Target */
-        frs = Vt2s->rptr[2][1] * ct + Vt2s->rptr[2][2] * rt + Vt2s->rptr[2][3] * st + Vt2s->rptr[2][4];
+        frs = rrs + m23 * st + m24;
         irs = nint(frs);
         if (irs < 0 || irs >= src->height) continue;
 
         /* Slice in source corresponding to CRS in Target */
-        fss = Vt2s->rptr[3][1] * ct + Vt2s->rptr[3][2] * rt + Vt2s->rptr[3][3] * st + Vt2s->rptr[3][4];
+        fss = rss + m33 * st + m34;
         iss = nint(fss);
         if (iss < 0 || iss >= src->depth) continue;
 
         /* Assign output volume values */
         if (InterpCode == SAMPLE_TRILINEAR)
           MRIsampleSeqVolume(src, fcs, frs, fss, valvect, 0, src->nframes - 1);
+        else if (InterpCode == SAMPLE_CUBIC_BSPLINE)
+          /* spline weights and mirrored indices are shared by all frames */
+          MRIsampleSeqBSpline(bspline, fcs, frs, fss, valvect, 0, src->nframes - 1);
         else {
           for (f = 0; f < src->nframes; f++) {
             switch (InterpCode) {
               case SAMPLE_NEAREST:
                 valvect[f] = MRIgetVoxVal(src, ics, irs, iss, f);
                 break;
-              case SAMPLE_CUBIC_BSPLINE:
-                MRIsampleBSpline(bspline, fcs, frs, fss, f, &rval);
-                valvect[f] = rval;
-                break;
               case SAMPLE_SINC: /* no multi-frame */
                 MRIsincSampleVolume(src, fcs, frs, fss, sinchw, &rval);
                 valvect[f] = rval;
@@ -820,7 +832,10 @@ int MRIvol2Vol(MRI *src, MRI *targ, MATRIX *Vt2s, int InterpCode, float param)
           }
         }
 
-        for (f = 0; f < src->nframes; f++) MRIsetVoxVal(targ, ct, rt, st, f, valvect[f]);
+        if (targ->type == MRI_FLOAT)
+          for (f = 0; f < src->nframes; f++) MRIFseq_vox(targ, ct, rt, st, f) = valvect[f];
+        else
+          for (f = 0; f < src->nframes; f++) MRIsetVoxVal(targ, ct, rt, st, f, valvect[f]);
 
       } /* target col */
     }   /* target row */
@@ -3009,16 +3024,15 @@ int MRIvol2VolVSM(MRI *src, MRI *targ, MATRIX *Vt2s, int InterpCode, float param
         /* Assign output volume values */
         if (InterpCode == SAMPLE_TRILINEAR)
           MRIsampleSeqVolume(src, fcs, frs, fss, valvect, 0, src->nframes - 1);
+        else if (InterpCode == SAMPLE_CUBIC_BSPLINE)
+          /* spline weights and mirrored indices are shared by all frames */
+          MRIsampleSeqBSpline(bspline, fcs, frs, fss, valvect, 0, src->nframes - 1);
         else {
           for (f = 0; f < src->nframes; f++) {
             switch (InterpCode) {
               case SAMPLE_NEAREST:
                 valvect[f] = MRIgetVoxVal(src, ics, irs, iss, f);
                 break;
-              case SAMPLE_CUBIC_BSPLINE:
-                MRIsampleBSpline(bspline, fcs, frs, fss, f, &rval);
-                valvect[f] = rval;
-                break;
               case SAMPLE_SINC: /* no multi-frame */
                 MRIsincSampleVolume(src, fcs, frs, fss, sinchw, &rval);
                 valvect[f] = rval;
@@ -3030,7 +3044,10 @@ int MRIvol2VolVSM(MRI *src, MRI *targ, MATRIX *Vt2s, int InterpCode, float param
           }
         }
 
-        for (f = 0; f < src->nframes; f++) MRIsetVoxVal(targ, ct, rt, st, f, valvect[f]);
+        if (targ->type == MRI_FLOAT)
+          for (f = 0; f < src->nframes; f++) MRIFseq_vox(targ, ct, rt, st, f) = valvect[f];
+        else
+          for (f = 0; f < src->nframes; f++) MRIsetVoxVal(targ, ct, rt, st, f, valvect[f]);
 
       } /* target col */
     }   /* target row */
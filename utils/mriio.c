@@ -182,6 +182,9 @@ static void local_buffer_to_image(BUFTYPE *buf, MRI *mri, int slice, int frame);
 static MRI *sdtRead(const char *fname, int read_volume);
 static MRI *mghRead(const char *fname, int read_volume, int frame);
 static int mghWrite(MRI *mri, const char *fname, int frame);
+static void mghWriteHeader(MRI *mri, int nframes, znzFile fp);
+static int mghWriteFrame(MRI *mri, int frame, int nth, int ntotal, znzFile fp, const char *fname);
+static void mghWriteTrailer(MRI *mri, znzFile fp);
 static int mghAppend(MRI *mri, const char *fname, int frame);
 
 /********************************************/
@@ -11551,64 +11554,23 @@ static MRI *mghRead(const char *fname, int read_volume, int frame)
   return (mri);
 }
 
-static int mghWrite(MRI *mri, const char *fname, int frame)
+/*-----------------------------------------------------
+  mghWriteHeader() - writes the fixed-size MGH header of mri to fp,
+  declaring nframes frames of data.
+  ------------------------------------------------------*/
+static void mghWriteHeader(MRI *mri, int nframes, znzFile fp)
 {
-  znzFile fp;
-  int ival, start_frame, end_frame, x, y, z, width, height, depth, unused_space_size, flen;
+  int unused_space_size;
   char buf[UNUSED_SPACE_SIZE + 1];
-  float fval;
-  short sval;
-  int gzipped = 0;
-  char *ext;
-
-  if (frame >= 0)
-    start_frame = end_frame = frame;
-  else {
-    start_frame = 0;
-    end_frame = mri->nframes - 1;
-  }
-  ////////////////////////////////////////////////////////////
-  ext = strrchr(fname, '.');
-  int valid_ext = 0;
-  if (ext) {
-    ++ext;
-    // if mgz, then it is compressed
-    if (!stricmp(ext, "mgz") || strstr(fname, "mgh.gz")) {
-      gzipped = 1;
-      valid_ext = 1;
-    }
-    else if (!stricmp(ext, "mgh")) {
-      valid_ext = 1;
-    }
-  }
-  if (valid_ext) {
-    fp = znzopen(fname, "wb", gzipped);
-    if (znz_isnull(fp)) {
-      errno = 0;
-      ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "mghWrite(%s, %d): could not open file", fname, frame));
-    }
-  }
-  else {
-    errno = 0;
-    ErrorReturn(ERROR_BADPARM,
-                (ERROR_BADPARM,
-                 "mghWrite: filename '%s' "
-                 "needs to have an extension of .mgh or .mgz",
-                 fname));
-  }
 
   /* WARNING - adding or removing anything before nframes will
      cause mghAppend to fail.
   */
-  width = mri->width;
-  height = mri->height;
-  depth = mri->depth;
-  // printf("(w,h,d) = (%d,%d,%d)\n", width, height, depth);
   znzwriteInt(MGH_VERSION, fp);
   znzwriteInt(mri->width, fp);
   znzwriteInt(mri->height, fp);
   znzwriteInt(mri->depth, fp);
-  znzwriteInt(mri->nframes, fp);
+  znzwriteInt(nframes, fp);
   znzwriteInt(mri->type, fp);
   znzwriteInt(mri->dof, fp);
 
@@ -11639,50 +11601,72 @@ static int mghWrite(MRI *mri, const char *fname, int frame)
   /* so stuff can be added to the header in the future */
   memset(buf, 0, UNUSED_SPACE_SIZE * sizeof(char));
   znzwrite(buf, sizeof(char), unused_space_size, fp);
+}
 
-  for (frame = start_frame; frame <= end_frame; frame++) {
-    for (z = 0; z < depth; z++) {
-      for (y = 0; y < height; y++) {
-        switch (mri->type) {
-          case MRI_SHORT:
-            for (x = 0; x < width; x++) {
-              if (z == 74 && y == 16 && x == 53) DiagBreak();
-              sval = MRISseq_vox(mri, x, y, z, frame);
-              znzwriteShort(sval, fp);
-            }
-            break;
-          case MRI_INT:
-            for (x = 0; x < width; x++) {
-              if (z == 74 && y == 16 && x == 53) DiagBreak();
-              ival = MRIIseq_vox(mri, x, y, z, frame);
-              znzwriteInt(ival, fp);
-            }
-            break;
-          case MRI_FLOAT:
-            for (x = 0; x < width; x++) {
-              if (z == 74 && y == 16 && x == 53) DiagBreak();
-              // printf("mghWrite: MRI_FLOAT: curr (x, y, z, frame) = (%d, %d, %d, %d)\n", x, y, z, frame);
-              fval = MRIFseq_vox(mri, x, y, z, frame);
-              // if(x==10 && y == 0 && z == 0 && frame == 67)
-              // printf("MRIIO: %g\n",fval);
-              znzwriteFloat(fval, fp);
-            }
-            break;
-          case MRI_UCHAR:
-            if ((int)znzwrite(&MRIseq_vox(mri, 0, y, z, frame), sizeof(BUFTYPE), width, fp) != width) {
-              errno = 0;
-              ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "mghWrite: could not write %d bytes to %s", width, fname));
-            }
-            break;
-          default:
+/*-----------------------------------------------------
+  mghWriteFrame() - writes the voxels of one frame of mri to fp. nth
+  and ntotal are only used for progress reporting.
+  ------------------------------------------------------*/
+static int mghWriteFrame(MRI *mri, int frame, int nth, int ntotal, znzFile fp, const char *fname)
+{
+  int ival, x, y, z, width, height, depth;
+  float fval;
+  short sval;
+
+  width = mri->width;
+  height = mri->height;
+  depth = mri->depth;
+  for (z = 0; z < depth; z++) {
+    for (y = 0; y < height; y++) {
+      switch (mri->type) {
+        case MRI_SHORT:
+          for (x = 0; x < width; x++) {
+            if (z == 74 && y == 16 && x == 53) DiagBreak();
+            sval = MRISseq_vox(mri, x, y, z, frame);
+            znzwriteShort(sval, fp);
+          }
+          break;
+        case MRI_INT:
+          for (x = 0; x < width; x++) {
+            if (z == 74 && y == 16 && x == 53) DiagBreak();
+            ival = MRIIseq_vox(mri, x, y, z, frame);
+            znzwriteInt(ival, fp);
+          }
+          break;
+        case MRI_FLOAT:
+          for (x = 0; x < width; x++) {
+            if (z == 74 && y == 16 && x == 53) DiagBreak();
+            // printf("mghWrite: MRI_FLOAT: curr (x, y, z, frame) = (%d, %d, %d, %d)\n", x, y, z, frame);
+            fval = MRIFseq_vox(mri, x, y, z, frame);
+            // if(x==10 && y == 0 && z == 0 && frame == 67)
+            // printf("MRIIO: %g\n",fval);
+            znzwriteFloat(fval, fp);
+          }
+          break;
+        case MRI_UCHAR:
+          if ((int)znzwrite(&MRIseq_vox(mri, 0, y, z, frame), sizeof(BUFTYPE), width, fp) != width) {
             errno = 0;
-            ErrorReturn(ERROR_UNSUPPORTED, (ERROR_UNSUPPORTED, "mghWrite: unsupported type %d", mri->type));
-            break;
-        }
+            ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "mghWrite: could not write %d bytes to %s", width, fname));
+          }
+          break;
+        default:
+          errno = 0;
+          ErrorReturn(ERROR_UNSUPPORTED, (ERROR_UNSUPPORTED, "mghWrite: unsupported type %d", mri->type));
+          break;
       }
-      exec_progress_callback(z, depth, frame - start_frame, end_frame - start_frame + 1);
     }
+    exec_progress_callback(z, depth, nth, ntotal);
   }
+  return (NO_ERROR);
+}
+
+/*-----------------------------------------------------
+  mghWriteTrailer() - writes the optional parameters and tags that
+  follow the voxel data in an MGH file.
+  ------------------------------------------------------*/
+static void mghWriteTrailer(MRI *mri, znzFile fp)
+{
+  int flen;
 
   znzwriteFloat(mri->tr, fp);
   znzwriteFloat(mri->flip_angle, fp);
@@ -11730,6 +11714,60 @@ static int mghWrite(MRI *mri, const char *fname, int frame)
 
     for (i = 0; i < mri->ncmds; i++) znzTAGwrite(fp, TAG_CMDLINE, mri->cmdlines[i], strlen(mri->cmdlines[i]) + 1);
   }
+}
+
+static int mghWrite(MRI *mri, const char *fname, int frame)
+{
+  znzFile fp;
+  int start_frame, end_frame, error;
+  int gzipped = 0;
+  char *ext;
+
+  if (frame >= 0)
+    start_frame = end_frame = frame;
+  else {
+    start_frame = 0;
+    end_frame = mri->nframes - 1;
+  }
+  ////////////////////////////////////////////////////////////
+  ext = strrchr(fname, '.');
+  int valid_ext = 0;
+  if (ext) {
+    ++ext;
+    // if mgz, then it is compressed
+    if (!stricmp(ext, "mgz") || strstr(fname, "mgh.gz")) {
+      gzipped = 1;
+      valid_ext = 1;
+    }
+    else if (!stricmp(ext, "mgh")) {
+      valid_ext = 1;
+    }
+  }
+  if (valid_ext) {
+    fp = znzopen(fname, "wb", gzipped);
+    if (znz_isnull(fp)) {
+      errno = 0;
+      ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "mghWrite(%s, %d): could not open file", fname, frame));
+    }
+  }
+  else {
+    errno = 0;
+    ErrorReturn(ERROR_BADPARM,
+                (ERROR_BADPARM,
+                 "mghWrite: filename '%s' "
+                 "needs to have an extension of .mgh or .mgz",
+                 fname));
+  }
+
+  mghWriteHeader(mri, mri->nframes, fp);
+  for (frame = start_frame; frame <= end_frame; frame++) {
+    error = mghWriteFrame(mri, frame, frame - start_frame, end_frame - start_frame + 1, fp, fname);
+    if (error != NO_ERROR) {
+      znzclose(fp);
+      return (error);
+    }
+  }
+  mghWriteTrailer(mri, fp);
 
   // fclose(fp) ;
   znzclose(fp);
@@ -12208,6 +12246,125 @@ static int mghAppend(MRI *mri, const char *fname, int frame)
   return (NO_ERROR);
 }
 
+/*-----------------------------------------------------
+  MRI_FRAME_WRITER - writes an MGH/MGZ volume one frame at a time, so
+  the output of a long concatenation never has to be in memory at
+  once. The header is written up front with the final number of
+  frames and the trailing tags when the writer is closed, so unlike
+  MRIappend this also works for compressed files.
+  ------------------------------------------------------*/
+struct MRI_FRAME_WRITER
+{
+  znzFile fp;
+  MRI *mri_header;  // geometry, type and tags of the output
+  int nframes;      // frames promised in the header
+  int nwritten;
+  char fname[STRLEN];
+};
+
+/*!
+  \fn MRI_FRAME_WRITER *MRIframeWriterOpen(MRI *mri_template, int nframes, const char *fname)
+  \brief Opens fname (.mgh or .mgz) for writing nframes frames with the
+  geometry, type and header of mri_template. mri_template is only
+  read here and may be freed afterwards.
+*/
+MRI_FRAME_WRITER *MRIframeWriterOpen(MRI *mri_template, int nframes, const char *fname)
+{
+  MRI_FRAME_WRITER *writer;
+  const char *ext;
+  int gzipped;
+
+  ext = strrchr(fname, '.');
+  if (ext && (!stricmp(ext + 1, "mgz") || strstr(fname, "mgh.gz")))
+    gzipped = 1;
+  else if (ext && !stricmp(ext + 1, "mgh"))
+    gzipped = 0;
+  else {
+    errno = 0;
+    ErrorReturn(NULL,
+                (ERROR_BADPARM, "MRIframeWriterOpen: filename '%s' needs to have an extension of .mgh or .mgz", fname));
+  }
+  if (nframes < 1) {
+    ErrorReturn(NULL, (ERROR_BADPARM, "MRIframeWriterOpen: nframes = %d", nframes));
+  }
+
+  writer = (MRI_FRAME_WRITER *)calloc(1, sizeof(MRI_FRAME_WRITER));
+  writer->fp = znzopen(fname, "wb", gzipped);
+  if (znz_isnull(writer->fp)) {
+    free(writer);
+    errno = 0;
+    ErrorReturn(NULL, (ERROR_BADPARM, "MRIframeWriterOpen(%s): could not open file", fname));
+  }
+  writer->mri_header =
+      MRIallocHeader(mri_template->width, mri_template->height, mri_template->depth, mri_template->type, nframes);
+  MRIcopyHeader(mri_template, writer->mri_header);
+  writer->nframes = nframes;
+  writer->nwritten = 0;
+  strncpy(writer->fname, fname, STRLEN - 1);
+
+  mghWriteHeader(writer->mri_header, nframes, writer->fp);
+  return (writer);
+}
+
+/*!
+  \fn int MRIframeWriterWrite(MRI_FRAME_WRITER *writer, MRI *mri, int frame)
+  \brief Appends the given frame of mri as the next output frame. mri
+  must have the dimensions and type the writer was opened with.
+*/
+int MRIframeWriterWrite(MRI_FRAME_WRITER *writer, MRI *mri, int frame)
+{
+  MRI *hdr = writer->mri_header;
+
+  if (mri->width != hdr->width || mri->height != hdr->height || mri->depth != hdr->depth || mri->type != hdr->type)
+    ErrorReturn(ERROR_BADPARM,
+                (ERROR_BADPARM,
+                 "MRIframeWriterWrite(%s): volume is %dx%dx%d type %d, expected %dx%dx%d type %d",
+                 writer->fname,
+                 mri->width,
+                 mri->height,
+                 mri->depth,
+                 mri->type,
+                 hdr->width,
+                 hdr->height,
+                 hdr->depth,
+                 hdr->type));
+  if (writer->nwritten >= writer->nframes)
+    ErrorReturn(ERROR_BADPARM,
+                (ERROR_BADPARM, "MRIframeWriterWrite(%s): all %d frames already written", writer->fname, writer->nframes));
+
+  writer->nwritten++;
+  return (mghWriteFrame(mri, frame, writer->nwritten - 1, writer->nframes, writer->fp, writer->fname));
+}
+
+/*!
+  \fn int MRIframeWriterClose(MRI_FRAME_WRITER **pwriter)
+  \brief Writes the trailing tags and closes the file. It is an error
+  to close the writer before all frames promised in the header have
+  been written (the file is still closed and the writer freed).
+*/
+int MRIframeWriterClose(MRI_FRAME_WRITER **pwriter)
+{
+  MRI_FRAME_WRITER *writer = *pwriter;
+  int error = NO_ERROR;
+
+  if (writer == NULL) return (NO_ERROR);
+
+  if (writer->nwritten != writer->nframes) {
+    printf("ERROR: MRIframeWriterClose(%s): %d of %d frames written\n",
+           writer->fname,
+           writer->nwritten,
+           writer->nframes);
+    error = ERROR_BADFILE;
+  }
+  else
+    mghWriteTrailer(writer->mri_header, writer->fp);
+  znzclose(writer->fp);
+  MRIfree(&writer->mri_header);
+  free(writer);
+  *pwriter = NULL;
+  return (error);
+}
+
 /*-----------------------------------------------------
   Parameters:
 
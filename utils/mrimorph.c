@@ -6650,6 +6650,7 @@ static MRI *g_mri_in, *g_mri_ref;
 static MP *g_parms;
 static GCA *g_gca;
 static double g_clamp;
+static GCA_SAMPLE_PACK *g_pack; /* samples of the current MRIemAlign() */
 extern void (*user_call_func)(float[]);
 
 #if 0
@@ -7327,10 +7328,14 @@ static float computeEMAlignmentErrorFunctional(float *p)
   MatrixPrintHires(stdout, m_L);
 #endif
 #endif
-  old_lta = (LTA *)parms->transform->xform;
-  parms->transform->xform = (void *)lta;
-  log_p = GCAcomputeLogSampleProbability(gca, parms->gcas, g_mri_in, parms->transform, parms->nsamples, clamp);
-  parms->transform->xform = (void *)old_lta;
+  if (g_pack)
+    log_p = GCAcomputeLogSampleProbabilityPacked(g_pack, mri_inputs, m_L, clamp);
+  else {
+    old_lta = (LTA *)parms->transform->xform;
+    parms->transform->xform = (void *)lta;
+    log_p = GCAcomputeLogSampleProbability(gca, parms->gcas, g_mri_in, parms->transform, parms->nsamples, clamp);
+    parms->transform->xform = (void *)old_lta;
+  }
   LTAfree(&lta);
   return (-log_p);
 }
@@ -7596,8 +7601,12 @@ int MRIemAlign(MRI *mri_in, GCA *gca, MORPH_PARMS *parms, MATRIX *m_L)
   fprintf(stdout, "Transform matrix\n");
   MatrixPrintHires(stdout, parms->lta->xforms[0].m_L);
   fprintf(stdout, "nsamples %d\n", parms->nsamples);
+  /* the samples are fixed for the whole alignment, so every evaluation
+     of the log likelihood goes through one packed copy of them */
+  g_pack = GCAsamplePackAlloc(gca, parms->gcas, parms->nsamples);
   /* E step */
-  pcurrent = -GCAcomputeLogSampleProbability(gca, parms->gcas, mri_in, parms->transform, parms->nsamples, parms->clamp);
+  pcurrent = -GCAcomputeLogSampleProbabilityPacked(
+        g_pack, mri_in, ((LTA *)parms->transform->xform)->xforms[0].m_L, parms->clamp);
 
   i = 0;
   do {
@@ -7605,11 +7614,12 @@ int MRIemAlign(MRI *mri_in, GCA *gca, MORPH_PARMS *parms, MATRIX *m_L)
     /* M step */
     mriQuasiNewtonEMAlignPyramidLevel(mri_in, gca, parms);
 
-    pcurrent =
-        -GCAcomputeLogSampleProbability(gca, parms->gcas, mri_in, parms->transform, parms->nsamples, parms->clamp);
+    pcurrent = -GCAcomputeLogSampleProbabilityPacked(
+        g_pack, mri_in, ((LTA *)parms->transform->xform)->xforms[0].m_L, parms->clamp);
     i++;
     printf("outof QuasiNewtonEMA: %03d: -log(p) = %6.1f  tol %f\n", parms->start_t + i, pcurrent, parms->tol);
   } while (((pcurrent - pold) / (pold)) > parms->tol);
+  GCAsamplePackFree(&g_pack);
 
   strcpy(parms->base_name, base_name);
   if (parms->log_fp) {
@@ -47,6 +47,7 @@
 #include "numerics.h"
 #include "proto.h"
 #include "region.h"
+#include "romp_support.h"
 #include "talairachex.h"
 
 /*-----------------------------------------------------
@@ -82,6 +83,20 @@ static int mriRemoveOutliers(MRI *mri, int min_nbrs);
 static MRI *mriDownsampleCtrl2(MRI *mri_src, MRI *mri_dst) ;
 #endif
 static MRI *mriSoapBubbleFloat(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst, int niter, float min_change);
+static int mriSoapBubbleRelaxFloat(MRI *mri_dst,
+                                   MRI *mri_ctrl,
+                                   MRI *mri_tmp,
+                                   int f,
+                                   int niter,
+                                   float min_change,
+                                   float max_change,
+                                   int *px1,
+                                   int *py1,
+                                   int *pz1,
+                                   int *px2,
+                                   int *py2,
+                                   int *pz2,
+                                   int grow);
 static MRI *mriSoapBubbleShort(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst, int niter);
 static MRI *mriSoapBubbleExpandFloat(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst, int niter);
 static MRI *mriBuildVoronoiDiagramFloat(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst);
@@ -1635,8 +1650,8 @@ MRI *MRInormFindControlPointsInWindow(MRI *mri_src,
                                       int scan_type,
                                       MRI *mri_not_control)
 {
-  int width, height, depth, x, y, z, xk, yk, zk, xi, yi, zi, *pxi, *pyi;
-  int *pzi, ctrl, nctrl, val0, val = 0, whalf;
+  int width, height, depth, z, *pxi, *pyi;
+  int *pzi, nctrl, whalf;
   float low_thresh, hi_thresh;
 
   whalf = nint(whalf_mm / mri_src->xsize);
@@ -1660,7 +1675,16 @@ MRI *MRInormFindControlPointsInWindow(MRI *mri_src,
   */
   low_thresh = floor(wm_target - intensity_below);
   hi_thresh = floor(wm_target + intensity_above);
-  for (nctrl = z = 0; z < depth; z++) {
+  /* each voxel only reads mri_src and its own entry in mri_ctrl, so
+     the slices can be scanned independently */
+  nctrl = 0;
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(shown_reproducible) reduction(+ : nctrl)
+#endif
+  for (z = 0; z < depth; z++) {
+    ROMP_PFLB_begin
+    int x, y, xk, yk, zk, xi, yi, zi, ctrl, val0, val = 0;
     for (y = 0; y < height; y++) {
       for (x = 0; x < width; x++) {
         if (MRIvox(mri_ctrl, x, y, z) > 0) /* already a control point */
@@ -1693,7 +1717,9 @@ MRI *MRInormFindControlPointsInWindow(MRI *mri_src,
         MRIvox(mri_ctrl, x, y, z) = ctrl;
       }
     }
+    ROMP_PFLB_end
   }
+  ROMP_PF_end
   if (Gdiag & DIAG_SHOW && debug_str != NULL)
     fprintf(
         stderr, "%s %d %dx%dx%d control points found\n", debug_str, nctrl, whalf * 2 + 1, whalf * 2 + 1, whalf * 2 + 1);
@@ -2614,6 +2640,166 @@ MRI *MRIsoapBubble(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst, int niter, float m
   return (mri_dst);
 }
 
+/*-----------------------------------------------------
+  MRIsoapBubbleMultigrid() - solves the same membrane problem as
+  MRIsoapBubble, coarse to fine. The control values are restricted
+  onto a half-resolution grid and solved there recursively. The
+  trilinearly interpolated coarse solution then seeds the unmarked
+  voxels at this level, followed by niter Jacobi sweeps over the
+  whole volume. Plain relaxation needs on the order of n sweeps to
+  carry a control value across an n voxel gap; starting from the
+  coarse solution only the fine detail is left to relax. Non-float
+  volumes are solved in float and converted back; multi-frame volumes
+  are handed to MRIsoapBubble.
+  ------------------------------------------------------*/
+#define SOAP_MULTIGRID_MIN_SIZE 8
+
+MRI *MRIsoapBubbleMultigrid(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst, int niter, float min_change)
+{
+  int width, height, depth, cwidth, cheight, cdepth, z, x1, y1, z1, x2, y2, z2;
+  MRI *mri_cval, *mri_cctrl, *mri_tmp;
+
+  if (mri_src->nframes > 1 || mri_ctrl->type != MRI_UCHAR) {
+    return (MRIsoapBubble(mri_src, mri_ctrl, mri_dst, niter, min_change));
+  }
+
+  width = mri_src->width;
+  height = mri_src->height;
+  depth = mri_src->depth;
+
+  if (mri_src->type != MRI_FLOAT) {
+    int x, y;
+    MRI *mri_float;
+
+    mri_float = MRIchangeType(mri_src, MRI_FLOAT, 0, 255, 1);
+    MRIsoapBubbleMultigrid(mri_float, mri_ctrl, mri_float, niter, min_change);
+    if (!mri_dst) {
+      mri_dst = MRIclone(mri_src, NULL);
+    }
+    // round into integer volumes like MRIsoapBubble() does, truncating
+    // would bias the result down
+    for (z = 0; z < depth; z++)
+      for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++) {
+          if (mri_dst->type == MRI_FLOAT)
+            MRIsetVoxVal(mri_dst, x, y, z, 0, MRIFvox(mri_float, x, y, z));
+          else
+            MRIsetVoxVal(mri_dst, x, y, z, 0, nint(MRIFvox(mri_float, x, y, z)));
+        }
+    MRIfree(&mri_float);
+    return (mri_dst);
+  }
+
+  if (!mri_dst) {
+    mri_dst = MRIcopy(mri_src, NULL);
+  }
+  else if (mri_dst != mri_src) {
+    MRIcopy(mri_src, mri_dst);
+  }
+
+  if (MIN(width, MIN(height, depth)) >= 2 * SOAP_MULTIGRID_MIN_SIZE) {
+    cwidth = (width + 1) / 2;
+    cheight = (height + 1) / 2;
+    cdepth = (depth + 1) / 2;
+    mri_cval = MRIalloc(cwidth, cheight, cdepth, MRI_FLOAT);
+    mri_cctrl = MRIalloc(cwidth, cheight, cdepth, MRI_UCHAR);
+
+    /* restriction: a coarse voxel is a control point if any of its
+       children is, and takes the mean of the marked children. The rest
+       take the mean of all children as a starting value. */
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+    for (z = 0; z < cdepth; z++) {
+      ROMP_PFLB_begin
+      int xc, yc, x, y, zf, nmarked, n;
+      float val, sum, sum_marked;
+
+      for (yc = 0; yc < cheight; yc++) {
+        for (xc = 0; xc < cwidth; xc++) {
+          nmarked = n = 0;
+          sum = sum_marked = 0.0f;
+          for (zf = 2 * z; zf <= MIN(2 * z + 1, depth - 1); zf++)
+            for (y = 2 * yc; y <= MIN(2 * yc + 1, height - 1); y++)
+              for (x = 2 * xc; x <= MIN(2 * xc + 1, width - 1); x++) {
+                val = MRIFvox(mri_dst, x, y, zf);
+                sum += val;
+                n++;
+                if (MRIvox(mri_ctrl, x, y, zf) == CONTROL_MARKED) {
+                  sum_marked += val;
+                  nmarked++;
+                }
+              }
+          if (nmarked > 0) {
+            MRIFvox(mri_cval, xc, yc, z) = sum_marked / nmarked;
+            MRIvox(mri_cctrl, xc, yc, z) = CONTROL_MARKED;
+          }
+          else {
+            MRIFvox(mri_cval, xc, yc, z) = sum / n;
+            MRIvox(mri_cctrl, xc, yc, z) = CONTROL_NONE;
+          }
+        }
+      }
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
+
+    MRIsoapBubbleMultigrid(mri_cval, mri_cctrl, mri_cval, niter, min_change);
+
+    /* prolongation: coarse voxel i is centered on fine coordinate 2i+0.5 */
+    ROMP_PF_begin
+#ifdef HAVE_OPENMP
+    #pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+    for (z = 0; z < depth; z++) {
+      ROMP_PFLB_begin
+      int x, y, x0, y0, z0, xp, yp, zp;
+      double xc, yc, zc, dx, dy, dz;
+
+      zc = MAX(0, MIN(cdepth - 1, (z - 0.5) / 2.0));
+      z0 = (int)zc;
+      zp = MIN(z0 + 1, cdepth - 1);
+      dz = zc - z0;
+      for (y = 0; y < height; y++) {
+        yc = MAX(0, MIN(cheight - 1, (y - 0.5) / 2.0));
+        y0 = (int)yc;
+        yp = MIN(y0 + 1, cheight - 1);
+        dy = yc - y0;
+        for (x = 0; x < width; x++) {
+          if (MRIvox(mri_ctrl, x, y, z) == CONTROL_MARKED) {
+            continue;
+          }
+          xc = MAX(0, MIN(cwidth - 1, (x - 0.5) / 2.0));
+          x0 = (int)xc;
+          xp = MIN(x0 + 1, cwidth - 1);
+          dx = xc - x0;
+          MRIFvox(mri_dst, x, y, z) =
+              (1 - dz) * ((1 - dy) * ((1 - dx) * MRIFvox(mri_cval, x0, y0, z0) + dx * MRIFvox(mri_cval, xp, y0, z0)) +
+                          dy * ((1 - dx) * MRIFvox(mri_cval, x0, yp, z0) + dx * MRIFvox(mri_cval, xp, yp, z0))) +
+              dz * ((1 - dy) * ((1 - dx) * MRIFvox(mri_cval, x0, y0, zp) + dx * MRIFvox(mri_cval, xp, y0, zp)) +
+                    dy * ((1 - dx) * MRIFvox(mri_cval, x0, yp, zp) + dx * MRIFvox(mri_cval, xp, yp, zp)));
+        }
+      }
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
+
+    MRIfree(&mri_cval);
+    MRIfree(&mri_cctrl);
+  }
+
+  mri_tmp = MRIcopy(mri_dst, NULL);
+  x1 = y1 = z1 = 0;
+  x2 = width - 1;
+  y2 = height - 1;
+  z2 = depth - 1;
+  mriSoapBubbleRelaxFloat(mri_dst, mri_ctrl, mri_tmp, 0, niter, min_change, 0, &x1, &y1, &z1, &x2, &y2, &z2, 0);
+  MRIfree(&mri_tmp);
+
+  return (mri_dst);
+}
+
 /*-----------------------------------------------------
   Parameters:
 
@@ -2781,6 +2967,117 @@ MRI *MRIsoapBubbleExpand(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst, int niter)
   return (mri_dst);
 }
 
+/*-----------------------------------------------------
+  mriSoapBubbleRelaxFloat() - Jacobi sweeps of the soap bubble over
+  the box (*px1,*py1,*pz1)-(*px2,*py2,*pz2) of frame f. Each unmarked
+  voxel is replaced by the mean of its 3x3x3 neighborhood. A sweep
+  only reads mri_dst and only writes mri_tmp, so the slices are
+  updated in parallel. If grow is set the box is enlarged by a voxel
+  after every sweep and the final box is passed back. Stops early when
+  the largest change drops below min_change; max_change seeds the
+  first test. Returns the number of sweeps done.
+  ------------------------------------------------------*/
+static int mriSoapBubbleRelaxFloat(MRI *mri_dst,
+                                   MRI *mri_ctrl,
+                                   MRI *mri_tmp,
+                                   int f,
+                                   int niter,
+                                   float min_change,
+                                   float max_change,
+                                   int *px1,
+                                   int *py1,
+                                   int *pz1,
+                                   int *px2,
+                                   int *py2,
+                                   int *pz2,
+                                   int grow)
+{
+  int i, z, x1, y1, z1, x2, y2, z2, *pxi, *pyi, *pzi;
+
+  x1 = *px1;
+  y1 = *py1;
+  z1 = *pz1;
+  x2 = *px2;
+  y2 = *py2;
+  z2 = *pz2;
+  pxi = mri_dst->xi;
+  pyi = mri_dst->yi;
+  pzi = mri_dst->zi;
+
+  for (i = 0; i < niter; i++) {
+    if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON) {
+      fprintf(stderr, "soap bubble iteration %d of %d\n", i + 1, niter);
+    }
+    ROMP_PF_begin
+#if defined(HAVE_OPENMP) && GCC_VERSION > 40408
+    #pragma omp parallel for if_ROMP(shown_reproducible) reduction(max : max_change)
+#endif
+    for (z = z1; z <= z2; z++) {
+      ROMP_PFLB_begin
+      int x, y, xk, yk, zk, xi, yi, zi;
+      BUFTYPE *pctrl, ctrl;
+      float *ptmp, mean, val;
+
+      for (y = y1; y <= y2; y++) {
+        pctrl = &MRIvox(mri_ctrl, x1, y, z);
+        ptmp = &MRIFseq_vox(mri_tmp, x1, y, z, f);
+        for (x = x1; x <= x2; x++) {
+          ctrl = *pctrl++;
+          if (ctrl == CONTROL_MARKED)  // marked point - don't change it
+          {
+            ptmp++;
+            continue;
+          }
+          /* now set this voxel to the average of
+             the marked neighbors */
+          mean = 0.0;
+          for (zk = -1; zk <= 1; zk++) {
+            zi = pzi[z + zk];
+            for (yk = -1; yk <= 1; yk++) {
+              yi = pyi[y + yk];
+              for (xk = -1; xk <= 1; xk++) {
+                xi = pxi[x + xk];
+                mean += MRIFseq_vox(mri_dst, xi, yi, zi, f);
+              }
+            }
+          }
+          val = *ptmp;
+          if (fabs(mean / (3 * 3 * 3.0) - val) > max_change) {
+            max_change = fabs(mean / (3 * 3 * 3.0) - val);
+          }
+          *ptmp++ = (float)mean / (3.0f * 3.0f * 3.0f);
+        }
+      }
+      ROMP_PFLB_end
+    }
+    ROMP_PF_end
+    MRIcopy(mri_tmp, mri_dst);
+    if (grow) {
+      x1 = MAX(x1 - 1, 0);
+      y1 = MAX(y1 - 1, 0);
+      z1 = MAX(z1 - 1, 0);
+      x2 = MIN(x2 + 1, mri_dst->width - 1);
+      y2 = MIN(y2 + 1, mri_dst->height - 1);
+      z2 = MIN(z2 + 1, mri_dst->depth - 1);
+    }
+    if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON) {
+      printf("iter %d: max change %f\n", i, max_change);
+    }
+    if (max_change < min_change) {
+      break;
+    }
+    max_change = 0;
+  }
+
+  *px1 = x1;
+  *py1 = y1;
+  *pz1 = z1;
+  *px2 = x2;
+  *py2 = y2;
+  *pz2 = z2;
+  return (i);
+}
+
 /*-----------------------------------------------------
   Parameters:
 
@@ -2872,10 +3169,8 @@ mriSoapBubbleFloat(MRI *mri_src,
 #else
 static MRI *mriSoapBubbleFloat(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst, int niter, float min_change)
 {
-  int width, height, depth, frames, x, y, z, f, xk, yk, zk, xi, yi, zi, i, *pxi, *pyi, *pzi, num, x1, y1, z1, x2, y2,
-      z2;
+  int width, height, depth, frames, x, y, z, f, xk, yk, zk, xi, yi, zi, *pxi, *pyi, *pzi, num, x1, y1, z1, x2, y2, z2;
   BUFTYPE *pctrl, ctrl;
-  float *ptmp;
   float mean, max_change = 0, val, min_val, max_val;
   MRI *mri_tmp;
   MRI_REGION box;
@@ -2918,7 +3213,6 @@ static MRI *mriSoapBubbleFloat(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst, int ni
     for (z = MAX(0, z1 - WHALF); z <= MIN(z2 + WHALF, depth - 1); z++) {
       for (y = MAX(0, y1 - WHALF); y <= MIN(y2 + WHALF, height - 1); y++) {
         pctrl = &MRIvox(mri_ctrl, MAX(0, x1 - WHALF), y, z);
-        ptmp = &MRIFseq_vox(mri_tmp, MAX(x1 - WHALF, 0), y, z, f);
         for (x = MAX(0, x1 - WHALF); x <= MIN(x2 + WHALF, width - 1); x++) {
           ctrl = *pctrl++;
           if (ctrl == CONTROL_MARKED) {
@@ -2954,59 +3248,10 @@ static MRI *mriSoapBubbleFloat(MRI *mri_src, MRI *mri_ctrl, MRI *mri_dst, int ni
     }
 
     /* now propagate values outwards */
-    for (i = 0; i < niter; i++) {
-      if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON) {
-        fprintf(stderr, "soap bubble iteration %d of %d\n", i + 1, niter);
-      }
-      for (z = z1; z <= z2; z++) {
-        for (y = y1; y <= y2; y++) {
-          pctrl = &MRIvox(mri_ctrl, x1, y, z);
-          ptmp = &MRIFseq_vox(mri_tmp, x1, y, z, f);
-          for (x = x1; x <= x2; x++) {
-            ctrl = *pctrl++;
-            if (ctrl == CONTROL_MARKED)  // marked point - don't change it
-            {
-              ptmp++;
-              continue;
-            }
-            /* now set this voxel to the average of
-               the marked neighbors */
-            mean = 0.0;
-            for (zk = -1; zk <= 1; zk++) {
-              zi = pzi[z + zk];
-              for (yk = -1; yk <= 1; yk++) {
-                yi = pyi[y + yk];
-                for (xk = -1; xk <= 1; xk++) {
-                  xi = pxi[x + xk];
-                  mean += MRIFseq_vox(mri_dst, xi, yi, zi, f);
-                }
-              }
-            }
-            val = *ptmp;
-            if (fabs(mean / (3 * 3 * 3.0) - val) > max_change) {
-              max_change = fabs(mean / (3 * 3 * 3.0) - val);
-            }
-            *ptmp++ = (float)mean / (3.0f * 3.0f * 3.0f);
-            // *ptmp++ = (float)nint((float)mean / (3.0f*3.0f*3.0f));
-          }
-        }
-      }
-      MRIcopy(mri_tmp, mri_dst);
-      x1 = MAX(x1 - 1, 0);
-      y1 = MAX(y1 - 1, 0);
-      z1 = MAX(z1 - 1, 0);
-      x2 = MIN(x2 + 1, width - 1);
-      y2 = MIN(y2 + 1, height - 1);
-      z2 = MIN(z2 + 1, depth - 1);
-      if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON) {
-        printf("iter %d: max change %f\n", i, max_change);
-      }
-      if (max_change < min_change) {
-        break;
-      }
-      max_change = 0;
-    }  // iter
-  }    // frames
+    mriSoapBubbleRelaxFloat(
+        mri_dst, mri_ctrl, mri_tmp, f, niter, min_change, max_change, &x1, &y1, &z1, &x2, &y2, &z2, 1);
+    max_change = 0;
+  }  // frames
 
   MRIfree(&mri_tmp);
 
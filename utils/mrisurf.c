@@ -80,6 +80,7 @@ static const int debugNonDeterminism = 0;
 #include "const.h"
 #include "diag.h"
 #include "error.h"
+#include "fftutils.h"
 #include "fio.h"
 #include "fnv_hash.h"
 #include "gifti_local.h"
@@ -5463,10 +5464,17 @@ int MRISreadCurvatureFile(MRI_SURFACE *mris, const char *sname)
                  "number in file %s",
                  fname));
   }
+  short *ibuf = (short *)calloc(vnum, sizeof(short));
+  if (ibuf == NULL) {
+    fclose(fp);
+    ErrorReturn(ERROR_NOMEMORY, (ERROR_NOMEMORY, "MRISreadBinaryCurvature: could not allocate %d values", vnum));
+  }
+  if (freadShortArray(ibuf, vnum, fp) != vnum)
+    ErrorPrintf(ERROR_BADFILE, "MRISreadBinaryCurvature: %s is truncated", fname);
   curvmin = 10000.0f;
   curvmax = -10000.0f; /* for compiler warnings */
   for (k = 0; k < vnum; k++) {
-    fread2(&i, fp);
+    i = ibuf[k];
     curv = i / 100.0;
 
     if (k == 0) {
@@ -5480,6 +5488,7 @@ int MRISreadCurvatureFile(MRI_SURFACE *mris, const char *sname)
     }
     mris->vertices[k].curv = curv;
   }
+  free(ibuf);
   mris->max_curv = curvmax;
   mris->min_curv = curvmin;
   if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON) {
@@ -14705,9 +14714,9 @@ int MRISreadAnnotation(MRI_SURFACE *mris, const char *sname)
  ------------------------------------------------------*/
 int MRISreadAnnotationIntoArray(const char *fname, int in_array_size, int **out_array)
 {
-  int i, j, vno, num;
+  int i, j, vno, num, nread;
   FILE *fp;
-  int *array = NULL;
+  int *array = NULL, *pairs;
 
   if (fname == NULL || out_array == NULL) ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "Parameter was NULL."));
   if (in_array_size < 0) ErrorReturn(ERROR_BADPARM, (ERROR_BADPARM, "in_array_size was negative."));
@@ -14731,11 +14740,27 @@ int MRISreadAnnotationIntoArray(const char *fname, int in_array_size, int **out_
   /* First int is the number of elements. */
   num = freadInt(fp);
 
-  /* For each one, read in a vno and an int for the annotation
-     value. Check the vno. */
+  /* The (vno, annotation) pairs are read in one block and swapped
+     in bulk. A short read keeps only the complete pairs. */
+  pairs = NULL;
+  if (num > 0) {
+    pairs = (int *)calloc(2 * (size_t)num, sizeof(int));
+    if (pairs == NULL) {
+      fclose(fp);
+      free(array);
+      ErrorReturn(ERROR_NOMEMORY, (ERROR_NOMEMORY, "could not allocate %d annotation entries for %s", num, fname));
+    }
+    nread = freadIntArray(pairs, 2 * num, fp);
+    if (nread != 2 * num) {
+      ErrorPrintf(ERROR_BADFILE, "MRISreadAnnotationIntoArray: %s is truncated", fname);
+      num = nread / 2;
+    }
+  }
+
+  /* For each one, check the vno. */
   for (j = 0; j < num; j++) {
-    vno = freadInt(fp);
-    i = freadInt(fp);
+    vno = pairs[2 * j];
+    i = pairs[2 * j + 1];
     if (vno == Gdiag_no) {
       DiagBreak();
     }
@@ -14761,6 +14786,7 @@ int MRISreadAnnotationIntoArray(const char *fname, int in_array_size, int **out_
       array[vno] = i;
     }
   }
+  if (pairs) free(pairs);
 
   fclose(fp);
 
@@ -31726,6 +31752,257 @@ int MRISrigidBodyAlignVectorLocal(MRI_SURFACE *mris, INTEGRATION_PARMS *old_parm
 
   Description
   ------------------------------------------------------*/
+/*-----------------------------------------------------
+  mrisRigidBodyAngles() - the angles scanned by the rigid body search
+  at one scale. Steps exactly as the nested loops of the original
+  search did, so the candidates are bit-identical.
+  ------------------------------------------------------*/
+static int mrisRigidBodyAngles(double degrees, double delta, double *angles, int max_angles)
+{
+  double angle;
+  int n;
+
+  for (n = 0, angle = -degrees; angle <= degrees && n < max_angles; angle += delta) {
+    angles[n++] = angle;
+  }
+  return (n);
+}
+
+/*-----------------------------------------------------
+  mrisRigidBodyCandidateSSE() - mrisComputeCorrelationError(mris,
+  parms, 1) for the surface rotated by MRISrotate(alpha, beta, gamma),
+  computed from rotated copies of the vertex coordinates. The surface
+  is not modified, so candidates can be scored concurrently, and the
+  vertices are summed in order so the result does not depend on the
+  number of threads. parms->geometry_error is not updated.
+  ------------------------------------------------------*/
+static double mrisRigidBodyCandidateSSE(
+    MRI_SURFACE *mris, INTEGRATION_PARMS *parms, float alpha, float beta, float gamma)
+{
+  int vno;
+  float ca, cb, cg, sa, sb, sg, xp, yp, zp;
+  float cacb, cacgsb, sasg, cgsa;
+  float casbsg, cbsa, cgsasb, casg;
+  float cacg, sasbsg, cbcg, cbsg;
+  double sse, src, target, delta, std;
+
+  if (FZERO(parms->l_corr + parms->l_pcorr)) {
+    return (0.0);
+  }
+
+  /* same single precision coefficients as MRISrotate */
+  sa = sin(alpha);
+  sb = sin(beta);
+  sg = sin(gamma);
+  ca = cos(alpha);
+  cb = cos(beta);
+  cg = cos(gamma);
+  cacb = ca * cb;
+  cacgsb = ca * cg * sb;
+  sasg = sa * sg;
+  cgsa = cg * sa;
+  casbsg = ca * sb * sg;
+  cbsa = cb * sa;
+  cgsasb = cg * sa * sb;
+  casg = ca * sg;
+  cacg = ca * cg;
+  sasbsg = sa * sb * sg;
+  cbcg = cb * cg;
+  cbsg = cb * sg;
+
+  sse = 0.0;
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    VERTEX *v = &mris->vertices[vno];
+    if (v->ripflag) {
+      continue;
+    }
+    xp = v->x * cacb + v->z * (-cacgsb - sasg) + v->y * (cgsa - casbsg);
+    yp = -v->x * cbsa + v->z * (cgsasb - casg) + v->y * (cacg + sasbsg);
+    zp = v->z * cbcg + v->x * sb + v->y * cbsg;
+
+    src = v->curv;
+    target = MRISPfunctionVal(parms->mrisp_template, mris, xp, yp, zp, parms->frame_no);
+    std = MRISPfunctionVal(parms->mrisp_template, mris, xp, yp, zp, parms->frame_no + 1);
+    std = sqrt(std);
+    if (FZERO(std)) {
+      std = DEFAULT_STD /*FSMALL*/;
+    }
+    delta = (src - target) / std;
+    if (parms->abs_norm) {
+      sse += fabs(delta);
+    }
+    else {
+      sse += delta * delta;
+    }
+  }
+  return (sse);
+}
+
+/*-----------------------------------------------------
+  mrisRigidBodyFFTScores() - approximate scores for every candidate
+  of the rigid body grid, scores[(ia*nangles + ib)*nangles + ig].
+
+  MRISrotate(alpha, beta, gamma) applies the rotation about z by
+  alpha last, and a rotation about z is a cyclic shift along the
+  theta axis of the template parameterization. So for each (beta,
+  gamma) the curvatures are binned once onto the parameterization at
+  their rotated positions. The std-weighted squared error against
+  the template for all theta shifts then follows from three
+  row-wise circular correlations, done with FFTs and summed in the
+  frequency domain. The scores of the grid alphas are interpolated
+  between neighbouring shifts.
+
+  This is a squared error on the template grid rather than the
+  per-vertex error of mrisComputeCorrelationError, so it is only used
+  to rank candidates. Returns ERROR_UNSUPPORTED if the number of
+  theta samples is not a power of 2.
+  ------------------------------------------------------*/
+static int mrisRigidBodyFFTScores(
+    MRI_SURFACE *mris, INTEGRATION_PARMS *parms, double *angles, int nangles, double *scores)
+{
+  MRI_SP *mrisp = parms->mrisp_template;
+  int udim, vdim, u, v, k, vno, ia, ib, ig, k0, k1, n;
+  float *tmpl_re, *tmpl_im, *nbins, *s1bins, *s2bins, *re, *im, *sum_re, *sum_im;
+  float mean, std, w, x, y, z, xp, yp, zp, ca, cb, cg, sa, sb, sg, phi, theta;
+  double kf, dk;
+
+  udim = U_DIM(mrisp);
+  vdim = V_DIM(mrisp);
+  if (!FFTisPowerOf2(vdim)) {
+    return (ERROR_UNSUPPORTED);
+  }
+
+  /* spectra of the three template terms of each row:
+     1/std^2, mean/std^2 and mean^2/std^2 */
+  tmpl_re = (float *)calloc(3 * udim * vdim, sizeof(float));
+  tmpl_im = (float *)calloc(3 * udim * vdim, sizeof(float));
+  nbins = (float *)calloc(udim * vdim, sizeof(float));
+  s1bins = (float *)calloc(udim * vdim, sizeof(float));
+  s2bins = (float *)calloc(udim * vdim, sizeof(float));
+  re = (float *)calloc(vdim, sizeof(float));
+  im = (float *)calloc(vdim, sizeof(float));
+  sum_re = (float *)calloc(vdim, sizeof(float));
+  sum_im = (float *)calloc(vdim, sizeof(float));
+  if (!tmpl_re || !tmpl_im || !nbins || !s1bins || !s2bins || !re || !im || !sum_re || !sum_im) {
+    ErrorExit(ERROR_NOMEMORY, "mrisRigidBodyFFTScores: could not allocate %dx%d buffers", udim, vdim);
+  }
+  for (u = 0; u < udim; u++) {
+    for (v = 0; v < vdim; v++) {
+      mean = *IMAGEFseq_pix(mrisp->Ip, u, v, parms->frame_no);
+      std = sqrt(*IMAGEFseq_pix(mrisp->Ip, u, v, parms->frame_no + 1));
+      if (FZERO(std)) {
+        std = DEFAULT_STD;
+      }
+      w = 1.0f / (std * std);
+      tmpl_re[(0 * udim + u) * vdim + v] = w;
+      tmpl_re[(1 * udim + u) * vdim + v] = mean * w;
+      tmpl_re[(2 * udim + u) * vdim + v] = mean * mean * w;
+    }
+    for (k = 0; k < 3; k++) {
+      CFFTforward(&tmpl_re[(k * udim + u) * vdim], &tmpl_im[(k * udim + u) * vdim], vdim);
+    }
+  }
+
+  for (ib = 0; ib < nangles; ib++) {
+    for (ig = 0; ig < nangles; ig++) {
+      /* bin the curvatures at their positions rotated by (0, beta, gamma) */
+      sb = sin((float)angles[ib]);
+      cb = cos((float)angles[ib]);
+      sg = sin((float)angles[ig]);
+      cg = cos((float)angles[ig]);
+      ca = 1.0f;
+      sa = 0.0f;
+      memset(nbins, 0, udim * vdim * sizeof(float));
+      memset(s1bins, 0, udim * vdim * sizeof(float));
+      memset(s2bins, 0, udim * vdim * sizeof(float));
+      for (vno = 0; vno < mris->nvertices; vno++) {
+        VERTEX *vertex = &mris->vertices[vno];
+        if (vertex->ripflag) {
+          continue;
+        }
+        x = vertex->x;
+        y = vertex->y;
+        z = vertex->z;
+        xp = x * ca * cb + z * (-ca * cg * sb - sa * sg) + y * (cg * sa - ca * sb * sg);
+        yp = -x * cb * sa + z * (cg * sa * sb - ca * sg) + y * (ca * cg + sa * sb * sg);
+        zp = z * cb * cg + x * sb + y * cb * sg;
+        theta = atan2(yp, xp);
+        if (theta < 0.0f) {
+          theta += 2 * M_PI;
+        }
+        phi = atan2(sqrt(xp * xp + yp * yp), zp);
+        u = nint(PHI_DIM(mrisp) * phi / PHI_MAX);
+        u = MAX(0, MIN(udim - 1, u));
+        v = nint(THETA_DIM(mrisp) * theta / THETA_MAX) % vdim;
+        nbins[u * vdim + v] += 1.0f;
+        s1bins[u * vdim + v] += vertex->curv;
+        s2bins[u * vdim + v] += vertex->curv * vertex->curv;
+      }
+
+      /* sum over rows of S2 (x) W - 2 S1 (x) MW + N (x) M2W in the
+         frequency domain, where (x) is circular cross-correlation */
+      memset(sum_re, 0, vdim * sizeof(float));
+      memset(sum_im, 0, vdim * sizeof(float));
+      for (u = 0; u < udim; u++) {
+        for (n = v = 0; v < vdim; v++) {
+          if (nbins[u * vdim + v] > 0) {
+            n++;
+          }
+        }
+        if (n == 0) {
+          continue;
+        }
+        for (k = 0; k < 3; k++) {
+          float *bins = k == 0 ? s2bins : (k == 1 ? s1bins : nbins);
+          float scale = k == 1 ? -2.0f : 1.0f;
+          float *tre = &tmpl_re[(k * udim + u) * vdim], *tim = &tmpl_im[(k * udim + u) * vdim];
+
+          memcpy(re, &bins[u * vdim], vdim * sizeof(float));
+          memset(im, 0, vdim * sizeof(float));
+          CFFTforward(re, im, vdim);
+          for (v = 0; v < vdim; v++) {
+            sum_re[v] += scale * (re[v] * tre[v] + im[v] * tim[v]);
+            sum_im[v] += scale * (im[v] * tre[v] - re[v] * tim[v]);
+          }
+        }
+      }
+      CFFTbackward(sum_re, sum_im, vdim);
+
+      /* alpha rotates theta by -alpha, i.e. a shift of alpha columns */
+      for (ia = 0; ia < nangles; ia++) {
+        kf = THETA_DIM(mrisp) * angles[ia] / THETA_MAX;
+        k0 = (int)floor(kf);
+        dk = kf - k0;
+        k1 = k0 + 1;
+        k0 = ((k0 % vdim) + vdim) % vdim;
+        k1 = ((k1 % vdim) + vdim) % vdim;
+        scores[(ia * nangles + ib) * nangles + ig] = (1.0 - dk) * sum_re[k0] + dk * sum_re[k1];
+      }
+    }
+  }
+
+  free(tmpl_re);
+  free(tmpl_im);
+  free(nbins);
+  free(s1bins);
+  free(s2bins);
+  free(re);
+  free(im);
+  free(sum_re);
+  free(sum_im);
+  return (NO_ERROR);
+}
+
+static const double *mris_rigid_fft_scores;
+static int mrisCompareRigidBodyScores(const void *p1, const void *p2)
+{
+  int i1 = *(const int *)p1, i2 = *(const int *)p2;
+
+  if (mris_rigid_fft_scores[i1] < mris_rigid_fft_scores[i2]) return (-1);
+  if (mris_rigid_fft_scores[i1] > mris_rigid_fft_scores[i2]) return (1);
+  return (i1 - i2);
+}
+
 #define STARTING_ANGLE RADIANS(16.0f)
 #define ENDING_ANGLE RADIANS(4.0f)
 #define NANGLES 8
@@ -31733,13 +32010,18 @@ int MRISrigidBodyAlignVectorLocal(MRI_SURFACE *mris, INTEGRATION_PARMS *old_parm
 int MRISrigidBodyAlignGlobal(
     MRI_SURFACE *mris, INTEGRATION_PARMS *parms, float min_degrees, float max_degrees, int nangles)
 {
-  double alpha, beta, gamma, degrees, delta, mina, minb, ming, sse, min_sse, ext_sse;
+  double alpha, beta, gamma, degrees, delta, mina, minb, ming, sse, min_sse, ext_sse, *angles;
   int old_status = mris->status, old_norm, msec;
   struct timeb mytimer;
 
   printf("Starting MRISrigidBodyAlignGlobal()\n");
   TimerStart(&mytimer);
 
+  angles = (double *)calloc(nangles + 3, sizeof(double));
+  if (!angles) {
+    ErrorExit(ERROR_NOMEMORY, "MRISrigidBodyAlignGlobal: could not allocate %d angles", nangles + 3);
+  }
+
   old_norm = parms->abs_norm;
   parms->abs_norm = 1;
   min_degrees = RADIANS(min_degrees);
@@ -31772,47 +32054,142 @@ int MRISrigidBodyAlignGlobal(
       fprintf(stdout, "scanning %2.2f degree nbhd, min sse = %2.2f\n", (float)DEGREES(degrees), (float)min_sse);
     }
 
-    for (alpha = -degrees; alpha <= degrees; alpha += delta) {
-      for (beta = -degrees; beta <= degrees; beta += delta) {
-        if (Gdiag & DIAG_SHOW) {
-          fprintf(stdout,
-                  "\r(%+2.2f, %+2.2f, %+2.2f), "
-                  "min @ (%2.2f, %2.2f, %2.2f) = %2.1f   ",
-                  (float)DEGREES(alpha),
-                  (float)DEGREES(beta),
-                  (float)DEGREES(-degrees),
-                  (float)DEGREES(mina),
-                  (float)DEGREES(minb),
-                  (float)DEGREES(ming),
-                  (float)min_sse);
-        }
-
-        for (gamma = -degrees; gamma <= degrees; gamma += delta) {
-          MRISsaveVertexPositions(mris, TMP_VERTICES);
-          MRISrotate(mris, mris, alpha, beta, gamma);
-          sse = mrisComputeCorrelationError(mris, parms, 1); /* was 0 !!!! */
-          if (gMRISexternalSSE) {
-            ext_sse = (*gMRISexternalSSE)(mris, parms);
-            sse += ext_sse;
+    if (gMRISexternalSSE) {
+      /* the external term may depend on any part of the surface, so
+         rotate it in place and score the candidates one at a time */
+      for (alpha = -degrees; alpha <= degrees; alpha += delta) {
+        for (beta = -degrees; beta <= degrees; beta += delta) {
+          if (Gdiag & DIAG_SHOW) {
+            fprintf(stdout,
+                    "\r(%+2.2f, %+2.2f, %+2.2f), "
+                    "min @ (%2.2f, %2.2f, %2.2f) = %2.1f   ",
+                    (float)DEGREES(alpha),
+                    (float)DEGREES(beta),
+                    (float)DEGREES(-degrees),
+                    (float)DEGREES(mina),
+                    (float)DEGREES(minb),
+                    (float)DEGREES(ming),
+                    (float)min_sse);
           }
-          MRISrestoreVertexPositions(mris, TMP_VERTICES);
-          if (sse < min_sse) {
-            mina = alpha;
-            minb = beta;
-            ming = gamma;
-            min_sse = sse;
+
+          for (gamma = -degrees; gamma <= degrees; gamma += delta) {
+            MRISsaveVertexPositions(mris, TMP_VERTICES);
+            MRISrotate(mris, mris, alpha, beta, gamma);
+            sse = mrisComputeCorrelationError(mris, parms, 1); /* was 0 !!!! */
+            if (gMRISexternalSSE) {
+              ext_sse = (*gMRISexternalSSE)(mris, parms);
+              sse += ext_sse;
+            }
+            MRISrestoreVertexPositions(mris, TMP_VERTICES);
+            if (sse < min_sse) {
+              mina = alpha;
+              minb = beta;
+              ming = gamma;
+              min_sse = sse;
+            }
+  #if 0
+            if (Gdiag & DIAG_SHOW)
+              fprintf(stdout, "\r(%+2.2f, %+2.2f, %+2.2f), "
+                      "min @ (%2.2f, %2.2f, %2.2f) = %2.1f   ",
+                      (float)DEGREES(alpha), (float)DEGREES(beta), (float)
+                      DEGREES(gamma), (float)DEGREES(mina),
+                      (float)DEGREES(minb), (float)DEGREES(ming),(float)min_sse);
+  #endif
+          }  // gamma
+        }    // beta
+      }      // alpha
+    }
+    else {
+      /* the candidates only differ in the rotation applied, so score
+         them all concurrently and then pick the minimum in the order
+         the serial scan would have visited them */
+      int nalpha, ncand, n, ia, ib, ig, *order = NULL, ntop;
+      double *cand_sse, *proxy = NULL;
+      char *scored;
+
+      nalpha = mrisRigidBodyAngles(degrees, delta, angles, nangles + 3);
+      ncand = nalpha * nalpha * nalpha;
+      cand_sse = (double *)calloc(ncand, sizeof(double));
+      scored = (char *)calloc(ncand, sizeof(char));
+      if (!cand_sse || !scored) {
+        ErrorExit(ERROR_NOMEMORY, "MRISrigidBodyAlignGlobal: could not allocate %d candidates", ncand);
+      }
+
+      /* optionally rank the grid with the FFT proxy and only score the
+         best candidates exactly. Once the grid is finer than the
+         template sampling the proxy can no longer tell candidates apart */
+      ntop = ncand;
+      if ((parms->flags & IP_RIGID_ALIGN_FFT) &&
+          delta >= 2 * THETA_MAX / THETA_DIM(parms->mrisp_template)) {
+        proxy = (double *)calloc(ncand, sizeof(double));
+        order = (int *)calloc(ncand, sizeof(int));
+        if (!proxy || !order) {
+          ErrorExit(ERROR_NOMEMORY, "MRISrigidBodyAlignGlobal: could not allocate %d candidates", ncand);
+        }
+        if (mrisRigidBodyFFTScores(mris, parms, angles, nalpha, proxy) == NO_ERROR) {
+          for (n = 0; n < ncand; n++) {
+            order[n] = n;
           }
-#if 0
-          if (Gdiag & DIAG_SHOW)
-            fprintf(stdout, "\r(%+2.2f, %+2.2f, %+2.2f), "
-                    "min @ (%2.2f, %2.2f, %2.2f) = %2.1f   ",
-                    (float)DEGREES(alpha), (float)DEGREES(beta), (float)
-                    DEGREES(gamma), (float)DEGREES(mina),
-                    (float)DEGREES(minb), (float)DEGREES(ming),(float)min_sse);
+          mris_rigid_fft_scores = proxy;
+          qsort(order, ncand, sizeof(int), mrisCompareRigidBodyScores);
+          mris_rigid_fft_scores = NULL;
+          ntop = MIN(ncand, 2 * nalpha);
+        }
+        else {
+          free(order);
+          order = NULL;
+        }
+      }
+
+      ROMP_PF_begin
+#ifdef HAVE_OPENMP
+      #pragma omp parallel for if_ROMP(shown_reproducible) private(ia, ib, ig)
 #endif
-        }  // gamma
-      }    // beta
-    }      // alpha
+      for (n = 0; n < ntop; n++) {
+        ROMP_PFLB_begin
+        int c = order ? order[n] : n;
+        ia = c / (nalpha * nalpha);
+        ib = (c / nalpha) % nalpha;
+        ig = c % nalpha;
+        cand_sse[c] = mrisRigidBodyCandidateSSE(mris, parms, angles[ia], angles[ib], angles[ig]);
+        scored[c] = 1;
+        ROMP_PFLB_end
+      }
+      ROMP_PF_end
+
+      for (ia = 0; ia < nalpha; ia++) {
+        for (ib = 0; ib < nalpha; ib++) {
+          for (ig = 0; ig < nalpha; ig++) {
+            n = (ia * nalpha + ib) * nalpha + ig;
+            if (scored[n] && cand_sse[n] < min_sse) {
+              mina = angles[ia];
+              minb = angles[ib];
+              ming = angles[ig];
+              min_sse = cand_sse[n];
+            }
+          }
+        }
+      }
+      if (Gdiag & DIAG_SHOW) {
+        fprintf(stdout,
+                "%d of %d candidates scored, min @ (%2.2f, %2.2f, %2.2f) = %2.1f",
+                ntop,
+                ncand,
+                (float)DEGREES(mina),
+                (float)DEGREES(minb),
+                (float)DEGREES(ming),
+                (float)min_sse);
+      }
+
+      free(cand_sse);
+      free(scored);
+      if (proxy) {
+        free(proxy);
+      }
+      if (order) {
+        free(order);
+      }
+    }
 
     if (Gdiag & DIAG_SHOW) {
       fprintf(stdout, "\n");
@@ -31868,6 +32245,7 @@ int MRISrigidBodyAlignGlobal(
     }
   }  // degrees
 
+  free(angles);
   mris->status = old_status;
   parms->abs_norm = old_norm;
 
@@ -45013,8 +45391,35 @@ typedef struct
   /* keep track of the result for the past iterations */
   int *nused;
   float *vertex_fitness;
+
+  /* defect vertices used by the last scored patch, and their displacements */
+  char *vertex_used;
+  float *vertex_displacement;
+
+  struct DEFECT_FITNESS_CACHE *fitness_cache; /* patches already scored */
 } RANDOM_PATCH, RP;
 
+/* fitness of a patch already scored during the search, keyed by the set
+   of edges it uses and the defect vertices it keeps */
+typedef struct
+{
+  unsigned long hash1, hash2;
+  int nused;
+  double fitness;
+  TP tp; /* likelihood terms, without the vertex, face and edge lists */
+  float *curvbak; /* displacements of the defect vertices, used by the vertex statistics */
+} DEFECT_FITNESS_ENTRY;
+
+typedef struct DEFECT_FITNESS_CACHE
+{
+  DEFECT_FITNESS_ENTRY *entries; /* open addressing, size is a power of 2 */
+  int size;
+  int nentries;
+  int nhits;
+} DEFECT_FITNESS_CACHE;
+
+#define DEFECT_FITNESS_CACHE_MAX_ENTRIES (1 << 20)
+
 typedef struct
 {
   float c_x, c_y, c_z;    /* canonical coordinates */
@@ -45329,6 +45734,23 @@ static int mrisMarkRetainedPartOfDefect(MRI_SURFACE *mris,
                                         int mark_discard,
                                         MHT *mht,
                                         int mode);
+/* candidate edges of one defect, built ahead of its retessellation */
+typedef struct
+{
+  EDGE *et;      /* candidate edges, sorted by cost */
+  int nedges;
+  ES *es;        /* edges of the original tessellation */
+  int nes;
+  int nvertices; /* kept defect vertices plus border */
+  int npairs;    /* vertex pairs considered */
+} DEFECT_EDGE_TABLE;
+
+static int mrisBuildDefectEdgeTable(MRI_SURFACE *mris,
+                                    MRI_SURFACE *mris_corrected,
+                                    DEFECT *defect,
+                                    int *vertex_trans,
+                                    MRI *mri,
+                                    DEFECT_EDGE_TABLE *table);
 static int mrisTessellateDefect(MRI_SURFACE *mris,
                                 MRI_SURFACE *mris_corrected,
                                 DEFECT *defect,
@@ -45343,7 +45765,8 @@ static int mrisTessellateDefect(MRI_SURFACE *mris,
                                 HISTOGRAM *h_grad,
                                 MRI *mri_gray_white,
                                 HISTOGRAM *h_dot,
-                                TOPOLOGY_PARMS *parms);
+                                TOPOLOGY_PARMS *parms,
+                                DEFECT_EDGE_TABLE *prebuilt);
 static int mrisDefectRemoveDegenerateVertices(MRI_SURFACE *mris, float min_sphere_dist, DEFECT *defect);
 static int mrisDefectRemoveProximalVertices(MRI_SURFACE *mris, float min_orig_dist, DEFECT *defect);
 static int mrisDefectRemoveNegativeVertices(MRI_SURFACE *mris, DEFECT *defect);
@@ -45392,8 +45815,8 @@ static void computeDefectSecondFundamentalForm(MRIS *mris, TP *tp);
 // static void computeDefectMetricProperties(MRIS *mris,TP * tp);
 static void printDefectStatistics(DP *dp);
 static void computeDisplacement(MRI_SURFACE *mris, DP *dp);
-static void updateVertexStatistics(
-    MRIS *mris, MRIS *mris_corrected, DVS *dvs, RP *rp, DP *dp, int *vertex_trans, float fitness);
+static void collectVertexStatistics(MRIS *mris_corrected, DP *dp, int *vertex_trans, char *used, float *displacement);
+static void applyVertexStatistics(RP *rp, DEFECT *defect, char const *used, float const *displacement, float fitness);
 static int deleteWorstVertices(MRIS *mris, RP *rp, DEFECT *defect, int *vertex_trans, float fraction, int count);
 static double mrisDefectPatchFitness(
     ComputeDefectContext* computeDefectContext,
@@ -47649,22 +48072,16 @@ static void savePatch(MRI *mri, MRIS *mris, MRIS *mris_corrected, DVS *dvs, DP *
   TPfree(&dp->tp);
 }
 
-static void updateVertexStatistics(
-    MRIS *mris, MRIS *mris_corrected, DVS *dvs, RP *rp, DP *dp, int *vertex_trans, float fitness)
+/* marks the defect vertices used by the retessellated patch and records
+   their displacements; the statistics themselves are updated by
+   applyVertexStatistics, so that patches scored concurrently can be
+   accounted for in a fixed order */
+static void collectVertexStatistics(MRIS *mris_corrected, DP *dp, int *vertex_trans, char *used, float *displacement)
 {
   DEFECT *defect;
   EDGE_TABLE *etable;
   int i, nedges;
-  float total_vertex_fitness = 0.f, new_fitness;
   VERTEX *v;
-  static int first_time = 1;
-
-  // TO UPDATE TO BE CHECKED
-  if (first_time) {
-    first_time = 0;
-  };
-
-  fitness = 1.0f;  // to be updated ...
 
   nedges = dp->nedges;
   etable = dp->etable;
@@ -47682,15 +48099,40 @@ static void updateVertexStatistics(
     mris_corrected->vertices[vertex_trans[defect->border[i]]].marked = 0;
   }
 
-  /* then compute the total fitness of these used vertices */
-  total_vertex_fitness = 0.0f;
+  /* record the used vertices and reset marks to zero */
   for (i = 0; i < defect->nvertices; i++) {
+    used[i] = 0;
+    displacement[i] = 0.0f;
     if (defect->status[i] == DISCARD_VERTEX) {
       continue;
     }
     v = &mris_corrected->vertices[vertex_trans[defect->vertices[i]]];
     if (v->marked == FINAL_VERTEX) {
-      total_vertex_fitness += v->curvbak * fitness;
+      used[i] = 1;
+      displacement[i] = v->curvbak;
+    }
+    v->marked = 0;
+  }
+}
+
+static void applyVertexStatistics(RP *rp, DEFECT *defect, char const *used, float const *displacement, float fitness)
+{
+  int i;
+  float total_vertex_fitness = 0.f, new_fitness;
+  static int first_time = 1;
+
+  // TO UPDATE TO BE CHECKED
+  if (first_time) {
+    first_time = 0;
+  };
+
+  fitness = 1.0f;  // to be updated ...
+
+  /* then compute the total fitness of these used vertices */
+  total_vertex_fitness = 0.0f;
+  for (i = 0; i < defect->nvertices; i++) {
+    if (used[i]) {
+      total_vertex_fitness += displacement[i] * fitness;
     }
   }
 
@@ -47701,18 +48143,13 @@ static void updateVertexStatistics(
   total_vertex_fitness /= 100.0f;
   total_vertex_fitness = 1.0f;  // TO BE CHECKED
 
-  /* finally update statistics and reset marks to zero */
+  /* finally update statistics */
   for (i = 0; i < defect->nvertices; i++) {
-    if (defect->status[i] == DISCARD_VERTEX) {
-      continue;
-    }
-    v = &mris_corrected->vertices[vertex_trans[defect->vertices[i]]];
-    if (v->marked == FINAL_VERTEX) {
-      new_fitness = (v->curvbak * fitness / total_vertex_fitness) + (float)rp->nused[i] * rp->vertex_fitness[i];
+    if (used[i]) {
+      new_fitness = (displacement[i] * fitness / total_vertex_fitness) + (float)rp->nused[i] * rp->vertex_fitness[i];
       rp->vertex_fitness[i] = new_fitness / ((float)rp->nused[i] + 1.0f);
       rp->nused[i]++;
     }
-    v->marked = 0;
   }
 }
 
@@ -50370,7 +50807,184 @@ static void computeDisplacement(MRI_SURFACE *mris, DP *dp)
   }
 }
 
-static double mrisDefectPatchFitness(
+static DEFECT_FITNESS_CACHE *defectFitnessCacheAlloc(void)
+{
+  DEFECT_FITNESS_CACHE *cache;
+
+  cache = (DEFECT_FITNESS_CACHE *)calloc(1, sizeof(DEFECT_FITNESS_CACHE));
+  if (!cache) {
+    ErrorExit(ERROR_NOMEMORY, "defectFitnessCacheAlloc: could not allocate cache");
+  }
+  cache->size = 1024;
+  cache->entries = (DEFECT_FITNESS_ENTRY *)calloc(cache->size, sizeof(DEFECT_FITNESS_ENTRY));
+  if (!cache->entries) {
+    ErrorExit(ERROR_NOMEMORY, "defectFitnessCacheAlloc: could not allocate %d entries", cache->size);
+  }
+  return (cache);
+}
+
+static void defectFitnessCacheFree(DEFECT_FITNESS_CACHE **pcache)
+{
+  DEFECT_FITNESS_CACHE *cache = *pcache;
+  int i;
+
+  if (!cache) {
+    return;
+  }
+  if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON)
+    fprintf(WHICH_OUTPUT, "%d patches scored, %d duplicates not rescored\n", cache->nentries, cache->nhits);
+  for (i = 0; i < cache->size; i++) {
+    if (cache->entries[i].curvbak) {
+      free(cache->entries[i].curvbak);
+    }
+  }
+  free(cache->entries);
+  free(cache);
+  *pcache = NULL;
+}
+
+/* two independent hashes of the retessellated patch: the edges of the
+   table it uses, the status of the defect vertices and the mode */
+static void defectPatchKey(DP *dp, unsigned long *phash1, unsigned long *phash2, int *pnused)
+{
+  unsigned long hash1, hash2;
+  int i, nused, used;
+  EDGE_TABLE *etable = dp->etable;
+  DEFECT *defect = dp->defect;
+
+  hash1 = fnv_init();
+  hash2 = fnv_init() ^ 0x9e3779b9;
+  for (nused = i = 0; i < dp->nedges; i++) {
+    used = etable->edges[i].used;
+    if (used == USED_IN_NEW_TESSELLATION || used == USED_IN_BOTH_TESSELLATION) {
+      hash1 = fnv_add(hash1, (const unsigned char *)&i, sizeof(i));
+      hash2 = fnv_add(hash2, (const unsigned char *)&i, sizeof(i));
+      hash2 = fnv_add(hash2, (const unsigned char *)&nused, sizeof(nused));
+      nused++;
+    }
+  }
+  hash1 = fnv_add(hash1, (const unsigned char *)defect->status, defect->nvertices);
+  hash2 = fnv_add(hash2, (const unsigned char *)defect->status, defect->nvertices);
+  hash1 = fnv_add(hash1, (const unsigned char *)&dp->retessellation_mode, sizeof(dp->retessellation_mode));
+  hash2 = fnv_add(hash2, (const unsigned char *)&dp->retessellation_mode, sizeof(dp->retessellation_mode));
+
+  *phash1 = hash1;
+  *phash2 = hash2;
+  *pnused = nused;
+}
+
+static DEFECT_FITNESS_ENTRY *defectFitnessCacheFind(DEFECT_FITNESS_CACHE *cache,
+                                                     unsigned long hash1,
+                                                     unsigned long hash2,
+                                                     int nused,
+                                                     int *pfound)
+{
+  int i;
+  DEFECT_FITNESS_ENTRY *entry;
+
+  for (i = hash1 & (cache->size - 1);; i = (i + 1) & (cache->size - 1)) {
+    entry = &cache->entries[i];
+    if (entry->nused == 0 && entry->hash1 == 0 && entry->hash2 == 0) {
+      *pfound = 0;
+      return (entry);
+    }
+    if (entry->hash1 == hash1 && entry->hash2 == hash2 && entry->nused == nused + 1) {
+      *pfound = 1;
+      return (entry);
+    }
+  }
+}
+
+static void defectFitnessCacheInsert(
+    DEFECT_FITNESS_CACHE *cache, unsigned long hash1, unsigned long hash2, int nused, MRIS *mris, DP *dp)
+{
+  DEFECT_FITNESS_ENTRY *entry, *old_entries;
+  DEFECT *defect = dp->defect;
+  int found, i, old_size;
+
+  if (cache->nentries >= DEFECT_FITNESS_CACHE_MAX_ENTRIES) {
+    return;
+  }
+
+  /* keep the table at most half full */
+  if (2 * (cache->nentries + 1) > cache->size) {
+    old_entries = cache->entries;
+    old_size = cache->size;
+    cache->size *= 2;
+    cache->entries = (DEFECT_FITNESS_ENTRY *)calloc(cache->size, sizeof(DEFECT_FITNESS_ENTRY));
+    if (!cache->entries) {
+      ErrorExit(ERROR_NOMEMORY, "defectFitnessCacheInsert: could not allocate %d entries", cache->size);
+    }
+    for (i = 0; i < old_size; i++) {
+      if (old_entries[i].nused > 0) {
+        entry = defectFitnessCacheFind(
+            cache, old_entries[i].hash1, old_entries[i].hash2, old_entries[i].nused - 1, &found);
+        *entry = old_entries[i];
+      }
+    }
+    free(old_entries);
+  }
+
+  entry = defectFitnessCacheFind(cache, hash1, hash2, nused, &found);
+  if (found) {
+    return;
+  }
+  entry->hash1 = hash1;
+  entry->hash2 = hash2;
+  entry->nused = nused + 1; /* 0 marks an empty slot */
+  entry->fitness = dp->fitness;
+  entry->tp = dp->tp;
+  entry->tp.vertices = entry->tp.faces = entry->tp.edges = NULL;
+  entry->curvbak = (float *)calloc(defect->nvertices, sizeof(float));
+  if (!entry->curvbak) {
+    ErrorExit(ERROR_NOMEMORY, "defectFitnessCacheInsert: could not allocate %d displacements", defect->nvertices);
+  }
+  for (i = 0; i < defect->nvertices; i++) {
+    if (defect->status[i] != DISCARD_VERTEX) {
+      entry->curvbak[i] = mris->vertices[defect->vertex_trans[defect->vertices[i]]].curvbak;
+    }
+  }
+  cache->nentries++;
+}
+
+/* looks the patch up in the cache and, when it was already scored, restores
+   its fitness, its likelihood terms and the displacements of its vertices;
+   the cache may be shared by the threads scoring patches of the same defect */
+static int defectFitnessCacheLookup(
+    DEFECT_FITNESS_CACHE *cache, unsigned long hash1, unsigned long hash2, int nused, MRIS *mris, DP *dp)
+{
+  DEFECT_FITNESS_ENTRY *entry;
+  DEFECT *defect = dp->defect;
+  int found, i;
+
+#ifdef HAVE_OPENMP
+  #pragma omp critical(defectFitnessCache)
+#endif
+  {
+    entry = defectFitnessCacheFind(cache, hash1, hash2, nused, &found);
+    if (found) {
+      TP tp = entry->tp;
+
+      tp.vertices = dp->tp.vertices;
+      tp.faces = dp->tp.faces;
+      tp.edges = dp->tp.edges;
+      dp->tp = tp;
+      dp->fitness = entry->fitness;
+      /* the vertex statistics are weighted by the displacements of the patch */
+      for (i = 0; i < defect->nvertices; i++) {
+        if (defect->status[i] != DISCARD_VERTEX) {
+          mris->vertices[defect->vertex_trans[defect->vertices[i]]].curvbak = entry->curvbak[i];
+        }
+      }
+      cache->nhits++;
+    }
+  }
+  return (found);
+}
+
+/* retessellates the patch, scores it and restores the surface; the vertices
+   used by the patch are returned in used/displacement */
+static double mrisScoreDefectPatch(
     ComputeDefectContext* computeDefectContext,
     MRI_SURFACE *mris,
     MRI_SURFACE *mris_corrected,
@@ -50378,7 +50992,9 @@ static double mrisDefectPatchFitness(
     DEFECT_PATCH *dp,
     int *vertex_trans,
     DEFECT_VERTEX_STATE *dvs,
-    RP *rp,
+    DEFECT_FITNESS_CACHE *cache,
+    char *used,
+    float *displacement,
     HISTOGRAM *h_k1,
     HISTOGRAM *h_k2,
     MRI *mri_k1_k2,
@@ -50393,6 +51009,8 @@ static double mrisDefectPatchFitness(
   int i, euler;
   VERTEX *v;
   DEFECT *defect = dp->defect;
+  unsigned long hash1 = 0, hash2 = 0;
+  int nused = 0, found = 0;
 
   defect->vertex_trans = vertex_trans;
   dp->verbose_mode = parms->verbose;
@@ -50402,6 +51020,16 @@ static double mrisDefectPatchFitness(
 
   retessellateDefect(mris, mris_corrected, dvs, dp);    // BEVIN mris_fix_topology
 
+  /* the rest only depends on the retessellated patch, so a patch that
+     was already scored (e.g. a duplicate offspring) is not scored again */
+  if (cache) {
+    defectPatchKey(dp, &hash1, &hash2, &nused);
+    found = defectFitnessCacheLookup(cache, hash1, hash2, nused, mris_corrected, dp);
+  }
+  if (found) {
+    goto update_statistics;
+  }
+
   /* detect the new set of faces */
   detectDefectFaces(mris_corrected, dp);
 
@@ -50438,9 +51066,16 @@ static double mrisDefectPatchFitness(
   dp->fitness = mrisComputeDefectLogLikelihood(
       computeDefectContext,
       mris_corrected, mri, dp, h_k1, h_k2, mri_k1_k2, h_white, h_gray, h_border, h_grad, mri_gray_white, h_dot, parms);
+  if (cache) {
+#ifdef HAVE_OPENMP
+    #pragma omp critical(defectFitnessCache)
+#endif
+    defectFitnessCacheInsert(cache, hash1, hash2, nused, mris_corrected, dp);
+  }
 
-  /* update statistics */
-  updateVertexStatistics(mris, mris_corrected, dvs, rp, dp, vertex_trans, dp->fitness);
+update_statistics:
+  /* record the vertices used by the patch */
+  collectVertexStatistics(mris_corrected, dp, vertex_trans, used, displacement);
 
   /* restore the vertex state */
   mrisRestoreVertexState(mris_corrected, dvs);
@@ -50460,6 +51095,316 @@ static double mrisDefectPatchFitness(
   return (dp->fitness);
 }
 
+static double mrisDefectPatchFitness(
+    ComputeDefectContext* computeDefectContext,
+    MRI_SURFACE *mris,
+    MRI_SURFACE *mris_corrected,
+    MRI *mri,
+    DEFECT_PATCH *dp,
+    int *vertex_trans,
+    DEFECT_VERTEX_STATE *dvs,
+    RP *rp,
+    HISTOGRAM *h_k1,
+    HISTOGRAM *h_k2,
+    MRI *mri_k1_k2,
+    HISTOGRAM *h_white,
+    HISTOGRAM *h_gray,
+    HISTOGRAM *h_border,
+    HISTOGRAM *h_grad,
+    MRI *mri_gray_white,
+    HISTOGRAM *h_dot,
+    TOPOLOGY_PARMS *parms)
+{
+  mrisScoreDefectPatch(computeDefectContext,
+                       mris,
+                       mris_corrected,
+                       mri,
+                       dp,
+                       vertex_trans,
+                       dvs,
+                       rp->fitness_cache,
+                       rp->vertex_used,
+                       rp->vertex_displacement,
+                       h_k1,
+                       h_k2,
+                       mri_k1_k2,
+                       h_white,
+                       h_gray,
+                       h_border,
+                       h_grad,
+                       mri_gray_white,
+                       h_dot,
+                       parms);
+
+  /* update statistics */
+  applyVertexStatistics(rp, dp->defect, rp->vertex_used, rp->vertex_displacement, dp->fitness);
+
+  return (dp->fitness);
+}
+
+/* The offspring of a generation only depend on the previous generation, so
+   they can be scored concurrently if every thread retessellates into its own
+   copy of the corrected surface, with its own copy of the defect, of the edge
+   table flags and of the distance volume.  Copying the surface only pays off
+   for large defects. */
+#define DEFECT_PATCH_WORKERS_MIN_EDGES 1000
+
+typedef struct
+{
+  MRIS *mris_corrected;  /* private copy of the corrected surface */
+  DEFECT defect;         /* shares the vertex lists and the status with the defect */
+  EDGE_TABLE etable;     /* private 'used' flags, shared overlap lists */
+  DVS *dvs;              /* recorded on the private surface */
+  MRI *mri_defect_sign;  /* written by the likelihood */
+  ComputeDefectContext computeDefectContext;
+} DEFECT_PATCH_WORKER;
+
+/* the retessellation reallocates the vertex neighbor and face lists and
+   appends to the face tables, so those are private; the other per-vertex
+   arrays are shared with the source and only read */
+static MRIS *mrisCopyForDefectPatchWorker(MRIS *mris_src)
+{
+  MRIS *mris;
+  VERTEX *v, *vsrc;
+  int vno;
+
+  mris = (MRIS *)calloc(1, sizeof(MRIS));
+  if (!mris) {
+    ErrorExit(ERROR_NOMEMORY, "mrisCopyForDefectPatchWorker: could not allocate surface");
+  }
+  memmove(mris, mris_src, sizeof(MRIS));
+
+  mris->vertices = (VERTEX *)calloc(mris_src->max_vertices, sizeof(VERTEX));
+  mris->faces = (FACE *)calloc(mris_src->max_faces, sizeof(FACE));
+  mris->faceNormCacheEntries = (FaceNormCacheEntry *)calloc(mris_src->max_faces, sizeof(FaceNormCacheEntry));
+  mris->faceNormDeferredEntries = (FaceNormDeferredEntry *)calloc(mris_src->max_faces, sizeof(FaceNormDeferredEntry));
+  if (!mris->vertices || !mris->faces || !mris->faceNormCacheEntries || !mris->faceNormDeferredEntries)
+    ErrorExit(ERROR_NOMEMORY,
+              "mrisCopyForDefectPatchWorker: could not allocate %d vertices and %d faces",
+              mris_src->max_vertices,
+              mris_src->max_faces);
+  memmove(mris->vertices, mris_src->vertices, mris_src->nvertices * sizeof(VERTEX));
+  memmove(mris->faces, mris_src->faces, mris_src->nfaces * sizeof(FACE));
+  memmove(mris->faceNormCacheEntries, mris_src->faceNormCacheEntries, mris_src->nfaces * sizeof(FaceNormCacheEntry));
+  memmove(mris->faceNormDeferredEntries,
+          mris_src->faceNormDeferredEntries,
+          mris_src->nfaces * sizeof(FaceNormDeferredEntry));
+
+  if (mris_src->v_frontal_pole) {
+    mris->v_frontal_pole = &mris->vertices[mris_src->v_frontal_pole - mris_src->vertices];
+  }
+  if (mris_src->v_occipital_pole) {
+    mris->v_occipital_pole = &mris->vertices[mris_src->v_occipital_pole - mris_src->vertices];
+  }
+  if (mris_src->v_temporal_pole) {
+    mris->v_temporal_pole = &mris->vertices[mris_src->v_temporal_pole - mris_src->vertices];
+  }
+
+  for (vno = 0; vno < mris_src->nvertices; vno++) {
+    vsrc = &mris_src->vertices[vno];
+    v = &mris->vertices[vno];
+    v->v = NULL;
+    v->f = NULL;
+    v->n = NULL;
+    if (vsrc->v && vsrc->vtotal) {
+      v->v = (int *)calloc(vsrc->vtotal, sizeof(int));
+      if (!v->v) {
+        ErrorExit(ERROR_NOMEMORY, "mrisCopyForDefectPatchWorker: could not allocate %d nbrs", vsrc->vtotal);
+      }
+      memmove(v->v, vsrc->v, vsrc->vtotal * sizeof(int));
+    }
+    if (vsrc->num) {
+      v->f = (int *)calloc(vsrc->num, sizeof(int));
+      v->n = (uchar *)calloc(vsrc->num, sizeof(uchar));
+      if (!v->f || !v->n) {
+        ErrorExit(ERROR_NOMEMORY, "mrisCopyForDefectPatchWorker: could not allocate %d faces", vsrc->num);
+      }
+      memmove(v->f, vsrc->f, vsrc->num * sizeof(int));
+      memmove(v->n, vsrc->n, vsrc->num * sizeof(uchar));
+    }
+  }
+
+  return (mris);
+}
+
+static void mrisFreeDefectPatchWorkerCopy(MRIS **pmris)
+{
+  MRIS *mris = *pmris;
+  VERTEX *v;
+  int vno;
+
+  *pmris = NULL;
+  for (vno = 0; vno < mris->nvertices; vno++) {
+    v = &mris->vertices[vno];
+    free(v->v);
+    free(v->f);
+    free(v->n);
+  }
+  free(mris->vertices);
+  free(mris->faces);
+  free(mris->faceNormCacheEntries);
+  free(mris->faceNormDeferredEntries);
+  free(mris);
+}
+
+static DEFECT_PATCH_WORKER *defectPatchWorkersAlloc(
+    int nworkers, MRIS *mris_corrected, DVS *dvs, EDGE_TABLE *etable, MRI *mri_defect_sign)
+{
+  DEFECT_PATCH_WORKER *workers, *w;
+  int n;
+
+  workers = (DEFECT_PATCH_WORKER *)calloc(nworkers, sizeof(DEFECT_PATCH_WORKER));
+  if (!workers) {
+    ErrorExit(ERROR_NOMEMORY, "defectPatchWorkersAlloc: could not allocate %d workers", nworkers);
+  }
+
+  for (n = 0; n < nworkers; n++) {
+    w = &workers[n];
+    w->mris_corrected = mrisCopyForDefectPatchWorker(mris_corrected);
+    w->defect = *dvs->defect;
+    w->etable = *etable;
+    w->etable.edges = (EDGE *)calloc(etable->nedges, sizeof(EDGE));
+    if (!w->etable.edges) {
+      ErrorExit(ERROR_NOMEMORY, "defectPatchWorkersAlloc: could not allocate %d edges", etable->nedges);
+    }
+    memmove(w->etable.edges, etable->edges, etable->nedges * sizeof(EDGE));
+    w->dvs = mrisRecordVertexState(w->mris_corrected, &w->defect, dvs->vertex_trans);
+    w->mri_defect_sign = mri_defect_sign ? MRIcopy(mri_defect_sign, NULL) : NULL;
+    constructComputeDefectContext(&w->computeDefectContext);
+  }
+
+  return (workers);
+}
+
+static void defectPatchWorkersFree(DEFECT_PATCH_WORKER **pworkers, int nworkers)
+{
+  DEFECT_PATCH_WORKER *workers = *pworkers, *w;
+  int n;
+
+  *pworkers = NULL;
+  for (n = 0; n < nworkers; n++) {
+    w = &workers[n];
+    destructComputeDefectContext(&w->computeDefectContext);
+    mrisFreeDefectVertexState(w->dvs);
+    free(w->etable.edges);
+    if (w->mri_defect_sign) {
+      MRIfree(&w->mri_defect_sign);
+    }
+    mrisFreeDefectPatchWorkerCopy(&w->mris_corrected);
+  }
+  free(workers);
+}
+
+/* scores a batch of patches of the same defect, concurrently when there are
+   workers; the used vertices of the pth patch are returned in the pth row of
+   used/displacement, and the caller applies the vertex statistics in
+   population order so that the result does not depend on the threads */
+static void mrisScoreDefectPatches(
+    DEFECT_PATCH_WORKER *workers,
+    int nworkers,
+    ComputeDefectContext* computeDefectContext,
+    DP **dps,
+    int npatches,
+    char *used,
+    float *displacement,
+    MRI_SURFACE *mris,
+    MRI_SURFACE *mris_corrected,
+    MRI *mri,
+    int *vertex_trans,
+    DEFECT_VERTEX_STATE *dvs,
+    RP *rp,
+    HISTOGRAM *h_k1,
+    HISTOGRAM *h_k2,
+    MRI *mri_k1_k2,
+    HISTOGRAM *h_white,
+    HISTOGRAM *h_gray,
+    HISTOGRAM *h_border,
+    HISTOGRAM *h_grad,
+    MRI *mri_gray_white,
+    HISTOGRAM *h_dot,
+    TOPOLOGY_PARMS *parms)
+{
+  int const nvertices = dvs->defect->nvertices;
+  int i, n, p, vno;
+
+  if (nworkers == 0) {
+    for (p = 0; p < npatches; p++)
+      mrisScoreDefectPatch(computeDefectContext,
+                           mris,
+                           mris_corrected,
+                           mri,
+                           dps[p],
+                           vertex_trans,
+                           dvs,
+                           rp->fitness_cache,
+                           used + p * nvertices,
+                           displacement + p * nvertices,
+                           h_k1,
+                           h_k2,
+                           mri_k1_k2,
+                           h_white,
+                           h_gray,
+                           h_border,
+                           h_grad,
+                           mri_gray_white,
+                           h_dot,
+                           parms);
+    return;
+  }
+
+  /* pick up the vertices discarded since the last batch */
+  for (n = 0; n < nworkers; n++) {
+    for (i = 0; i < dvs->nvertices; i++) {
+      vno = dvs->vs[i].vno;
+      if (vno < 0) {
+        continue;
+      }
+      workers[n].mris_corrected->vertices[vno].ripflag = mris_corrected->vertices[vno].ripflag;
+    }
+  }
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible) schedule(dynamic, 1)
+#endif
+  for (p = 0; p < npatches; p++) {
+    ROMP_PFLB_begin
+    DEFECT_PATCH_WORKER *w = &workers[omp_get_thread_num()];
+    DP *dp = dps[p];
+    DP wdp = *dp;
+
+    wdp.defect = &w->defect;
+    wdp.etable = &w->etable;
+    wdp.mri_defect_sign = w->mri_defect_sign;
+    mrisScoreDefectPatch(&w->computeDefectContext,
+                         mris,
+                         w->mris_corrected,
+                         mri,
+                         &wdp,
+                         vertex_trans,
+                         w->dvs,
+                         rp->fitness_cache,
+                         used + p * nvertices,
+                         displacement + p * nvertices,
+                         h_k1,
+                         h_k2,
+                         mri_k1_k2,
+                         h_white,
+                         h_gray,
+                         h_border,
+                         h_grad,
+                         mri_gray_white,
+                         h_dot,
+                         parms);
+    wdp.defect = dp->defect;
+    wdp.etable = dp->etable;
+    wdp.mri_defect_sign = dp->mri_defect_sign;
+    *dp = wdp;
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
 static int mrisFreeDefectVertexState(DEFECT_VERTEX_STATE *dvs)
 {
   int i;
@@ -52335,6 +53280,110 @@ static int pushApartDefects(MRIS *mris, DEFECT_LIST *dl)
 //
 //////////////////////////////////////////////////////////////////////
 
+/*-----------------------------------------------------
+  mrisPrepareDefectBatch() - starting at defect first, collect the
+  defects that can be prepared together and build their edge tables
+  concurrently. A defect joins the batch if none of its vertices,
+  border, convex hull or their neighbors were claimed by an earlier
+  defect of the batch, so retessellating the earlier defects cannot
+  change its table. The batch is also cut once the tables would
+  hold more than DEFECT_BATCH_MAX_PAIRS candidate edges. The
+  retessellations themselves still run one at a time, in order.
+  Returns one past the last defect of the batch.
+  ------------------------------------------------------*/
+#define DEFECT_BATCH_MAX_PAIRS (1 << 23)
+
+static int mrisDefectFootprintClaimed(MRI_SURFACE *mris, int *vlist, int nv, int *stamp, int batch)
+{
+  int i, n;
+  VERTEX *v;
+
+  for (i = 0; i < nv; i++) {
+    v = &mris->vertices[vlist[i]];
+    if (stamp[vlist[i]] == batch) {
+      return (1);
+    }
+    for (n = 0; n < v->vnum; n++)
+      if (stamp[v->v[n]] == batch) {
+        return (1);
+      }
+  }
+  return (0);
+}
+
+static void mrisClaimDefectFootprint(MRI_SURFACE *mris, int *vlist, int nv, int *stamp, int batch)
+{
+  int i, n;
+  VERTEX *v;
+
+  for (i = 0; i < nv; i++) {
+    v = &mris->vertices[vlist[i]];
+    stamp[vlist[i]] = batch;
+    for (n = 0; n < v->vnum; n++) {
+      stamp[v->v[n]] = batch;
+    }
+  }
+}
+
+static int mrisPrepareDefectBatch(MRI_SURFACE *mris,
+                                  MRI_SURFACE *mris_corrected,
+                                  DEFECT_LIST *dl,
+                                  int first,
+                                  int *vertex_trans,
+                                  MRI *mri,
+                                  int *stamp,
+                                  DEFECT_EDGE_TABLE *tables)
+{
+  int i, last, nv, k;
+  double npairs, total_pairs;
+  DEFECT *defect;
+
+  for (total_pairs = 0.0, last = first; last < dl->ndefects; last++) {
+    defect = &dl->defects[last];
+    if (mrisDefectFootprintClaimed(mris, defect->vertices, defect->nvertices, stamp, first) ||
+        mrisDefectFootprintClaimed(mris, defect->border, defect->nborder, stamp, first) ||
+        mrisDefectFootprintClaimed(mris, defect->chull, defect->nchull, stamp, first)) {
+      break;
+    }
+    for (nv = defect->nborder, k = 0; k < defect->nvertices; k++)
+      if (defect->status[k] == KEEP_VERTEX) {
+        nv++;
+      }
+    npairs = 0.5 * nv * (nv - 1);
+    if (last > first && total_pairs + npairs > DEFECT_BATCH_MAX_PAIRS) {
+      break;
+    }
+    total_pairs += npairs;
+    mrisClaimDefectFootprint(mris, defect->vertices, defect->nvertices, stamp, first);
+    mrisClaimDefectFootprint(mris, defect->border, defect->nborder, stamp, first);
+    mrisClaimDefectFootprint(mris, defect->chull, defect->nchull, stamp, first);
+  }
+
+#if MATRIX_ALLOCATION
+  {
+    /* initialize its statics before the workers use it */
+    double xv, yv, zv;
+    mriSurfaceRASToVoxel(0, 0, 0, &xv, &yv, &zv);
+  }
+#endif
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(shown_reproducible) schedule(dynamic, 1)
+#endif
+  for (i = first; i < last; i++) {
+    ROMP_PFLB_begin
+    mrisBuildDefectEdgeTable(mris, mris_corrected, &dl->defects[i], vertex_trans, mri, &tables[i]);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  if (DIAG_VERBOSE_ON && last - first > 1)
+    fprintf(WHICH_OUTPUT, "prepared edge tables of defects %d to %d concurrently\n", first, last - 1);
+
+  return (last);
+}
+
 MRI_SURFACE *MRIScorrectTopology(
     MRI_SURFACE *mris, MRI_SURFACE *mris_corrected, MRI *mri, MRI *mri_wm, int nsmooth, TOPOLOGY_PARMS *parms)
 {
@@ -52348,6 +53397,8 @@ MRI_SURFACE *MRIScorrectTopology(
   HISTOGRAM *h_k1, *h_k2, *h_gray, *h_white, *h_dot, *h_border, *h_grad;
   MRI *mri_gray_white, *mri_k1_k2;
   MRIS *mris_corrected_final;
+  DEFECT_EDGE_TABLE *edge_tables = NULL;
+  int *defect_stamp = NULL, batch_end = 0;
 #if 0
   float              max_len ;
 #endif
@@ -52911,6 +53962,19 @@ MRI_SURFACE *MRIScorrectTopology(
     mrisComputeSurfaceStatistics(mris, mri, h_k1, h_k2, mri_k1_k2, mri_gray_white, h_dot);
 
   mrisMarkAllDefects(mris, dl, 0);
+
+  /* the edge tables of the plain retessellation can be built ahead of
+     time, a batch of independent defects at a time */
+  if (parms->correct_defect < 0 && !(parms->search_mode != GREEDY_SEARCH && parms->optimal_mapping)) {
+    edge_tables = (DEFECT_EDGE_TABLE *)calloc(dl->ndefects, sizeof(DEFECT_EDGE_TABLE));
+    defect_stamp = (int *)malloc(mris->nvertices * sizeof(int));
+    if (!edge_tables || !defect_stamp)
+      ErrorExit(ERROR_NOMEMORY, "MRIScorrectTopology: could not allocate %d edge tables", dl->ndefects);
+    for (vno = 0; vno < mris->nvertices; vno++) {
+      defect_stamp[vno] = -1;
+    }
+  }
+
   for (i = 0; i < dl->ndefects; i++) {
     if (parms->correct_defect >= 0 && i != parms->correct_defect) {
       continue;
@@ -52920,6 +53984,9 @@ MRI_SURFACE *MRIScorrectTopology(
     if (i == Gdiag_no) {
       DiagBreak();
     }
+    if (edge_tables && i >= batch_end) {
+      batch_end = mrisPrepareDefectBatch(mris, mris_corrected, dl, i, vertex_trans, mri, defect_stamp, edge_tables);
+    }
 #if 0
     fprintf(WHICH_OUTPUT,
             "\rretessellating defect %d with %d vertices (chull=%d).    ",
@@ -52980,7 +54047,8 @@ MRI_SURFACE *MRIScorrectTopology(
                            h_grad,
                            mri_gray_white,
                            h_dot,
-                           parms);
+                           parms,
+                           NULL);
 
 #if 1
       {
@@ -53115,7 +54183,8 @@ MRI_SURFACE *MRIScorrectTopology(
                                h_grad,
                                mri_gray_white,
                                h_dot,
-                               parms);
+                               parms,
+                               NULL);
 
 #if 1
           {
@@ -53221,7 +54290,8 @@ MRI_SURFACE *MRIScorrectTopology(
                            h_grad,
                            mri_gray_white,
                            h_dot,
-                           parms);
+                           parms,
+                           edge_tables ? &edge_tables[i] : NULL);
     }
 
     /* compute Euler number of surface */
@@ -53264,6 +54334,18 @@ MRI_SURFACE *MRIScorrectTopology(
     if (parms->correct_defect >= 0 && i == parms->correct_defect)
       ErrorExit(ERROR_BADPARM, "TERMINATING PROGRAM AFTER CORRECTED DEFECT\n");
   }
+  if (edge_tables) {
+    for (i = 0; i < dl->ndefects; i++) {
+      if (edge_tables[i].et) {
+        free(edge_tables[i].et);
+      }
+      if (edge_tables[i].es) {
+        free(edge_tables[i].es);
+      }
+    }
+    free(edge_tables);
+    free(defect_stamp);
+  }
 #if ADD_EXTRA_VERTICES
   if (retessellation_error >= 0) {
     fprintf(WHICH_OUTPUT,
@@ -59146,7 +60228,8 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
                                 HISTOGRAM *h_grad,
                                 MRI *mri_gray_white,
                                 HISTOGRAM *h_dot,
-                                TOPOLOGY_PARMS *parms);
+                                TOPOLOGY_PARMS *parms,
+                                DEFECT_EDGE_TABLE *prebuilt);
 				
 static int mrisTessellateDefect(MRI_SURFACE *mris,
                                 MRI_SURFACE *mris_corrected,
@@ -59162,7 +60245,8 @@ static int mrisTessellateDefect(MRI_SURFACE *mris,
                                 HISTOGRAM *h_grad,
                                 MRI *mri_gray_white,
                                 HISTOGRAM *h_dot,
-                                TOPOLOGY_PARMS *parms) {
+                                TOPOLOGY_PARMS *parms,
+                                DEFECT_EDGE_TABLE *prebuilt) {
   fprintf(stderr,
           "\nCORRECTING DEFECT %d (vertices=%d, convex hull=%d, v0=%d)\n",
           defect->defect_number,
@@ -59173,52 +60257,44 @@ static int mrisTessellateDefect(MRI_SURFACE *mris,
   // TIMER_INTERVAL_BEGIN(old);
   
   int result = mrisTessellateDefect_wkr(
-    mris,mris_corrected,defect,vertex_trans,mri,h_k1,h_k2,mri_k1_k2,h_white,h_gray,h_border,h_grad,mri_gray_white,h_dot,parms);
+    mris,mris_corrected,defect,vertex_trans,mri,h_k1,h_k2,mri_k1_k2,h_white,h_gray,h_border,h_grad,mri_gray_white,h_dot,parms,prebuilt);
 
   // TIMER_INTERVAL_END(old);
   
   return result;
 }
 				
-static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
-                                MRI_SURFACE *mris_corrected,
-                                DEFECT *defect,
-                                int *vertex_trans,
-                                MRI *mri,
-                                HISTOGRAM *h_k1,
-                                HISTOGRAM *h_k2,
-                                MRI *mri_k1_k2,
-                                HISTOGRAM *h_white,
-                                HISTOGRAM *h_gray,
-                                HISTOGRAM *h_border,
-                                HISTOGRAM *h_grad,
-                                MRI *mri_gray_white,
-                                HISTOGRAM *h_dot,
-                                TOPOLOGY_PARMS *parms)
+/*-----------------------------------------------------
+  mrisBuildDefectEdgeTable() - build the table of all possible edges
+  among the vertices in the defect and on its border, sorted by their
+  likelihood cost, without the edges that intersect one already in the
+  tessellation. Only reads the surfaces and the volume, so the tables
+  of defects that do not share any vertices or neighbors can be built
+  concurrently.
+  ------------------------------------------------------*/
+static int mrisBuildDefectEdgeTable(MRI_SURFACE *mris,
+                                    MRI_SURFACE *mris_corrected,
+                                    DEFECT *defect,
+                                    int *vertex_trans,
+                                    MRI *mri,
+                                    DEFECT_EDGE_TABLE *table)
 {
-  int i, j, vlist[MAX_DEFECT_VERTICES], n, nvertices, nedges, ndiscarded;
+  int i, j, *vlist, n, nvertices, nedges, ndiscarded;
   VERTEX *v, *v2;
   EDGE *et;
-  /*  double  cx, cy, cz, max_len ;*/
-  static int dno = 0;
   double x, y, z, xv, yv, zv, val0, val, total, dx, dy, dz, d, wval, gval, Ix, Iy, Iz;
   float norm1[3], norm2[3], nx, ny, nz;
   int nes; /* number of edges present in original tessellation */
   ES *es;  /* list of edges present in original tessellation */
-  /*generate an initial ordering*/
-  int *ordering = NULL;
 
+  memset(table, 0, sizeof(*table));
 
-  ROMP_PF_begin
-  
-  /* first build table of all possible edges among vertices in the defect
-     and on its border.
-  */
-  if (parms->search_mode != GREEDY_SEARCH)
-    computeDefectStatistics(mri, mris, defect, h_white, h_gray, mri_gray_white, h_k1, h_k2, mri_k1_k2, 0);
+  /* too big for the stack of a worker thread */
+  vlist = (int *)calloc(defect->nvertices + defect->nborder + 1, sizeof(int));
+  if (!vlist)
+    ErrorExit(ERROR_NOMEMORY, "mrisBuildDefectEdgeTable: could not allocate %d vertices",
+              defect->nvertices + defect->nborder);
 
-  /* first build table of all possible edges among vertices in the defect
-     and on its border.*/
   for (nes = nvertices = i = 0; i < defect->nvertices; i++) {
     if (nvertices >= MAX_DEFECT_VERTICES)
       ErrorExit(ERROR_NOMEMORY, "mrisTessellateDefect: too many vertices in defect (%d)", MAX_DEFECT_VERTICES);
@@ -59237,9 +60313,9 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
             defect->defect_number,
             nvertices,
             defect->nchull);
-  dno++;
   if (nvertices == 0) /* should never happen */
   {
+    free(vlist);
     return (NO_ERROR);
   }
 
@@ -59252,7 +60328,6 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
               "could not allocate %d edges for retessellation",
               nedges);
 
-  ROMP_PF_end
   
   n = 0;
   ROMP_PF_begin
@@ -59503,9 +60578,80 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
 
   /* sort the edge list by edge length */
   qsort(et, nedges, sizeof(EDGE), compare_edge_length);
+  free(vlist);
+
+  /* list the edges used in the original tessellation */
+  es = (ES *)malloc(nes * sizeof(ES));
+  for (nes = i = 0; i < nedges; i++)
+    if (et[i].used == USED_IN_ORIGINAL_TESSELLATION) {
+      // et[i].used=0; //reset state
+      es[nes].vno1 = et[i].vno1;
+      es[nes].vno2 = et[i].vno2;
+
+      es[nes].segment = -1;
+      es[nes++].n = i;
+    }
+
+  table->et = et;
+  table->nedges = nedges;
+  table->es = es;
+  table->nes = nes;
+  table->nvertices = nvertices;
+  table->npairs = n;
+  return (NO_ERROR);
+}
+
+static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
+                                MRI_SURFACE *mris_corrected,
+                                DEFECT *defect,
+                                int *vertex_trans,
+                                MRI *mri,
+                                HISTOGRAM *h_k1,
+                                HISTOGRAM *h_k2,
+                                MRI *mri_k1_k2,
+                                HISTOGRAM *h_white,
+                                HISTOGRAM *h_gray,
+                                HISTOGRAM *h_border,
+                                HISTOGRAM *h_grad,
+                                MRI *mri_gray_white,
+                                HISTOGRAM *h_dot,
+                                TOPOLOGY_PARMS *parms,
+                                DEFECT_EDGE_TABLE *prebuilt)
+{
+  int j, nedges;
+  EDGE *et;
+  static int dno = 0;
+  int nes; /* number of edges present in original tessellation */
+  ES *es;  /* list of edges present in original tessellation */
+  /*generate an initial ordering*/
+  int *ordering = NULL;
+  DEFECT_EDGE_TABLE table;
+
+  if (parms->search_mode != GREEDY_SEARCH)
+    computeDefectStatistics(mri, mris, defect, h_white, h_gray, mri_gray_white, h_k1, h_k2, mri_k1_k2, 0);
+
+  /* the table of candidate edges may have been built ahead of time */
+  if (prebuilt) {
+    table = *prebuilt;
+    memset(prebuilt, 0, sizeof(*prebuilt));
+  }
+  else {
+    mrisBuildDefectEdgeTable(mris, mris_corrected, defect, vertex_trans, mri, &table);
+  }
+  dno++;
+  if (table.nvertices == 0) /* should never happen */
+  {
+    return (NO_ERROR);
+  }
+  et = table.et;
+  nedges = table.nedges;
+  es = table.es;
+  nes = table.nes;
 
-  if (!n) /* should never happen */
+  if (!table.npairs) /* should never happen */
   {
+    free(es);
+    free(et);
     return (NO_ERROR);
   }
 
@@ -59541,17 +60687,6 @@ static int mrisTessellateDefect_wkr(MRI_SURFACE *mris,
   }
 #endif
 
-  /* list the edges used in the original tessellation */
-  es = (ES *)malloc(nes * sizeof(ES));
-  for (nes = i = 0; i < nedges; i++)
-    if (et[i].used == USED_IN_ORIGINAL_TESSELLATION) {
-      // et[i].used=0; //reset state
-      es[nes].vno1 = et[i].vno1;
-      es[nes].vno2 = et[i].vno2;
-
-      es[nes].segment = -1;
-      es[nes++].n = i;
-    }
 
   // main part of the routine: the retessellation (using a specific method) !
   if (getenv("USE_GA_TOPOLOGY_CORRECTION") != NULL) {
@@ -60265,6 +61400,11 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(MRI_SURFACE *mris,
   int number_of_patches, nbestpatch;
   int ncross_overs, ntotalcross_overs, ntotalmutations, nmutations;
   int nintersections;
+  DEFECT_PATCH_WORKER *workers = NULL;
+  DP *batch[MAX_PATCHES];
+  int nworkers = 0, parents1[MAX_PATCHES], parents2[MAX_PATCHES], mutated[MAX_PATCHES], nmutated, first_offspring;
+  char *batch_used = NULL;
+  float *batch_displacement = NULL;
   static int first_time = 1;
 
   nbestpatch = number_of_patches = 0;
@@ -60480,6 +61620,9 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(MRI_SURFACE *mris,
   memmove(rp.status, defect->status, defect->nvertices * sizeof(char));
   rp.nused = (int *)calloc(defect->nvertices, sizeof(int));
   rp.vertex_fitness = (float *)calloc(defect->nvertices, sizeof(float));
+  rp.vertex_used = (char *)calloc(defect->nvertices, sizeof(char));
+  rp.vertex_displacement = (float *)calloc(defect->nvertices, sizeof(float));
+  rp.fitness_cache = defectFitnessCacheAlloc();
 
   nbests = 0;
 
@@ -60898,6 +62041,16 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(MRI_SURFACE *mris,
 
   last_fitness = best_fitness;
 
+  /* the offspring of a generation are scored in batches */
+  batch_used = (char *)calloc(max_patches * defect->nvertices, sizeof(char));
+  batch_displacement = (float *)calloc(max_patches * defect->nvertices, sizeof(float));
+  if (!batch_used || !batch_displacement)
+    ErrorExit(ERROR_NOMEMORY, "could not allocate vertex statistics of %d patches", max_patches);
+  if (nedges >= DEFECT_PATCH_WORKERS_MIN_EDGES && omp_get_max_threads() > 1) {
+    nworkers = omp_get_max_threads();
+    workers = defectPatchWorkersAlloc(nworkers, mris_corrected, dvs, &etable, mri_defect_sign);
+  }
+
   ROMP_PF_end
 
   ROMP_PF_begin
@@ -60931,30 +62084,42 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(MRI_SURFACE *mris,
     ROMP_PF_begin
     
     /* now replace the worst ones with mutated copies of the best */
+    for (i = 0; i < nreplacements; i++) {
+      dp = batch[i] = &dps_next_generation[next_gen_index + i];
+      mrisCopyDefectPatch(&dps[ranks[i]], dp);
+      mrisMutateDefectPatch(dp, &etable, MUTATION_PCT);
+    }
+    mrisScoreDefectPatches(workers,
+                           nworkers,
+                           &computeDefectContext,
+                           batch,
+                           nreplacements,
+                           batch_used,
+                           batch_displacement,
+                           mris,
+                           mris_corrected,
+                           mri,
+                           vertex_trans,
+                           dvs,
+                           &rp,
+                           h_k1,
+                           h_k2,
+                           mri_k1_k2,
+                           h_white,
+                           h_gray,
+                           h_border,
+                           h_grad,
+                           mri_gray_white,
+                           h_dot,
+                           parms);
+
     for (i = 0; i < nreplacements; i++) {
       ntotalmutations++;
 
       dp = &dps_next_generation[next_gen_index++];
-      mrisCopyDefectPatch(&dps[ranks[i]], dp);
-      mrisMutateDefectPatch(dp, &etable, MUTATION_PCT);
-      fitness = mrisDefectPatchFitness(&computeDefectContext,
-                                       mris,
-                                       mris_corrected,
-                                       mri,
-                                       dp,
-                                       vertex_trans,
-                                       dvs,
-                                       &rp,
-                                       h_k1,
-                                       h_k2,
-                                       mri_k1_k2,
-                                       h_white,
-                                       h_gray,
-                                       h_border,
-                                       h_grad,
-                                       mri_gray_white,
-                                       h_dot,
-                                       parms);
+      fitness = dp->fitness;
+      applyVertexStatistics(
+          &rp, defect, batch_used + i * defect->nvertices, batch_displacement + i * defect->nvertices, fitness);
 #if SAVE_FIT_VALS
       fitness_values[number_of_patches] = fitness;
       if (number_of_patches)
@@ -61107,9 +62272,12 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(MRI_SURFACE *mris,
     ROMP_PF_end
     ROMP_PF_begin
 
+    /* the offspring are scored together: the parents are drawn first, then the
+       offspring that do not improve on the best patch are mutated and scored
+       again */
+    first_offspring = next_gen_index;
     for (i = 0; i < ncrossovers; i++) {
       int p1, p2;
-      ntotalcross_overs++;
 
       p1 = selected[i];
       do /* select second parent at random */
@@ -61117,28 +62285,49 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(MRI_SURFACE *mris,
         p2 = selected[(int)randomNumber(0, ncrossovers - .001)];
       } while (p2 == p1);
 
+      parents1[i] = p1;
+      parents2[i] = p2;
+      dp = batch[i] = &dps_next_generation[first_offspring + i];
+      mrisCrossoverDefectPatches(&dps[p1], &dps[p2], dp, &etable);
+    }
+    mrisScoreDefectPatches(workers,
+                           nworkers,
+                           &computeDefectContext,
+                           batch,
+                           ncrossovers,
+                           batch_used,
+                           batch_displacement,
+                           mris,
+                           mris_corrected,
+                           mri,
+                           vertex_trans,
+                           dvs,
+                           &rp,
+                           h_k1,
+                           h_k2,
+                           mri_k1_k2,
+                           h_white,
+                           h_gray,
+                           h_border,
+                           h_grad,
+                           mri_gray_white,
+                           h_dot,
+                           parms);
+
+    nmutated = 0;
+    for (i = 0; i < ncrossovers; i++) {
+      int p1, p2;
+      ntotalcross_overs++;
+
+      p1 = parents1[i];
+      p2 = parents2[i];
+
       ROMP_PF_begin
 
       dp = &dps_next_generation[next_gen_index++];
-      mrisCrossoverDefectPatches(&dps[p1], &dps[p2], dp, &etable);
-      fitness = mrisDefectPatchFitness(&computeDefectContext,
-                                       mris,
-                                       mris_corrected,
-                                       mri,
-                                       dp,
-                                       vertex_trans,
-                                       dvs,
-                                       &rp,
-                                       h_k1,
-                                       h_k2,
-                                       mri_k1_k2,
-                                       h_white,
-                                       h_gray,
-                                       h_border,
-                                       h_grad,
-                                       mri_gray_white,
-                                       h_dot,
-                                       parms);
+      fitness = dp->fitness;
+      applyVertexStatistics(
+          &rp, defect, batch_used + i * defect->nvertices, batch_displacement + i * defect->nvertices, fitness);
 #if SAVE_FIT_VALS
       fitness_values[number_of_patches] = fitness;
       if (number_of_patches)
@@ -61222,107 +62411,129 @@ static NOINLINE int mrisComputeOptimalRetessellation_wkr(MRI_SURFACE *mris,
       }
       else /* mutate it also */
       {
-        ROMP_PF_begin
-
         mrisMutateDefectPatch(dp, &etable, MUTATION_PCT);
-        fitness = mrisDefectPatchFitness(&computeDefectContext,
-                                         mris,
-                                         mris_corrected,
-                                         mri,
-                                         dp,
-                                         vertex_trans,
-                                         dvs,
-                                         &rp,
-                                         h_k1,
-                                         h_k2,
-                                         mri_k1_k2,
-                                         h_white,
-                                         h_gray,
-                                         h_border,
-                                         h_grad,
-                                         mri_gray_white,
-                                         h_dot,
-                                         parms);
+        mutated[nmutated++] = i;
+      }
+    }
+
+    for (j = 0; j < nmutated; j++) {
+      batch[j] = &dps_next_generation[first_offspring + mutated[j]];
+    }
+    mrisScoreDefectPatches(workers,
+                           nworkers,
+                           &computeDefectContext,
+                           batch,
+                           nmutated,
+                           batch_used,
+                           batch_displacement,
+                           mris,
+                           mris_corrected,
+                           mri,
+                           vertex_trans,
+                           dvs,
+                           &rp,
+                           h_k1,
+                           h_k2,
+                           mri_k1_k2,
+                           h_white,
+                           h_gray,
+                           h_border,
+                           h_grad,
+                           mri_gray_white,
+                           h_dot,
+                           parms);
+
+    for (j = 0; j < nmutated; j++) {
+      int p1, p2;
+
+      ROMP_PF_begin
+
+      i = mutated[j];
+      p1 = parents1[i];
+      p2 = parents2[i];
+      dp = batch[j];
+      fitness = dp->fitness;
+      applyVertexStatistics(
+          &rp, defect, batch_used + j * defect->nvertices, batch_displacement + j * defect->nvertices, fitness);
 #if SAVE_FIT_VALS
-        fitness_values[number_of_patches] = fitness;
-        if (number_of_patches)
-          best_values[number_of_patches] = MAX(best_values[number_of_patches - 1], fitness);
-        else {
-          best_values[number_of_patches] = fitness;
-        }
+      fitness_values[number_of_patches] = fitness;
+      if (number_of_patches)
+        best_values[number_of_patches] = MAX(best_values[number_of_patches - 1], fitness);
+      else {
+        best_values[number_of_patches] = fitness;
+      }
 #endif
-        number_of_patches++;
-        ntotalmutations++;
+      number_of_patches++;
+      ntotalmutations++;
 
-        if (fitness > best_fitness) {
-          nmutations++;
-          nunchanged = 0;
-          best_fitness = fitness;
-          best_i = next_gen_index - 1;
+      if (fitness > best_fitness) {
+        nmutations++;
+        nunchanged = 0;
+        best_fitness = fitness;
+        best_i = first_offspring + i;
 
-          nfinalvertices = nremovedvertices;
-          nbestpatch = number_of_patches;
+        nfinalvertices = nremovedvertices;
+        nbestpatch = number_of_patches;
 
-          rp.best_fitness = best_fitness;
-          /* save ordering*/
-          memmove(rp.best_ordering, dp->ordering, nedges * sizeof(int));
-          /* save current status of vertices */
-          memmove(rp.status, defect->status, defect->nvertices * sizeof(char));
+        rp.best_fitness = best_fitness;
+        /* save ordering*/
+        memmove(rp.best_ordering, dp->ordering, nedges * sizeof(int));
+        /* save current status of vertices */
+        memmove(rp.status, defect->status, defect->nvertices * sizeof(char));
 
-          if (parms->verbose > VERBOSE_MODE_DEFAULT)
-            fprintf(WHICH_OUTPUT,
-                    "CROSSOVER (%d x %d) & MUTATION: "
-                    "new optimal fitness found at %d: %2.4e\n",
-                    dps[p1].rank,
-                    dps[p2].rank,
-                    best_i,
-                    fitness);
-          if (parms->verbose == VERBOSE_MODE_LOW) {
-            printDefectStatistics(dp);
-          }
-          if (parms->save_fname && (parms->defect_number < 0 || (parms->defect_number == defect->defect_number))) {
-            sprintf(fname,
-                    "%s/rh.defect_%d_surf_%d_%d",
-                    parms->save_fname,
-                    defect->defect_number,
-                    ngenerations - 1,
-                    dps[p1].rank);
-            savePatch(mri, mris, mris_corrected, dvs, &dps[p1], fname, parms);
-            sprintf(fname,
-                    "%s/rh.defect_%d_surf_%d_%d",
-                    parms->save_fname,
-                    defect->defect_number,
-                    ngenerations - 1,
-                    dps[p2].rank);
-            savePatch(mri, mris, mris_corrected, dvs, &dps[p2], fname, parms);
-            sprintf(fname,
-                    "%s/rh.defect_%d_best_%d_%dcm%d_%d",
-                    parms->save_fname,
-                    defect->defect_number,
-                    ngenerations,
-                    best_i,
-                    dps[p1].rank,
-                    dps[p2].rank);
-            savePatch(mri, mris, mris_corrected, dvs, dp, fname, parms);
+        if (parms->verbose > VERBOSE_MODE_DEFAULT)
+          fprintf(WHICH_OUTPUT,
+                  "CROSSOVER (%d x %d) & MUTATION: "
+                  "new optimal fitness found at %d: %2.4e\n",
+                  dps[p1].rank,
+                  dps[p2].rank,
+                  best_i,
+                  fitness);
+        if (parms->verbose == VERBOSE_MODE_LOW) {
+          printDefectStatistics(dp);
+        }
+        if (parms->save_fname && (parms->defect_number < 0 || (parms->defect_number == defect->defect_number))) {
+          sprintf(fname,
+                  "%s/rh.defect_%d_surf_%d_%d",
+                  parms->save_fname,
+                  defect->defect_number,
+                  ngenerations - 1,
+                  dps[p1].rank);
+          savePatch(mri, mris, mris_corrected, dvs, &dps[p1], fname, parms);
+          sprintf(fname,
+                  "%s/rh.defect_%d_surf_%d_%d",
+                  parms->save_fname,
+                  defect->defect_number,
+                  ngenerations - 1,
+                  dps[p2].rank);
+          savePatch(mri, mris, mris_corrected, dvs, &dps[p2], fname, parms);
+          sprintf(fname,
+                  "%s/rh.defect_%d_best_%d_%dcm%d_%d",
+                  parms->save_fname,
+                  defect->defect_number,
+                  ngenerations,
+                  best_i,
+                  dps[p1].rank,
+                  dps[p2].rank);
+          savePatch(mri, mris, mris_corrected, dvs, dp, fname, parms);
 
-            sprintf(fname, "%s/rh.defect_%d_best_%d", parms->save_fname, defect->defect_number, nbests++);
+          sprintf(fname, "%s/rh.defect_%d_best_%d", parms->save_fname, defect->defect_number, nbests++);
+          savePatch(mri, mris, mris_corrected, dvs, dp, fname, parms);
+          if (parms->movie) {
+            sprintf(fname, "%s/rh.defect_%d_movie_%d", parms->save_fname, defect->defect_number, nmovies++);
             savePatch(mri, mris, mris_corrected, dvs, dp, fname, parms);
-            if (parms->movie) {
-              sprintf(fname, "%s/rh.defect_%d_movie_%d", parms->save_fname, defect->defect_number, nmovies++);
-              savePatch(mri, mris, mris_corrected, dvs, dp, fname, parms);
-            }
-          }
-
-          if (++nbest == debug_patch_n) {
-            dps = dps_next_generation;
-            goto debug_use_this_patch;
           }
-          nmut++;
-          ncross++;
         }
 
-        ROMP_PF_end
+        if (++nbest == debug_patch_n) {
+          dps = dps_next_generation;
+          goto debug_use_this_patch;
+        }
+        nmut++;
+        ncross++;
       }
+
+      ROMP_PF_end
     }
 
     ROMP_PF_end
@@ -61599,6 +62810,11 @@ debug_use_this_patch:
   ROMP_PF_begin
 
   /* free everything */
+  if (workers) {
+    defectPatchWorkersFree(&workers, nworkers);
+  }
+  free(batch_used);
+  free(batch_displacement);
   destructComputeDefectContext(&computeDefectContext);
   mrisFreeDefectVertexState(dvs);
 
@@ -61623,6 +62839,9 @@ debug_use_this_patch:
   free(rp.status);
   free(rp.nused);
   free(rp.vertex_fitness);
+  free(rp.vertex_used);
+  free(rp.vertex_displacement);
+  defectFitnessCacheFree(&rp.fitness_cache);
 
   if (mri_defect) {
     MRIfree(&mri_defect);
@@ -61831,6 +63050,9 @@ static int mrisComputeRandomRetessellation(MRI_SURFACE *mris,
   memmove(rp.status, defect->status, defect->nvertices * sizeof(char));
   rp.nused = (int *)calloc(defect->nvertices, sizeof(int));
   rp.vertex_fitness = (float *)calloc(defect->nvertices, sizeof(float));
+  rp.vertex_used = (char *)calloc(defect->nvertices, sizeof(char));
+  rp.vertex_displacement = (float *)calloc(defect->nvertices, sizeof(float));
+  rp.fitness_cache = defectFitnessCacheAlloc();
 
   if (parms->retessellation_mode) {
     dp.retessellation_mode = USE_SOME_VERTICES;
@@ -62076,6 +63298,9 @@ static int mrisComputeRandomRetessellation(MRI_SURFACE *mris,
   free(rp.status);
   free(rp.nused);
   free(rp.vertex_fitness);
+  free(rp.vertex_used);
+  free(rp.vertex_displacement);
+  defectFitnessCacheFree(&rp.fitness_cache);
 
   if (mri_defect) {
     MRIfree(&mri_defect);
@@ -67807,10 +69032,17 @@ int MRISreadNewCurvatureFile(MRI_SURFACE *mris, const char *sname)
         (ERROR_NOFILE, "MRISreadNewCurvature(%s): vals/vertex %d unsupported (must be 1) ", fname, vals_per_vertex));
   }
 
+  float *fbuf = (float *)calloc(vnum, sizeof(float));
+  if (fbuf == NULL) {
+    fclose(fp);
+    ErrorReturn(ERROR_NOMEMORY, (ERROR_NOMEMORY, "MRISreadNewCurvature: could not allocate %d values", vnum));
+  }
+  if (freadFloatArray(fbuf, vnum, fp) != vnum)
+    ErrorPrintf(ERROR_BADFILE, "MRISreadNewCurvature: %s is truncated", fname);
   curvmin = 10000.0f;
   curvmax = -10000.0f; /* for compiler warnings */
   for (k = 0; k < vnum; k++) {
-    curv = freadFloat(fp);
+    curv = fbuf[k];
     if (k == 0) {
       curvmin = curvmax = curv;
     }
@@ -67822,6 +69054,7 @@ int MRISreadNewCurvatureFile(MRI_SURFACE *mris, const char *sname)
     }
     mris->vertices[k].curv = curv;
   }
+  free(fbuf);
   mris->max_curv = curvmax;
   mris->min_curv = curvmin;
   if (Gdiag & DIAG_SHOW && DIAG_VERBOSE_ON) {
@@ -68603,6 +69836,11 @@ MRI *MRISsmoothMRI(MRIS *Surf, MRI *Src, int nSmoothSteps, MRI *BinMask, MRI *Ta
   if (!UFSS) {
     UFSS = "1";
   }
+  if (!strcmp(UFSS, "2")) {
+    // "setenv USE_FAST_SURF_SMOOTHER 2" selects the polynomial smoother
+    Targ = MRISsmoothMRIcheb(Surf, Src, nSmoothSteps, BinMask, Targ);
+    return (Targ);
+  }
   if (strcmp(UFSS, "0")) {
     Targ = MRISsmoothMRIFast(Surf, Src, nSmoothSteps, BinMask, Targ);
     return (Targ);
@@ -69025,6 +70263,224 @@ MRI *MRISsmoothMRIFastD(MRIS *Surf, MRI *Src, int nSmoothSteps, MRI *IncMask, MR
   return (Targ);
 }
 
+/*-------------------------------------------------------------------
+  MRISsmoothMRIcheb() - computes the same thing as
+  MRISsmoothMRIFast() (nSmoothSteps of nearest-neighbor averaging
+  with the same rip/mask rules) but in far fewer passes for large
+  nSmoothSteps.
+
+  One averaging step is a row-stochastic operator A = D^-1 W, with W
+  the symmetric (self + valid neighbor) adjacency restricted to the
+  mask. Its eigenvalues are real and lie in [-1,1], so A^n can be
+  written in Chebyshev polynomials of A:
+
+    x^n = 2^(1-n) sum_{k=n,n-2,...} C(n,(n-k)/2) T_k(x)
+
+  (the k=0 term, if any, is halved). The coefficients are a binomial
+  distribution folded about n/2. All but O(sqrt(n)) of them are
+  negligible, so the expansion is truncated where the dropped
+  coefficients sum to less than MRIS_CHEB_TOL. Since |T_k| <= 1 on
+  the spectrum, that sum bounds the error relative to the input. The
+  T_k(A)X terms come from the three-term recurrence
+  T_{k+1} = 2 A T_k - T_{k-1}, one averaging pass each: 200 steps
+  take 74 passes, 2000 steps take 238.
+
+  Frames are smoothed MRIS_CHEB_NFB at a time as a vertex x frame
+  block, so each neighbor gather moves a contiguous run of frames.
+  Falls back to MRISsmoothMRIFast() when truncation would not save
+  passes.
+  -------------------------------------------------------------------*/
+#define MRIS_CHEB_TOL 1.0e-7
+#define MRIS_CHEB_NFB 8
+
+/* Y = A X for an nfb-frame block stored vertex-major */
+static void mrisChebApply(
+    int nvertices, const int *rip, const int *nbr_start, const int *nbr, int nfb, const double *X, double *Y)
+{
+  int vno;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(assume_reproducible)
+#endif
+  for (vno = 0; vno < nvertices; vno++) {
+    ROMP_PFLB_begin
+    int n, f;
+    double *y = &Y[(size_t)vno * nfb];
+    const double *x;
+
+    if (rip[vno]) {
+      for (f = 0; f < nfb; f++) y[f] = 0;
+      ROMP_PFLB_continue;
+    }
+    x = &X[(size_t)nbr[nbr_start[vno]] * nfb];
+    for (f = 0; f < nfb; f++) y[f] = x[f];
+    for (n = nbr_start[vno] + 1; n < nbr_start[vno + 1]; n++) {
+      x = &X[(size_t)nbr[n] * nfb];
+      for (f = 0; f < nfb; f++) y[f] += x[f];
+    }
+    for (f = 0; f < nfb; f++) y[f] /= (nbr_start[vno + 1] - nbr_start[vno]);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+}
+
+MRI *MRISsmoothMRIcheb(MRIS *Surf, MRI *Src, int nSmoothSteps, MRI *IncMask, MRI *Targ)
+{
+  int nvox, vno, nthnbr, nbrvno, k, kmax, frame, f, nfb, reshape, nnbrs;
+  int *rip, *nbr_start, *nbr;
+  double *coef, tail, *T0, *T1, *T2, *Acc, *tmp, c;
+  MRI *SrcTmp, *mritmp, *IncMaskTmp = NULL;
+  struct timeb mytimer;
+  VERTEX *v;
+
+  if (Gdiag_no > 0) printf("MRISsmoothMRIcheb()\n");
+
+  nvox = Src->width * Src->height * Src->depth;
+  if (Surf->nvertices != nvox) {
+    printf("ERROR: MRISsmoothMRIcheb(): Surf/Src dimension mismatch\n");
+    return (NULL);
+  }
+  if (Targ != NULL) {
+    if (MRIdimMismatch(Src, Targ, 1)) {
+      printf("ERROR: MRISsmoothMRIcheb(): output dimension mismatch\n");
+      return (NULL);
+    }
+    if (Targ->type != MRI_FLOAT) {
+      printf("ERROR: MRISsmoothMRIcheb(): structure passed is not MRI_FLOAT\n");
+      return (NULL);
+    }
+  }
+  if (IncMask && IncMask->width * IncMask->height * IncMask->depth != nvox) {
+    printf("ERROR: MRISsmoothMRIcheb(): Surf/Mask dimension mismatch\n");
+    return (NULL);
+  }
+
+  /* Chebyshev coefficients of x^n, kept for k = n, n-2, ... ; the
+     expansion is cut at kmax, the lowest degree whose dropped tail
+     is below tolerance. */
+  if (nSmoothSteps < 1) return (MRISsmoothMRIFast(Surf, Src, nSmoothSteps, IncMask, Targ));
+  coef = (double *)calloc(nSmoothSteps + 1, sizeof(double));
+  for (k = nSmoothSteps; k >= 0; k -= 2) {
+    coef[k] = exp((1 - nSmoothSteps) * M_LN2 + lgamma(nSmoothSteps + 1.0) - lgamma((nSmoothSteps - k) / 2 + 1.0) -
+                  lgamma((nSmoothSteps + k) / 2 + 1.0));
+    if (k == 0) coef[k] /= 2;
+  }
+  tail = 0;
+  kmax = nSmoothSteps;
+  while (kmax >= 2 && tail + coef[kmax] < MRIS_CHEB_TOL) {
+    tail += coef[kmax];
+    kmax -= 2;
+  }
+  if (kmax >= nSmoothSteps - 2) {
+    // truncation saves nothing, the plain iteration is cheaper
+    free(coef);
+    return (MRISsmoothMRIFast(Surf, Src, nSmoothSteps, IncMask, Targ));
+  }
+  if (Gdiag_no > 0) printf("MRISsmoothMRIcheb(): %d steps as degree %d, tail %g\n", nSmoothSteps, kmax, tail);
+
+  if (IncMask) {
+    if (IncMask->width != nvox)
+      IncMaskTmp = mri_reshape(IncMask, nvox, 1, 1, IncMask->nframes);
+    else
+      IncMaskTmp = MRIcopy(IncMask, NULL);
+  }
+  if (Src->width != nvox) {
+    SrcTmp = mri_reshape(Src, nvox, 1, 1, Src->nframes);
+    reshape = 1;
+  }
+  else {
+    SrcTmp = MRIcopy(Src, NULL);
+    reshape = 0;
+  }
+
+  /* neighborhoods as in MRISsmoothMRIFast(): self first, then the
+     unripped, in-mask neighbors. Out-of-mask vertices are zeroed. */
+  rip = (int *)calloc(nvox, sizeof(int));
+  nbr_start = (int *)calloc(nvox + 1, sizeof(int));
+  for (nnbrs = vno = 0; vno < nvox; vno++) nnbrs += 1 + Surf->vertices[vno].vnum;
+  nbr = (int *)calloc(nnbrs, sizeof(int));
+  for (nnbrs = vno = 0; vno < nvox; vno++) {
+    nbr_start[vno] = nnbrs;
+    if (IncMaskTmp && MRIgetVoxVal(IncMaskTmp, vno, 0, 0, 0) < 0.5) {
+      rip[vno] = 1;
+      continue;
+    }
+    nbr[nnbrs++] = vno;
+    v = &Surf->vertices[vno];
+    for (nthnbr = 0; nthnbr < v->vnum; nthnbr++) {
+      nbrvno = v->v[nthnbr];
+      if (Surf->vertices[nbrvno].ripflag) continue;
+      if (IncMaskTmp && MRIgetVoxVal(IncMaskTmp, nbrvno, 0, 0, 0) < 0.5) continue;
+      nbr[nnbrs++] = nbrvno;
+    }
+  }
+  nbr_start[nvox] = nnbrs;
+
+  T0 = (double *)calloc((size_t)nvox * MRIS_CHEB_NFB, sizeof(double));
+  T1 = (double *)calloc((size_t)nvox * MRIS_CHEB_NFB, sizeof(double));
+  T2 = (double *)calloc((size_t)nvox * MRIS_CHEB_NFB, sizeof(double));
+  Acc = (double *)calloc((size_t)nvox * MRIS_CHEB_NFB, sizeof(double));
+  if (!T0 || !T1 || !T2 || !Acc) ErrorExit(ERROR_NOMEMORY, "MRISsmoothMRIcheb(): could not alloc %d vertices", nvox);
+
+  TimerStart(&mytimer);
+  for (frame = 0; frame < Src->nframes; frame += MRIS_CHEB_NFB) {
+    nfb = MIN(MRIS_CHEB_NFB, Src->nframes - frame);
+    for (vno = 0; vno < nvox; vno++)
+      for (f = 0; f < nfb; f++)
+        T0[(size_t)vno * nfb + f] = rip[vno] ? 0 : MRIgetVoxVal(SrcTmp, vno, 0, 0, frame + f);
+
+    // Acc = c_0 T_0 + c_1 T_1 + ... with only every other c nonzero
+    memset(Acc, 0, (size_t)nvox * nfb * sizeof(double));
+    if (coef[0] != 0)
+      for (k = 0; k < nvox * nfb; k++) Acc[k] = coef[0] * T0[k];
+    mrisChebApply(nvox, rip, nbr_start, nbr, nfb, T0, T1);
+    if (coef[1] != 0)
+      for (k = 0; k < nvox * nfb; k++) Acc[k] += coef[1] * T1[k];
+    for (int deg = 2; deg <= kmax; deg++) {
+      mrisChebApply(nvox, rip, nbr_start, nbr, nfb, T1, T2);
+      c = coef[deg];
+      for (k = 0; k < nvox * nfb; k++) {
+        T2[k] = 2 * T2[k] - T0[k];
+        if (c != 0) Acc[k] += c * T2[k];
+      }
+      tmp = T0;
+      T0 = T1;
+      T1 = T2;
+      T2 = tmp;
+    }
+
+    for (vno = 0; vno < nvox; vno++)
+      for (f = 0; f < nfb; f++) MRIsetVoxVal(SrcTmp, vno, 0, 0, frame + f, Acc[(size_t)vno * nfb + f]);
+  }
+
+  if (reshape) {
+    mritmp = mri_reshape(SrcTmp, Src->width, Src->height, Src->depth, Src->nframes);
+    Targ = MRIcopy(mritmp, Targ);
+    MRIfree(&mritmp);
+  }
+  else
+    Targ = MRIcopy(SrcTmp, Targ);
+
+  if (Gdiag_no > 0) {
+    printf("MRISsmoothMRIcheb() nsteps = %d, passes = %d, tsec = %g\n", nSmoothSteps, kmax,
+           TimerStop(&mytimer) / 1000.0);
+    fflush(stdout);
+  }
+
+  MRIfree(&SrcTmp);
+  if (IncMaskTmp) MRIfree(&IncMaskTmp);
+  free(coef);
+  free(rip);
+  free(nbr_start);
+  free(nbr);
+  free(T0);
+  free(T1);
+  free(T2);
+  free(Acc);
+  return (Targ);
+}
+
 /*------------------------------------------------------------------
   MRISsmoothMRIFastFrame() same as MRISsmoothMRIFast() but operates
   on a single frame. This allows the pointers to be cached in
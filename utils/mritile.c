@@ -0,0 +1,501 @@
+/**
+ * @file  mritile.c
+ * @brief out-of-core, tile-by-tile filtering of volumes on disk
+ *
+ * A volume that is too large to hold in memory is processed as a grid
+ * of tiles. Each tile is read from the input file together with a
+ * halo wide enough for the filter's neighborhood, filtered with the
+ * ordinary in-memory routine, and the tile's core is written straight
+ * into the output file. Peak memory is one tile plus halo regardless
+ * of the size of the volume.
+ */
+/*
+ * Copyright © 2011 The General Hospital Corporation (Boston, MA) "MGH"
+ *
+ * Terms and conditions for use, reproduction, distribution and contribution
+ * are found in the 'FreeSurfer Software License Agreement' contained
+ * in the file 'LICENSE' found in the FreeSurfer distribution, and here:
+ *
+ * https://surfer.nmr.mgh.harvard.edu/fswiki/FreeSurferSoftwareLicense
+ *
+ * Reporting: freesurfer@nmr.mgh.harvard.edu
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "diag.h"
+#include "error.h"
+#include "machine.h"
+#include "macros.h"
+#include "mri.h"
+#include "mri_identify.h"
+#include "nifti1.h"
+#include "proto.h"
+#include "utils.h"
+
+#include "mritile.h"
+
+/* size of the fixed MGH header that precedes the voxel data */
+#define MGH_DATA_OFFSET 284
+
+static int tilePread(int fd, void *buf, size_t nbytes, long long offset)
+{
+  char *cbuf = (char *)buf;
+  ssize_t n;
+
+  while (nbytes > 0) {
+    n = pread(fd, cbuf, nbytes, (off_t)offset);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) continue;
+      return (ERROR_BADFILE);
+    }
+    cbuf += n;
+    offset += n;
+    nbytes -= n;
+  }
+  return (NO_ERROR);
+}
+
+static int tilePwrite(int fd, const void *buf, size_t nbytes, long long offset)
+{
+  const char *cbuf = (const char *)buf;
+  ssize_t n;
+
+  while (nbytes > 0) {
+    n = pwrite(fd, cbuf, nbytes, (off_t)offset);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) continue;
+      return (ERROR_BADFILE);
+    }
+    cbuf += n;
+    offset += n;
+    nbytes -= n;
+  }
+  return (NO_ERROR);
+}
+
+static void tileSwapRow(void *buf, int nvox, int bpv)
+{
+  if (bpv == 2)
+    ByteSwap2(buf, (long int)nvox * 2);
+  else if (bpv == 4)
+    ByteSwap4(buf, (long int)nvox * 4);
+}
+
+static int tileTypeBytes(int type)
+{
+  switch (type) {
+    case MRI_UCHAR:
+      return (1);
+    case MRI_SHORT:
+      return (2);
+    case MRI_INT:
+    case MRI_FLOAT:
+      return (4);
+  }
+  return (0);
+}
+
+static int tileReadMGHHeader(MRI_TILED_FILE *tf)
+{
+  int hdr[6], n;
+
+  if (tilePread(tf->fd, hdr, sizeof(hdr), 0) != NO_ERROR) return (ERROR_BADFILE);
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+  for (n = 0; n < 6; n++) hdr[n] = swapInt(hdr[n]);
+  tf->swap = 1;
+#else
+  tf->swap = 0;
+#endif
+  tf->width = hdr[1];
+  tf->height = hdr[2];
+  tf->depth = hdr[3];
+  tf->nframes = hdr[4];
+  tf->type = hdr[5];
+  tf->data_offset = MGH_DATA_OFFSET;
+  return (NO_ERROR);
+}
+
+static int tileReadNiftiHeader(MRI_TILED_FILE *tf)
+{
+  struct nifti_1_header hdr;
+  int n;
+
+  if (tilePread(tf->fd, &hdr, sizeof(hdr), 0) != NO_ERROR) return (ERROR_BADFILE);
+  tf->swap = 0;
+  if (hdr.sizeof_hdr != 348) {
+    if (swapInt(hdr.sizeof_hdr) != 348) return (ERROR_BADFILE);
+    tf->swap = 1;
+    for (n = 0; n < 8; n++) hdr.dim[n] = swapShort(hdr.dim[n]);
+    hdr.datatype = swapShort(hdr.datatype);
+    hdr.vox_offset = swapFloat(hdr.vox_offset);
+    hdr.scl_slope = swapFloat(hdr.scl_slope);
+    hdr.scl_inter = swapFloat(hdr.scl_inter);
+  }
+  if (strcmp(hdr.magic, "n+1")) {
+    printf("ERROR: MRItiledOpen(): %s is not a single-file NIfTI-1 volume\n", tf->fname);
+    return (ERROR_UNSUPPORTED);
+  }
+  if ((hdr.scl_slope != 0 && hdr.scl_slope != 1) || hdr.scl_inter != 0) {
+    printf("ERROR: MRItiledOpen(): %s has intensity scaling, which tiled access does not apply\n", tf->fname);
+    return (ERROR_UNSUPPORTED);
+  }
+  tf->width = hdr.dim[1];
+  tf->height = hdr.dim[0] > 1 ? hdr.dim[2] : 1;
+  tf->depth = hdr.dim[0] > 2 ? hdr.dim[3] : 1;
+  tf->nframes = hdr.dim[0] > 3 ? hdr.dim[4] : 1;
+  switch (hdr.datatype) {
+    case DT_UINT8:
+      tf->type = MRI_UCHAR;
+      break;
+    case DT_INT16:
+      tf->type = MRI_SHORT;
+      break;
+    case DT_INT32:
+      tf->type = MRI_INT;
+      break;
+    case DT_FLOAT32:
+      tf->type = MRI_FLOAT;
+      break;
+    default:
+      printf("ERROR: MRItiledOpen(): %s has unsupported NIfTI datatype %d\n", tf->fname, hdr.datatype);
+      return (ERROR_UNSUPPORTED);
+  }
+  tf->data_offset = (long long)hdr.vox_offset;
+  return (NO_ERROR);
+}
+
+/*---------------------------------------------------------------
+  MRItiledOpen() - opens an uncompressed .mgh or single-file .nii
+  volume for region-wise reading. Only the header is read.
+  Compressed volumes cannot be accessed at random and are rejected.
+  ---------------------------------------------------------------*/
+MRI_TILED_FILE *MRItiledOpen(const char *fname)
+{
+  MRI_TILED_FILE *tf;
+  char *ext;
+  int err;
+
+  tf = (MRI_TILED_FILE *)calloc(1, sizeof(MRI_TILED_FILE));
+  strncpy(tf->fname, fname, STRLEN - 1);
+  tf->filetype = mri_identify(fname);
+  ext = strrchr(fname, '.');
+  if (tf->filetype == NII_FILE && !(ext && !stricmp(ext, ".nii"))) {
+    printf("ERROR: MRItiledOpen(): %s is a compressed NIfTI volume, which cannot be read region-wise; "
+           "convert it to an uncompressed .nii first\n",
+           fname);
+    free(tf);
+    return (NULL);
+  }
+  if (!(tf->filetype == MRI_MGH_FILE && ext && !stricmp(ext, ".mgh")) && tf->filetype != NII_FILE) {
+    printf("ERROR: MRItiledOpen(): %s must be an uncompressed .mgh or .nii volume\n", fname);
+    free(tf);
+    return (NULL);
+  }
+
+  tf->fd = open(fname, O_RDONLY);
+  if (tf->fd < 0) {
+    free(tf);
+    ErrorReturn(NULL, (ERROR_NOFILE, "MRItiledOpen(): could not open %s", fname));
+  }
+  if (tf->filetype == MRI_MGH_FILE)
+    err = tileReadMGHHeader(tf);
+  else
+    err = tileReadNiftiHeader(tf);
+  tf->bytes_per_voxel = tileTypeBytes(tf->type);
+  if (err == NO_ERROR && tf->bytes_per_voxel == 0) {
+    printf("ERROR: MRItiledOpen(): %s has unsupported voxel type %d\n", fname, tf->type);
+    err = ERROR_UNSUPPORTED;
+  }
+  if (err != NO_ERROR) {
+    close(tf->fd);
+    free(tf);
+    ErrorReturn(NULL, (err, "MRItiledOpen(): could not read header of %s", fname));
+  }
+  if (tf->bytes_per_voxel == 1) tf->swap = 0;
+  tf->data_end = tf->data_offset +
+                 (long long)tf->width * tf->height * tf->depth * tf->nframes * tf->bytes_per_voxel;
+  return (tf);
+}
+
+/*---------------------------------------------------------------
+  MRItiledCreate() - creates an output volume with the same header,
+  dimensions, type and trailing tags as tf_template. The header
+  and anything after the voxel data are copied byte for byte; the
+  voxel data are zero until written with MRItiledWriteRegion().
+  ---------------------------------------------------------------*/
+MRI_TILED_FILE *MRItiledCreate(const char *fname, MRI_TILED_FILE *tf_template)
+{
+  MRI_TILED_FILE *tf;
+  struct stat st;
+  char *buf;
+  long long nbytes, ntail;
+
+  tf = (MRI_TILED_FILE *)calloc(1, sizeof(MRI_TILED_FILE));
+  *tf = *tf_template;
+  strncpy(tf->fname, fname, STRLEN - 1);
+  tf->fd = open(fname, O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (tf->fd < 0) {
+    free(tf);
+    ErrorReturn(NULL, (ERROR_NOFILE, "MRItiledCreate(): could not create %s", fname));
+  }
+
+  if (fstat(tf_template->fd, &st) != 0) st.st_size = tf_template->data_end;
+  ntail = (long long)st.st_size - tf_template->data_end;
+  nbytes = MAX(tf->data_offset, ntail);
+  buf = (char *)calloc(nbytes > 0 ? nbytes : 1, 1);
+  if (tilePread(tf_template->fd, buf, tf->data_offset, 0) != NO_ERROR ||
+      tilePwrite(tf->fd, buf, tf->data_offset, 0) != NO_ERROR || ftruncate(tf->fd, (off_t)tf->data_end) != 0 ||
+      (ntail > 0 && (tilePread(tf_template->fd, buf, ntail, tf_template->data_end) != NO_ERROR ||
+                     tilePwrite(tf->fd, buf, ntail, tf->data_end) != NO_ERROR))) {
+    free(buf);
+    close(tf->fd);
+    free(tf);
+    ErrorReturn(NULL, (ERROR_BADFILE, "MRItiledCreate(): could not write header of %s", fname));
+  }
+  free(buf);
+  return (tf);
+}
+
+int MRItiledClose(MRI_TILED_FILE **ptf)
+{
+  MRI_TILED_FILE *tf = *ptf;
+  int ret = NO_ERROR;
+
+  if (tf == NULL) return (NO_ERROR);
+  if (close(tf->fd) != 0) ret = ERROR_BADFILE;
+  free(tf);
+  *ptf = NULL;
+  return (ret);
+}
+
+/*---------------------------------------------------------------
+  MRItiledReadRegion() - reads the voxels in region (all frames)
+  into a newly allocated MRI of the file's type. The region must
+  lie inside the volume.
+  ---------------------------------------------------------------*/
+MRI *MRItiledReadRegion(MRI_TILED_FILE *tf, MRI_REGION *region)
+{
+  MRI *mri;
+  int f, y, z, bpv = tf->bytes_per_voxel;
+  long long offset;
+  char *row;
+
+  mri = MRIallocSequence(region->dx, region->dy, region->dz, tf->type, tf->nframes);
+  if (mri == NULL) ErrorReturn(NULL, (ERROR_NOMEMORY, "MRItiledReadRegion(): could not alloc tile"));
+
+  for (f = 0; f < tf->nframes; f++)
+    for (z = 0; z < region->dz; z++)
+      for (y = 0; y < region->dy; y++) {
+        offset = tf->data_offset +
+                 ((((long long)f * tf->depth + region->z + z) * tf->height + region->y + y) * tf->width + region->x) *
+                     bpv;
+        row = (char *)mri->slices[f * mri->depth + z][y];
+        if (tilePread(tf->fd, row, (size_t)region->dx * bpv, offset) != NO_ERROR) {
+          MRIfree(&mri);
+          ErrorReturn(NULL, (ERROR_BADFILE, "MRItiledReadRegion(): read failed on %s", tf->fname));
+        }
+        if (tf->swap) tileSwapRow(row, region->dx, bpv);
+      }
+  return (mri);
+}
+
+/*---------------------------------------------------------------
+  MRItiledWriteRegion() - writes the voxels of mri starting at
+  (xoff,yoff,zoff) into region of the file. mri is converted to
+  the file's type with MRIsetVoxVal() if the types differ.
+  ---------------------------------------------------------------*/
+int MRItiledWriteRegion(MRI_TILED_FILE *tf, MRI *mri, int xoff, int yoff, int zoff, MRI_REGION *region)
+{
+  MRI *mri_typed = NULL;
+  int f, x, y, z, bpv = tf->bytes_per_voxel, ret = NO_ERROR;
+  long long offset;
+  char *row, *buf;
+
+  if (mri->type != tf->type) {
+    mri_typed = MRIallocSequence(region->dx, region->dy, region->dz, tf->type, tf->nframes);
+    for (f = 0; f < tf->nframes; f++)
+      for (z = 0; z < region->dz; z++)
+        for (y = 0; y < region->dy; y++)
+          for (x = 0; x < region->dx; x++)
+            MRIsetVoxVal(mri_typed, x, y, z, f, MRIgetVoxVal(mri, x + xoff, y + yoff, z + zoff, f));
+    mri = mri_typed;
+    xoff = yoff = zoff = 0;
+  }
+
+  buf = (char *)malloc((size_t)region->dx * bpv);
+  for (f = 0; f < tf->nframes && ret == NO_ERROR; f++)
+    for (z = 0; z < region->dz && ret == NO_ERROR; z++)
+      for (y = 0; y < region->dy; y++) {
+        offset = tf->data_offset +
+                 ((((long long)f * tf->depth + region->z + z) * tf->height + region->y + y) * tf->width + region->x) *
+                     bpv;
+        row = (char *)mri->slices[f * mri->depth + z + zoff][y + yoff] + (size_t)xoff * bpv;
+        memcpy(buf, row, (size_t)region->dx * bpv);
+        if (tf->swap) tileSwapRow(buf, region->dx, bpv);
+        if (tilePwrite(tf->fd, buf, (size_t)region->dx * bpv, offset) != NO_ERROR) {
+          ret = ERROR_BADFILE;
+          break;
+        }
+      }
+  free(buf);
+  if (mri_typed) MRIfree(&mri_typed);
+  if (ret != NO_ERROR) ErrorReturn(ret, (ret, "MRItiledWriteRegion(): write failed on %s", tf->fname));
+  return (NO_ERROR);
+}
+
+/*---------------------------------------------------------------
+  MRItiledApplyFilter() - runs filter over in_fname tile by tile
+  and writes the result to out_fname (same format, header and
+  type). Each tile of tile_size^3 core voxels is read with a halo
+  of halo voxels on every side that lies inside the volume. The
+  filter sees an ordinary MRI and returns a result of the same
+  dimensions. Only the core is written back. Where the halo is cut
+  off by the volume border the tile border is the volume border, so
+  the filter's own edge handling is unchanged. With halo >= the
+  filter's radius the output matches filtering the whole volume in
+  memory. The filters themselves are OpenMP-parallel, so tiles are
+  processed one after another with all threads working on each.
+  ---------------------------------------------------------------*/
+int MRItiledApplyFilter(
+    const char *in_fname, const char *out_fname, MRI_TILE_FILTER filter, void *parms, int halo, int tile_size)
+{
+  MRI_TILED_FILE *tf_in, *tf_out;
+  MRI_REGION core, ext;
+  MRI *mri_tile, *mri_filtered;
+  int x0, y0, z0, ntiles, nth, ret = NO_ERROR;
+
+  if (tile_size <= 0) tile_size = MRI_TILE_DEFAULT_SIZE;
+  if (halo < 0) halo = 0;
+
+  tf_in = MRItiledOpen(in_fname);
+  if (tf_in == NULL) return (ERROR_NOFILE);
+  tf_out = MRItiledCreate(out_fname, tf_in);
+  if (tf_out == NULL) {
+    MRItiledClose(&tf_in);
+    return (ERROR_NOFILE);
+  }
+
+  ntiles = ((tf_in->width + tile_size - 1) / tile_size) * ((tf_in->height + tile_size - 1) / tile_size) *
+           ((tf_in->depth + tile_size - 1) / tile_size);
+  if (Gdiag & DIAG_SHOW)
+    printf("MRItiledApplyFilter(): %dx%dx%dx%d volume in %d tiles of %d (halo %d)\n", tf_in->width, tf_in->height,
+           tf_in->depth, tf_in->nframes, ntiles, tile_size, halo);
+
+  nth = 0;
+  for (z0 = 0; z0 < tf_in->depth && ret == NO_ERROR; z0 += tile_size)
+    for (y0 = 0; y0 < tf_in->height && ret == NO_ERROR; y0 += tile_size)
+      for (x0 = 0; x0 < tf_in->width && ret == NO_ERROR; x0 += tile_size) {
+        core.x = x0;
+        core.y = y0;
+        core.z = z0;
+        core.dx = MIN(tile_size, tf_in->width - x0);
+        core.dy = MIN(tile_size, tf_in->height - y0);
+        core.dz = MIN(tile_size, tf_in->depth - z0);
+        ext.x = MAX(0, x0 - halo);
+        ext.y = MAX(0, y0 - halo);
+        ext.z = MAX(0, z0 - halo);
+        ext.dx = MIN(tf_in->width, x0 + core.dx + halo) - ext.x;
+        ext.dy = MIN(tf_in->height, y0 + core.dy + halo) - ext.y;
+        ext.dz = MIN(tf_in->depth, z0 + core.dz + halo) - ext.z;
+
+        mri_tile = MRItiledReadRegion(tf_in, &ext);
+        if (mri_tile == NULL) {
+          ret = ERROR_BADFILE;
+          break;
+        }
+        mri_filtered = (*filter)(mri_tile, parms);
+        if (mri_filtered == NULL)
+          ret = ERROR_BADPARM;
+        else
+          ret = MRItiledWriteRegion(tf_out, mri_filtered, core.x - ext.x, core.y - ext.y, core.z - ext.z, &core);
+        if (mri_filtered && mri_filtered != mri_tile) MRIfree(&mri_filtered);
+        MRIfree(&mri_tile);
+        exec_progress_callback(nth++, ntiles, 0, 1);
+      }
+
+  MRItiledClose(&tf_in);
+  if (MRItiledClose(&tf_out) != NO_ERROR && ret == NO_ERROR) ret = ERROR_BADFILE;
+  return (ret);
+}
+
+/*---------------------------------------------------------------
+  Tiled versions of the common neighborhood filters. Each one sets
+  the halo to the radius of the in-memory routine it wraps.
+  ---------------------------------------------------------------*/
+static MRI *tileMedianFilter(MRI *mri_src, void *parms)
+{
+  return (MRImedian(mri_src, NULL, *(int *)parms, NULL));
+}
+
+int MRItiledMedian(const char *in_fname, const char *out_fname, int wsize, int tile_size)
+{
+  return (MRItiledApplyFilter(in_fname, out_fname, tileMedianFilter, &wsize, wsize / 2, tile_size));
+}
+
+static MRI *tileGaussianFilter(MRI *mri_src, void *parms)
+{
+  return (MRIconvolveGaussian(mri_src, NULL, (MRI *)parms));
+}
+
+int MRItiledGaussian(const char *in_fname, const char *out_fname, float sigma, int tile_size)
+{
+  MRI *mri_kernel;
+  int ret;
+
+  mri_kernel = MRIgaussian1d(sigma, -1);
+  ret = MRItiledApplyFilter(in_fname, out_fname, tileGaussianFilter, mri_kernel, mri_kernel->width / 2, tile_size);
+  MRIfree(&mri_kernel);
+  return (ret);
+}
+
+typedef struct
+{
+  int operation;
+  int niter;
+} TILE_MORPH_PARMS;
+
+static MRI *tileMorphologyFilter(MRI *mri_src, void *parms)
+{
+  TILE_MORPH_PARMS *mp = (TILE_MORPH_PARMS *)parms;
+  MRI *mri_dst = NULL;
+  int i;
+
+  if (mp->operation == MRI_TILE_DILATE || mp->operation == MRI_TILE_CLOSE)
+    for (i = 0; i < mp->niter; i++) {
+      mri_dst = MRIdilate(mri_src, mri_dst);
+      MRIcopy(mri_dst, mri_src);
+    }
+  for (i = 0; i < mp->niter && mp->operation != MRI_TILE_DILATE; i++) {
+    mri_dst = MRIerode(mri_src, mri_dst);
+    MRIcopy(mri_dst, mri_src);
+  }
+  if (mp->operation == MRI_TILE_OPEN)
+    for (i = 0; i < mp->niter; i++) {
+      mri_dst = MRIdilate(mri_src, mri_dst);
+      MRIcopy(mri_dst, mri_src);
+    }
+  if (mri_dst == NULL) mri_dst = MRIcopy(mri_src, NULL);
+  return (mri_dst);
+}
+
+/* operation is one of MRI_TILE_ERODE/DILATE/OPEN/CLOSE, applied niter
+   times with the 3x3x3 MRIerode()/MRIdilate() as in mri_morphology */
+int MRItiledMorphology(const char *in_fname, const char *out_fname, int operation, int niter, int tile_size)
+{
+  TILE_MORPH_PARMS mp;
+  int halo;
+
+  mp.operation = operation;
+  mp.niter = niter;
+  halo = (operation == MRI_TILE_OPEN || operation == MRI_TILE_CLOSE) ? 2 * niter : niter;
+  return (MRItiledApplyFilter(in_fname, out_fname, tileMorphologyFilter, &mp, halo, tile_size));
+}
@@ -69,6 +69,8 @@
 #include "bfileio.h"
 #include "corio.h"
 #include "diag.h"
+#include "error.h"
+#include "fio.h"
 #include "label.h"
 #include "matrix.h"
 #include "mri.h"
@@ -859,6 +861,406 @@ MRI *vol2surf_linear(MRI *SrcVol,
   return (TrgVol);
 }
 
+/*------------------------------------------------------------
+  VOL2SURFplanBuild() - precomputes the geometry used by
+  vol2surf_linear() so that it can be applied to many volumes that
+  share the same surface, registration, and voxel grid (eg, every run
+  of an fMRI session). For each vertex and each projection depth
+  (ProjFracMin to ProjFracMax in steps of ProjFracDelta, same
+  semantics as the --projfrac-avg/--projdist-avg options of
+  mri_vol2surf), it stores the source voxel indices and weights
+  needed to reproduce the nearest neighbor or trilinear sample. Only
+  SAMPLE_NEAREST and SAMPLE_TRILINEAR are supported. Arguments are as
+  in vol2surf_linear(). Free with VOL2SURFplanFree().
+  ------------------------------------------------------------*/
+VOL2SURF_PLAN *VOL2SURFplanBuild(MRI *SrcVol,
+                                 MATRIX *Qsrc,
+                                 MATRIX *Fsrc,
+                                 MATRIX *Wsrc,
+                                 MATRIX *Dsrc,
+                                 MRI_SURFACE *TrgSurf,
+                                 float ProjFracMin,
+                                 float ProjFracMax,
+                                 float ProjFracDelta,
+                                 int ProjDistFlag,
+                                 int InterpMethod,
+                                 int float2int)
+{
+  VOL2SURF_PLAN *plan;
+  MATRIX *QFWDsrc;
+  int FreeQsrc = 0, nproj, nthproj, vtx, k;
+  float ProjFrac;
+
+  if (InterpMethod != SAMPLE_NEAREST && InterpMethod != SAMPLE_TRILINEAR) {
+    printf("ERROR: VOL2SURFplanBuild(): interpolation method %d not supported\n", InterpMethod);
+    return (NULL);
+  }
+  if (float2int != FLT2INT_ROUND && float2int != FLT2INT_FLOOR && float2int != FLT2INT_TKREG) {
+    printf("ERROR: VOL2SURFplanBuild(): unrecognized float2int code %d\n", float2int);
+    return (NULL);
+  }
+  if (ProjFracDelta <= 0) ProjFracDelta = 1.0;
+
+  // same loop as mri_vol2surf so the number of depths matches exactly
+  nproj = 0;
+  for (ProjFrac = ProjFracMin; ProjFrac <= ProjFracMax; ProjFrac += ProjFracDelta) nproj++;
+  if (nproj == 0) nproj = 1;
+
+  if (Qsrc == NULL) {
+    Qsrc = MRIxfmCRS2XYZtkreg(SrcVol);
+    Qsrc = MatrixInverse(Qsrc, Qsrc);
+    FreeQsrc = 1;
+  }
+  QFWDsrc = ComputeQFWD(Qsrc, Fsrc, Wsrc, Dsrc, NULL);
+
+  plan = VOL2SURFplanAlloc(TrgSurf->nvertices, nproj, (InterpMethod == SAMPLE_TRILINEAR) ? 8 : 1);
+  plan->width = SrcVol->width;
+  plan->height = SrcVol->height;
+  plan->depth = SrcVol->depth;
+  plan->interp = InterpMethod;
+  plan->ProjFracMin = ProjFracMin;
+  plan->ProjFracMax = ProjFracMax;
+  plan->ProjFracDelta = ProjFracDelta;
+  plan->ProjDistFlag = ProjDistFlag;
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(shown_reproducible) private(k, nthproj, ProjFrac)
+#endif
+  for (vtx = 0; vtx < TrgSurf->nvertices; vtx++) {
+    ROMP_PFLB_begin
+    float Tx, Ty, Tz, fcol, frow, fslc;
+    int icol, irow, islc, sample, xm, xp, ym, yp, zm, zp;
+    double x, y, z, xmd, ymd, zmd, xpd, ypd, zpd;
+    int *index;
+    float *weight;
+
+    for (nthproj = 0; nthproj < nproj; nthproj++) {
+      ProjFrac = ProjFracMin + nthproj * ProjFracDelta;
+      sample = vtx * nproj + nthproj;
+      index = &plan->index[sample * plan->nweights];
+      weight = &plan->weight[sample * plan->nweights];
+      plan->hitindex[sample] = -1;
+      for (k = 0; k < plan->nweights; k++) {
+        index[k] = -1;
+        weight[k] = 0;
+      }
+
+      if (ProjFrac != 0.0) {
+        if (ProjDistFlag)
+          ProjNormDist(&Tx, &Ty, &Tz, TrgSurf, vtx, ProjFrac);
+        else
+          ProjNormFracThick(&Tx, &Ty, &Tz, TrgSurf, vtx, ProjFrac);
+      }
+      else {
+        Tx = TrgSurf->vertices[vtx].x;
+        Ty = TrgSurf->vertices[vtx].y;
+        Tz = TrgSurf->vertices[vtx].z;
+      }
+
+      // Same as MatrixMultiply(QFWDsrc, Txyz, Scrs) in vol2surf_linear()
+      fcol = QFWDsrc->rptr[1][1] * Tx + QFWDsrc->rptr[1][2] * Ty + QFWDsrc->rptr[1][3] * Tz + QFWDsrc->rptr[1][4];
+      frow = QFWDsrc->rptr[2][1] * Tx + QFWDsrc->rptr[2][2] * Ty + QFWDsrc->rptr[2][3] * Tz + QFWDsrc->rptr[2][4];
+      fslc = QFWDsrc->rptr[3][1] * Tx + QFWDsrc->rptr[3][2] * Ty + QFWDsrc->rptr[3][3] * Tz + QFWDsrc->rptr[3][4];
+
+      switch (float2int) {
+        case FLT2INT_ROUND:
+          icol = nint(fcol);
+          irow = nint(frow);
+          islc = nint(fslc);
+          break;
+        case FLT2INT_FLOOR:
+          icol = (int)floor(fcol);
+          irow = (int)floor(frow);
+          islc = (int)floor(fslc);
+          break;
+        default:  // FLT2INT_TKREG
+          icol = (int)floor(fcol);
+          irow = (int)ceil(frow);
+          islc = (int)floor(fslc);
+          break;
+      }
+      if (irow < 0 || irow >= SrcVol->height || icol < 0 || icol >= SrcVol->width || islc < 0 ||
+          islc >= SrcVol->depth)
+        continue;
+      plan->hitindex[sample] = icol + irow * SrcVol->width + islc * SrcVol->width * SrcVol->height;
+
+      if (InterpMethod == SAMPLE_NEAREST) {
+        index[0] = plan->hitindex[sample];
+        weight[0] = 1.0;
+        continue;
+      }
+
+      // Trilinear weights, matching the clamping in MRIsampleSeqVolume()
+      if (MRIindexNotInVolume(SrcVol, fcol, frow, fslc) == 1) {
+        index[0] = VOL2SURF_PLAN_OUTSIDE;  // sampled as SrcVol->outside_val
+        continue;
+      }
+      x = MIN(MAX(fcol, 0.0), SrcVol->width - 1.0);
+      y = MIN(MAX(frow, 0.0), SrcVol->height - 1.0);
+      z = MIN(MAX(fslc, 0.0), SrcVol->depth - 1.0);
+      xm = MAX((int)x, 0);
+      xp = MIN(SrcVol->width - 1, xm + 1);
+      ym = MAX((int)y, 0);
+      yp = MIN(SrcVol->height - 1, ym + 1);
+      zm = MAX((int)z, 0);
+      zp = MIN(SrcVol->depth - 1, zm + 1);
+      xmd = x - (float)xm;
+      ymd = y - (float)ym;
+      zmd = z - (float)zm;
+      xpd = (1.0f - xmd);
+      ypd = (1.0f - ymd);
+      zpd = (1.0f - zmd);
+#define V2SIND(c, r, s) ((c) + (r)*SrcVol->width + (s)*SrcVol->width * SrcVol->height)
+      index[0] = V2SIND(xm, ym, zm);
+      weight[0] = xpd * ypd * zpd;
+      index[1] = V2SIND(xm, ym, zp);
+      weight[1] = xpd * ypd * zmd;
+      index[2] = V2SIND(xm, yp, zm);
+      weight[2] = xpd * ymd * zpd;
+      index[3] = V2SIND(xm, yp, zp);
+      weight[3] = xpd * ymd * zmd;
+      index[4] = V2SIND(xp, ym, zm);
+      weight[4] = xmd * ypd * zpd;
+      index[5] = V2SIND(xp, ym, zp);
+      weight[5] = xmd * ypd * zmd;
+      index[6] = V2SIND(xp, yp, zm);
+      weight[6] = xmd * ymd * zpd;
+      index[7] = V2SIND(xp, yp, zp);
+      weight[7] = xmd * ymd * zmd;
+#undef V2SIND
+    }
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  MatrixFree(&QFWDsrc);
+  if (FreeQsrc) MatrixFree(&Qsrc);
+  return (plan);
+}
+
+/*------------------------------------------------------------
+  VOL2SURFplanAlloc() - allocates a sampling plan with nweights
+  voxels for each of nproj projections of nvertices vertices.
+  ------------------------------------------------------------*/
+VOL2SURF_PLAN *VOL2SURFplanAlloc(int nvertices, int nproj, int nweights)
+{
+  VOL2SURF_PLAN *plan;
+  size_t nsamples;
+
+  plan = (VOL2SURF_PLAN *)calloc(1, sizeof(VOL2SURF_PLAN));
+  plan->nvertices = nvertices;
+  plan->nproj = nproj;
+  plan->nweights = nweights;
+  nsamples = (size_t)nvertices * nproj;
+  plan->hitindex = (int *)calloc(nsamples, sizeof(int));
+  plan->index = (int *)calloc(nsamples * nweights, sizeof(int));
+  plan->weight = (float *)calloc(nsamples * nweights, sizeof(float));
+  if (plan->hitindex == NULL || plan->index == NULL || plan->weight == NULL)
+    ErrorExit(ERROR_NOMEMORY, "VOL2SURFplanAlloc(): could not alloc plan for %d vertices x %d", nvertices, nproj);
+  return (plan);
+}
+
+int VOL2SURFplanFree(VOL2SURF_PLAN **pplan)
+{
+  VOL2SURF_PLAN *plan = *pplan;
+  if (plan == NULL) return (0);
+  free(plan->hitindex);
+  free(plan->index);
+  free(plan->weight);
+  free(plan);
+  *pplan = NULL;
+  return (0);
+}
+
+/*------------------------------------------------------------
+  VOL2SURFplanApply() - samples all frames of SrcVol onto the surface
+  using a plan from VOL2SURFplanBuild(). The projections are averaged
+  (or the max is taken if GetProjMax) so the result is the same as
+  calling vol2surf_linear() for each projection and combining them as
+  mri_vol2surf does. As in vol2surf_linear(), projections whose voxel
+  falls outside of the volume contribute 0 and trilinear samples that
+  are out of bounds contribute SrcVol->outside_val. If SrcHitVol is
+  non-NULL, it is zeroed and the number of times each voxel was sampled
+  by the last projection is stored in it, which is what is left in it
+  after mri_vol2surf calls vol2surf_linear() once per projection.
+  Vertices are processed in parallel; each one gathers all frames in
+  one pass.
+  ------------------------------------------------------------*/
+MRI *VOL2SURFplanApply(VOL2SURF_PLAN *plan, MRI *SrcVol, int GetProjMax, MRI *SrcHitVol, MRI *TrgVol)
+{
+  int vtx, nframes, n, nsamples;
+
+  if (SrcVol->width != plan->width || SrcVol->height != plan->height || SrcVol->depth != plan->depth) {
+    printf("ERROR: VOL2SURFplanApply(): volume dimension %d %d %d does not match plan %d %d %d\n",
+           SrcVol->width, SrcVol->height, SrcVol->depth, plan->width, plan->height, plan->depth);
+    return (NULL);
+  }
+  nframes = SrcVol->nframes;
+
+  if (TrgVol == NULL) {
+    TrgVol = MRIallocSequence(plan->nvertices, 1, 1, MRI_FLOAT, nframes);
+    if (TrgVol == NULL) return (NULL);
+    MRIcopyHeader(SrcVol, TrgVol);
+    TrgVol->xsize = 1;
+    TrgVol->ysize = 1;
+    TrgVol->zsize = 1;
+  }
+  if (TrgVol->width != plan->nvertices || TrgVol->nframes != nframes || TrgVol->type != MRI_FLOAT) {
+    printf("ERROR: VOL2SURFplanApply(): output volume does not match plan\n");
+    return (NULL);
+  }
+
+  ROMP_PF_begin
+#ifdef HAVE_OPENMP
+  #pragma omp parallel for if_ROMP(shown_reproducible)
+#endif
+  for (vtx = 0; vtx < plan->nvertices; vtx++) {
+    ROMP_PFLB_begin
+    int nthproj, k, f, c, r, s, ind, sample;
+    float w, *valvect, *accum;
+
+    valvect = (float *)calloc(2 * nframes, sizeof(float));
+    accum = &valvect[nframes];
+    for (nthproj = 0; nthproj < plan->nproj; nthproj++) {
+      sample = vtx * plan->nproj + nthproj;
+      memset(valvect, 0, nframes * sizeof(float));
+      if (plan->index[sample * plan->nweights] == VOL2SURF_PLAN_OUTSIDE)
+        for (f = 0; f < nframes; f++) valvect[f] = SrcVol->outside_val;
+      for (k = 0; k < plan->nweights; k++) {
+        ind = plan->index[sample * plan->nweights + k];
+        if (ind < 0) continue;
+        w = plan->weight[sample * plan->nweights + k];
+        c = ind % plan->width;
+        r = (ind / plan->width) % plan->height;
+        s = ind / (plan->width * plan->height);
+        if (SrcVol->type == MRI_FLOAT)
+          for (f = 0; f < nframes; f++) valvect[f] += w * MRIFseq_vox(SrcVol, c, r, s, f);
+        else
+          for (f = 0; f < nframes; f++) valvect[f] += w * MRIgetVoxVal(SrcVol, c, r, s, f);
+      }
+      if (nthproj == 0)
+        memcpy(accum, valvect, nframes * sizeof(float));
+      else if (!GetProjMax)
+        for (f = 0; f < nframes; f++) accum[f] += valvect[f];
+      else
+        for (f = 0; f < nframes; f++) accum[f] = MAX(accum[f], valvect[f]);
+    }
+    for (f = 0; f < nframes; f++)
+      MRIFseq_vox(TrgVol, vtx, 0, 0, f) = GetProjMax ? accum[f] : accum[f] / plan->nproj;
+    free(valvect);
+    ROMP_PFLB_end
+  }
+  ROMP_PF_end
+
+  // Hit counts are accumulated serially since vertices share voxels
+  if (SrcHitVol != NULL) {
+    MRIconst(SrcHitVol->width, SrcHitVol->height, SrcHitVol->depth, 1, 0, SrcHitVol);
+    nsamples = plan->nvertices * plan->nproj;
+    for (n = plan->nproj - 1; n < nsamples; n += plan->nproj) {
+      int ind = plan->hitindex[n];
+      if (ind < 0) continue;
+      MRIFseq_vox(SrcHitVol,
+                  ind % plan->width,
+                  (ind / plan->width) % plan->height,
+                  ind / (plan->width * plan->height),
+                  0)++;
+    }
+  }
+
+  return (TrgVol);
+}
+
+/*------------------------------------------------------------
+  VOL2SURFplanWrite() - saves a sampling plan so that it can be
+  reused by later invocations (eg, mri_vol2surf --plan). The file
+  is big-endian like the other FreeSurfer binary formats.
+  ------------------------------------------------------------*/
+int VOL2SURFplanWrite(VOL2SURF_PLAN *plan, const char *fname)
+{
+  FILE *fp;
+  size_t n, nsamples;
+
+  fp = fopen(fname, "wb");
+  if (fp == NULL) ErrorReturn(ERROR_NOFILE, (ERROR_NOFILE, "VOL2SURFplanWrite(): could not open %s", fname));
+
+  fwriteInt(VOL2SURF_PLAN_MAGIC, fp);
+  fwriteInt(VOL2SURF_PLAN_VERSION, fp);
+  fwriteInt(plan->nvertices, fp);
+  fwriteInt(plan->nproj, fp);
+  fwriteInt(plan->nweights, fp);
+  fwriteInt(plan->width, fp);
+  fwriteInt(plan->height, fp);
+  fwriteInt(plan->depth, fp);
+  fwriteInt(plan->interp, fp);
+  fwriteInt(plan->ProjDistFlag, fp);
+  fwriteFloat(plan->ProjFracMin, fp);
+  fwriteFloat(plan->ProjFracMax, fp);
+  fwriteFloat(plan->ProjFracDelta, fp);
+
+  nsamples = (size_t)plan->nvertices * plan->nproj;
+  for (n = 0; n < nsamples; n++) fwriteInt(plan->hitindex[n], fp);
+  for (n = 0; n < nsamples * plan->nweights; n++) fwriteInt(plan->index[n], fp);
+  for (n = 0; n < nsamples * plan->nweights; n++) fwriteFloat(plan->weight[n], fp);
+
+  if (ferror(fp)) {
+    fclose(fp);
+    ErrorReturn(ERROR_BADFILE, (ERROR_BADFILE, "VOL2SURFplanWrite(): error writing %s", fname));
+  }
+  fclose(fp);
+  return (NO_ERROR);
+}
+
+/*------------------------------------------------------------
+  VOL2SURFplanRead() - reads a plan written by VOL2SURFplanWrite().
+  ------------------------------------------------------------*/
+VOL2SURF_PLAN *VOL2SURFplanRead(const char *fname)
+{
+  FILE *fp;
+  VOL2SURF_PLAN *plan;
+  int magic, version, nvertices, nproj, nweights;
+  size_t n, nsamples;
+
+  fp = fopen(fname, "rb");
+  if (fp == NULL) ErrorReturn(NULL, (ERROR_NOFILE, "VOL2SURFplanRead(): could not open %s", fname));
+
+  magic = freadInt(fp);
+  version = freadInt(fp);
+  if (magic != VOL2SURF_PLAN_MAGIC || version != VOL2SURF_PLAN_VERSION) {
+    fclose(fp);
+    ErrorReturn(NULL, (ERROR_BADFILE, "VOL2SURFplanRead(): %s is not a vol2surf plan (version %d)", fname, version));
+  }
+  nvertices = freadInt(fp);
+  nproj = freadInt(fp);
+  nweights = freadInt(fp);
+  if (nvertices <= 0 || nproj <= 0 || (nweights != 1 && nweights != 8)) {
+    fclose(fp);
+    ErrorReturn(NULL, (ERROR_BADFILE, "VOL2SURFplanRead(): %s has a corrupt header", fname));
+  }
+  plan = VOL2SURFplanAlloc(nvertices, nproj, nweights);
+  plan->width = freadInt(fp);
+  plan->height = freadInt(fp);
+  plan->depth = freadInt(fp);
+  plan->interp = freadInt(fp);
+  plan->ProjDistFlag = freadInt(fp);
+  plan->ProjFracMin = freadFloat(fp);
+  plan->ProjFracMax = freadFloat(fp);
+  plan->ProjFracDelta = freadFloat(fp);
+
+  nsamples = (size_t)plan->nvertices * plan->nproj;
+  for (n = 0; n < nsamples; n++) plan->hitindex[n] = freadInt(fp);
+  for (n = 0; n < nsamples * plan->nweights; n++) plan->index[n] = freadInt(fp);
+  for (n = 0; n < nsamples * plan->nweights; n++) plan->weight[n] = freadFloat(fp);
+
+  if (feof(fp) || ferror(fp)) {
+    fclose(fp);
+    VOL2SURFplanFree(&plan);
+    ErrorReturn(NULL, (ERROR_BADFILE, "VOL2SURFplanRead(): %s is truncated", fname));
+  }
+  fclose(fp);
+  return (plan);
+}
+
 /*!
 \fn MRI *MRISapplyReg(MRI *SrcSurfVals, MRI_SURFACE **SurfReg, int nsurfs,
                   int ReverseMapFlag, int DoJac, int UseHash)
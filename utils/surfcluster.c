@@ -45,6 +45,7 @@
 #include "volcluster.h"
 
 static int sclustCompare(const void *a, const void *b);
+static int sclustFindRoot(int *parent, int vtx);
 
 /*---------------------------------------------------------------
   sculstSrcVersion(void) - returns CVS version of this file.
@@ -63,34 +64,42 @@ SCS *sclustMapSurfClusters(
     MRI_SURFACE *Surf, float thmin, float thmax, int thsign, float minarea, int *nClusters, MATRIX *XFM)
 {
   SCS *scs, *scs_sorted;
-  int vtx, vtx_inrange, vtx_clustno, CurrentClusterNo;
-  float vtx_val, ClusterArea;
-  int nVtxsInCluster;
-
-  /* initialized all cluster numbers to 0 */
-  for (vtx = 0; vtx < Surf->nvertices; vtx++) Surf->vertices[vtx].undefval = 0; /* overloads this elem of struct */
-
-  /* Go through each vertex looking for one that meets the threshold
-     criteria and has not been previously assigned to a cluster.
-     When found, grow it out. */
-  CurrentClusterNo = 1;
-  for (vtx = 0; vtx < Surf->nvertices; vtx++) {
-    vtx_val = Surf->vertices[vtx].val;
-    vtx_clustno = Surf->vertices[vtx].undefval;
-    vtx_inrange = clustValueInRange(vtx_val, thmin, thmax, thsign);
-
-    if (vtx_clustno == 0 && vtx_inrange) {
-      sclustGrowSurfCluster(CurrentClusterNo, vtx, Surf, thmin, thmax, thsign);
-      if (minarea > 0) {
-        /* If the cluster does not meet the area criteria, delete it */
-        ClusterArea = sclustSurfaceArea(CurrentClusterNo, Surf, &nVtxsInCluster);
-        if (ClusterArea < minarea) {
-          sclustZeroSurfaceClusterNo(CurrentClusterNo, Surf);
-          continue;
-        }
-      }
+  int vtx, c, nLabeled, CurrentClusterNo, *ClusterMap;
+  float *ClusterArea, area;
+
+  /* Label each vertex that meets the threshold criteria with the number
+     of its cluster. Clusters are numbered in order of their first
+     vertex, as if grown from each unassigned vertex in turn. */
+  nLabeled = sclustLabelSurfClusters(Surf, thmin, thmax, thsign);
+  CurrentClusterNo = nLabeled + 1;
+
+  if (minarea > 0 && nLabeled > 0) {
+    /* Delete the clusters that do not meet the area criteria and
+       renumber the rest. Areas are accumulated for all clusters in one
+       pass, the same way sclustSurfaceArea() computes them. */
+    ClusterArea = (float *)calloc(nLabeled + 1, sizeof(float));
+    ClusterMap = (int *)calloc(nLabeled + 1, sizeof(int));
+    for (vtx = 0; vtx < Surf->nvertices; vtx++) {
+      c = Surf->vertices[vtx].undefval;
+      if (c == 0) continue;
+      if (!Surf->group_avg_vtxarea_loaded)
+        ClusterArea[c] += Surf->vertices[vtx].area;
+      else
+        ClusterArea[c] += Surf->vertices[vtx].group_avg_area;
+    }
+    CurrentClusterNo = 1;
+    for (c = 1; c <= nLabeled; c++) {
+      area = ClusterArea[c];
+      if (Surf->group_avg_surface_area > 0 && !Surf->group_avg_vtxarea_loaded)
+        area *= (Surf->group_avg_surface_area / Surf->total_area);
+      if (area < minarea) continue;
+      ClusterMap[c] = CurrentClusterNo;
       CurrentClusterNo++;
     }
+    for (vtx = 0; vtx < Surf->nvertices; vtx++)
+      Surf->vertices[vtx].undefval = ClusterMap[Surf->vertices[vtx].undefval];
+    free(ClusterArea);
+    free(ClusterMap);
   }
 
   *nClusters = CurrentClusterNo - 1;
@@ -127,7 +136,7 @@ SCS *sclustMapSurfClusters(
    ------------------------------------------------------------ */
 int sclustGrowSurfCluster(int ClusterNo, int SeedVtx, MRI_SURFACE *Surf, float thmin, float thmax, int thsign)
 {
-  int nbr, nbr_vtx, nbr_inrange, nbr_clustno;
+  int nbr, vtx, nbr_vtx, nbr_inrange, nbr_clustno, nstack, *stack;
   float nbr_val;
 
   if (ClusterNo == 0) {
@@ -135,20 +144,124 @@ int sclustGrowSurfCluster(int ClusterNo, int SeedVtx, MRI_SURFACE *Surf, float t
     return (1);
   }
 
+  /* Depth-first with an explicit stack (each vertex is pushed at most
+     once) so that large clusters cannot overflow the call stack */
+  stack = (int *)calloc(Surf->nvertices, sizeof(int));
+  if (stack == NULL) {
+    printf("ERROR: clustGrowSurfCluster(): could not alloc stack\n");
+    return (1);
+  }
   Surf->vertices[SeedVtx].undefval = ClusterNo;
-
-  for (nbr = 0; nbr < Surf->vertices[SeedVtx].vnum; nbr++) {
-    nbr_vtx = Surf->vertices[SeedVtx].v[nbr];
-    nbr_clustno = Surf->vertices[nbr_vtx].undefval;
-    if (nbr_clustno != 0) continue;
-    nbr_val = Surf->vertices[nbr_vtx].val;
-    if (fabs(nbr_val) < thmin) continue;
-    nbr_inrange = clustValueInRange(nbr_val, thmin, thmax, thsign);
-    if (!nbr_inrange) continue;
-    sclustGrowSurfCluster(ClusterNo, nbr_vtx, Surf, thmin, thmax, thsign);
+  stack[0] = SeedVtx;
+  nstack = 1;
+  while (nstack > 0) {
+    vtx = stack[--nstack];
+    for (nbr = 0; nbr < Surf->vertices[vtx].vnum; nbr++) {
+      nbr_vtx = Surf->vertices[vtx].v[nbr];
+      nbr_clustno = Surf->vertices[nbr_vtx].undefval;
+      if (nbr_clustno != 0) continue;
+      nbr_val = Surf->vertices[nbr_vtx].val;
+      if (fabs(nbr_val) < thmin) continue;
+      nbr_inrange = clustValueInRange(nbr_val, thmin, thmax, thsign);
+      if (!nbr_inrange) continue;
+      Surf->vertices[nbr_vtx].undefval = ClusterNo;
+      stack[nstack++] = nbr_vtx;
+    }
   }
+  free(stack);
   return (0);
 }
+/* ------------------------------------------------------------
+   sclustLabelSurfClusters() - sets the undefval of every vertex
+   that meets the threshold criteria to the number of its cluster
+   (and of all other vertices to 0) using a union-find over the
+   surface edges. Clusters are numbered from 1 in the order of
+   their lowest-numbered vertex, ie, the same numbers as growing
+   a cluster from each unassigned vertex in turn. Returns the
+   number of clusters.
+   ------------------------------------------------------------ */
+int sclustLabelSurfClusters(MRI_SURFACE *Surf, float thmin, float thmax, int thsign)
+{
+  int vtx, nbr, nbr_vtx, root, nbr_root, nClusters, *parent;
+  VERTEX *v;
+
+  parent = (int *)calloc(Surf->nvertices, sizeof(int));
+  if (parent == NULL) {
+    printf("ERROR: sclustLabelSurfClusters(): could not alloc %d\n", Surf->nvertices);
+    return (0);
+  }
+  for (vtx = 0; vtx < Surf->nvertices; vtx++) {
+    Surf->vertices[vtx].undefval = 0;
+    if (clustValueInRange(Surf->vertices[vtx].val, thmin, thmax, thsign))
+      parent[vtx] = vtx;
+    else
+      parent[vtx] = -1;
+  }
+
+  /* Join the trees of neighboring vertices, always under the
+     lower-numbered root so that a parent never comes after its child */
+  for (vtx = 0; vtx < Surf->nvertices; vtx++) {
+    if (parent[vtx] < 0) continue;
+    v = &Surf->vertices[vtx];
+    for (nbr = 0; nbr < v->vnum; nbr++) {
+      nbr_vtx = v->v[nbr];
+      if (parent[nbr_vtx] < 0) continue;
+      root = sclustFindRoot(parent, vtx);
+      nbr_root = sclustFindRoot(parent, nbr_vtx);
+      if (nbr_root < root)
+        parent[root] = nbr_root;
+      else if (root < nbr_root)
+        parent[nbr_root] = root;
+    }
+  }
+
+  nClusters = 0;
+  for (vtx = 0; vtx < Surf->nvertices; vtx++) {
+    if (parent[vtx] < 0) continue;
+    if (parent[vtx] == vtx)
+      Surf->vertices[vtx].undefval = ++nClusters;
+    else
+      Surf->vertices[vtx].undefval = Surf->vertices[parent[vtx]].undefval;
+  }
+
+  free(parent);
+  return (nClusters);
+}
+/* ------------------------------------------------------------
+   sclustMaxClusterStats() - labels the clusters like
+   sclustMapSurfClusters() (with no area threshold) and returns the
+   max cluster area, number of vertices and vertex-weighted weight
+   (any of which can be NULL) without sorting the clusters or
+   building a sorted summary. This is all cluster simulations need.
+   The undefval of each vertex is left as its unsorted cluster
+   number. Returns the number of clusters.
+   ------------------------------------------------------------ */
+int sclustMaxClusterStats(MRI_SURFACE *Surf,
+                          float thmin,
+                          float thmax,
+                          int thsign,
+                          double *maxarea,
+                          int *maxcount,
+                          float *maxweightvtx)
+{
+  int nClusters;
+  SCS *scs;
+
+  if (maxarea) *maxarea = 0;
+  if (maxcount) *maxcount = 0;
+  if (maxweightvtx) *maxweightvtx = 0;
+
+  nClusters = sclustLabelSurfClusters(Surf, thmin, thmax, thsign);
+  if (nClusters == 0) return (0);
+
+  scs = SurfClusterSummary(Surf, NULL, &nClusters);
+  if (maxarea) *maxarea = sclustMaxClusterArea(scs, nClusters);
+  if (maxcount) *maxcount = sclustMaxClusterCount(scs, nClusters);
+  if (maxweightvtx) *maxweightvtx = sclustMaxClusterWeightVtx(scs, nClusters, thsign);
+  free(scs);
+
+  return (nClusters);
+}
 /*----------------------------------------------------------------
   sclustSurfaceArea() - computes the surface area (in mm^2) of a
   cluster. Note:   MRIScomputeMetricProperties() must have been
@@ -688,6 +801,20 @@ static int sclustCompare(const void *a, const void *b)
   return (0);
 }
 
+/*----------------------------------------------------------------
+  sclustFindRoot() - returns the root of vtx in the union-find
+  forest used by sclustLabelSurfClusters(), halving the path on
+  the way up.
+  ----------------------------------------------------------------*/
+static int sclustFindRoot(int *parent, int vtx)
+{
+  while (parent[vtx] != vtx) {
+    parent[vtx] = parent[parent[vtx]];
+    vtx = parent[vtx];
+  }
+  return (vtx);
+}
+
 /*-------------------------------------------------------------------
   sclustMaxClusterArea() - returns the area of the cluster with the
   maximum area.
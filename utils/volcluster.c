@@ -46,6 +46,7 @@
 const char *vclustSrcVersion(void) { return ("$Id: volcluster.c,v 1.57 2016/11/01 19:43:00 greve Exp $"); }
 
 static int ConvertCRS2XYZ(int col, int row, int slc, MATRIX *CRS2XYZ, float *x, float *y, float *z);
+static int clustFindRoot(int *parent, int idx);
 
 /*----------------------------------------------------------------*/
 VOLCLUSTER *clustAllocCluster(int nmembers)
@@ -440,6 +441,233 @@ VOLCLUSTER *clustGrow(int col0, int row0, int slc0, MRI *HitMap, int AllowDiag)
   return (vc);
 }
 
+/*------------------------------------------------------------------------
+  clustLabelVolume() - labels the clusters of voxels in vol that are
+  within the threshold range (and non-zero in binmask if binmask is
+  non-NULL) in two passes with a union-find instead of growing them
+  voxel by voxel. nbrs is the connectivity: 6 (shared face), 18 (face
+  or edge) or 26 (face, edge or corner). Returns an array with the
+  cluster number of each voxel, indexed by (col*height + row)*depth +
+  slc, 0 for voxels not in a cluster. Clusters are numbered from 1 in
+  the order of their first voxel in col/row/slc order, which is the
+  order in which clustGrow() seeds them. The number of clusters is
+  returned in nClusters, and the number of voxels in range in nhits
+  if nhits is not NULL. The caller must free() the array.
+  ------------------------------------------------------------------------*/
+int *clustLabelVolume(MRI *vol,
+                      int frame,
+                      float thmin,
+                      float thmax,
+                      int thsign,
+                      MRI *binmask,
+                      int maskframe,
+                      int nbrs,
+                      int *nClusters,
+                      int *nhits)
+{
+  int col, row, slc, dcol, drow, dslc, ncol, nrow, nslc, nth, noff, maxdsum;
+  int offcol[13], offrow[13], offslc[13];
+  int idx, nidx, root, nroot, nvox, nc, nh, maskval, *ClustNo;
+  float val;
+
+  *nClusters = 0;
+  if (nhits) *nhits = 0;
+  if (nbrs == 6)
+    maxdsum = 1;
+  else if (nbrs == 18)
+    maxdsum = 2;
+  else if (nbrs == 26)
+    maxdsum = 3;
+  else {
+    printf("ERROR: clustLabelVolume: connectivity must be 6, 18, or 26, not %d\n", nbrs);
+    return (NULL);
+  }
+
+  /* neighbors that come before a voxel in col/row/slc order */
+  noff = 0;
+  for (dcol = -1; dcol <= 0; dcol++) {
+    for (drow = -1; drow <= +1; drow++) {
+      for (dslc = -1; dslc <= +1; dslc++) {
+        if (dcol == 0 && (drow > 0 || (drow == 0 && dslc >= 0))) continue;
+        if (abs(dcol) + abs(drow) + abs(dslc) > maxdsum) continue;
+        offcol[noff] = dcol;
+        offrow[noff] = drow;
+        offslc[noff] = dslc;
+        noff++;
+      }
+    }
+  }
+
+  nvox = vol->width * vol->height * vol->depth;
+  ClustNo = (int *)calloc(nvox, sizeof(int));
+  if (ClustNo == NULL) {
+    printf("ERROR: clustLabelVolume: could not alloc %d voxels\n", nvox);
+    return (NULL);
+  }
+
+  /* First pass: ClustNo[idx] = 1 + the parent of voxel idx in its
+     cluster's tree. Trees are always linked to the smaller root, so
+     each root is the first voxel of its cluster and a voxel's parent
+     never comes after it. */
+  nh = 0;
+  for (col = 0; col < vol->width; col++) {
+    for (row = 0; row < vol->height; row++) {
+      for (slc = 0; slc < vol->depth; slc++) {
+        if (binmask != NULL) {
+          maskval = MRIgetVoxVal(binmask, col, row, slc, maskframe);
+          if (maskval == 0) continue;
+        }
+        val = MRIgetVoxVal(vol, col, row, slc, frame);
+        if (!clustValueInRange(val, thmin, thmax, thsign)) continue;
+        nh++;
+        idx = (col * vol->height + row) * vol->depth + slc;
+        ClustNo[idx] = idx + 1;
+        for (nth = 0; nth < noff; nth++) {
+          ncol = col + offcol[nth];
+          nrow = row + offrow[nth];
+          nslc = slc + offslc[nth];
+          if (ncol < 0 || nrow < 0 || nrow >= vol->height || nslc < 0 || nslc >= vol->depth) continue;
+          nidx = (ncol * vol->height + nrow) * vol->depth + nslc;
+          if (ClustNo[nidx] == 0) continue;
+          root = clustFindRoot(ClustNo, idx);
+          nroot = clustFindRoot(ClustNo, nidx);
+          if (nroot < root)
+            ClustNo[root] = nroot + 1;
+          else if (root < nroot)
+            ClustNo[nroot] = root + 1;
+        }
+      }
+    }
+  }
+
+  /* Second pass: number the roots in order. Parents come first, so by
+     the time a voxel is reached its parent already holds the (negated)
+     cluster number. */
+  nc = 0;
+  for (idx = 0; idx < nvox; idx++) {
+    if (ClustNo[idx] == 0) continue;
+    if (ClustNo[idx] - 1 == idx) {
+      nc++;
+      ClustNo[idx] = -nc;
+    }
+    else
+      ClustNo[idx] = ClustNo[ClustNo[idx] - 1];
+  }
+  for (idx = 0; idx < nvox; idx++) ClustNo[idx] = -ClustNo[idx];
+
+  if (Gdiag_no > 1) printf("INFO: clustLabelVolume: found %d hits in %d clusters\n", nh, nc);
+  *nClusters = nc;
+  if (nhits) *nhits = nh;
+  return (ClustNo);
+}
+
+/*------------------------------------------------------------------------
+  clustLabelsToClusterList() - builds the cluster list from the cluster
+  numbers computed by clustLabelVolume() with the same connectivity.
+  The members of each cluster are listed in the order clustGrow() adds
+  them when seeded with the cluster's first voxel, so the results (eg,
+  the maximum member) are the same as growing the clusters. ClustNo is
+  used as scratch space and is restored on return.
+  ------------------------------------------------------------------------*/
+VOLCLUSTER **clustLabelsToClusterList(MRI *vol, int *ClustNo, int nClusters, int nbrs)
+{
+  VOLCLUSTER **vclist, *vc;
+  int *nmembers, *seed, nvox, idx, nidx, c, n, nmemb;
+  int col, row, slc, ncol, nrow, nslc, dcol, drow, dslc, dsum, maxdsum;
+
+  maxdsum = (nbrs == 26) ? 3 : ((nbrs == 18) ? 2 : 1);
+  nvox = vol->width * vol->height * vol->depth;
+
+  vclist = clustAllocClusterList(nClusters + 1);
+  nmembers = (int *)calloc(nClusters + 1, sizeof(int));
+  seed = (int *)calloc(nClusters + 1, sizeof(int));
+  if (vclist == NULL || nmembers == NULL || seed == NULL) {
+    printf("ERROR: clustLabelsToClusterList: could not alloc %d clusters\n", nClusters);
+    return (NULL);
+  }
+  for (idx = nvox - 1; idx >= 0; idx--) {
+    c = ClustNo[idx];
+    if (c == 0) continue;
+    nmembers[c]++;
+    seed[c] = idx;
+  }
+
+  for (c = 1; c <= nClusters; c++) {
+    vc = clustAllocCluster(nmembers[c]);
+    vc->voxsize = vol->xsize * vol->ysize * vol->zsize;
+    vclist[c - 1] = vc;
+
+    /* breadth-first from the seed, using the member list as the queue
+       and the sign of ClustNo to mark voxels already added */
+    idx = seed[c];
+    vc->slc[0] = idx % vol->depth;
+    vc->row[0] = (idx / vol->depth) % vol->height;
+    vc->col[0] = idx / (vol->depth * vol->height);
+    ClustNo[idx] = -c;
+    nmemb = 1;
+    for (n = 0; n < nmemb; n++) {
+      col = vc->col[n];
+      row = vc->row[n];
+      slc = vc->slc[n];
+      for (dcol = -1; dcol <= +1; dcol++) {
+        for (drow = -1; drow <= +1; drow++) {
+          for (dslc = -1; dslc <= +1; dslc++) {
+            dsum = abs(dcol) + abs(drow) + abs(dslc);
+            if (dsum == 0 || dsum > maxdsum) continue;
+            ncol = col + dcol;
+            if (ncol < 0 || ncol >= vol->width) continue;
+            nrow = row + drow;
+            if (nrow < 0 || nrow >= vol->height) continue;
+            nslc = slc + dslc;
+            if (nslc < 0 || nslc >= vol->depth) continue;
+            nidx = (ncol * vol->height + nrow) * vol->depth + nslc;
+            if (ClustNo[nidx] != c) continue;
+            ClustNo[nidx] = -c;
+            vc->col[nmemb] = ncol;
+            vc->row[nmemb] = nrow;
+            vc->slc[nmemb] = nslc;
+            nmemb++;
+          }
+        }
+      }
+    }
+  }
+  for (idx = 0; idx < nvox; idx++)
+    if (ClustNo[idx] < 0) ClustNo[idx] = -ClustNo[idx];
+
+  free(nmembers);
+  free(seed);
+  return (vclist);
+}
+
+/*------------------------------------------------------------------------
+  clustMaxClusterSize() - returns the number of voxels in the largest
+  cluster without building the cluster list. This is all that cluster
+  simulations need. Same as clustMaxClusterCount() on the list
+  returned by clustGetClusters() when nbrs=6 and there is no size
+  threshold. The number of clusters is returned in nClusters. Returns
+  -1 on error.
+  ------------------------------------------------------------------------*/
+int clustMaxClusterSize(
+    MRI *vol, int frame, float thmin, float thmax, int thsign, MRI *binmask, int nbrs, int *nClusters)
+{
+  int *ClustNo, *nmembers, nvox, idx, c, MaxCount;
+
+  ClustNo = clustLabelVolume(vol, frame, thmin, thmax, thsign, binmask, 0, nbrs, nClusters, NULL);
+  if (ClustNo == NULL) return (-1);
+
+  nvox = vol->width * vol->height * vol->depth;
+  nmembers = (int *)calloc(*nClusters + 1, sizeof(int));
+  for (idx = 0; idx < nvox; idx++) nmembers[ClustNo[idx]]++;
+  MaxCount = 0;
+  for (c = 1; c <= *nClusters; c++)
+    if (nmembers[c] > MaxCount) MaxCount = nmembers[c];
+
+  free(nmembers);
+  free(ClustNo);
+  return (MaxCount);
+}
+
 /*-------------------------------------------------------------------*/
 int clustMaxMember(VOLCLUSTER *vc, MRI *vol, int frame, int thsign)
 {
@@ -792,58 +1020,34 @@ VOLCLUSTER **clustGetClusters(MRI *vol,
                               int *nClusters,
                               MATRIX *XFM)
 {
-  int nthhit, nclusters, nhits, *hitcol = NULL, *hitrow = NULL, *hitslc = NULL;
-  int col, row, slc, allowdiag = 0, nprunedclusters;
-  MRI *HitMap;
+  int n, nclusters, nhits, *ClustNo, nprunedclusters;
   VOLCLUSTER **ClusterList, **ClusterList2;
   float voxsizemm3, distthresh = 0;
 
   voxsizemm3 = vol->xsize * vol->ysize * vol->zsize;
 
-  /* Initialize the hit map - this is a map of voxels that have been
-     accounted for as either outside of a the threshold range or
-     belonging to a cluster. The initialization is for thresholding */
-  HitMap = clustInitHitMap(vol, frame, threshmin, threshmax, threshsign, &nhits, &hitcol, &hitrow, &hitslc, binmask, 0);
-  if (HitMap == NULL) {
-    // Nothing survived the first thresholding
+  /* Label the voxels in the threshold range by cluster (face
+     connectivity) */
+  ClustNo = clustLabelVolume(vol, frame, threshmin, threshmax, threshsign, binmask, 0, 6, &nclusters, &nhits);
+  if (ClustNo == NULL) {
     *nClusters = 0;
     return (NULL);
   }
   if (Gdiag_no > 0) printf("INFO: Found %d voxels in threhold range\n", nhits);
 
-  /* Allocate an array of clusters equal to the number of hits -- this
-     is the maximum number of clusters possible */
-  ClusterList = clustAllocClusterList(nhits);
+  ClusterList = clustLabelsToClusterList(vol, ClustNo, nclusters, 6);
+  free(ClustNo);
   if (ClusterList == NULL) {
-    printf("ERROR: could not alloc %d clusters\n", nhits);
+    printf("ERROR: could not alloc %d clusters\n", nclusters);
+    *nClusters = 0;
     return (NULL);
   }
 
-  nclusters = 0;
-  for (nthhit = 0; nthhit < nhits; nthhit++) {
-    /* Determine whether this hit is still valid. It may
-       not be if it was assigned to the cluster of a
-       previous hit */
-    col = hitcol[nthhit];
-    row = hitrow[nthhit];
-    slc = hitslc[nthhit];
-    if (MRIgetVoxVal(HitMap, col, row, slc, 0)) continue;
-
-    /* Grow cluster using this hit as a seed */
-    ClusterList[nclusters] = clustGrow(col, row, slc, HitMap, allowdiag);
-    ClusterList[nclusters]->voxsize = voxsizemm3;
-
+  for (n = 0; n < nclusters; n++) {
     /* Determine the member with the maximum value */
-    clustMaxMember(ClusterList[nclusters], vol, frame, threshsign);
-
-    if (XFM) clustComputeTal(ClusterList[nclusters], XFM);
-
-    /* increment the number of clusters */
-    nclusters++;
+    clustMaxMember(ClusterList[n], vol, frame, threshsign);
+    if (XFM) clustComputeTal(ClusterList[n], XFM);
   }
-  free(hitcol);
-  free(hitrow);
-  free(hitslc);
 
   if (Gdiag_no > 0) printf("INFO: Found %d clusters that meet threshold criteria\n", nclusters);
 
@@ -869,8 +1073,6 @@ VOLCLUSTER **clustGetClusters(MRI *vol,
   clustFreeClusterList(&ClusterList, nclusters);
   ClusterList = ClusterList2;
 
-  MRIfree(&HitMap);
-
   if (Gdiag_no > 0) printf("INFO: Found %d final clusters\n", nclusters);
   *nClusters = nclusters;
   return (ClusterList);
@@ -923,6 +1125,20 @@ int clustDumpSummary(FILE *fp, VOLCLUSTER **ClusterList, int nClusters)
 
 /*-------------------------------------------------------------*/
 
+/*------------------------------------------------------------------------
+  clustFindRoot() - returns the root of voxel idx in the union-find
+  forest used by clustLabelVolume() (parent[i] holds 1 + the parent of
+  i), halving the path on the way up.
+  ------------------------------------------------------------------------*/
+static int clustFindRoot(int *parent, int idx)
+{
+  while (parent[idx] - 1 != idx) {
+    parent[idx] = parent[parent[idx] - 1];
+    idx = parent[idx] - 1;
+  }
+  return (idx);
+}
+
 /*----------------------------------------------------------------
   ConvertCRS2XYZ() - computes the xyz coordinate given the CRS and
   the transform matrix. This function just hides the matrix